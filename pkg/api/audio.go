@@ -1,7 +1,6 @@
 package api
 
 import (
-	"bytes"
 	"encoding/json"
 	"fmt"
 	"io"
@@ -18,6 +17,8 @@ import (
 type command struct {
 	Type  int16       `json:"type"`
 	Value interface{} `json:"value"`
+	Gain  *float64    `json:"gain,omitempty"`
+	Pan   *float64    `json:"pan,omitempty"`
 }
 
 type postCommandRequest struct {
@@ -31,17 +32,12 @@ func PostAudioCommand(w http.ResponseWriter, r *http.Request) error {
 		isForcePush = 1
 	}
 
-	buf := &bytes.Buffer{}
-
-	if _, err := io.Copy(buf, r.Body); err != nil {
-		log.Println(err)
-		return fmt.Errorf("Requested JSON is broken")
-	}
-
-	log.Printf("body=%s\n", buf.Bytes())
 	var req postCommandRequest
 
-	if err := json.Unmarshal(buf.Bytes(), &req); err != nil {
+	// Decoded as it is read. The body is not logged, since this runs on
+	// every keystroke; clients that care about latency push through the
+	// command pipe of the DLL instead.
+	if err := json.NewDecoder(r.Body).Decode(&req); err != nil {
 		log.Println(err)
 		return fmt.Errorf("Requested JSON is invalid")
 	}
@@ -51,10 +47,18 @@ func PostAudioCommand(w http.ResponseWriter, r *http.Request) error {
 
 	for i, v := range req.Commands {
 		cs[i].Type = v.Type
+		cs[i].Gain = 1.0
 
 		switch v.Type {
 		case types.EnumSFX:
 			cs[i].SFXIndex = int16(v.Value.(float64))
+
+			if v.Gain != nil {
+				cs[i].Gain = float32(*v.Gain)
+			}
+			if v.Pan != nil {
+				cs[i].Pan = float32(*v.Pan)
+			}
 		case types.EnumWait:
 			cs[i].WaitDuration = uintptr(math.Float64bits(v.Value.(float64)))
 		case types.EnumText, types.EnumSSML:
@@ -126,9 +130,39 @@ func GetAudioPause(w http.ResponseWriter, r *http.Request) error {
 	return nil
 }
 
+func PostAudioLatency(w http.ResponseWriter, r *http.Request) error {
+	var mode int32
+
+	switch r.URL.Query().Get("mode") {
+	case "default":
+		mode = 0
+	case "low":
+		mode = 1
+	default:
+		return fmt.Errorf("Query parameter 'mode' must be 'default' or 'low'")
+	}
+
+	var code int32
+
+	dll.ProcSetLatencyMode.Call(uintptr(unsafe.Pointer(&code)), uintptr(mode))
+
+	if code != 0 {
+		log.Printf("Failed to call SetLatencyMode (code=%v)", code)
+		return fmt.Errorf("Internal error")
+	}
+	if _, err := io.WriteString(w, "{}"); err != nil {
+		log.Println(err)
+		return fmt.Errorf("Internal error")
+	}
+
+	return nil
+}
+
 func GetAudioEnable(w http.ResponseWriter, r *http.Request) error {
 	var code int32
 
+	defer voiceSnapshot.Invalidate()
+
 	dll.ProcSetup.Call(uintptr(unsafe.Pointer(&code)), uintptr(0))
 
 	if code != 0 {
@@ -145,6 +179,8 @@ func GetAudioEnable(w http.ResponseWriter, r *http.Request) error {
 func GetAudioDisable(w http.ResponseWriter, r *http.Request) error {
 	var code int32
 
+	defer voiceSnapshot.Invalidate()
+
 	dll.ProcTeardown.Call(uintptr(unsafe.Pointer(&code)))
 
 	if code != 0 {
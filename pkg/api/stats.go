@@ -0,0 +1,162 @@
+package api
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"io"
+	"log"
+	"net/http"
+	"unsafe"
+
+	"github.com/moutend/AudioNode/pkg/dll"
+	"github.com/moutend/AudioNode/pkg/types"
+)
+
+type latencyStage struct {
+	Name   string  `json:"name"`
+	Count  int64   `json:"count"`
+	MeanUs float64 `json:"meanUs"`
+	P50Us  float64 `json:"p50Us"`
+	P90Us  float64 `json:"p90Us"`
+	P99Us  float64 `json:"p99Us"`
+	P999Us float64 `json:"p999Us"`
+	MaxUs  float64 `json:"maxUs"`
+}
+
+type renderPeriod struct {
+	Sequence      int64 `json:"sequence"`
+	IntervalUs    int32 `json:"intervalUs"`
+	FillUs        int32 `json:"fillUs"`
+	PaddingFrames int32 `json:"paddingFrames"`
+	FramesWritten int32 `json:"framesWritten"`
+	Underrun      bool  `json:"underrun"`
+	Late          bool  `json:"late"`
+	Failed        bool  `json:"failed"`
+}
+
+type renderStats struct {
+	Periods       int64          `json:"periods"`
+	Underruns     int64          `json:"underruns"`
+	LateWakeups   int64          `json:"lateWakeups"`
+	Failures      int64          `json:"failures"`
+	FramesWritten int64          `json:"framesWritten"`
+	PeriodUs      int32          `json:"periodUs"`
+	FillP50Us     float64        `json:"fillP50Us"`
+	FillP99Us     float64        `json:"fillP99Us"`
+	FillMaxUs     float64        `json:"fillMaxUs"`
+	MaxLateUs     int32          `json:"maxLateUs"`
+	MMCSS         string         `json:"mmcss"`
+	Recent        []renderPeriod `json:"recent"`
+}
+
+type getStatsResponse struct {
+	Latency []latencyStage `json:"latency"`
+	Render  renderStats    `json:"render"`
+}
+
+// recentRenderPeriods is how many of the latest render periods GetStats
+// returns.
+const recentRenderPeriods = 64
+
+func GetStats(w http.ResponseWriter, r *http.Request) error {
+	var code int32
+	var stagesLength int32
+
+	summaries := make([]types.LatencySummary, len(types.LatencyStageNames))
+
+	dll.ProcGetLatencyStats.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&summaries[0])), uintptr(len(summaries)), uintptr(unsafe.Pointer(&stagesLength)))
+
+	if code != 0 {
+		log.Printf("Failed to call GetLatencyStats (code=%v)", code)
+		return fmt.Errorf("Internal error")
+	}
+	if int(stagesLength) < len(summaries) {
+		summaries = summaries[:stagesLength]
+	}
+
+	stages := make([]latencyStage, len(summaries))
+
+	for i, s := range summaries {
+		stages[i] = latencyStage{
+			Name:   types.LatencyStageNames[i],
+			Count:  s.Count,
+			MeanUs: s.Mean,
+			P50Us:  s.P50,
+			P90Us:  s.P90,
+			P99Us:  s.P99,
+			P999Us: s.P999,
+			MaxUs:  s.Max,
+		}
+	}
+
+	render, err := getRenderStats()
+
+	if err != nil {
+		return err
+	}
+
+	data, err := json.Marshal(getStatsResponse{Latency: stages, Render: render})
+
+	if err != nil {
+		log.Println(err)
+		return fmt.Errorf("Internal error")
+	}
+	if _, err = io.Copy(w, bytes.NewBuffer(data)); err != nil {
+		log.Println(err)
+		return fmt.Errorf("Internal error")
+	}
+
+	return nil
+}
+
+func getRenderStats() (renderStats, error) {
+	var code int32
+	var periodsWritten int32
+	var summary types.RenderSummary
+
+	periods := make([]types.RenderPeriodSample, recentRenderPeriods)
+
+	dll.ProcGetRenderTelemetry.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&summary)), uintptr(unsafe.Pointer(&periods[0])), uintptr(len(periods)), uintptr(unsafe.Pointer(&periodsWritten)))
+
+	if code != 0 {
+		log.Printf("Failed to call GetRenderTelemetry (code=%v)", code)
+		return renderStats{}, fmt.Errorf("Internal error")
+	}
+
+	mmcss := types.MMCSSStatusNames[0]
+
+	if int(summary.MMCSS) < len(types.MMCSSStatusNames) && summary.MMCSS >= 0 {
+		mmcss = types.MMCSSStatusNames[summary.MMCSS]
+	}
+
+	recent := make([]renderPeriod, periodsWritten)
+
+	for i, p := range periods[:periodsWritten] {
+		recent[i] = renderPeriod{
+			Sequence:      p.Sequence,
+			IntervalUs:    p.IntervalMicros,
+			FillUs:        p.FillMicros,
+			PaddingFrames: p.PaddingFrames,
+			FramesWritten: p.FramesWritten,
+			Underrun:      p.Flags&types.RenderPeriodUnderrun != 0,
+			Late:          p.Flags&types.RenderPeriodLate != 0,
+			Failed:        p.Flags&types.RenderPeriodFailed != 0,
+		}
+	}
+
+	return renderStats{
+		Periods:       summary.Periods,
+		Underruns:     summary.Underruns,
+		LateWakeups:   summary.LateWakeups,
+		Failures:      summary.Failures,
+		FramesWritten: summary.FramesWritten,
+		PeriodUs:      summary.PeriodMicros,
+		FillP50Us:     summary.FillP50,
+		FillP99Us:     summary.FillP99,
+		FillMaxUs:     summary.FillMax,
+		MaxLateUs:     summary.MaxLateMicros,
+		MMCSS:         mmcss,
+		Recent:        recent,
+	}, nil
+}
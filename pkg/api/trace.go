@@ -0,0 +1,59 @@
+package api
+
+import (
+	"fmt"
+	"io"
+	"log"
+	"net/http"
+	"syscall"
+	"unsafe"
+
+	"github.com/moutend/AudioNode/pkg/dll"
+)
+
+func PostTraceStart(w http.ResponseWriter, r *http.Request) error {
+	path := r.URL.Query().Get("path")
+
+	if path == "" {
+		return fmt.Errorf("Query parameter 'path' is required")
+	}
+
+	pathPtr, err := syscall.BytePtrFromString(path)
+
+	if err != nil {
+		log.Println(err)
+		return fmt.Errorf("Query parameter 'path' is invalid")
+	}
+
+	var code int32
+
+	dll.ProcStartCommandTrace.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(pathPtr)))
+
+	if code != 0 {
+		log.Printf("Failed to call StartCommandTrace (code=%v)", code)
+		return fmt.Errorf("Failed to start command trace")
+	}
+	if _, err := io.WriteString(w, "{}"); err != nil {
+		log.Println(err)
+		return fmt.Errorf("Internal error")
+	}
+
+	return nil
+}
+
+func PostTraceStop(w http.ResponseWriter, r *http.Request) error {
+	var code int32
+
+	dll.ProcStopCommandTrace.Call(uintptr(unsafe.Pointer(&code)))
+
+	if code != 0 {
+		log.Printf("Failed to call StopCommandTrace (code=%v)", code)
+		return fmt.Errorf("No command trace is being recorded")
+	}
+	if _, err := io.WriteString(w, "{}"); err != nil {
+		log.Println(err)
+		return fmt.Errorf("Internal error")
+	}
+
+	return nil
+}
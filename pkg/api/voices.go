@@ -9,10 +9,10 @@ import (
 	"math"
 	"net/http"
 	"strconv"
-	"syscall"
 	"unsafe"
 
 	"github.com/moutend/AudioNode/pkg/dll"
+	"github.com/moutend/AudioNode/pkg/types"
 )
 
 type voiceProperty struct {
@@ -40,123 +40,26 @@ type getVoicesResponse struct {
 type putVoiceRequest rwVoiceProperty
 
 func GetVoices(w http.ResponseWriter, r *http.Request) error {
-	var code int32
-	var numberOfVoices int32
-
-	dll.ProcGetVoiceCount.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&numberOfVoices)))
-
-	if code != 0 {
-		log.Printf("Failed to call GetVoiceCount() code=%d", code)
-		return fmt.Errorf("Internal error")
-	}
+	snapshot, err := voiceSnapshot.Get()
 
-	var defaultVoiceIndex int32
-
-	dll.ProcGetDefaultVoice.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&defaultVoiceIndex)))
-
-	if code != 0 {
-		log.Printf("Failed to call GetDefaultVoice() code=%d", code)
+	if err != nil {
+		log.Println(err)
 		return fmt.Errorf("Internal error")
 	}
 
-	voiceProperties := make([]voiceProperty, numberOfVoices)
-
-	for i, _ := range voiceProperties {
-		var idLength int32
-
-		dll.ProcGetVoiceIdLength.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&idLength)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceIdLength() code=%d", code)
-			break
-		}
-
-		id := make([]uint16, idLength)
-
-		dll.ProcGetVoiceId.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&id[0])))
-
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceId() code=%d", code)
-			break
-		}
-
-		var displayNameLength int32
-
-		dll.ProcGetVoiceDisplayNameLength.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&displayNameLength)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceDisplayNameLength() code=%d", code)
-			break
-		}
-
-		displayName := make([]uint16, displayNameLength)
-
-		dll.ProcGetVoiceDisplayName.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&displayName[0])))
+	voiceProperties := make([]voiceProperty, len(snapshot.Voices))
 
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceDisplayName() code=%d", code)
-			break
-		}
-
-		var languageLength int32
-
-		dll.ProcGetVoiceLanguageLength.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&languageLength)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceLanguageLength() code=%d", code)
-			break
-		}
-
-		language := make([]uint16, languageLength)
-
-		dll.ProcGetVoiceLanguage.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&language[0])))
-
-		if code != 0 {
-			log.Printf("Failed to call GetVoiceLanguage() code=%d", code)
-			break
-		}
-
-		var speakingRate uint64
-
-		dll.ProcGetSpeakingRate.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&speakingRate)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetSpeakingRate (code=%d)", code)
-			break
-		}
-
-		var audioPitch uint64
-
-		dll.ProcGetAudioPitch.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&audioPitch)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetAudioPitch (code=%d)", code)
-			break
-		}
-
-		var audioVolume uint64
-
-		dll.ProcGetAudioVolume.Call(uintptr(unsafe.Pointer(&code)), uintptr(i), uintptr(unsafe.Pointer(&audioVolume)))
-
-		if code != 0 {
-			log.Printf("Failed to call GetAudioVolume (code=%d)", code)
-			break
-		}
-
-		voiceProperties[i].Id = syscall.UTF16ToString(id)
-		voiceProperties[i].DisplayName = syscall.UTF16ToString(displayName)
-		voiceProperties[i].Language = syscall.UTF16ToString(language)
-		voiceProperties[i].SpeakingRate = math.Float64frombits(speakingRate)
-		voiceProperties[i].AudioPitch = math.Float64frombits(audioPitch)
-		voiceProperties[i].AudioVolume = math.Float64frombits(audioVolume)
-	}
-	if code != 0 {
-		log.Printf("Failed to obtain voice info (code=%v)", code)
-		return fmt.Errorf("Internal error")
+	for i, v := range snapshot.Voices {
+		voiceProperties[i].Id = v.Id
+		voiceProperties[i].DisplayName = v.DisplayName
+		voiceProperties[i].Language = v.Language
+		voiceProperties[i].SpeakingRate = v.SpeakingRate
+		voiceProperties[i].AudioPitch = v.AudioPitch
+		voiceProperties[i].AudioVolume = v.AudioVolume
 	}
 
 	data, err := json.Marshal(getVoicesResponse{
-		DefaultVoiceIndex: defaultVoiceIndex,
+		DefaultVoiceIndex: snapshot.DefaultVoiceIndex,
 		Voices:            voiceProperties,
 	})
 
@@ -173,6 +76,24 @@ func GetVoices(w http.ResponseWriter, r *http.Request) error {
 	return nil
 }
 
+// defaultVoice returns the index and the cached properties of the default
+// voice.
+func defaultVoice() (int32, *types.VoiceProperty, error) {
+	snapshot, err := voiceSnapshot.Get()
+
+	if err != nil {
+		return 0, nil, err
+	}
+
+	index := snapshot.DefaultVoiceIndex
+
+	if index < 0 || int(index) >= len(snapshot.Voices) {
+		return 0, nil, fmt.Errorf("Default voice %d is out of range", index)
+	}
+
+	return index, &snapshot.Voices[index], nil
+}
+
 func PostVoice(w http.ResponseWriter, r *http.Request) error {
 	indexStr := r.URL.Query().Get("index")
 
@@ -205,6 +126,8 @@ func PostVoice(w http.ResponseWriter, r *http.Request) error {
 		return fmt.Errorf("Requested JSON is invalid")
 	}
 
+	defer voiceSnapshot.Invalidate()
+
 	var code int32
 
 	if req.SpeakingRate >= 0.0 {
@@ -262,30 +185,18 @@ func PostVoiceRate(w http.ResponseWriter, r *http.Request) error {
 		return nil
 	}
 
-	var code int32
-	var voiceIndex int32
-
-	dll.ProcGetDefaultVoice.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&voiceIndex)))
-
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetDefaultVoice (code=%v)", code)
+	voiceIndex, voice, err := defaultVoice()
 
+	if err != nil {
 		log.Println(err)
 		return err
 	}
 
-	var speakingRate uint64
-
-	dll.ProcGetSpeakingRate.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(unsafe.Pointer(&speakingRate)))
-
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetSpeakingRate (code=%v, index=%v)", code, voiceIndex)
+	defer voiceSnapshot.Invalidate()
 
-		log.Println(err)
-		return err
-	}
+	var code int32
 
-	newSpeakingRate := diffFloat64 + math.Float64frombits(speakingRate)
+	newSpeakingRate := diffFloat64 + voice.SpeakingRate
 
 	dll.ProcSetSpeakingRate.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(math.Float64bits(newSpeakingRate)))
 
@@ -323,30 +234,18 @@ func PostVoicePitch(w http.ResponseWriter, r *http.Request) error {
 		return nil
 	}
 
-	var code int32
-	var voiceIndex int32
-
-	dll.ProcGetDefaultVoice.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&voiceIndex)))
-
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetDefaultVoice (code=%v)", code)
+	voiceIndex, voice, err := defaultVoice()
 
+	if err != nil {
 		log.Println(err)
 		return err
 	}
 
-	var speakingPitch uint64
-
-	dll.ProcGetAudioPitch.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(unsafe.Pointer(&speakingPitch)))
+	defer voiceSnapshot.Invalidate()
 
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetAudioPitch (code=%v, index=%v)", code, voiceIndex)
-
-		log.Println(err)
-		return err
-	}
+	var code int32
 
-	newSpeakingPitch := diffFloat64 + math.Float64frombits(speakingPitch)
+	newSpeakingPitch := diffFloat64 + voice.AudioPitch
 
 	dll.ProcSetAudioPitch.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(math.Float64bits(newSpeakingPitch)))
 
@@ -384,30 +283,18 @@ func PostVoiceVolume(w http.ResponseWriter, r *http.Request) error {
 		return nil
 	}
 
-	var code int32
-	var voiceIndex int32
-
-	dll.ProcGetDefaultVoice.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&voiceIndex)))
-
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetDefaultVoice (code=%v)", code)
+	voiceIndex, voice, err := defaultVoice()
 
+	if err != nil {
 		log.Println(err)
 		return err
 	}
 
-	var speakingVolume uint64
-
-	dll.ProcGetAudioVolume.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(unsafe.Pointer(&speakingVolume)))
-
-	if code != 0 {
-		err := fmt.Errorf("Failed to call GetAudioVolume (code=%v, index=%v)", code, voiceIndex)
+	defer voiceSnapshot.Invalidate()
 
-		log.Println(err)
-		return err
-	}
+	var code int32
 
-	newSpeakingVolume := diffFloat64 + math.Float64frombits(speakingVolume)
+	newSpeakingVolume := diffFloat64 + voice.AudioVolume
 
 	dll.ProcSetAudioVolume.Call(uintptr(unsafe.Pointer(&code)), uintptr(voiceIndex), uintptr(math.Float64bits(newSpeakingVolume)))
 
@@ -0,0 +1,70 @@
+package api
+
+import (
+	"fmt"
+	"sync"
+	"unsafe"
+
+	"github.com/moutend/AudioNode/pkg/dll"
+	"github.com/moutend/AudioNode/pkg/types"
+)
+
+// voiceSnapshotCache keeps the last snapshot read from the DLL. Handlers that
+// change a voice or restart the engine invalidate it.
+type voiceSnapshotCache struct {
+	mutex    sync.Mutex
+	snapshot *types.VoiceSnapshot
+}
+
+var voiceSnapshot = &voiceSnapshotCache{}
+
+func (c *voiceSnapshotCache) Get() (*types.VoiceSnapshot, error) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+
+	if c.snapshot != nil {
+		return c.snapshot, nil
+	}
+
+	snapshot, err := readVoiceSnapshot()
+
+	if err != nil {
+		return nil, err
+	}
+
+	c.snapshot = snapshot
+
+	return snapshot, nil
+}
+
+func (c *voiceSnapshotCache) Invalidate() {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+
+	c.snapshot = nil
+}
+
+func readVoiceSnapshot() (*types.VoiceSnapshot, error) {
+	var code int32
+	var length int32
+
+	dll.ProcGetVoiceSnapshot.Call(uintptr(unsafe.Pointer(&code)), 0, 0, uintptr(unsafe.Pointer(&length)))
+
+	// The first call only reports the length, which only grows when the
+	// engine is set up again in between.
+	for attempt := 0; attempt < 3; attempt++ {
+		if code != 0 && code != -2 {
+			break
+		}
+
+		buffer := make([]byte, length)
+
+		dll.ProcGetVoiceSnapshot.Call(uintptr(unsafe.Pointer(&code)), uintptr(unsafe.Pointer(&buffer[0])), uintptr(len(buffer)), uintptr(unsafe.Pointer(&length)))
+
+		if code == 0 {
+			return types.ParseVoiceSnapshot(buffer)
+		}
+	}
+
+	return nil, fmt.Errorf("Failed to call GetVoiceSnapshot (code=%v)", code)
+}
@@ -25,6 +25,12 @@ func (a *app) setup() error {
 	mux.Get("/v1/audio/disable", api.GetAudioDisable)
 	mux.Get("/v1/audio/restart", api.GetAudioRestart)
 	mux.Get("/v1/audio/pause", api.GetAudioPause)
+	mux.Post("/v1/audio/latency", api.PostAudioLatency)
+
+	mux.Get("/v1/stats", api.GetStats)
+
+	mux.Post("/v1/trace/start", api.PostTraceStart)
+	mux.Post("/v1/trace/stop", api.PostTraceStop)
 
 	mux.Get("/v1/voices", api.GetVoices)
 	mux.Post("/v1/voice", api.PostVoice)
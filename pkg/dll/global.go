@@ -11,8 +11,14 @@ var (
 	ProcTeardown                  = dll.NewProc("Teardown")
 	ProcFadeIn                    = dll.NewProc("FadeIn")
 	ProcFadeOut                   = dll.NewProc("FadeOut")
+	ProcSetLatencyMode            = dll.NewProc("SetLatencyMode")
 	ProcPush                      = dll.NewProc("Push")
+	ProcStartCommandTrace         = dll.NewProc("StartCommandTrace")
+	ProcStopCommandTrace          = dll.NewProc("StopCommandTrace")
+	ProcGetLatencyStats           = dll.NewProc("GetLatencyStats")
+	ProcGetRenderTelemetry        = dll.NewProc("GetRenderTelemetry")
 	ProcGetVoiceCount             = dll.NewProc("GetVoiceCount")
+	ProcGetVoiceSnapshot          = dll.NewProc("GetVoiceSnapshot")
 	ProcGetVoiceId                = dll.NewProc("GetVoiceId")
 	ProcGetVoiceIdLength          = dll.NewProc("GetVoiceIdLength")
 	ProcGetVoiceDisplayName       = dll.NewProc("GetVoiceDisplayName")
@@ -12,4 +12,67 @@ type Command struct {
 	SFXIndex     int16
 	WaitDuration uintptr
 	Text         uintptr
+	Gain         float32
+	Pan          float32
+}
+
+// LatencyStageNames lists the stages GetLatencyStats reports, in its order.
+var LatencyStageNames = []string{
+	"dispatch",
+	"synthesisStart",
+	"synthesisEnd",
+	"feed",
+	"firstSample",
+}
+
+// LatencySummary mirrors the struct filled by GetLatencyStats. Times are in
+// microseconds since Push.
+type LatencySummary struct {
+	Count int64
+	Mean  float64
+	P50   float64
+	P90   float64
+	P99   float64
+	P999  float64
+	Max   float64
+}
+
+// MMCSSStatusNames names the values of RenderSummary.MMCSS.
+var MMCSSStatusNames = []string{
+	"unknown",
+	"disabled",
+	"registered",
+	"failed",
+}
+
+// RenderSummary mirrors the struct filled by GetRenderTelemetry. Times are in
+// microseconds.
+type RenderSummary struct {
+	Periods       int64
+	Underruns     int64
+	LateWakeups   int64
+	Failures      int64
+	FramesWritten int64
+	FillP50       float64
+	FillP99       float64
+	FillMax       float64
+	PeriodMicros  int32
+	MaxLateMicros int32
+	MMCSS         int32
+}
+
+const (
+	RenderPeriodUnderrun = 1
+	RenderPeriodLate     = 2
+	RenderPeriodFailed   = 4
+)
+
+// RenderPeriodSample mirrors one period written by GetRenderTelemetry.
+type RenderPeriodSample struct {
+	Sequence       int64
+	IntervalMicros int32
+	FillMicros     int32
+	PaddingFrames  int32
+	FramesWritten  int32
+	Flags          int32
 }
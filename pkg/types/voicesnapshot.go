@@ -0,0 +1,93 @@
+package types
+
+import (
+	"encoding/binary"
+	"fmt"
+	"math"
+	"unicode/utf16"
+)
+
+const (
+	VoiceSnapshotVersion = 1
+
+	voiceSnapshotHeaderSize = 16
+	voiceSnapshotRecordSize = 48
+)
+
+type VoiceProperty struct {
+	Id           string
+	DisplayName  string
+	Language     string
+	SpeakingRate float64
+	AudioPitch   float64
+	AudioVolume  float64
+}
+
+type VoiceSnapshot struct {
+	DefaultVoiceIndex int32
+	Voices            []VoiceProperty
+}
+
+// ParseVoiceSnapshot decodes the buffer filled by GetVoiceSnapshot.
+func ParseVoiceSnapshot(data []byte) (*VoiceSnapshot, error) {
+	if len(data) < voiceSnapshotHeaderSize {
+		return nil, fmt.Errorf("voice snapshot is too short")
+	}
+
+	le := binary.LittleEndian
+
+	if version := le.Uint32(data[0:]); version != VoiceSnapshotVersion {
+		return nil, fmt.Errorf("unsupported voice snapshot version %d", version)
+	}
+
+	count := int(le.Uint32(data[4:]))
+
+	if count > (len(data)-voiceSnapshotHeaderSize)/voiceSnapshotRecordSize {
+		return nil, fmt.Errorf("voice snapshot is truncated")
+	}
+
+	text := func(record []byte) (string, error) {
+		offset := int(le.Uint32(record[0:]))
+		length := int(le.Uint32(record[4:]))
+
+		if offset < 0 || length < 0 || offset > len(data) || length > (len(data)-offset)/2 {
+			return "", fmt.Errorf("voice snapshot has a broken string")
+		}
+
+		u := make([]uint16, length)
+
+		for i := range u {
+			u[i] = le.Uint16(data[offset+2*i:])
+		}
+
+		return string(utf16.Decode(u)), nil
+	}
+
+	snapshot := &VoiceSnapshot{
+		DefaultVoiceIndex: int32(le.Uint32(data[8:])),
+		Voices:            make([]VoiceProperty, count),
+	}
+
+	for i := range snapshot.Voices {
+		record := data[voiceSnapshotHeaderSize+i*voiceSnapshotRecordSize:]
+		v := &snapshot.Voices[i]
+
+		v.SpeakingRate = math.Float64frombits(le.Uint64(record[0:]))
+		v.AudioPitch = math.Float64frombits(le.Uint64(record[8:]))
+		v.AudioVolume = math.Float64frombits(le.Uint64(record[16:]))
+
+		var err error
+
+		if v.Id, err = text(record[24:]); err != nil {
+			return nil, err
+		}
+		if v.DisplayName, err = text(record[32:]); err != nil {
+			return nil, err
+		}
+		if v.Language, err = text(record[40:]); err != nil {
+			return nil, err
+		}
+	}
+
+	return snapshot, nil
+}
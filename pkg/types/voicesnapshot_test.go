@@ -0,0 +1,75 @@
+package types
+
+import (
+	"encoding/binary"
+	"math"
+	"testing"
+	"unicode/utf16"
+)
+
+func buildVoiceSnapshot(defaultVoiceIndex int32, voices []VoiceProperty) []byte {
+	le := binary.LittleEndian
+	data := make([]byte, voiceSnapshotHeaderSize+len(voices)*voiceSnapshotRecordSize)
+
+	le.PutUint32(data[0:], VoiceSnapshotVersion)
+	le.PutUint32(data[4:], uint32(len(voices)))
+	le.PutUint32(data[8:], uint32(defaultVoiceIndex))
+
+	for i, v := range voices {
+		record := data[voiceSnapshotHeaderSize+i*voiceSnapshotRecordSize:]
+
+		le.PutUint64(record[0:], math.Float64bits(v.SpeakingRate))
+		le.PutUint64(record[8:], math.Float64bits(v.AudioPitch))
+		le.PutUint64(record[16:], math.Float64bits(v.AudioVolume))
+
+		for j, s := range []string{v.Id, v.DisplayName, v.Language} {
+			u := utf16.Encode([]rune(s))
+
+			le.PutUint32(record[24+j*8:], uint32(len(data)))
+			le.PutUint32(record[28+j*8:], uint32(len(u)))
+
+			for _, c := range u {
+				data = append(data, byte(c), byte(c>>8))
+			}
+
+			// data may have moved.
+			record = data[voiceSnapshotHeaderSize+i*voiceSnapshotRecordSize:]
+		}
+	}
+
+	return data
+}
+
+func TestParseVoiceSnapshot(t *testing.T) {
+	voices := []VoiceProperty{
+		{"voice-a", "Microsoft Haruka", "ja-JP", 1.5, 1.0, 0.8},
+		{"voice-b", "Microsoft Zira", "en-US", 1.0, 0.9, 1.0},
+	}
+	data := buildVoiceSnapshot(1, voices)
+
+	snapshot, err := ParseVoiceSnapshot(data)
+
+	if err != nil {
+		t.Fatal(err)
+	}
+	if snapshot.DefaultVoiceIndex != 1 {
+		t.Fatalf("expected default voice 1, got %d", snapshot.DefaultVoiceIndex)
+	}
+	if len(snapshot.Voices) != len(voices) {
+		t.Fatalf("expected %d voices, got %d", len(voices), len(snapshot.Voices))
+	}
+	for i := range voices {
+		if snapshot.Voices[i] != voices[i] {
+			t.Fatalf("voice %d: expected %+v, got %+v", i, voices[i], snapshot.Voices[i])
+		}
+	}
+	if _, err := ParseVoiceSnapshot(data[:len(data)-1]); err == nil {
+		t.Fatal("expected an error for a truncated string")
+	}
+
+	binary.LittleEndian.PutUint32(data, VoiceSnapshotVersion+1)
+
+	if _, err := ParseVoiceSnapshot(data); err == nil {
+		t.Fatal("expected an error for an unknown version")
+	}
+}
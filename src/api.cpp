@@ -1,8 +1,8 @@
 #include <cppaudio/engine.h>
 #include <cpplogger/cpplogger.h>
 #include <cstring>
-#include <fstream>
 #include <mutex>
+#include <vector>
 #include <windows.h>
 
 #include <strsafe.h>
@@ -10,6 +10,8 @@
 #include "api.h"
 #include "audioloop.h"
 #include "commandloop.h"
+#include "commandpipeloop.h"
+#include "commandtrace.h"
 #include "context.h"
 #include "logloop.h"
 #include "sfxloop.h"
@@ -20,30 +22,127 @@
 extern Logger::Logger *Log;
 
 int16_t maxWaves = 128;
+uint32_t sfxWorkers = 2;
+uint32_t sfxVoices = 8;
+StealPolicy sfxStealPolicy = StealPolicy::Oldest;
+ResampleQuality voiceResampleQuality = ResampleQuality::LongSinc;
+ResampleQuality sfxResampleQuality = ResampleQuality::ShortSinc;
+double fadeSeconds = 0.05;
+RampCurve fadeCurve = RampCurve::Exponential;
+// Sound effects are lowered by 6 dB while speech plays.
+float sfxDuckGain = 0.5f;
+uint32_t maxCommands = 256;
+uint32_t textCapacity = 16384;
+uint32_t maxTextCapacity = 262144;
+uint32_t speechLookahead = 2;
+uint64_t speechCacheBytes = 16 * 1024 * 1024;
+uint32_t voiceStreamBytes = 65536;
+const wchar_t *commandPipeName = L"\\\\.\\pipe\\AudioNode";
 bool isActive{false};
 std::mutex apiMutex;
 
 LogLoopContext *logLoopCtx{nullptr};
 CommandLoopContext *commandLoopCtx{nullptr};
+CommandPipeContext *commandPipeCtx{nullptr};
 VoiceInfoContext *voiceInfoCtx{nullptr};
 VoiceLoopContext *voiceLoopCtx{nullptr};
 SFXLoopContext *sfxLoopCtx{nullptr};
-AudioLoopContext *voiceRenderCtx{nullptr};
-AudioLoopContext *sfxRenderCtx{nullptr};
+AudioLoopContext *renderCtx{nullptr};
 
 HANDLE logLoopThread{nullptr};
 HANDLE commandLoopThread{nullptr};
+HANDLE commandPipeThread{nullptr};
 HANDLE voiceInfoThread{nullptr};
 HANDLE voiceLoopThread{nullptr};
-HANDLE voiceRenderThread{nullptr};
 HANDLE sfxLoopThread{nullptr};
-HANDLE sfxRenderThread{nullptr};
+HANDLE renderThread{nullptr};
 
 HANDLE nextVoiceEvent{nullptr};
 HANDLE nextSoundEvent{nullptr};
 
-PCMAudio::RingEngine *voiceEngine{nullptr};
-PCMAudio::LauncherEngine *sfxEngine{nullptr};
+StreamSource *voiceStream{nullptr};
+SFXBank *sfxBank{nullptr};
+
+SFXSource *sfxSource{nullptr};
+SFXQueue *sfxQueue{nullptr};
+Mixer *outputMixer{nullptr};
+LatencyStats *latencyStats{nullptr};
+RenderTelemetry *renderTelemetry{nullptr};
+
+std::mutex prosodyMutex;
+
+// Records Push calls and voice setting changes while a trace is started.
+CommandTraceWriter commandTrace;
+
+// Serializes the producers of the command ring: Push and the command pipe.
+// The pipe does not take apiMutex, which Teardown holds while it waits for
+// the pipe thread to quit.
+std::mutex pushMutex;
+
+// Queues commands and wakes the command loop. Returns the code of Push.
+int32_t pushCommands(Command **commandsPtr, int32_t commandsLength,
+                     bool isForcePush) {
+  std::lock_guard<std::mutex> lock(pushMutex);
+
+  if (commandsPtr == nullptr || commandsLength <= 0) {
+    return -1;
+  }
+
+  commandTrace.WritePush(commandsPtr, commandsLength, isForcePush);
+
+  CommandRing *commands = commandLoopCtx->Commands;
+  uint64_t pushTime = LatencyNow();
+  bool ok{true};
+
+  if (isForcePush) {
+    commands->BeginForcePush();
+  }
+  for (int32_t i = 0; i < commandsLength && ok; i++) {
+    ok = PushCommand(commands, *commandsPtr[i], pushTime);
+  }
+
+  bool wasIdle = commandLoopCtx->IsIdle.exchange(false);
+
+  if ((isForcePush || wasIdle) && !SetEvent(commandLoopCtx->PushEvent)) {
+    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+    return -1;
+  }
+  if (!ok) {
+    Log->Warn(L"Command queue is full", GetCurrentThreadId(), __LONGFILE__);
+    return -2;
+  }
+
+  return 0;
+}
+
+// Pushes the batches sent through the command pipe.
+class PipeSink : public CommandSink {
+public:
+  int32_t Push(Command **commands, int32_t length, bool isForcePush) override {
+    return pushCommands(commands, length, isForcePush);
+  }
+};
+
+PipeSink pipeSink;
+
+// Rate and pitch are applied by the voice stream rather than the
+// synthesizer, so that a change reaches the utterance being played. The
+// mutex keeps an older table from being applied after a newer one.
+void applyVoiceProsody() {
+  std::lock_guard<std::mutex> lock(prosodyMutex);
+
+  if (voiceStream == nullptr || voiceInfoCtx == nullptr ||
+      voiceInfoCtx->Settings == nullptr || voiceInfoCtx->Count == 0) {
+    return;
+  }
+
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
+  const VoiceProsody &prosody = table->Voices[table->DefaultVoiceIndex];
+
+  voiceStream->SetProsody(prosody.SpeakingRate, prosody.AudioPitch);
+
+  voiceInfoCtx->Settings->Release(table);
+}
 
 void __stdcall Setup(int32_t *code, int32_t logLevel) {
   std::lock_guard<std::mutex> lock(apiMutex);
@@ -104,7 +203,12 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
 
   Log->Info(L"Delete voice info thread", GetCurrentThreadId(), __LONGFILE__);
 
-  voiceEngine = new PCMAudio::RingEngine();
+  latencyStats = new LatencyStats();
+
+  voiceStream = new StreamSource(voiceStreamBytes);
+  voiceStream->SetLatencyStats(latencyStats);
+
+  applyVoiceProsody();
 
   nextVoiceEvent =
       CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
@@ -117,7 +221,7 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
 
   voiceLoopCtx = new VoiceLoopContext();
   voiceLoopCtx->NextEvent = nextVoiceEvent;
-  voiceLoopCtx->VoiceEngine = voiceEngine;
+  voiceLoopCtx->VoiceStream = voiceStream;
   voiceLoopCtx->VoiceInfoCtx = voiceInfoCtx;
 
   voiceLoopCtx->FeedEvent =
@@ -138,46 +242,42 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
     return;
   }
 
-  Log->Info(L"Create voice loop thread", GetCurrentThreadId(), __LONGFILE__);
-
-  voiceLoopThread = CreateThread(nullptr, 0, voiceLoop,
-                                 static_cast<void *>(voiceLoopCtx), 0, nullptr);
-
-  if (voiceLoopThread == nullptr) {
-    Log->Fail(L"Failed to create thread", GetCurrentThreadId(), __LONGFILE__);
-    *code = -1;
-    return;
-  }
-
-  voiceRenderCtx = new AudioLoopContext();
-  voiceRenderCtx->NextEvent = nextVoiceEvent;
-  voiceRenderCtx->Engine = voiceEngine;
-
-  voiceRenderCtx->QuitEvent =
+  voiceLoopCtx->ReadyEvent =
       CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
 
-  if (voiceRenderCtx->QuitEvent == nullptr) {
+  if (voiceLoopCtx->ReadyEvent == nullptr) {
     Log->Fail(L"Failed to create event", GetCurrentThreadId(), __LONGFILE__);
     *code = -1;
     return;
   }
 
-  Log->Info(L"Create voice render thread", GetCurrentThreadId(), __LONGFILE__);
+  // Refill the voice stream once half of it has been played.
+  voiceStream->SetLowWatermark(voiceStreamBytes / 2, SignalEvent,
+                               voiceLoopCtx->ReadyEvent);
 
-  voiceRenderThread = CreateThread(
-      nullptr, 0, audioLoop, static_cast<void *>(voiceRenderCtx), 0, nullptr);
+  voiceLoopCtx->Cache = new SpeechCache(speechCacheBytes);
+  voiceLoopCtx->Speech =
+      new SpeechPipeline(speechLookahead, voiceLoopCtx->Cache);
+  voiceLoopCtx->Speech->SetLatencyStats(latencyStats);
 
-  if (voiceRenderThread == nullptr) {
+  Log->Info(L"Create voice loop thread", GetCurrentThreadId(), __LONGFILE__);
+
+  voiceLoopThread = CreateThread(nullptr, 0, voiceLoop,
+                                 static_cast<void *>(voiceLoopCtx), 0, nullptr);
+
+  if (voiceLoopThread == nullptr) {
     Log->Fail(L"Failed to create thread", GetCurrentThreadId(), __LONGFILE__);
     *code = -1;
     return;
   }
 
-  sfxEngine = new PCMAudio::LauncherEngine(maxWaves);
+  // Waves are only mapped and decoded when they are first used.
+  sfxBank = new SFXBank(maxWaves, sfxWorkers);
 
   for (int16_t i = 0; i < maxWaves; i++) {
-    wchar_t *filePath = new wchar_t[256]{};
-    HRESULT hr = StringCbPrintfW(filePath, 255, L"waves\\%03d.wav", i + 1);
+    char filePath[256]{};
+    HRESULT hr =
+        StringCbPrintfA(filePath, sizeof(filePath), "waves\\%03d.wav", i + 1);
 
     if (FAILED(hr)) {
       Log->Fail(L"Failed to build file path", GetCurrentThreadId(),
@@ -185,20 +285,15 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
       continue;
     }
 
-    std::ifstream file(filePath, std::ios::binary | std::ios::in);
-
-    if (!sfxEngine->Register(i, file)) {
-      Log->Fail(L"Failed to register", GetCurrentThreadId(), __LONGFILE__);
-      continue;
-    }
-
-    Log->Info(filePath, GetCurrentThreadId(), __LONGFILE__);
-
-    delete[] filePath;
-    filePath = nullptr;
-
-    file.close();
+    sfxBank->SetPath(i, filePath);
   }
+  // A bank packed by sfxpack takes precedence over the individual files.
+  if (sfxBank->LoadBank("waves\\waves.bank")) {
+    Log->Info(L"Use packed SFX bank", GetCurrentThreadId(), __LONGFILE__);
+  }
+
+  sfxSource = new SFXSource(sfxBank, sfxVoices, sfxStealPolicy);
+  sfxSource->SetLatencyStats(latencyStats);
 
   nextSoundEvent =
       CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
@@ -211,7 +306,10 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
 
   sfxLoopCtx = new SFXLoopContext();
   sfxLoopCtx->NextEvent = nextSoundEvent;
-  sfxLoopCtx->SFXEngine = sfxEngine;
+  sfxLoopCtx->Bank = sfxBank;
+
+  sfxQueue = new SFXQueue(sfxSource, latencyStats);
+  sfxLoopCtx->Queue = sfxQueue;
 
   sfxLoopCtx->FeedEvent =
       CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
@@ -242,25 +340,53 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
     return;
   }
 
-  sfxRenderCtx = new AudioLoopContext();
-  sfxRenderCtx->NextEvent = nextSoundEvent;
-  sfxRenderCtx->Engine = sfxEngine;
 
-  sfxRenderCtx->QuitEvent =
+  // Both buses share one output stream, so voice and SFX are mixed on the same
+  // device clock by a single render thread.
+  outputMixer = new Mixer();
+  outputMixer->AddBus(voiceStream, 1.0f);
+  outputMixer->AddBus(sfxSource, 1.0f);
+  outputMixer->SetResampleQuality(VoiceBus, voiceResampleQuality);
+  outputMixer->SetResampleQuality(SFXBus, sfxResampleQuality);
+
+  DuckSettings sfxDucking;
+
+  sfxDucking.KeyBus = VoiceBus;
+  sfxDucking.Gain = sfxDuckGain;
+  outputMixer->SetDucking(SFXBus, sfxDucking);
+
+  renderTelemetry = new RenderTelemetry();
+
+  renderCtx = new AudioLoopContext();
+  renderCtx->Telemetry = renderTelemetry;
+  renderCtx->NextEvents[VoiceBus] = nextVoiceEvent;
+  renderCtx->NextEvents[SFXBus] = nextSoundEvent;
+  renderCtx->OutputMixer = outputMixer;
+
+  renderCtx->QuitEvent =
       CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
 
-  if (sfxRenderCtx->QuitEvent == nullptr) {
+  if (renderCtx->QuitEvent == nullptr) {
     Log->Fail(L"Failed to create event", GetCurrentThreadId(), __LONGFILE__);
     *code = -1;
     return;
   }
 
-  Log->Info(L"Create SFX render thread", GetCurrentThreadId(), __LONGFILE__);
+  renderCtx->RestartEvent =
+      CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
 
-  sfxRenderThread = CreateThread(nullptr, 0, audioLoop,
-                                 static_cast<void *>(sfxRenderCtx), 0, nullptr);
+  if (renderCtx->RestartEvent == nullptr) {
+    Log->Fail(L"Failed to create event", GetCurrentThreadId(), __LONGFILE__);
+    *code = -1;
+    return;
+  }
+
+  Log->Info(L"Create render thread", GetCurrentThreadId(), __LONGFILE__);
+
+  renderThread = CreateThread(nullptr, 0, audioLoop,
+                              static_cast<void *>(renderCtx), 0, nullptr);
 
-  if (sfxRenderThread == nullptr) {
+  if (renderThread == nullptr) {
     Log->Fail(L"Failed to create thread", GetCurrentThreadId(), __LONGFILE__);
     *code = -1;
     return;
@@ -288,16 +414,10 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
 
   commandLoopCtx->VoiceLoopCtx = voiceLoopCtx;
   commandLoopCtx->SFXLoopCtx = sfxLoopCtx;
-  commandLoopCtx->Commands =
-      new Command *[commandLoopCtx->MaxCommands] { nullptr };
-
-  for (int32_t i = 0; i < commandLoopCtx->MaxCommands; i++) {
-    commandLoopCtx->Commands[i] = new Command;
-    commandLoopCtx->Commands[i]->Type = 0;
-    commandLoopCtx->Commands[i]->SFXIndex = 0;
-    commandLoopCtx->Commands[i]->WaitDuration = 0.0;
-    commandLoopCtx->Commands[i]->Text = nullptr;
-  }
+  commandLoopCtx->OutputMixer = outputMixer;
+  commandLoopCtx->Stats = latencyStats;
+  commandLoopCtx->Commands = new CommandRing(
+      maxCommands, OverflowPolicy::DropOldest, textCapacity, maxTextCapacity);
 
   Log->Info(L"Create command loop thread", GetCurrentThreadId(), __LONGFILE__);
 
@@ -310,6 +430,34 @@ void __stdcall Setup(int32_t *code, int32_t logLevel) {
     return;
   }
 
+  // Clients that send a command per keystroke push through the pipe, which
+  // skips HTTP and JSON.
+  commandPipeCtx = new CommandPipeContext();
+  commandPipeCtx->PipeName = commandPipeName;
+  commandPipeCtx->Sink = &pipeSink;
+
+  commandPipeCtx->QuitEvent =
+      CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+
+  if (commandPipeCtx->QuitEvent == nullptr) {
+    Log->Fail(L"Failed to create event", GetCurrentThreadId(), __LONGFILE__);
+    *code = -1;
+    return;
+  }
+
+  Log->Info(L"Create command pipe loop thread", GetCurrentThreadId(),
+            __LONGFILE__);
+
+  commandPipeThread = CreateThread(nullptr, 0, commandPipeLoop,
+                                   static_cast<void *>(commandPipeCtx), 0,
+                                   nullptr);
+
+  if (commandPipeThread == nullptr) {
+    Log->Fail(L"Failed to create thread", GetCurrentThreadId(), __LONGFILE__);
+    *code = -1;
+    return;
+  }
+
   Log->Info(L"Complete setup AudioNode", GetCurrentThreadId(), __LONGFILE__);
 }
 
@@ -326,6 +474,29 @@ void __stdcall Teardown(int32_t *code) {
 
   Log->Info(L"Teardown AudioNode", GetCurrentThreadId(), __LONGFILE__);
 
+  // The pipe pushes into the command loop, so it quits first.
+  if (commandPipeThread == nullptr) {
+    goto END_COMMANDPIPE_CLEANUP;
+  }
+  if (!SetEvent(commandPipeCtx->QuitEvent)) {
+    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+    *code = -1;
+    return;
+  }
+
+  WaitForSingleObject(commandPipeThread, INFINITE);
+  SafeCloseHandle(&commandPipeThread);
+
+  SafeCloseHandle(&(commandPipeCtx->QuitEvent));
+
+  delete commandPipeCtx;
+  commandPipeCtx = nullptr;
+
+  Log->Info(L"Delete command pipe loop thread", GetCurrentThreadId(),
+            __LONGFILE__);
+
+END_COMMANDPIPE_CLEANUP:
+
   if (commandLoopThread == nullptr) {
     goto END_COMMANDLOOP_CLEANUP;
   }
@@ -338,13 +509,8 @@ void __stdcall Teardown(int32_t *code) {
   WaitForSingleObject(commandLoopThread, INFINITE);
   SafeCloseHandle(&commandLoopThread);
 
-  for (int32_t i = 0; i < commandLoopCtx->MaxCommands; i++) {
-    delete[] commandLoopCtx->Commands[i]->Text;
-    commandLoopCtx->Commands[i]->Text = nullptr;
-
-    delete commandLoopCtx->Commands[i];
-    commandLoopCtx->Commands[i] = nullptr;
-  }
+  delete commandLoopCtx->Commands;
+  commandLoopCtx->Commands = nullptr;
 
   SafeCloseHandle(&(commandLoopCtx->PushEvent));
   SafeCloseHandle(&(commandLoopCtx->QuitEvent));
@@ -369,8 +535,14 @@ END_COMMANDLOOP_CLEANUP:
   SafeCloseHandle(&voiceLoopThread);
 
   SafeCloseHandle(&(voiceLoopCtx->QuitEvent));
-  SafeCloseHandle(&(voiceLoopCtx->NextEvent));
   SafeCloseHandle(&(voiceLoopCtx->FeedEvent));
+  SafeCloseHandle(&(voiceLoopCtx->ReadyEvent));
+
+  delete voiceLoopCtx->Speech;
+  voiceLoopCtx->Speech = nullptr;
+
+  delete voiceLoopCtx->Cache;
+  voiceLoopCtx->Cache = nullptr;
 
   for (unsigned int i = 0; i < voiceInfoCtx->Count; i++) {
     delete[] voiceInfoCtx->VoiceProperties[i]->Id;
@@ -381,11 +553,17 @@ END_COMMANDLOOP_CLEANUP:
 
     delete[] voiceInfoCtx->VoiceProperties[i]->Language;
     voiceInfoCtx->VoiceProperties[i]->Language = nullptr;
+
+    delete voiceInfoCtx->VoiceProperties[i];
+    voiceInfoCtx->VoiceProperties[i] = nullptr;
   }
 
   delete[] voiceInfoCtx->VoiceProperties;
   voiceInfoCtx->VoiceProperties = nullptr;
 
+  delete voiceInfoCtx->Settings;
+  voiceInfoCtx->Settings = nullptr;
+
   delete voiceInfoCtx;
   voiceInfoCtx = nullptr;
 
@@ -396,31 +574,6 @@ END_COMMANDLOOP_CLEANUP:
 
 END_VOICELOOP_CLEANUP:
 
-  if (voiceRenderThread == nullptr) {
-    goto END_VOICERENDER_CLEANUP;
-  }
-  if (!SetEvent(voiceRenderCtx->QuitEvent)) {
-    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
-    *code = -1;
-    return;
-  }
-
-  WaitForSingleObject(voiceRenderThread, INFINITE);
-  SafeCloseHandle(&voiceRenderThread);
-
-  SafeCloseHandle(&(voiceRenderCtx->NextEvent));
-  SafeCloseHandle(&(voiceRenderCtx->QuitEvent));
-
-  delete voiceRenderCtx;
-  voiceRenderCtx = nullptr;
-
-  delete voiceEngine;
-  voiceEngine = nullptr;
-
-  Log->Info(L"Delete voice render thread", GetCurrentThreadId(), __LONGFILE__);
-
-END_VOICERENDER_CLEANUP:
-
   if (sfxLoopThread == nullptr) {
     goto END_SFXLOOP_CLEANUP;
   }
@@ -434,7 +587,6 @@ END_VOICERENDER_CLEANUP:
   SafeCloseHandle(&sfxLoopThread);
 
   SafeCloseHandle(&(sfxLoopCtx->FeedEvent));
-  SafeCloseHandle(&(sfxLoopCtx->NextEvent));
   SafeCloseHandle(&(sfxLoopCtx->QuitEvent));
 
   delete sfxLoopCtx;
@@ -444,27 +596,48 @@ END_VOICERENDER_CLEANUP:
 
 END_SFXLOOP_CLEANUP:
 
-  if (sfxRenderThread == nullptr) {
-    goto END_SFXRENDER_CLEANUP;
+  if (renderThread == nullptr) {
+    goto END_RENDER_CLEANUP;
   }
-  if (!SetEvent(sfxRenderCtx->QuitEvent)) {
+  if (!SetEvent(renderCtx->QuitEvent)) {
     Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
     *code = -1;
     return;
   }
 
-  WaitForSingleObject(sfxRenderThread, INFINITE);
-  SafeCloseHandle(&sfxRenderThread);
+  WaitForSingleObject(renderThread, INFINITE);
+  SafeCloseHandle(&renderThread);
+
+  SafeCloseHandle(&(renderCtx->QuitEvent));
+  SafeCloseHandle(&(renderCtx->RestartEvent));
+
+  delete renderCtx;
+  renderCtx = nullptr;
+
+  delete renderTelemetry;
+  renderTelemetry = nullptr;
+
+  delete outputMixer;
+  outputMixer = nullptr;
 
-  SafeCloseHandle(&(sfxRenderCtx->NextEvent));
-  SafeCloseHandle(&(sfxRenderCtx->QuitEvent));
+  delete sfxQueue;
+  sfxQueue = nullptr;
 
-  delete sfxEngine;
-  sfxEngine = nullptr;
+  delete sfxSource;
+  sfxSource = nullptr;
 
-  Log->Info(L"Delete SFX render thread", GetCurrentThreadId(), __LONGFILE__);
+  delete voiceStream;
+  voiceStream = nullptr;
 
-END_SFXRENDER_CLEANUP:
+  delete latencyStats;
+  latencyStats = nullptr;
+
+  delete sfxBank;
+  sfxBank = nullptr;
+
+  Log->Info(L"Delete render thread", GetCurrentThreadId(), __LONGFILE__);
+
+END_RENDER_CLEANUP:
 
   SafeCloseHandle(&nextVoiceEvent);
   SafeCloseHandle(&nextSoundEvent);
@@ -490,6 +663,8 @@ END_SFXRENDER_CLEANUP:
 
 END_LOGLOOP_CLEANUP:
 
+  commandTrace.Close();
+
   isActive = false;
 }
 
@@ -506,8 +681,13 @@ void __stdcall FadeIn(int32_t *code) {
 
   Log->Info(L"Called FadeIn()", GetCurrentThreadId(), __LONGFILE__);
 
-  voiceEngine->FadeIn();
-  sfxEngine->FadeIn();
+  for (int32_t bus = 0; bus < outputMixer->GetBusCount(); bus++) {
+    if (!outputMixer->RampGain(bus, 1.0f, fadeSeconds, fadeCurve)) {
+      Log->Warn(L"Too many gain ramps", GetCurrentThreadId(), __LONGFILE__);
+      *code = -2;
+      return;
+    }
+  }
 
   *code = 0;
 }
@@ -525,8 +705,45 @@ void __stdcall FadeOut(int32_t *code) {
 
   Log->Info(L"Called FadeOut()", GetCurrentThreadId(), __LONGFILE__);
 
-  voiceEngine->FadeOut();
-  sfxEngine->FadeOut();
+  // What is playing is discarded once it is silent. The buses stay muted
+  // until FadeIn.
+  for (int32_t bus = 0; bus < outputMixer->GetBusCount(); bus++) {
+    if (!outputMixer->RampGain(bus, 0.0f, fadeSeconds, fadeCurve, 0, true)) {
+      Log->Warn(L"Too many gain ramps", GetCurrentThreadId(), __LONGFILE__);
+      *code = -2;
+      return;
+    }
+  }
+
+  *code = 0;
+}
+
+void __stdcall SetLatencyMode(int32_t *code, int32_t mode) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
+    return;
+  }
+  if (!isActive) {
+    *code = -1;
+    return;
+  }
+  if (mode != static_cast<int32_t>(LatencyMode::Default) &&
+      mode != static_cast<int32_t>(LatencyMode::Low)) {
+    *code = -2;
+    return;
+  }
+
+  Log->Info(L"Called SetLatencyMode()", GetCurrentThreadId(), __LONGFILE__);
+
+  renderCtx->Latency.store(static_cast<LatencyMode>(mode));
+
+  // The period is fixed once the stream is initialized, so reopen it.
+  if (!SetEvent(renderCtx->RestartEvent)) {
+    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+    *code = -1;
+    return;
+  }
 
   *code = 0;
 }
@@ -547,11 +764,11 @@ void __stdcall Push(int32_t *code, Command **commandsPtr,
     return;
   }
 
-  wchar_t *msg = new wchar_t[256]{};
+  wchar_t msg[256]{};
 
-  HRESULT hr = StringCbPrintfW(
-      msg, 255, L"Called Push Read=%d,Write=%d,IsForce=%d",
-      commandLoopCtx->ReadIndex, commandLoopCtx->WriteIndex, isForcePush);
+  HRESULT hr = StringCbPrintfW(msg, sizeof(msg),
+                               L"Called Push Length=%d,IsForce=%d",
+                               commandsLength, isForcePush);
 
   if (FAILED(hr)) {
     *code = -1;
@@ -560,60 +777,155 @@ void __stdcall Push(int32_t *code, Command **commandsPtr,
 
   Log->Info(msg, GetCurrentThreadId(), __LONGFILE__);
 
-  delete[] msg;
-  msg = nullptr;
-
-  bool isIdle = commandLoopCtx->IsIdle;
-  int32_t base = commandLoopCtx->WriteIndex;
-  size_t textLen{};
-
-  for (int32_t i = 0; i < commandsLength; i++) {
-    int32_t offset = (base + i) % commandLoopCtx->MaxCommands;
-
-    commandLoopCtx->Commands[offset]->Type = commandsPtr[i]->Type;
-
-    switch (commandsPtr[i]->Type) {
-    case 1:
-      commandLoopCtx->Commands[offset]->SFXIndex =
-          commandsPtr[i]->SFXIndex <= 0 ? 0 : commandsPtr[i]->SFXIndex - 1;
-      break;
-    case 2:
-      commandLoopCtx->Commands[offset]->WaitDuration =
-          commandsPtr[i]->WaitDuration;
-      break;
-    case 3: // Generate voice from plain text
-    case 4: // Generate voice from SSML
-      delete[] commandLoopCtx->Commands[offset]->Text;
-      commandLoopCtx->Commands[offset]->Text = nullptr;
-
-      textLen = std::wcslen(commandsPtr[i]->Text) + 1;
-      commandLoopCtx->Commands[offset]->Text = new wchar_t[textLen];
-      std::wmemcpy(commandLoopCtx->Commands[offset]->Text, commandsPtr[i]->Text,
-                   textLen);
-
-      break;
-    default:
-      // do nothing
-      continue;
+  *code = pushCommands(commandsPtr, commandsLength, isForcePush != 0);
+}
+
+void __stdcall StartCommandTrace(int32_t *code, const char *path) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
+    return;
+  }
+  if (!isActive || path == nullptr) {
+    *code = -1;
+    return;
+  }
+
+  Log->Info(L"Called StartCommandTrace", GetCurrentThreadId(), __LONGFILE__);
+
+  if (!commandTrace.Open(path)) {
+    Log->Warn(L"Failed to open command trace", GetCurrentThreadId(),
+              __LONGFILE__);
+    *code = -2;
+    return;
+  }
+  // A replay starts from the voice settings in effect now.
+  if (voiceInfoCtx != nullptr && voiceInfoCtx->Settings != nullptr &&
+      voiceInfoCtx->VoiceProperties != nullptr) {
+    std::vector<const wchar_t *> ids(voiceInfoCtx->Count);
+
+    for (unsigned int i = 0; i < voiceInfoCtx->Count; i++) {
+      ids[i] = voiceInfoCtx->VoiceProperties[i]->Id;
     }
 
-    commandLoopCtx->WriteIndex =
-        (commandLoopCtx->WriteIndex + 1) % commandLoopCtx->MaxCommands;
+    const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
+
+    commandTrace.WriteVoices(*table, ids.data());
+
+    voiceInfoCtx->Settings->Release(table);
   }
-  if (isForcePush) {
-    commandLoopCtx->ReadIndex = base;
+
+  *code = 0;
+}
+
+void __stdcall StopCommandTrace(int32_t *code) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
+    return;
   }
-  if (!isForcePush && !isIdle) {
-    *code = 0;
+
+  Log->Info(L"Called StopCommandTrace", GetCurrentThreadId(), __LONGFILE__);
+
+  *code = commandTrace.Close() ? 0 : -1;
+}
+
+void __stdcall GetLatencyStats(int32_t *code, LatencySummary *summaries,
+                               int32_t summariesLength,
+                               int32_t *stagesLength) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
     return;
   }
-  if (!SetEvent(commandLoopCtx->PushEvent)) {
-    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+  if (!isActive || latencyStats == nullptr) {
+    *code = -1;
+    return;
+  }
+  if (stagesLength == nullptr ||
+      (summaries == nullptr && summariesLength > 0)) {
+    *code = -1;
+    return;
+  }
+
+  *stagesLength = LatencyStageCount;
+
+  for (int32_t i = 0; i < summariesLength && i < LatencyStageCount; i++) {
+    const LatencyHistogram &histogram =
+        latencyStats->Get(static_cast<LatencyStage>(i));
+
+    summaries[i].Count = static_cast<int64_t>(histogram.GetCount());
+    summaries[i].Mean = histogram.GetMean();
+    summaries[i].P50 = static_cast<double>(histogram.GetPercentile(0.5));
+    summaries[i].P90 = static_cast<double>(histogram.GetPercentile(0.9));
+    summaries[i].P99 = static_cast<double>(histogram.GetPercentile(0.99));
+    summaries[i].P999 = static_cast<double>(histogram.GetPercentile(0.999));
+    summaries[i].Max = static_cast<double>(histogram.GetMax());
+  }
+
+  *code = 0;
+}
+
+void __stdcall GetRenderTelemetry(int32_t *code, RenderSummary *summary,
+                                  RenderPeriodSample *periods,
+                                  int32_t periodsLength,
+                                  int32_t *periodsWritten) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
+    return;
+  }
+  if (!isActive || renderTelemetry == nullptr) {
+    *code = -1;
+    return;
+  }
+  if (summary == nullptr || periodsWritten == nullptr ||
+      (periods == nullptr && periodsLength > 0)) {
     *code = -1;
     return;
   }
 
-  commandLoopCtx->IsIdle = false;
+  RenderTotals totals = renderTelemetry->GetTotals();
+  const LatencyHistogram &fillTimes = renderTelemetry->GetFillTimes();
+
+  summary->Periods = static_cast<int64_t>(totals.Periods);
+  summary->Underruns = static_cast<int64_t>(totals.Underruns);
+  summary->LateWakeups = static_cast<int64_t>(totals.LateWakeups);
+  summary->Failures = static_cast<int64_t>(totals.Failures);
+  summary->FramesWritten = static_cast<int64_t>(totals.FramesWritten);
+  summary->FillP50 = static_cast<double>(fillTimes.GetPercentile(0.5));
+  summary->FillP99 = static_cast<double>(fillTimes.GetPercentile(0.99));
+  summary->FillMax = static_cast<double>(fillTimes.GetMax());
+  summary->PeriodMicros = static_cast<int32_t>(totals.PeriodMicros);
+  summary->MaxLateMicros = static_cast<int32_t>(totals.MaxLateMicros);
+  summary->MMCSS = static_cast<int32_t>(totals.MMCSS);
+
+  *periodsWritten = 0;
+
+  if (periodsLength <= 0) {
+    *code = 0;
+    return;
+  }
+
+  RenderPeriod *recent = new RenderPeriod[periodsLength];
+  uint32_t count =
+      renderTelemetry->Read(recent, static_cast<uint32_t>(periodsLength));
+
+  for (uint32_t i = 0; i < count; i++) {
+    periods[i].Sequence = static_cast<int64_t>(recent[i].Sequence);
+    periods[i].IntervalMicros = static_cast<int32_t>(recent[i].IntervalMicros);
+    periods[i].FillMicros = static_cast<int32_t>(recent[i].FillMicros);
+    periods[i].PaddingFrames = static_cast<int32_t>(recent[i].PaddingFrames);
+    periods[i].FramesWritten = static_cast<int32_t>(recent[i].FramesWritten);
+    periods[i].Flags = (recent[i].IsUnderrun ? 1 : 0) |
+                       (recent[i].IsLate ? 2 : 0) |
+                       (recent[i].IsFailed ? 4 : 0);
+  }
+
+  delete[] recent;
+  recent = nullptr;
+
+  *periodsWritten = static_cast<int32_t>(count);
   *code = 0;
 }
 
@@ -636,6 +948,87 @@ void __stdcall GetVoiceCount(int32_t *code, int32_t *numberOfVoices) {
   *code = 0;
 }
 
+void __stdcall GetVoiceSnapshot(int32_t *code, char *buffer,
+                                int32_t bufferLength,
+                                int32_t *snapshotLength) {
+  constexpr uint32_t version = 1;
+  constexpr size_t headerBytes = 16;
+  constexpr size_t voiceBytes = 48;
+
+  // Teardown deletes the voice info under the same lock.
+  std::lock_guard<std::mutex> lock(apiMutex);
+
+  if (code == nullptr) {
+    return;
+  }
+  if (snapshotLength == nullptr) {
+    *code = -1;
+    return;
+  }
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->VoiceProperties == nullptr ||
+      voiceInfoCtx->Settings == nullptr) {
+    *code = -1;
+    return;
+  }
+  if (Log != nullptr) {
+    Log->Info(L"Called GetVoiceSnapshot", GetCurrentThreadId(), __LONGFILE__);
+  }
+
+  uint32_t count = voiceInfoCtx->Count;
+  size_t length = headerBytes + count * voiceBytes;
+
+  for (uint32_t i = 0; i < count; i++) {
+    VoiceProperty *property = voiceInfoCtx->VoiceProperties[i];
+
+    length += sizeof(wchar_t) *
+              (wcslen(property->Id) + wcslen(property->DisplayName) +
+               wcslen(property->Language));
+  }
+
+  *snapshotLength = static_cast<int32_t>(length);
+
+  if (buffer == nullptr || bufferLength < 0 ||
+      static_cast<size_t>(bufferLength) < length) {
+    *code = -2;
+    return;
+  }
+
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
+  int32_t defaultIndex = table->DefaultVoiceIndex;
+  size_t textOffset = headerBytes + count * voiceBytes;
+
+  std::memset(buffer, 0, headerBytes);
+  std::memcpy(buffer, &version, 4);
+  std::memcpy(buffer + 4, &count, 4);
+  std::memcpy(buffer + 8, &defaultIndex, 4);
+
+  for (uint32_t i = 0; i < count; i++) {
+    VoiceProperty *property = voiceInfoCtx->VoiceProperties[i];
+    char *record = buffer + headerBytes + i * voiceBytes;
+    const wchar_t *texts[3] = {property->Id, property->DisplayName,
+                               property->Language};
+
+    std::memcpy(record, &table->Voices[i].SpeakingRate, 8);
+    std::memcpy(record + 8, &table->Voices[i].AudioPitch, 8);
+    std::memcpy(record + 16, &table->Voices[i].AudioVolume, 8);
+
+    for (int j = 0; j < 3; j++) {
+      uint32_t offset = static_cast<uint32_t>(textOffset);
+      uint32_t textLength = static_cast<uint32_t>(wcslen(texts[j]));
+
+      std::memcpy(record + 24 + j * 8, &offset, 4);
+      std::memcpy(record + 28 + j * 8, &textLength, 4);
+      std::memcpy(buffer + textOffset, texts[j], textLength * sizeof(wchar_t));
+
+      textOffset += textLength * sizeof(wchar_t);
+    }
+  }
+
+  voiceInfoCtx->Settings->Release(table);
+
+  *code = 0;
+}
+
 void __stdcall GetVoiceDisplayName(int32_t *code, int32_t index,
                                    wchar_t *displayName) {
   if (code == nullptr) {
@@ -645,7 +1038,7 @@ void __stdcall GetVoiceDisplayName(int32_t *code, int32_t index,
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -654,9 +1047,9 @@ void __stdcall GetVoiceDisplayName(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetVoiceDisplayName (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetVoiceDisplayName (index=%d)", index);
 
   if (FAILED(hr)) {
     *code = -1;
@@ -665,9 +1058,6 @@ void __stdcall GetVoiceDisplayName(int32_t *code, int32_t index,
 
   Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
 
-  delete[] s;
-  s = nullptr;
-
   size_t displayNameLength =
       wcslen(voiceInfoCtx->VoiceProperties[index]->DisplayName);
   std::wmemcpy(displayName, voiceInfoCtx->VoiceProperties[index]->DisplayName,
@@ -687,7 +1077,7 @@ void __stdcall GetVoiceDisplayNameLength(int32_t *code, int32_t index,
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -696,9 +1086,10 @@ void __stdcall GetVoiceDisplayNameLength(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(
-      s, 256, L"Called GetVoiceDisplayNameLength (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetVoiceDisplayNameLength (index=%d)",
+                               index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -708,9 +1099,6 @@ void __stdcall GetVoiceDisplayNameLength(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   *displayNameLength = static_cast<int32_t>(
       wcslen(voiceInfoCtx->VoiceProperties[index]->DisplayName));
 }
@@ -726,7 +1114,7 @@ void __stdcall GetVoiceId(int32_t *code, int32_t index, wchar_t *id) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -735,8 +1123,9 @@ void __stdcall GetVoiceId(int32_t *code, int32_t index, wchar_t *id) {
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(s, 256, L"Called GetVoiceId (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s), L"Called GetVoiceId (index=%d)",
+                               index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -746,9 +1135,6 @@ void __stdcall GetVoiceId(int32_t *code, int32_t index, wchar_t *id) {
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   size_t idLength =
       static_cast<int32_t>(wcslen(voiceInfoCtx->VoiceProperties[index]->Id));
   std::wmemcpy(id, voiceInfoCtx->VoiceProperties[index]->Id, idLength);
@@ -766,7 +1152,7 @@ void __stdcall GetVoiceIdLength(int32_t *code, int32_t index,
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -775,9 +1161,9 @@ void __stdcall GetVoiceIdLength(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetVoiceIdLength (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetVoiceIdLength (index=%d)", index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -787,9 +1173,6 @@ void __stdcall GetVoiceIdLength(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   *idLength =
       static_cast<int32_t>(wcslen(voiceInfoCtx->VoiceProperties[index]->Id));
 }
@@ -806,7 +1189,7 @@ void __stdcall GetVoiceLanguage(int32_t *code, int32_t index,
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -815,9 +1198,9 @@ void __stdcall GetVoiceLanguage(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetVoiceLanguage (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetVoiceLanguage (index=%d)", index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -827,9 +1210,6 @@ void __stdcall GetVoiceLanguage(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   size_t languageLength =
       wcslen(voiceInfoCtx->VoiceProperties[index]->Language);
   std::wmemcpy(language, voiceInfoCtx->VoiceProperties[index]->Language,
@@ -848,7 +1228,7 @@ void __stdcall GetVoiceLanguageLength(int32_t *code, int32_t index,
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -857,9 +1237,10 @@ void __stdcall GetVoiceLanguageLength(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(
-      s, 256, L"Called GetVoiceLanguageLength (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetVoiceLanguageLength (index=%d)",
+                               index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -869,9 +1250,6 @@ void __stdcall GetVoiceLanguageLength(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   *languageLength = static_cast<int32_t>(
       wcslen(voiceInfoCtx->VoiceProperties[index]->Language));
 }
@@ -883,7 +1261,7 @@ void __stdcall GetDefaultVoice(int32_t *code, int32_t *index) {
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
@@ -895,29 +1273,40 @@ void __stdcall GetDefaultVoice(int32_t *code, int32_t *index) {
     Log->Info(L"Called GetDefaultVoice", GetCurrentThreadId(), __LONGFILE__);
   }
 
-  *index = voiceInfoCtx->DefaultVoiceIndex;
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
+
+  *index = table->DefaultVoiceIndex;
+
+  voiceInfoCtx->Settings->Release(table);
 }
 
 void __stdcall SetDefaultVoice(int32_t *code, int32_t index) {
+  // The change is recorded and applied under one lock, so that a trace
+  // replays setters in the order they took effect.
+  std::lock_guard<std::mutex> lock(apiMutex);
+
   if (code == nullptr) {
     return;
   }
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
   if (Log != nullptr) {
-    Log->Info(L"Called GetDefaultVoice", GetCurrentThreadId(), __LONGFILE__);
+    Log->Info(L"Called SetDefaultVoice", GetCurrentThreadId(), __LONGFILE__);
   }
 
-  voiceInfoCtx->DefaultVoiceIndex = index;
+  voiceInfoCtx->Settings->SetDefaultVoice(index);
+  commandTrace.WriteDefaultVoice(index);
+
+  applyVoiceProsody();
 }
 
 void __stdcall GetSpeakingRate(int32_t *code, int32_t index, double *rate) {
@@ -927,11 +1316,11 @@ void __stdcall GetSpeakingRate(int32_t *code, int32_t index, double *rate) {
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -940,9 +1329,9 @@ void __stdcall GetSpeakingRate(int32_t *code, int32_t index, double *rate) {
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetSpeakingRate (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetSpeakingRate (index=%d)", index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -952,24 +1341,27 @@ void __stdcall GetSpeakingRate(int32_t *code, int32_t index, double *rate) {
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
 
-  *rate = voiceInfoCtx->VoiceProperties[index]->SpeakingRate;
+  *rate = table->Voices[index].SpeakingRate;
+
+  voiceInfoCtx->Settings->Release(table);
 }
 
 void __stdcall SetSpeakingRate(int32_t *code, int32_t index, double rate) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
   if (code == nullptr) {
     return;
   }
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -978,9 +1370,10 @@ void __stdcall SetSpeakingRate(int32_t *code, int32_t index, double rate) {
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(
-      s, 256, L"Called SetSpeakingRate (index=%d, rate=%.2f)", index, rate);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called SetSpeakingRate (index=%d, rate=%.2f)",
+                               index, rate);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -990,16 +1383,16 @@ void __stdcall SetSpeakingRate(int32_t *code, int32_t index, double rate) {
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
-  if (rate < 0.5) {
-    rate = 0.5;
+  if (rate < VoiceProsody::MinSpeakingRate) {
+    rate = VoiceProsody::MinSpeakingRate;
   }
-  if (rate > 6.0) {
-    rate = 6.0;
+  if (rate > VoiceProsody::MaxSpeakingRate) {
+    rate = VoiceProsody::MaxSpeakingRate;
   }
-  voiceInfoCtx->VoiceProperties[index]->SpeakingRate = rate;
+  voiceInfoCtx->Settings->SetSpeakingRate(index, rate);
+  commandTrace.WriteVoiceSetting(TraceEventType::SpeakingRate, index, rate);
+
+  applyVoiceProsody();
 }
 
 void __stdcall GetAudioPitch(int32_t *code, int32_t index, double *audioPitch) {
@@ -1009,11 +1402,11 @@ void __stdcall GetAudioPitch(int32_t *code, int32_t index, double *audioPitch) {
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -1022,9 +1415,9 @@ void __stdcall GetAudioPitch(int32_t *code, int32_t index, double *audioPitch) {
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetAudioPitch (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s), L"Called GetAudioPitch (index=%d)",
+                               index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -1034,24 +1427,27 @@ void __stdcall GetAudioPitch(int32_t *code, int32_t index, double *audioPitch) {
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
+
+  *audioPitch = table->Voices[index].AudioPitch;
 
-  *audioPitch = voiceInfoCtx->VoiceProperties[index]->AudioPitch;
+  voiceInfoCtx->Settings->Release(table);
 }
 
 void __stdcall SetAudioPitch(int32_t *code, int32_t index, double audioPitch) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
   if (code == nullptr) {
     return;
   }
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -1060,10 +1456,11 @@ void __stdcall SetAudioPitch(int32_t *code, int32_t index, double audioPitch) {
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(
-      s, 256, L"Called SetAudioPitch (index=%d, audioPitch=%.2f)", index,
-      audioPitch);
+  wchar_t s[256]{};
+  HRESULT hr =
+      StringCbPrintfW(s, sizeof(s),
+                      L"Called SetAudioPitch (index=%d, audioPitch=%.2f)",
+                      index, audioPitch);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -1073,17 +1470,18 @@ void __stdcall SetAudioPitch(int32_t *code, int32_t index, double audioPitch) {
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
-  if (audioPitch < 0.0) {
-    audioPitch = 0.0;
+  if (audioPitch < VoiceProsody::MinAudioPitch) {
+    audioPitch = VoiceProsody::MinAudioPitch;
   }
-  if (audioPitch > 2.0) {
-    audioPitch = 2.0;
+  if (audioPitch > VoiceProsody::MaxAudioPitch) {
+    audioPitch = VoiceProsody::MaxAudioPitch;
   }
 
-  voiceInfoCtx->VoiceProperties[index]->AudioPitch = audioPitch;
+  voiceInfoCtx->Settings->SetAudioPitch(index, audioPitch);
+  commandTrace.WriteVoiceSetting(TraceEventType::AudioPitch, index,
+                                 audioPitch);
+
+  applyVoiceProsody();
 }
 
 void __stdcall GetAudioVolume(int32_t *code, int32_t index,
@@ -1094,11 +1492,11 @@ void __stdcall GetAudioVolume(int32_t *code, int32_t index,
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -1107,9 +1505,9 @@ void __stdcall GetAudioVolume(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr =
-      StringCbPrintfW(s, 256, L"Called GetAudioVolume (index=%d)", index);
+  wchar_t s[256]{};
+  HRESULT hr = StringCbPrintfW(s, sizeof(s),
+                               L"Called GetAudioVolume (index=%d)", index);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -1119,25 +1517,28 @@ void __stdcall GetAudioVolume(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
+  const VoiceTable *table = voiceInfoCtx->Settings->Acquire();
 
-  *audioVolume = voiceInfoCtx->VoiceProperties[index]->AudioVolume;
+  *audioVolume = table->Voices[index].AudioVolume;
+
+  voiceInfoCtx->Settings->Release(table);
 }
 
 void __stdcall SetAudioVolume(int32_t *code, int32_t index,
                               double audioVolume) {
+  std::lock_guard<std::mutex> lock(apiMutex);
+
   if (code == nullptr) {
     return;
   }
 
   *code = 0;
 
-  if (voiceInfoCtx == nullptr) {
+  if (voiceInfoCtx == nullptr || voiceInfoCtx->Settings == nullptr) {
     *code = -1;
     return;
   }
-  if (index < 0 || index > static_cast<int32_t>(voiceInfoCtx->Count)) {
+  if (index < 0 || index >= static_cast<int32_t>(voiceInfoCtx->Count)) {
     *code = -2;
     return;
   }
@@ -1146,10 +1547,11 @@ void __stdcall SetAudioVolume(int32_t *code, int32_t index,
     return;
   }
 
-  wchar_t *s = new wchar_t[256]{};
-  HRESULT hr = StringCbPrintfW(
-      s, 256, L"Called SetAudioVolume (index=%d, audioVolume=%.2f)", index,
-      audioVolume);
+  wchar_t s[256]{};
+  HRESULT hr =
+      StringCbPrintfW(s, sizeof(s),
+                      L"Called SetAudioVolume (index=%d, audioVolume=%.2f)",
+                      index, audioVolume);
 
   if (FAILED(hr)) {
     *code = -4;
@@ -1159,9 +1561,6 @@ void __stdcall SetAudioVolume(int32_t *code, int32_t index,
     Log->Info(s, GetCurrentThreadId(), __LONGFILE__);
   }
 
-  delete[] s;
-  s = nullptr;
-
   if (audioVolume < 0.0) {
     audioVolume = 0.0;
   }
@@ -1169,5 +1568,7 @@ void __stdcall SetAudioVolume(int32_t *code, int32_t index,
     audioVolume = 1.0;
   }
 
-  voiceInfoCtx->VoiceProperties[index]->AudioVolume = audioVolume;
+  voiceInfoCtx->Settings->SetAudioVolume(index, audioVolume);
+  commandTrace.WriteVoiceSetting(TraceEventType::AudioVolume, index,
+                                 audioVolume);
 }
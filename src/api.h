@@ -13,11 +13,51 @@ export void __stdcall Teardown(int32_t *code);
 export void __stdcall FadeIn(int32_t *code);
 export void __stdcall FadeOut(int32_t *code);
 
+export void __stdcall SetLatencyMode(int32_t *code, int32_t mode);
+
 export void __stdcall Push(int32_t *code, Command **commandsPtr,
                            int32_t commandsLength, int32_t isForcePush);
 
+// Starts recording every Push call and voice setting change to the file at
+// path, UTF-8, for replaying the session later. code is -2 when the file
+// cannot be created or a trace is already being recorded.
+export void __stdcall StartCommandTrace(int32_t *code, const char *path);
+// Stops recording and closes the file. Teardown stops it as well.
+export void __stdcall StopCommandTrace(int32_t *code);
+
+// Fills summaries with the time from Push to each stage, in the order of
+// LatencyStage: dispatch, synthesis start, synthesis end, feed and first
+// sample. At most summariesLength stages are written; stagesLength
+// receives how many there are.
+export void __stdcall GetLatencyStats(int32_t *code, LatencySummary *summaries,
+                                      int32_t summariesLength,
+                                      int32_t *stagesLength);
+
+// Fills summary with the render thread counters, and periods with up to
+// periodsLength of the most recent periods, oldest first. periodsWritten
+// receives how many were written.
+export void __stdcall GetRenderTelemetry(int32_t *code, RenderSummary *summary,
+                                         RenderPeriodSample *periods,
+                                         int32_t periodsLength,
+                                         int32_t *periodsWritten);
+
 export void __stdcall GetVoiceCount(int32_t *code, int32_t *numberOfVoices);
 
+// Copies every voice's properties into buffer in one call. snapshotLength
+// receives the number of bytes needed; when buffer is missing or shorter,
+// nothing is copied and code is -2. Layout, version 1, little endian:
+//
+//   header   16 bytes: version, voice count, default voice index, reserved
+//   voices   48 bytes each: speaking rate, audio pitch and audio volume as
+//            doubles, then offset and length of id, display name and
+//            language as uint32
+//   strings  UTF-16 without terminators
+//
+// Offsets are in bytes from the start of buffer, lengths in UTF-16 units.
+export void __stdcall GetVoiceSnapshot(int32_t *code, char *buffer,
+                                       int32_t bufferLength,
+                                       int32_t *snapshotLength);
+
 export void __stdcall GetVoiceDisplayName(int32_t *code, int32_t index,
                                           wchar_t *displayName);
 export void __stdcall GetVoiceDisplayNameLength(int32_t *code, int32_t index,
@@ -16,10 +16,48 @@ using namespace Windows::Media::Devices;
 
 extern Logger::Logger *Log;
 
-AudioCore::AudioCore(PCMAudio::Engine *engine, HANDLE refreshEvent,
-                     HANDLE failEvent, HANDLE nextEvent)
-    : mEngine(engine), mRefreshEvent(refreshEvent), mFailEvent(failEvent),
-      mNextEvent(nextEvent) {}
+namespace {
+SampleFormat sampleFormatFromMixFormat(const WAVEFORMATEX *format) {
+  bool isFloat{format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT};
+  bool isPCM{format->wFormatTag == WAVE_FORMAT_PCM};
+
+  if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+    const WAVEFORMATEXTENSIBLE *formatEx =
+        reinterpret_cast<const WAVEFORMATEXTENSIBLE *>(format);
+
+    isFloat = formatEx->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+    isPCM = formatEx->SubFormat == KSDATAFORMAT_SUBTYPE_PCM;
+  }
+  if (isFloat && format->wBitsPerSample == 32) {
+    return SampleFormat::Float32;
+  }
+  if (!isPCM) {
+    return SampleFormat::Unknown;
+  }
+
+  // A 32-bit container with fewer valid bits is written as int32.
+  switch (format->wBitsPerSample) {
+  case 16:
+    return SampleFormat::Int16;
+  case 24:
+    return SampleFormat::Int24;
+  case 32:
+    return SampleFormat::Int32;
+  }
+
+  return SampleFormat::Unknown;
+}
+} // namespace
+
+AudioCore::AudioCore(Mixer *mixer, HANDLE refreshEvent, HANDLE failEvent,
+                     const HANDLE *nextEvents, LatencyMode latencyMode,
+                     RenderTelemetry *telemetry)
+    : mLatencyMode(latencyMode), mMixer(mixer), mRefreshEvent(refreshEvent),
+      mFailEvent(failEvent), mRenderer(mixer), mTelemetry(telemetry) {
+  for (int32_t i = 0; i < mixer->GetBusCount(); i++) {
+    mNextEvents[i] = nextEvents[i];
+  }
+}
 
 void AudioCore::LogMixFormat() {
   std::wstringstream wss;
@@ -33,7 +71,8 @@ void AudioCore::LogMixFormat() {
       reinterpret_cast<WAVEFORMATEXTENSIBLE *>(mMixFormat);
 
   wss << L"wValidBitsPerSample: " << mixFormatEx->Samples.wValidBitsPerSample
-      << L"}";
+      << L", ";
+  wss << L"SampleFormat: " << SampleFormatName(mStreamFormat.Format) << L"}";
 
   Log->Info(wss.str(), GetCurrentThreadId(), __LONGFILE__);
 }
@@ -58,12 +97,15 @@ void AudioCore::Shutdown() {
   CoTaskMemFree(mMixFormat);
   mMixFormat = nullptr;
 
+  mRenderer.Close();
+
   SafeCloseHandle(&mShutdownEvent);
   SafeCloseHandle(&mRenderEvent);
   SafeCloseHandle(&mSwitchStreamEvent);
   SafeRelease(&mDevice);
   SafeRelease(&mDeviceEnumerator);
   SafeRelease(&mAudioRenderClient);
+  SafeRelease(&mAudioClient3);
   SafeRelease(&mAudioClient);
 
   mActive = false;
@@ -94,6 +136,15 @@ AudioCore::ActivateCompleted(IActivateAudioInterfaceAsyncOperation *operation) {
     goto CLEANUP;
   }
 
+  // Only Windows 10 and later have IAudioClient3. Without it the stream uses
+  // the default period.
+  unknown->QueryInterface(IID_PPV_ARGS(&mAudioClient3));
+
+  if (mAudioClient3 == nullptr) {
+    Log->Info(L"IAudioClient3 is not available", GetCurrentThreadId(),
+              __LONGFILE__);
+  }
+
   hr = mAudioClient->GetMixFormat(&mMixFormat);
 
   if (FAILED(hr)) {
@@ -101,26 +152,33 @@ AudioCore::ActivateCompleted(IActivateAudioInterfaceAsyncOperation *operation) {
               GetCurrentThreadId(), __LONGFILE__);
     goto CLEANUP;
   }
-  if (reinterpret_cast<WAVEFORMATEXTENSIBLE *>(mMixFormat)->SubFormat !=
-      KSDATAFORMAT_SUBTYPE_PCM) {
-    reinterpret_cast<WAVEFORMATEXTENSIBLE *>(mMixFormat)->SubFormat =
-        KSDATAFORMAT_SUBTYPE_PCM;
-  }
 
   mFrameSize = mMixFormat->nBlockAlign;
+  mStreamFormat.Format = sampleFormatFromMixFormat(mMixFormat);
+  mStreamFormat.Channels = mMixFormat->nChannels;
+  mStreamFormat.SamplesPerSec = mMixFormat->nSamplesPerSec;
 
   LogMixFormat();
 
-  hr = mAudioClient->Initialize(
-      AUDCLNT_SHAREMODE_SHARED,
-      AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_NOPERSIST,
-      mHNSBufferDuration, mHNSBufferDuration, mMixFormat, nullptr);
+  if (mStreamFormat.Format == SampleFormat::Unknown) {
+    Log->Fail(L"Unsupported mix format", GetCurrentThreadId(), __LONGFILE__);
+    hr = E_FAIL;
+    goto CLEANUP;
+  }
 
-  if (FAILED(hr)) {
+  if (!OpenSharedStream(this, mLatencyMode, &mPeriodInFrames)) {
     Log->Fail(L"Failed to initialize mAudioClient", GetCurrentThreadId(),
               __LONGFILE__);
+    hr = E_FAIL;
     goto CLEANUP;
   }
+  if (mPeriodInFrames > 0) {
+    std::wstringstream wss;
+
+    wss << L"Use low latency period: " << mPeriodInFrames << L" frames";
+
+    Log->Info(wss.str(), GetCurrentThreadId(), __LONGFILE__);
+  }
 
   hr = mAudioClient->GetBufferSize(&mBufferFrames);
 
@@ -130,6 +188,12 @@ AudioCore::ActivateCompleted(IActivateAudioInterfaceAsyncOperation *operation) {
     goto CLEANUP;
   }
 
+  if (!mRenderer.Open(mStreamFormat, mBufferFrames)) {
+    Log->Fail(L"Failed to open renderer", GetCurrentThreadId(), __LONGFILE__);
+    hr = E_FAIL;
+    goto CLEANUP;
+  }
+
   hr = mAudioClient->GetService(__uuidof(IAudioRenderClient),
                                 (void **)&mAudioRenderClient);
 
@@ -279,9 +343,12 @@ CLEANUP:
     SafeCloseHandle(&mShutdownEvent);
     SafeRelease(&mDeviceEnumerator);
     SafeRelease(&mAudioRenderClient);
+    SafeRelease(&mAudioClient3);
     SafeRelease(&mAudioClient);
     SafeRelease(&unknown);
 
+    mRenderer.Close();
+
     if (!SetEvent(mFailEvent)) {
       Log->Fail(L"Failed to ", GetCurrentThreadId(), __LONGFILE__);
     }
@@ -311,22 +378,26 @@ DWORD AudioCore::DoRenderThread() {
   HANDLE mmcssHandle{nullptr};
   HANDLE waitArray[3] = {mShutdownEvent, mSwitchStreamEvent, mRenderEvent};
   DWORD mmcssTaskIndex{0};
+  MMCSSStatus mmcss{MMCSSStatus::Disabled};
 
   if (!mDisableMMCSS) {
     mmcssHandle = AvSetMmThreadCharacteristics("Audio", &mmcssTaskIndex);
     if (mmcssHandle == nullptr) {
       Log->Warn(L"Failed to call AvSetMmThreadCharacteristics",
                 GetCurrentThreadId(), __LONGFILE__);
+      mmcss = MMCSSStatus::Failed;
     } else {
       Log->Info(L"Success applying MMCSS attribute", GetCurrentThreadId(),
                 __LONGFILE__);
+      mmcss = MMCSSStatus::Registered;
     }
   }
+  if (mTelemetry != nullptr) {
+    mTelemetry->Start(getPeriodMicros(), mmcss);
+  }
 
-  int bytesPerSample{mMixFormat->wBitsPerSample / 8};
   bool isPlaying{true};
-
-  mEngine->SetTargetSamplesPerSec(mMixFormat->nSamplesPerSec);
+  int32_t completions[Mixer::MaxBuses]{};
 
   while (isPlaying) {
     DWORD waitResult = WaitForMultipleObjects(3, waitArray, FALSE, INFINITE);
@@ -350,67 +421,32 @@ DWORD AudioCore::DoRenderThread() {
       Log->Info(L"Switch render device", GetCurrentThreadId(), __LONGFILE__);
       isPlaying = false;
       break;
-    case WAIT_OBJECT_0 + 2: // mRenderEvent
-      BYTE *pData{nullptr};
-      UINT32 padding{};
-      UINT32 availableFrames{};
+    case WAIT_OBJECT_0 + 2: { // mRenderEvent
+      uint64_t wakeTime = LatencyNow();
 
-      hr = mAudioClient->GetCurrentPadding(&padding);
+      mPaddingFrames = 0;
+      mFramesWritten = 0;
 
-      if (!SUCCEEDED(hr)) {
-        Log->Warn(L"Failed to call IAudioClient::GetCurrentPadding",
-                  GetCurrentThreadId(), __LONGFILE__);
-        isPlaying = false;
-        break;
-      }
-
-      availableFrames = mBufferFrames - padding;
+      bool isRendered = mRenderer.Render(this, completions);
 
-      hr = mAudioRenderClient->GetBuffer(availableFrames, &pData);
-
-      if (!SUCCEEDED(hr)) {
-        Log->Warn(L"Failed to call IAudioRenderClient::GetBuffer",
-                  GetCurrentThreadId(), __LONGFILE__);
+      if (mTelemetry != nullptr) {
+        mTelemetry->Record(wakeTime, LatencyNow() - wakeTime, mPaddingFrames,
+                           mFramesWritten, !isRendered);
+      }
+      if (!isRendered) {
         isPlaying = false;
         break;
       }
-
-      int samples =
-          static_cast<int>(availableFrames * mFrameSize) / bytesPerSample;
-
-      for (int i = 0; i < samples; i++) {
-        double f64 = mEngine->Read();
-        int32_t s32 = static_cast<int32_t>(f64);
-
-        for (int j = 0; j < bytesPerSample; j++) {
-          pData[bytesPerSample * i + bytesPerSample - 1 - j] =
-              s32 >> (8 * (bytesPerSample - 1 - j)) & 0xFF;
-        }
-
-        mEngine->Next();
-
-        if (!mEngine->IsCompleted()) {
-          continue;
-        }
-        if (!SetEvent(mNextEvent)) {
+      for (int32_t i = 0; i < mMixer->GetBusCount(); i++) {
+        if (completions[i] > 0 && !SetEvent(mNextEvents[i])) {
           Log->Fail(L"Failed to send event", GetCurrentThreadId(),
                     __LONGFILE__);
         }
-
-        mEngine->Reset();
-      }
-
-      hr = mAudioRenderClient->ReleaseBuffer(availableFrames, 0);
-
-      if (!SUCCEEDED(hr)) {
-        Log->Warn(L"Failed to call IAudioRenderClient::releaseBuffer",
-                  GetCurrentThreadId(), __LONGFILE__);
-        isPlaying = false;
-        break;
       }
 
       break;
     }
+    }
   }
   if (!mDisableMMCSS) {
     AvRevertMmThreadCharacteristics(mmcssHandle);
@@ -434,3 +470,118 @@ DWORD AudioCore::DoRenderThread() {
 
   return S_OK;
 }
+
+const StreamFormat &AudioCore::GetStreamFormat() const { return mStreamFormat; }
+
+bool AudioCore::GetAvailableFrames(uint32_t *frames) {
+  UINT32 padding{};
+  HRESULT hr = mAudioClient->GetCurrentPadding(&padding);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioClient::GetCurrentPadding",
+              GetCurrentThreadId(), __LONGFILE__);
+    return false;
+  }
+
+  *frames = mBufferFrames - padding;
+  mPaddingFrames = padding;
+
+  return true;
+}
+
+bool AudioCore::GetBuffer(uint32_t frames, uint8_t **data) {
+  HRESULT hr = mAudioRenderClient->GetBuffer(frames, data);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioRenderClient::GetBuffer",
+              GetCurrentThreadId(), __LONGFILE__);
+    return false;
+  }
+
+  return true;
+}
+
+bool AudioCore::ReleaseBuffer(uint32_t frames) {
+  HRESULT hr = mAudioRenderClient->ReleaseBuffer(frames, 0);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioRenderClient::ReleaseBuffer",
+              GetCurrentThreadId(), __LONGFILE__);
+    return false;
+  }
+
+  mFramesWritten += frames;
+
+  return true;
+}
+
+bool AudioCore::GetSharedModeEnginePeriod(EnginePeriod *period) {
+  if (mAudioClient3 == nullptr) {
+    return false;
+  }
+
+  HRESULT hr = mAudioClient3->GetSharedModeEnginePeriod(
+      mMixFormat, &mDefaultPeriodInFrames, &mFundamentalPeriodInFrames,
+      &mMinPeriodInFrames, &mMaxPeriodInFrames);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioClient3::GetSharedModeEnginePeriod",
+              GetCurrentThreadId(), __LONGFILE__);
+    return false;
+  }
+
+  period->DefaultFrames = mDefaultPeriodInFrames;
+  period->FundamentalFrames = mFundamentalPeriodInFrames;
+  period->MinFrames = mMinPeriodInFrames;
+  period->MaxFrames = mMaxPeriodInFrames;
+
+  return true;
+}
+
+bool AudioCore::InitializeSharedAudioStream(uint32_t periodFrames) {
+  if (mAudioClient3 == nullptr) {
+    return false;
+  }
+
+  HRESULT hr = mAudioClient3->InitializeSharedAudioStream(
+      AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_NOPERSIST,
+      periodFrames, mMixFormat, nullptr);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioClient3::InitializeSharedAudioStream",
+              GetCurrentThreadId(), __LONGFILE__);
+    return false;
+  }
+
+  return true;
+}
+
+bool AudioCore::InitializeDefault() {
+  HRESULT hr = mAudioClient->Initialize(
+      AUDCLNT_SHAREMODE_SHARED,
+      AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_NOPERSIST,
+      mHNSBufferDuration, mHNSBufferDuration, mMixFormat, nullptr);
+
+  return SUCCEEDED(hr);
+}
+
+// Returns how often the engine wakes the render thread, or 0 when it is not
+// known.
+uint32_t AudioCore::getPeriodMicros() {
+  if (mPeriodInFrames > 0 && mStreamFormat.SamplesPerSec > 0) {
+    return static_cast<uint32_t>(1000000ULL * mPeriodInFrames /
+                                 mStreamFormat.SamplesPerSec);
+  }
+
+  REFERENCE_TIME defaultPeriod{0};
+  HRESULT hr = mAudioClient->GetDevicePeriod(&defaultPeriod, nullptr);
+
+  if (FAILED(hr)) {
+    Log->Warn(L"Failed to call IAudioClient::GetDevicePeriod",
+              GetCurrentThreadId(), __LONGFILE__);
+    return 0;
+  }
+
+  // REFERENCE_TIME is in 100 ns units.
+  return static_cast<uint32_t>(defaultPeriod / 10);
+}
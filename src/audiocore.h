@@ -3,20 +3,27 @@
 #include <AudioClient.h>
 #include <AudioPolicy.h>
 #include <MMDeviceAPI.h>
-#include <cppaudio/engine.h>
 #include <windows.h>
 #include <wrl/implements.h>
 
+#include "audiosink.h"
+#include "mixer.h"
 #include "notification.h"
+#include "renderer.h"
+#include "rendertelemetry.h"
+#include "streamperiod.h"
 
 using namespace Microsoft::WRL;
 
 class AudioCore
     : public RuntimeClass<RuntimeClassFlags<ClassicCom>, FtmBase,
-                          IActivateAudioInterfaceCompletionHandler> {
+                          IActivateAudioInterfaceCompletionHandler>,
+      public AudioSink,
+      public SharedStreamClient {
 public:
-  AudioCore(PCMAudio::Engine *engine, HANDLE refreshEvent, HANDLE failEvent,
-            HANDLE nextEvent);
+  AudioCore(Mixer *mixer, HANDLE refreshEvent, HANDLE failEvent,
+            const HANDLE *nextEvents, LatencyMode latencyMode,
+            RenderTelemetry *telemetry);
 
   void LogMixFormat();
   void Shutdown();
@@ -27,19 +34,33 @@ public:
   static DWORD __stdcall RenderThread(LPVOID Context);
   DWORD DoRenderThread();
 
+  // AudioSink
+  const StreamFormat &GetStreamFormat() const override;
+  bool GetAvailableFrames(uint32_t *frames) override;
+  bool GetBuffer(uint32_t frames, uint8_t **data) override;
+  bool ReleaseBuffer(uint32_t frames) override;
+
+  // SharedStreamClient
+  bool GetSharedModeEnginePeriod(EnginePeriod *period) override;
+  bool InitializeSharedAudioStream(uint32_t periodFrames) override;
+  bool InitializeDefault() override;
+
 private:
+  uint32_t getPeriodMicros();
+
   bool mActive = false;
-  PCMAudio::Engine *mEngine = nullptr;
+  LatencyMode mLatencyMode = LatencyMode::Default;
+  Mixer *mMixer = nullptr;
 
   ERole mDeviceRole;
-  bool mDisableMMCSS;
+  bool mDisableMMCSS = false;
   bool mInStreamSwitch;
 
   HANDLE mRenderThread = nullptr;
 
   HANDLE mRefreshEvent = nullptr;
   HANDLE mFailEvent = nullptr;
-  HANDLE mNextEvent = nullptr;
+  HANDLE mNextEvents[Mixer::MaxBuses]{};
 
   HANDLE mRenderEvent = nullptr;
   HANDLE mShutdownEvent = nullptr;
@@ -50,14 +71,25 @@ private:
   IMMDeviceEnumerator *mDeviceEnumerator = nullptr;
   IMMDevice *mDevice = nullptr;
   IAudioRenderClient *mAudioRenderClient = nullptr;
-  IAudioClient3 *mAudioClient = nullptr;
+  IAudioClient *mAudioClient = nullptr;
+  // nullptr before Windows 10.
+  IAudioClient3 *mAudioClient3 = nullptr;
   WAVEFORMATEX *mMixFormat = nullptr;
 
   REFERENCE_TIME mHNSBufferDuration = 0;
-  UINT32 mDefaultPeriodInFrames;
-  UINT32 mFundamentalPeriodInFrames;
-  UINT32 mMaxPeriodInFrames;
-  UINT32 mMinPeriodInFrames;
+  UINT32 mDefaultPeriodInFrames = 0;
+  UINT32 mFundamentalPeriodInFrames = 0;
+  UINT32 mMaxPeriodInFrames = 0;
+  UINT32 mMinPeriodInFrames = 0;
+  UINT32 mPeriodInFrames = 0;
   UINT32 mBufferFrames;
   UINT32 mFrameSize;
+
+  StreamFormat mStreamFormat;
+  Renderer mRenderer;
+
+  // Measured by the sink calls of the period being rendered.
+  RenderTelemetry *mTelemetry = nullptr;
+  UINT32 mPaddingFrames = 0;
+  UINT32 mFramesWritten = 0;
 };
@@ -47,7 +47,8 @@ DWORD WINAPI audioLoop(LPVOID context) {
     IActivateAudioInterfaceAsyncOperation *op{nullptr};
     IActivateAudioInterfaceCompletionHandler *obj{nullptr};
     ComPtr<AudioCore> renderer =
-        Make<AudioCore>(ctx->Engine, refreshEvent, failEvent, ctx->NextEvent);
+        Make<AudioCore>(ctx->OutputMixer, refreshEvent, failEvent,
+                        ctx->NextEvents, ctx->Latency.load(), ctx->Telemetry);
 
     HRESULT hr = renderer->QueryInterface(IID_PPV_ARGS(&obj));
 
@@ -58,7 +59,7 @@ DWORD WINAPI audioLoop(LPVOID context) {
       return hr;
     }
 
-    hr = ActivateAudioInterfaceAsync(deviceId->Data(), __uuidof(IAudioClient3),
+    hr = ActivateAudioInterfaceAsync(deviceId->Data(), __uuidof(IAudioClient),
                                      nullptr, obj, &op);
 
     if (FAILED(hr)) {
@@ -69,8 +70,9 @@ DWORD WINAPI audioLoop(LPVOID context) {
 
     SafeRelease(&op);
 
-    HANDLE waitArray[3] = {ctx->QuitEvent, refreshEvent, failEvent};
-    DWORD waitResult = WaitForMultipleObjects(3, waitArray, FALSE, INFINITE);
+    HANDLE waitArray[4] = {ctx->QuitEvent, refreshEvent, failEvent,
+                           ctx->RestartEvent};
+    DWORD waitResult = WaitForMultipleObjects(4, waitArray, FALSE, INFINITE);
 
     switch (waitResult) {
     case WAIT_OBJECT_0 + 0: // ctx->QuitEvent
@@ -84,6 +86,9 @@ DWORD WINAPI audioLoop(LPVOID context) {
                 __LONGFILE__);
       Sleep(1000);
       break;
+    case WAIT_OBJECT_0 + 3: // ctx->RestartEvent
+      Log->Info(L"Restart audio renderer", GetCurrentThreadId(), __LONGFILE__);
+      break;
     }
 
     SafeCloseHandle(&refreshEvent);
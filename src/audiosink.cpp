@@ -0,0 +1,21 @@
+#include "audiosink.h"
+
+uint16_t BytesPerSample(SampleFormat format) {
+  switch (format) {
+  case SampleFormat::Int16:
+    return 2;
+  case SampleFormat::Int24:
+    return 3;
+  case SampleFormat::Int32:
+  case SampleFormat::Float32:
+    return 4;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+uint32_t BytesPerFrame(const StreamFormat &format) {
+  return BytesPerSample(format.Format) * format.Channels;
+}
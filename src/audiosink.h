@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "samplewriter.h"
+
+struct StreamFormat {
+  SampleFormat Format = SampleFormat::Unknown;
+  uint16_t Channels = 0;
+  uint32_t SamplesPerSec = 0;
+};
+
+uint16_t BytesPerSample(SampleFormat format);
+uint32_t BytesPerFrame(const StreamFormat &format);
+
+// AudioSink is an output endpoint that accepts rendered frames. The render
+// loop asks how many frames fit, acquires a buffer for them, fills it and
+// releases it, mirroring IAudioRenderClient.
+class AudioSink {
+public:
+  virtual ~AudioSink() {}
+
+  virtual const StreamFormat &GetStreamFormat() const = 0;
+  virtual bool GetAvailableFrames(uint32_t *frames) = 0;
+  virtual bool GetBuffer(uint32_t frames, uint8_t **data) = 0;
+  virtual bool ReleaseBuffer(uint32_t frames) = 0;
+};
@@ -0,0 +1,168 @@
+#include <cstring>
+#include <fstream>
+
+#include "bankfile.h"
+
+namespace {
+constexpr char bankMagic[4] = {'S', 'F', 'X', 'B'};
+constexpr uint32_t bankVersion = 1;
+constexpr uint32_t headerSize = 64;
+constexpr uint32_t entrySize = 32;
+constexpr uint32_t dataAlignment = 64;
+constexpr uint16_t entryFlagPresent = 1;
+
+uint16_t getUint16(const char *p) {
+  uint16_t v{};
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t getUint32(const char *p) {
+  uint32_t v{};
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t getUint64(const char *p) {
+  uint64_t v{};
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+template <typename T> void put(char *p, T v) { std::memcpy(p, &v, sizeof(v)); }
+
+uint64_t alignUp(uint64_t v) {
+  return (v + dataAlignment - 1) & ~uint64_t{dataAlignment - 1};
+}
+} // namespace
+
+bool BankFile::Open(const char *path) {
+  Close();
+
+  if (!mFile.Open(path)) {
+    return false;
+  }
+
+  const char *data = mFile.GetData();
+  size_t size = mFile.GetSize();
+
+  if (size < headerSize || std::memcmp(data, bankMagic, 4) != 0 ||
+      getUint32(data + 4) != bankVersion) {
+    Close();
+    return false;
+  }
+
+  uint32_t count = getUint32(data + 8);
+  uint64_t indexOffset = getUint64(data + 16);
+
+  if (indexOffset > size ||
+      (size - indexOffset) / entrySize < static_cast<uint64_t>(count)) {
+    Close();
+    return false;
+  }
+
+  mCount = count;
+  mIndex = data + indexOffset;
+
+  return true;
+}
+
+void BankFile::Close() {
+  mFile.Close();
+  mCount = 0;
+  mIndex = nullptr;
+}
+
+uint32_t BankFile::GetCount() const { return mCount; }
+
+bool BankFile::GetEntry(uint32_t index, BankEntry *entry) const {
+  if (index >= mCount) {
+    return false;
+  }
+
+  const char *p = mIndex + index * entrySize;
+  uint64_t offset = getUint64(p);
+  uint32_t frames = getUint32(p + 8);
+  uint16_t channels = getUint16(p + 12);
+  uint16_t flags = getUint16(p + 14);
+  uint32_t samplesPerSec = getUint32(p + 16);
+  uint64_t bytes = uint64_t{frames} * channels * sizeof(float);
+
+  if ((flags & entryFlagPresent) == 0 || channels == 0 || frames == 0 ||
+      offset % dataAlignment != 0 || offset > mFile.GetSize() ||
+      bytes > mFile.GetSize() - offset) {
+    return false;
+  }
+
+  entry->Samples = reinterpret_cast<const float *>(mFile.GetData() + offset);
+  entry->Frames = frames;
+  entry->Channels = channels;
+  entry->SamplesPerSec = samplesPerSec;
+
+  return true;
+}
+
+bool WriteBankFile(const char *path, const BankEntry *entries,
+                   uint32_t count) {
+  std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+
+  if (!file.is_open()) {
+    return false;
+  }
+
+  char header[headerSize]{};
+  char *index = new char[count * entrySize]{};
+  uint64_t offset = alignUp(headerSize + uint64_t{count} * entrySize);
+
+  for (uint32_t i = 0; i < count; i++) {
+    const BankEntry &entry = entries[i];
+    char *p = index + i * entrySize;
+
+    if (entry.Samples == nullptr || entry.Frames == 0 ||
+        entry.Channels == 0) {
+      continue;
+    }
+
+    put<uint64_t>(p, offset);
+    put<uint32_t>(p + 8, entry.Frames);
+    put<uint16_t>(p + 12, entry.Channels);
+    put<uint16_t>(p + 14, entryFlagPresent);
+    put<uint32_t>(p + 16, entry.SamplesPerSec);
+
+    offset = alignUp(offset + uint64_t{entry.Frames} * entry.Channels *
+                                  sizeof(float));
+  }
+
+  std::memcpy(header, bankMagic, 4);
+  put<uint32_t>(header + 4, bankVersion);
+  put<uint32_t>(header + 8, count);
+  put<uint64_t>(header + 16, headerSize);
+
+  file.write(header, headerSize);
+  file.write(index, count * entrySize);
+
+  delete[] index;
+  index = nullptr;
+
+  const char padding[dataAlignment]{};
+  uint64_t written = headerSize + uint64_t{count} * entrySize;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const BankEntry &entry = entries[i];
+
+    if (entry.Samples == nullptr || entry.Frames == 0 ||
+        entry.Channels == 0) {
+      continue;
+    }
+
+    uint64_t bytes = uint64_t{entry.Frames} * entry.Channels * sizeof(float);
+
+    file.write(padding, alignUp(written) - written);
+    file.write(reinterpret_cast<const char *>(entry.Samples), bytes);
+    written = alignUp(written) + bytes;
+  }
+
+  file.close();
+
+  return !file.fail();
+}
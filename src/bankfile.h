@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mappedfile.h"
+
+// A bank file packs sound effects pre-decoded to interleaved float32 so they
+// can be played straight from a mapped view. Layout, little endian:
+//
+//   header   64 bytes: "SFXB", version, entry count, index offset
+//   index    32 bytes per entry: data offset, frames, channels, flags, rate
+//   data     float32 samples, each entry starting on a 64-byte boundary
+//
+// Entry i holds the sound effect with index i; unused indices are empty.
+struct BankEntry {
+  const float *Samples = nullptr;
+  uint32_t Frames = 0;
+  uint16_t Channels = 0;
+  uint32_t SamplesPerSec = 0;
+};
+
+class BankFile {
+public:
+  bool Open(const char *path);
+  void Close();
+
+  uint32_t GetCount() const;
+  // Returns false for empty or out of range entries.
+  bool GetEntry(uint32_t index, BankEntry *entry) const;
+
+private:
+  MappedFile mFile;
+  uint32_t mCount = 0;
+  const char *mIndex = nullptr;
+};
+
+// Writes count entries to path. Entries without samples are stored empty.
+bool WriteBankFile(const char *path, const BankEntry *entries, uint32_t count);
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+
+#include "commandchannel.h"
+
+namespace {
+constexpr size_t LengthBytes = 4;
+constexpr size_t PayloadHeaderBytes = 8;
+constexpr size_t CommandBytes = 24;
+constexpr uint32_t NoText = 0xFFFFFFFF;
+
+// Both ends are little endian, as are Windows and the platforms the tests
+// run on, so values are copied as they are.
+template <class T> T get(const uint8_t *p) {
+  T value;
+
+  std::memcpy(&value, p, sizeof(value));
+
+  return value;
+}
+
+template <class T> void put(std::vector<uint8_t> *out, T value) {
+  size_t offset = out->size();
+
+  out->resize(offset + sizeof(value));
+  std::memcpy(out->data() + offset, &value, sizeof(value));
+}
+
+void putText(std::vector<uint8_t> *out, const wchar_t *text) {
+  size_t length = std::wcslen(text);
+  size_t lengthOffset = out->size();
+  uint32_t units{0};
+
+  put<uint32_t>(out, 0);
+
+  for (size_t i = 0; i < length; i++) {
+    uint32_t c = static_cast<uint32_t>(text[i]);
+
+    if (c >= 0x10000) {
+      c -= 0x10000;
+      put<uint16_t>(out, static_cast<uint16_t>(0xD800 + (c >> 10)));
+      put<uint16_t>(out, static_cast<uint16_t>(0xDC00 + (c & 0x3FF)));
+      units += 2;
+    } else {
+      put<uint16_t>(out, static_cast<uint16_t>(c));
+      units += 1;
+    }
+  }
+
+  std::memcpy(out->data() + lengthOffset, &units, sizeof(units));
+}
+
+void appendText(std::vector<wchar_t> *text, const uint8_t *units,
+                uint32_t length) {
+  if (sizeof(wchar_t) == 2) {
+    size_t offset = text->size();
+
+    text->resize(offset + length);
+    std::memcpy(text->data() + offset, units, length * 2);
+
+    return;
+  }
+  for (uint32_t i = 0; i < length; i++) {
+    uint32_t c = get<uint16_t>(units + i * 2);
+
+    if (c >= 0xD800 && c < 0xDC00 && i + 1 < length) {
+      uint32_t low = get<uint16_t>(units + (i + 1) * 2);
+
+      if (low >= 0xDC00 && low < 0xE000) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        i += 1;
+      }
+    }
+
+    text->push_back(static_cast<wchar_t>(c));
+  }
+}
+} // namespace
+
+void EncodeCommandFrame(const Command *const *commands, uint16_t length,
+                        uint8_t flags, uint32_t sequence,
+                        std::vector<uint8_t> *frame) {
+  size_t lengthOffset = frame->size();
+
+  put<uint32_t>(frame, 0);
+  put<uint8_t>(frame, CommandChannel::Version);
+  put<uint8_t>(frame, flags);
+  put<uint16_t>(frame, length);
+  put<uint32_t>(frame, sequence);
+
+  for (uint16_t i = 0; i < length; i++) {
+    const Command *c = commands[i];
+
+    put<int16_t>(frame, c->Type);
+    put<int16_t>(frame, c->SFXIndex);
+    put<float>(frame, c->Gain);
+    put<float>(frame, c->Pan);
+    put<double>(frame, c->WaitDuration);
+
+    if (c->Text == nullptr) {
+      put<uint32_t>(frame, NoText);
+    } else {
+      putText(frame, c->Text);
+    }
+  }
+
+  uint32_t payloadLength =
+      static_cast<uint32_t>(frame->size() - lengthOffset - LengthBytes);
+
+  std::memcpy(frame->data() + lengthOffset, &payloadLength,
+              sizeof(payloadLength));
+}
+
+CommandChannel::CommandChannel(CommandSink *sink) : mSink(sink) {}
+
+bool CommandChannel::Receive(const void *data, size_t length) {
+  if (mIsBroken) {
+    return false;
+  }
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+  // Completes the frame left over from earlier reads first. Only the bytes
+  // it needs are copied.
+  while (!mPartial.empty() && length > 0) {
+    size_t needed = mPartial.size() < LengthBytes
+                        ? LengthBytes
+                        : LengthBytes + get<uint32_t>(mPartial.data());
+    size_t n = std::min(needed - mPartial.size(), length);
+
+    mPartial.insert(mPartial.end(), bytes, bytes + n);
+    bytes += n;
+    length -= n;
+
+    if (consume(mPartial.data(), mPartial.size()) > 0) {
+      mPartial.clear();
+    }
+    if (mIsBroken) {
+      return false;
+    }
+  }
+  if (length == 0) {
+    return true;
+  }
+
+  // Whole frames are decoded where they were read.
+  size_t used = consume(bytes, length);
+
+  if (mIsBroken) {
+    return false;
+  }
+
+  mPartial.assign(bytes + used, bytes + length);
+
+  return true;
+}
+
+bool CommandChannel::TakeReplies(std::vector<uint8_t> *replies) {
+  replies->clear();
+
+  if (mReplies.empty()) {
+    return false;
+  }
+
+  replies->swap(mReplies);
+
+  return true;
+}
+
+void CommandChannel::Reset() {
+  mPartial.clear();
+  mReplies.clear();
+  mIsBroken = false;
+}
+
+bool CommandChannel::IsBroken() const { return mIsBroken; }
+
+uint64_t CommandChannel::GetFrameCount() const { return mFrameCount; }
+
+size_t CommandChannel::consume(const uint8_t *data, size_t length) {
+  size_t offset{0};
+
+  while (length - offset >= LengthBytes) {
+    uint32_t n = get<uint32_t>(data + offset);
+
+    if (n > MaxCommandFrameBytes) {
+      mIsBroken = true;
+      break;
+    }
+    if (length - offset - LengthBytes < n) {
+      break;
+    }
+    if (!decode(data + offset + LengthBytes, n)) {
+      mIsBroken = true;
+      break;
+    }
+
+    offset += LengthBytes + n;
+  }
+
+  return offset;
+}
+
+bool CommandChannel::decode(const uint8_t *payload, uint32_t length) {
+  if (length < PayloadHeaderBytes || payload[0] != Version) {
+    return false;
+  }
+
+  uint8_t flags = payload[1];
+  uint16_t count = get<uint16_t>(payload + 2);
+  uint32_t sequence = get<uint32_t>(payload + 4);
+  size_t offset{PayloadHeaderBytes};
+
+  mCommands.resize(count);
+  mPointers.resize(count);
+  mTextOffsets.resize(count);
+  mText.clear();
+
+  for (uint16_t i = 0; i < count; i++) {
+    if (length - offset < CommandBytes) {
+      return false;
+    }
+
+    const uint8_t *p = payload + offset;
+    Command &c = mCommands[i];
+    uint32_t textLength = get<uint32_t>(p + 20);
+
+    c.Type = get<int16_t>(p);
+    c.SFXIndex = get<int16_t>(p + 2);
+    c.Gain = get<float>(p + 4);
+    c.Pan = get<float>(p + 8);
+    c.WaitDuration = get<double>(p + 12);
+    c.Text = nullptr;
+    offset += CommandBytes;
+    mTextOffsets[i] = SIZE_MAX;
+
+    if (textLength == NoText) {
+      continue;
+    }
+    if ((length - offset) / 2 < textLength) {
+      return false;
+    }
+
+    mTextOffsets[i] = mText.size();
+    appendText(&mText, payload + offset, textLength);
+    mText.push_back(L'\0');
+    offset += textLength * 2;
+  }
+  if (offset != length) {
+    return false;
+  }
+
+  // The text buffer has stopped growing, so it can be pointed into now.
+  for (uint16_t i = 0; i < count; i++) {
+    if (mTextOffsets[i] != SIZE_MAX) {
+      mCommands[i].Text = mText.data() + mTextOffsets[i];
+    }
+
+    mPointers[i] = &mCommands[i];
+  }
+
+  mFrameCount += 1;
+
+  int32_t code = mSink->Push(mPointers.data(), count,
+                             (flags & CommandFrameForcePush) != 0);
+
+  if (flags & CommandFrameReply) {
+    put<uint32_t>(&mReplies, 8);
+    put<uint32_t>(&mReplies, sequence);
+    put<int32_t>(&mReplies, code);
+  }
+
+  return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+
+// CommandSink takes the batches that arrive on a CommandChannel.
+class CommandSink {
+public:
+  virtual ~CommandSink() = default;
+
+  // Returns what Push would set code to.
+  virtual int32_t Push(Command **commands, int32_t length,
+                       bool isForcePush) = 0;
+};
+
+// Flags of a command frame.
+constexpr uint8_t CommandFrameForcePush = 1;
+// The sender wants the code of the push back.
+constexpr uint8_t CommandFrameReply = 2;
+
+// Frames larger than this break the stream.
+constexpr uint32_t MaxCommandFrameBytes = 1024 * 1024;
+
+// Appends one frame carrying commands to frame. Commands are encoded as
+// Push receives them: SFX indices start at 1.
+//
+// Layout, little endian:
+//
+//   frame    payload length as uint32, then the payload
+//   payload  version as uint8, flags as uint8, command count as uint16,
+//            sequence as uint32, then the commands
+//   command  Type as int16, SFXIndex as int16, Gain and Pan as float,
+//            WaitDuration as double, text length in UTF-16 units as uint32
+//            or 0xFFFFFFFF without text, then the text as UTF-16
+//   reply    length as uint32 (8), sequence as uint32, code as int32
+void EncodeCommandFrame(const Command *const *commands, uint16_t length,
+                        uint8_t flags, uint32_t sequence,
+                        std::vector<uint8_t> *frame);
+
+// CommandChannel decodes the frames of one byte stream, such as a pipe or a
+// socket, and pushes each batch to a sink as soon as its frame is complete.
+// Frames may arrive in any number of pieces. Decoded commands and their text
+// live in buffers that are reused between frames, so a steady stream does
+// not allocate.
+//
+// It belongs to the thread that reads the stream.
+class CommandChannel {
+public:
+  static constexpr uint8_t Version = 1;
+
+  explicit CommandChannel(CommandSink *sink);
+
+  // Feeds bytes read from the stream. Returns false once the stream is
+  // broken; nothing more is decoded and the connection should be closed.
+  bool Receive(const void *data, size_t length);
+  // Moves the replies waiting to be written back into replies. Returns
+  // false when there are none.
+  bool TakeReplies(std::vector<uint8_t> *replies);
+  // Forgets a partial frame and pending replies, for a new connection.
+  void Reset();
+
+  bool IsBroken() const;
+  uint64_t GetFrameCount() const;
+
+private:
+  // Decodes the complete frames at the front of data and returns the bytes
+  // used.
+  size_t consume(const uint8_t *data, size_t length);
+  bool decode(const uint8_t *payload, uint32_t length);
+
+  CommandSink *mSink = nullptr;
+  // A frame that has not arrived completely.
+  std::vector<uint8_t> mPartial;
+  std::vector<uint8_t> mReplies;
+  std::vector<Command> mCommands;
+  std::vector<Command *> mPointers;
+  std::vector<wchar_t> mText;
+  std::vector<size_t> mTextOffsets;
+  bool mIsBroken = false;
+  uint64_t mFrameCount = 0;
+};
@@ -2,6 +2,7 @@
 #include <windows.h>
 
 #include "commandloop.h"
+#include "commandscheduler.h"
 #include "context.h"
 #include "util.h"
 
@@ -9,6 +10,88 @@
 
 extern Logger::Logger *Log;
 
+namespace {
+// Wakes the voice and SFX loops and logs what the scheduler plays.
+class LoopHost : public SchedulerHost {
+public:
+  LoopHost(VoiceLoopContext *voiceCtx, SFXLoopContext *sfxCtx)
+      : mVoiceCtx(voiceCtx), mSFXCtx(sfxCtx) {}
+
+  VoiceSettings GetVoice() override;
+  void RequestSynthesis() override;
+  void RequestSFX() override;
+  void Report(SchedulerEvent event) override;
+
+private:
+  VoiceLoopContext *mVoiceCtx = nullptr;
+  SFXLoopContext *mSFXCtx = nullptr;
+};
+
+VoiceSettings LoopHost::GetVoice() {
+  VoiceSettings voice;
+  VoiceInfoContext *info = mVoiceCtx->VoiceInfoCtx;
+
+  if (info == nullptr || info->VoiceProperties == nullptr ||
+      info->Settings == nullptr || info->Count == 0) {
+    return voice;
+  }
+
+  VoiceSettingsStore *settings = info->Settings;
+  const VoiceTable *table = settings->Acquire();
+  unsigned int index = table->DefaultVoiceIndex;
+
+  voice.Version = table->Version;
+  voice.VoiceIndex = index;
+  voice.VoiceId = info->VoiceProperties[index]->Id;
+  // Rate and pitch are applied by the voice stream while it plays, so speech
+  // is synthesized at a rate and pitch of 1 and cached regardless of them.
+  voice.AudioVolume = table->Voices[index].AudioVolume;
+
+  settings->Release(table);
+
+  return voice;
+}
+
+void LoopHost::RequestSynthesis() {
+  if (!SetEvent(mVoiceCtx->FeedEvent)) {
+    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+  }
+}
+
+void LoopHost::RequestSFX() {
+  if (!SetEvent(mSFXCtx->FeedEvent)) {
+    Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+  }
+}
+
+void LoopHost::Report(SchedulerEvent event) {
+  switch (event) {
+  case SchedulerEvent::PlayText:
+    Log->Info(L"Play voice generated from plain text", GetCurrentThreadId(),
+              __LONGFILE__);
+    break;
+  case SchedulerEvent::PlaySSML:
+    Log->Info(L"Play voice generated from SSML", GetCurrentThreadId(),
+              __LONGFILE__);
+    break;
+  case SchedulerEvent::PlaySFX:
+    Log->Info(L"Play SFX", GetCurrentThreadId(), __LONGFILE__);
+    break;
+  case SchedulerEvent::Wait:
+    Log->Info(L"Wait", GetCurrentThreadId(), __LONGFILE__);
+    break;
+  case SchedulerEvent::SkipFailedVoice:
+    Log->Warn(L"Skip voice that failed to synthesize", GetCurrentThreadId(),
+              __LONGFILE__);
+    break;
+  case SchedulerEvent::SkipUnsupportedVoice:
+    Log->Warn(L"Skip voice with unsupported wave header",
+              GetCurrentThreadId(), __LONGFILE__);
+    break;
+  }
+}
+} // namespace
+
 DWORD WINAPI commandLoop(LPVOID context) {
   Log->Info(L"Start command loop thread", GetCurrentThreadId(), __LONGFILE__);
 
@@ -19,80 +102,36 @@ DWORD WINAPI commandLoop(LPVOID context) {
     return E_FAIL;
   }
 
-  Command *cmd{nullptr};
+  LoopHost host(ctx->VoiceLoopCtx, ctx->SFXLoopCtx);
+  SchedulerContext schedulerCtx;
+
+  schedulerCtx.Commands = ctx->Commands;
+  schedulerCtx.Speech = ctx->VoiceLoopCtx->Speech;
+  schedulerCtx.VoiceStream = ctx->VoiceLoopCtx->VoiceStream;
+  schedulerCtx.SFX = ctx->SFXLoopCtx->Queue;
+  schedulerCtx.Bank = ctx->SFXLoopCtx->Bank;
+  schedulerCtx.OutputMixer = ctx->OutputMixer;
+  schedulerCtx.Stats = ctx->Stats;
+  schedulerCtx.IsIdle = &ctx->IsIdle;
+  schedulerCtx.Host = &host;
+
+  CommandScheduler scheduler(schedulerCtx);
   bool isActive{true};
 
   while (isActive) {
-    HANDLE waitArray[4] = {ctx->QuitEvent, ctx->PushEvent,
+    HANDLE waitArray[5] = {ctx->QuitEvent, ctx->PushEvent,
                            ctx->VoiceLoopCtx->NextEvent,
-                           ctx->SFXLoopCtx->NextEvent};
-    DWORD waitResult = WaitForMultipleObjects(4, waitArray, FALSE, INFINITE);
+                           ctx->SFXLoopCtx->NextEvent,
+                           ctx->VoiceLoopCtx->ReadyEvent};
+    DWORD waitResult = WaitForMultipleObjects(5, waitArray, FALSE, INFINITE);
 
+    // ctx->QuitEvent
     if (waitResult == WAIT_OBJECT_0 + 0) {
       isActive = false;
       continue;
     }
-    if (ctx->ReadIndex == ctx->WriteIndex) {
-      ctx->IsIdle = true;
-      continue;
-    }
-    switch (waitResult) {
-    case WAIT_OBJECT_0 + 1: // ctx->PushEvent
-      ctx->VoiceLoopCtx->VoiceEngine->FadeOut();
-      ctx->SFXLoopCtx->SFXEngine->FadeOut();
-      break;
-    }
-
-    cmd = ctx->Commands[ctx->ReadIndex];
-    ctx->ReadIndex = (ctx->ReadIndex + 1) % ctx->MaxCommands;
-
-    switch (cmd->Type) {
-    case 1:
-      Log->Info(L"Play SFX", GetCurrentThreadId(), __LONGFILE__);
-
-      ctx->SFXLoopCtx->SFXIndex = cmd->SFXIndex;
-
-      if (!SetEvent(ctx->SFXLoopCtx->FeedEvent)) {
-        Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
-      }
-
-      break;
-    case 2:
-      Log->Info(L"Wait", GetCurrentThreadId(), __LONGFILE__);
-
-      ctx->SFXLoopCtx->SFXIndex = -1;
-      ctx->SFXLoopCtx->WaitDuration = cmd->WaitDuration;
 
-      if (!SetEvent(ctx->SFXLoopCtx->FeedEvent)) {
-        Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
-      }
-
-      break;
-    case 3:
-      Log->Info(L"Play voice generated from plain text", GetCurrentThreadId(),
-                __LONGFILE__);
-
-      ctx->VoiceLoopCtx->IsSSML = false;
-      ctx->VoiceLoopCtx->Text = cmd->Text;
-
-      if (!SetEvent(ctx->VoiceLoopCtx->FeedEvent)) {
-        Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
-      }
-
-      break;
-    case 4:
-      Log->Info(L"Play voice generated from SSML", GetCurrentThreadId(),
-                __LONGFILE__);
-
-      ctx->VoiceLoopCtx->IsSSML = true;
-      ctx->VoiceLoopCtx->Text = cmd->Text;
-
-      if (!SetEvent(ctx->VoiceLoopCtx->FeedEvent)) {
-        Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
-      }
-
-      break;
-    }
+    scheduler.Run();
   }
 
   Log->Info(L"End command loop thread", GetCurrentThreadId(), __LONGFILE__);
@@ -0,0 +1,191 @@
+#include <cpplogger/cpplogger.h>
+#include <vector>
+#include <windows.h>
+
+#include "commandchannel.h"
+#include "commandpipeloop.h"
+#include "context.h"
+#include "util.h"
+
+extern Logger::Logger *Log;
+
+namespace {
+// Large enough for a burst of keystrokes in one read.
+constexpr DWORD PipeBufferBytes = 65536;
+constexpr DWORD ReconnectMilliseconds = 100;
+
+enum class IOResult { Done, Failed, Quit };
+
+// Waits for the overlapped operation started on pipe. Teardown cancels it
+// through quitEvent.
+IOResult await(HANDLE pipe, OVERLAPPED *overlapped, HANDLE quitEvent,
+               DWORD *transferred) {
+  HANDLE waitArray[2] = {quitEvent, overlapped->hEvent};
+  DWORD waitResult = WaitForMultipleObjects(2, waitArray, FALSE, INFINITE);
+
+  if (waitResult != WAIT_OBJECT_0 + 1) {
+    CancelIoEx(pipe, overlapped);
+    GetOverlappedResult(pipe, overlapped, transferred, TRUE);
+
+    return IOResult::Quit;
+  }
+  if (!GetOverlappedResult(pipe, overlapped, transferred, FALSE)) {
+    return IOResult::Failed;
+  }
+
+  return IOResult::Done;
+}
+
+IOResult connect(HANDLE pipe, OVERLAPPED *overlapped, HANDLE quitEvent) {
+  DWORD transferred{0};
+
+  if (ConnectNamedPipe(pipe, overlapped)) {
+    return IOResult::Done;
+  }
+
+  switch (GetLastError()) {
+  case ERROR_PIPE_CONNECTED:
+    return IOResult::Done;
+  case ERROR_IO_PENDING:
+    return await(pipe, overlapped, quitEvent, &transferred);
+  default:
+    return IOResult::Failed;
+  }
+}
+
+IOResult read(HANDLE pipe, OVERLAPPED *overlapped, HANDLE quitEvent,
+              char *buffer, DWORD length, DWORD *transferred) {
+  if (ReadFile(pipe, buffer, length, nullptr, overlapped)) {
+    return GetOverlappedResult(pipe, overlapped, transferred, FALSE)
+               ? IOResult::Done
+               : IOResult::Failed;
+  }
+  if (GetLastError() != ERROR_IO_PENDING) {
+    return IOResult::Failed;
+  }
+
+  return await(pipe, overlapped, quitEvent, transferred);
+}
+
+IOResult write(HANDLE pipe, OVERLAPPED *overlapped, HANDLE quitEvent,
+               const std::vector<uint8_t> &data) {
+  DWORD transferred{0};
+
+  if (!WriteFile(pipe, data.data(), static_cast<DWORD>(data.size()), nullptr,
+                 overlapped) &&
+      GetLastError() != ERROR_IO_PENDING) {
+    return IOResult::Failed;
+  }
+
+  IOResult result = await(pipe, overlapped, quitEvent, &transferred);
+
+  if (result == IOResult::Done && transferred != data.size()) {
+    return IOResult::Failed;
+  }
+
+  return result;
+}
+
+// Decodes what the client sends until it disconnects or breaks the stream.
+IOResult serve(HANDLE pipe, OVERLAPPED *overlapped, HANDLE quitEvent,
+               CommandChannel *channel) {
+  char buffer[PipeBufferBytes];
+  std::vector<uint8_t> replies;
+
+  while (true) {
+    DWORD transferred{0};
+    IOResult result = read(pipe, overlapped, quitEvent, buffer,
+                           sizeof(buffer), &transferred);
+
+    if (result != IOResult::Done) {
+      return result;
+    }
+    if (!channel->Receive(buffer, transferred)) {
+      Log->Warn(L"Disconnect client that sent a broken frame",
+                GetCurrentThreadId(), __LONGFILE__);
+      return IOResult::Failed;
+    }
+    if (channel->TakeReplies(&replies)) {
+      result = write(pipe, overlapped, quitEvent, replies);
+
+      if (result != IOResult::Done) {
+        return result;
+      }
+    }
+  }
+}
+} // namespace
+
+DWORD WINAPI commandPipeLoop(LPVOID context) {
+  Log->Info(L"Start command pipe loop thread", GetCurrentThreadId(),
+            __LONGFILE__);
+
+  CommandPipeContext *ctx = static_cast<CommandPipeContext *>(context);
+
+  if (ctx == nullptr) {
+    Log->Fail(L"Failed to obtain ctx", GetCurrentThreadId(), __LONGFILE__);
+    return E_FAIL;
+  }
+
+  OVERLAPPED overlapped{};
+
+  overlapped.hEvent = CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET,
+                                    EVENT_MODIFY_STATE | SYNCHRONIZE);
+
+  if (overlapped.hEvent == nullptr) {
+    Log->Fail(L"Failed to create event", GetCurrentThreadId(), __LONGFILE__);
+    return E_FAIL;
+  }
+
+  CommandChannel channel(ctx->Sink);
+  bool isActive{true};
+
+  while (isActive) {
+    HANDLE pipe = CreateNamedPipeW(
+        ctx->PipeName, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+            PIPE_REJECT_REMOTE_CLIENTS,
+        1, PipeBufferBytes, PipeBufferBytes, 0, nullptr);
+
+    if (pipe == INVALID_HANDLE_VALUE) {
+      Log->Fail(L"Failed to create named pipe", GetCurrentThreadId(),
+                __LONGFILE__);
+      break;
+    }
+
+    IOResult result = connect(pipe, &overlapped, ctx->QuitEvent);
+
+    if (result == IOResult::Done) {
+      Log->Info(L"Command pipe client connected", GetCurrentThreadId(),
+                __LONGFILE__);
+
+      result = serve(pipe, &overlapped, ctx->QuitEvent, &channel);
+
+      Log->Info(L"Command pipe client disconnected", GetCurrentThreadId(),
+                __LONGFILE__);
+    } else if (result == IOResult::Failed) {
+      Log->Warn(L"Failed to connect command pipe client",
+                GetCurrentThreadId(), __LONGFILE__);
+
+      // Keeps a pipe that fails to connect from spinning.
+      if (WaitForSingleObject(ctx->QuitEvent, ReconnectMilliseconds) ==
+          WAIT_OBJECT_0) {
+        result = IOResult::Quit;
+      }
+    }
+    if (result == IOResult::Quit) {
+      isActive = false;
+    }
+
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+    channel.Reset();
+  }
+
+  SafeCloseHandle(&overlapped.hEvent);
+
+  Log->Info(L"End command pipe loop thread", GetCurrentThreadId(),
+            __LONGFILE__);
+
+  return S_OK;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <windows.h>
+
+DWORD WINAPI commandPipeLoop(LPVOID context);
@@ -0,0 +1,229 @@
+#include <cstring>
+#include <cwchar>
+#include <thread>
+#include <type_traits>
+
+#include "commandring.h"
+
+namespace {
+uint32_t roundUp(uint32_t n) {
+  uint32_t v{1};
+
+  while (v < n) {
+    v <<= 1;
+  }
+
+  return v;
+}
+} // namespace
+
+static_assert(std::is_trivially_copyable<QueuedCommand>::value,
+              "QueuedCommand is stored as words");
+
+CommandRing::CommandRing(uint32_t capacity, OverflowPolicy policy,
+                         uint32_t textCapacity, uint32_t maxTextCapacity)
+    : mCapacity(roundUp(capacity)), mMask(mCapacity - 1), mPolicy(policy),
+      mArena(textCapacity, maxTextCapacity, 2 * mCapacity) {
+  mSlots = new Slot[mCapacity];
+}
+
+CommandRing::~CommandRing() {
+  delete[] mSlots;
+  mSlots = nullptr;
+}
+
+void CommandRing::store(Slot *slot, const QueuedCommand &command) {
+  uint64_t words[SlotWords]{};
+
+  std::memcpy(words, &command, sizeof(command));
+
+  for (size_t i = 0; i < SlotWords; i++) {
+    slot->Words[i].store(words[i], std::memory_order_relaxed);
+  }
+}
+
+QueuedCommand CommandRing::load(const Slot *slot) {
+  uint64_t words[SlotWords];
+  QueuedCommand command;
+
+  for (size_t i = 0; i < SlotWords; i++) {
+    words[i] = slot->Words[i].load(std::memory_order_relaxed);
+  }
+
+  std::memcpy(&command, words, sizeof(command));
+
+  return command;
+}
+
+// Drops the command at index, the oldest one queued, unless Pop claims it
+// first. Either way the slot is no longer queued afterwards.
+void CommandRing::drop(uint64_t index) {
+  if (!mReadIndex.compare_exchange_strong(index, index + 1,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+    return;
+  }
+
+  // Only the producer writes the slots, so the command is read whole.
+  QueuedCommand command = load(&mSlots[index & mMask]);
+
+  mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (command.HasText) {
+    mArena.Release(command.Text);
+  }
+}
+
+bool CommandRing::Push(int16_t type, int16_t sfxIndex, double waitDuration,
+                       const wchar_t *text, float gain, float pan,
+                       uint64_t pushTime) {
+  uint64_t w = mWriteIndex.load(std::memory_order_relaxed);
+
+  while (true) {
+    uint64_t r = mReadIndex.load(std::memory_order_acquire);
+
+    if (w - r < mCapacity) {
+      break;
+    }
+    switch (mPolicy) {
+    case OverflowPolicy::Reject:
+      mRejectedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    case OverflowPolicy::DropOldest:
+      drop(r);
+      break;
+    case OverflowPolicy::Block:
+      std::this_thread::yield();
+      break;
+    }
+  }
+
+  QueuedCommand command;
+
+  command.Type = type;
+  command.SFXIndex = sfxIndex;
+  command.WaitDuration = waitDuration;
+  command.Gain = gain;
+  command.Pan = pan;
+  command.Generation = mGeneration.load(std::memory_order_relaxed);
+  command.PushTime = pushTime;
+
+  if (text != nullptr) {
+    command.HasText = true;
+
+    // A full arena is overflow too; dropping the oldest commands frees
+    // their text.
+    while (!mArena.Allocate(text, static_cast<uint32_t>(std::wcslen(text)),
+                            &command.Text)) {
+      uint64_t r = mReadIndex.load(std::memory_order_acquire);
+
+      if (mPolicy != OverflowPolicy::DropOldest || r == w) {
+        mRejectedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      drop(r);
+    }
+  }
+
+  store(&mSlots[w & mMask], command);
+  mWriteIndex.store(w + 1, std::memory_order_seq_cst);
+
+  return true;
+}
+
+void CommandRing::BeginForcePush() {
+  mGeneration.fetch_add(1, std::memory_order_release);
+}
+
+bool CommandRing::Pop(QueuedCommand *command) {
+  uint64_t r = mReadIndex.load(std::memory_order_acquire);
+
+  while (r != mWriteIndex.load(std::memory_order_acquire)) {
+    QueuedCommand copy = load(&mSlots[r & mMask]);
+
+    // The producer dropped the command since r was read; r is reloaded.
+    if (!mReadIndex.compare_exchange_weak(r, r + 1,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+      continue;
+    }
+
+    r += 1;
+
+    if (copy.Generation != mGeneration.load(std::memory_order_acquire)) {
+      ReleaseText(copy);
+      mSkippedCount.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    *command = copy;
+
+    return true;
+  }
+
+  return false;
+}
+
+const wchar_t *CommandRing::GetText(const QueuedCommand &command) const {
+  if (!command.HasText) {
+    return nullptr;
+  }
+
+  return mArena.Resolve(command.Text);
+}
+
+void CommandRing::ReleaseText(const QueuedCommand &command) {
+  if (command.HasText) {
+    mArena.Release(command.Text);
+  }
+}
+
+TextArena *CommandRing::GetTextArena() { return &mArena; }
+
+bool CommandRing::IsEmpty() const {
+  return mReadIndex.load(std::memory_order_seq_cst) ==
+         mWriteIndex.load(std::memory_order_seq_cst);
+}
+
+uint32_t CommandRing::GetGeneration() const {
+  return mGeneration.load(std::memory_order_acquire);
+}
+
+uint32_t CommandRing::GetCapacity() const { return mCapacity; }
+
+uint32_t CommandRing::GetTextCapacity() const {
+  return mArena.GetCapacity();
+}
+
+uint32_t CommandRing::GetTextHighWatermark() const {
+  return mArena.GetHighWatermark();
+}
+
+uint64_t CommandRing::GetDroppedCount() const {
+  return mDroppedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t CommandRing::GetRejectedCount() const {
+  return mRejectedCount.load(std::memory_order_relaxed);
+}
+
+uint64_t CommandRing::GetSkippedCount() const {
+  return mSkippedCount.load(std::memory_order_relaxed);
+}
+
+bool PushCommand(CommandRing *ring, const Command &c, uint64_t pushTime) {
+  switch (c.Type) {
+  case 1:
+    return ring->Push(c.Type, c.SFXIndex <= 0 ? 0 : c.SFXIndex - 1, 0.0,
+                      nullptr, c.Gain, c.Pan, pushTime);
+  case 2:
+    return ring->Push(c.Type, 0, c.WaitDuration, nullptr, 1.0f, 0.0f,
+                      pushTime);
+  case 3: // Generate voice from plain text
+  case 4: // Generate voice from SSML
+    return ring->Push(c.Type, 0, 0.0, c.Text, 1.0f, 0.0f, pushTime);
+  default:
+    return true;
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "textarena.h"
+#include "types.h"
+
+// QueuedCommand is the ring's copy of a Command. Text lives in the ring's
+// arena.
+struct QueuedCommand {
+  int16_t Type = 0;
+  int16_t SFXIndex = 0;
+  double WaitDuration = 0.0;
+  float Gain = 1.0f;
+  float Pan = 0.0f;
+  bool HasText = false;
+  TextSpan Text;
+  uint32_t Generation = 0;
+  // LatencyNow() when the command was pushed, or 0.
+  uint64_t PushTime = 0;
+};
+
+enum class OverflowPolicy {
+  // Push fails and the command is not queued.
+  Reject,
+  // The oldest queued commands are discarded to make room, in the ring and
+  // in its text arena.
+  DropOldest,
+  // Push waits until the consumer frees a slot.
+  Block
+};
+
+// CommandRing is a bounded single-producer/single-consumer queue. Push never
+// waits for the consumer unless the policy is Block. Commands pushed before
+// the last BeginForcePush are skipped by Pop.
+//
+// Pop claims a command by moving the read index on with a compare-exchange,
+// and the producer drops the oldest command the same way, so every command
+// goes to exactly one of them. Pop copies the slot before it claims it: if
+// the producer dropped the command and wrote the slot again meanwhile, the
+// claim fails and the copy is thrown away. Slots are accessed a word at a
+// time through atomics, so such a copy is stale but never a data race.
+//
+// Text is copied into an arena owned by the ring and stays there. Whoever
+// pops a command with text owns its span and gives it back with ReleaseText,
+// or hands it on with the arena, as the scheduler does to SpeechPipeline.
+// The ring releases the text of the commands it drops or skips.
+class CommandRing {
+public:
+  // capacity is rounded up to a power of two. Text capacities are in
+  // characters. The arena holds the text of up to twice capacity commands:
+  // a full ring and as many again that were popped and not released yet.
+  CommandRing(uint32_t capacity, OverflowPolicy policy,
+              uint32_t textCapacity, uint32_t maxTextCapacity);
+  ~CommandRing();
+
+  // Producer side.
+  bool Push(int16_t type, int16_t sfxIndex, double waitDuration,
+            const wchar_t *text, float gain = 1.0f, float pan = 0.0f,
+            uint64_t pushTime = 0);
+  void BeginForcePush();
+
+  // Consumer side. The text of a popped command stays valid until it is
+  // released.
+  bool Pop(QueuedCommand *command);
+  const wchar_t *GetText(const QueuedCommand &command) const;
+  void ReleaseText(const QueuedCommand &command);
+  TextArena *GetTextArena();
+
+  bool IsEmpty() const;
+  uint32_t GetGeneration() const;
+  uint32_t GetCapacity() const;
+  uint32_t GetTextCapacity() const;
+  uint32_t GetTextHighWatermark() const;
+  uint64_t GetDroppedCount() const;
+  uint64_t GetRejectedCount() const;
+  uint64_t GetSkippedCount() const;
+
+private:
+  static constexpr size_t SlotWords = (sizeof(QueuedCommand) + 7) / 8;
+
+  struct Slot {
+    std::atomic<uint64_t> Words[SlotWords];
+  };
+
+  static void store(Slot *slot, const QueuedCommand &command);
+  static QueuedCommand load(const Slot *slot);
+  void drop(uint64_t index);
+
+  Slot *mSlots = nullptr;
+  uint32_t mCapacity = 0;
+  uint32_t mMask = 0;
+  OverflowPolicy mPolicy = OverflowPolicy::Reject;
+  TextArena mArena;
+
+  std::atomic<uint64_t> mReadIndex{0};
+  std::atomic<uint64_t> mWriteIndex{0};
+  std::atomic<uint32_t> mGeneration{0};
+
+  std::atomic<uint64_t> mDroppedCount{0};
+  std::atomic<uint64_t> mRejectedCount{0};
+  std::atomic<uint64_t> mSkippedCount{0};
+};
+
+// Queues c the way Push receives it from clients: SFX indices start at 1 and
+// commands of unknown types are skipped, which counts as success.
+bool PushCommand(CommandRing *ring, const Command &c, uint64_t pushTime);
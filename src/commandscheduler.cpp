@@ -0,0 +1,251 @@
+#include "commandscheduler.h"
+#include "waveheader.h"
+
+namespace {
+// Largest piece copied into the voice stream at once.
+constexpr uint32_t StreamChunkBytes = 4096;
+// Enough for the header written by SpeechSynthesizer and a few extra chunks.
+constexpr uint32_t WaveHeaderBytes = 512;
+// How far ahead of the render position commands are scheduled when nothing
+// is playing. It covers the hop through the SFX loop.
+constexpr double ScheduleLeadSeconds = 0.005;
+} // namespace
+
+CommandScheduler::CommandScheduler(const SchedulerContext &ctx)
+    : mCtx(ctx), mGeneration(ctx.Commands->GetGeneration()) {}
+
+// Commands never start in the past.
+uint64_t CommandScheduler::schedule() {
+  double lead = ScheduleLeadSeconds * mCtx.OutputMixer->GetSamplesPerSec();
+  uint64_t earliest =
+      mCtx.OutputMixer->GetPosition() + static_cast<uint64_t>(lead);
+
+  if (mCursor < earliest) {
+    mCursor = earliest;
+  }
+
+  return mCursor;
+}
+
+// A force push discards everything queued before it, including utterances
+// that are already being synthesized.
+void CommandScheduler::discard(uint32_t nextGeneration) {
+  mGeneration = nextGeneration;
+  mWindowCount = 0;
+  mFeed.IsStreaming = false;
+  mCursor = 0;
+  mCtx.Speech->Cancel();
+  mCtx.SFX->Discard();
+
+  if (mIsSpeaking) {
+    // Nothing more is written to the stream.
+    mCtx.VoiceStream->End();
+    mCtx.VoiceStream->Stop();
+    mIsSpeaking = false;
+  }
+}
+
+// Copies as much of the front utterance as is synthesized and fits into the
+// voice stream. The stream is ended once the whole utterance is written.
+void CommandScheduler::pumpVoice() {
+  char chunk[StreamChunkBytes];
+
+  while (mFeed.IsStreaming) {
+    // Stopped by a fade out.
+    if (mCtx.VoiceStream->IsIdle()) {
+      mCtx.Speech->PopFront();
+      mFeed.IsStreaming = false;
+      break;
+    }
+
+    uint64_t remaining = mFeed.End - mFeed.Offset;
+    uint32_t length = mCtx.VoiceStream->GetWritableBytes();
+    bool isComplete{false};
+
+    if (length > sizeof(chunk)) {
+      length = sizeof(chunk);
+    }
+    if (length > remaining) {
+      length = static_cast<uint32_t>(remaining);
+    }
+
+    uint32_t n =
+        mCtx.Speech->ReadFront(mFeed.Offset, chunk, length, &isComplete);
+
+    mCtx.VoiceStream->Write(chunk, n);
+    mFeed.Offset += n;
+
+    if (isComplete || mFeed.Offset == mFeed.End) {
+      mCtx.VoiceStream->End();
+      mCtx.Speech->PopFront();
+      mFeed.IsStreaming = false;
+    }
+    if (n == 0) {
+      break;
+    }
+  }
+}
+
+// Starts streaming the front utterance at startFrame once its header is
+// available and the previous stream is idle.
+CommandScheduler::VoiceStart
+CommandScheduler::beginVoice(uint64_t startFrame, uint64_t pushTime) {
+  char header[WaveHeaderBytes];
+  bool isComplete{false};
+  uint32_t n = mCtx.Speech->ReadFront(0, header, sizeof(header), &isComplete);
+  StreamFormat format;
+  size_t dataOffset{0};
+  uint32_t dataLength{0};
+
+  if (!ParseWaveHeader(header, n, &format, &dataOffset, &dataLength)) {
+    if (isComplete || n == sizeof(header)) {
+      mCtx.Host->Report(SchedulerEvent::SkipUnsupportedVoice);
+      mCtx.Speech->PopFront();
+      return VoiceStart::Skipped;
+    }
+
+    return VoiceStart::Waiting;
+  }
+  if (!mCtx.VoiceStream->Begin(format, startFrame, pushTime)) {
+    return VoiceStart::Waiting;
+  }
+
+  mFeed.IsStreaming = true;
+  mFeed.Offset = dataOffset;
+  // Streams that do not know their length in advance leave it open.
+  mFeed.End = dataLength == 0 || dataLength == UINT32_MAX
+                  ? UINT64_MAX
+                  : dataOffset + dataLength;
+
+  pumpVoice();
+
+  return VoiceStart::Started;
+}
+
+void CommandScheduler::Run() {
+  QueuedCommand cmd;
+
+  while (true) {
+    if (mCtx.Commands->GetGeneration() != mGeneration) {
+      discard(mCtx.Commands->GetGeneration());
+    }
+    if (mWindowCount == LookaheadCommands || mCtx.Speech->IsFull()) {
+      break;
+    }
+    if (!mCtx.Commands->Pop(&cmd)) {
+      mCtx.IsIdle->store(true);
+
+      // Push does not wake the loop while it is busy. A command queued
+      // between Pop and the store above would otherwise wait for the next
+      // push.
+      if (mCtx.Commands->IsEmpty() || !mCtx.IsIdle->exchange(false)) {
+        break;
+      }
+
+      continue;
+    }
+    if (cmd.Generation != mGeneration) {
+      discard(cmd.Generation);
+    }
+    if (mCtx.Stats != nullptr) {
+      mCtx.Stats->Record(LatencyStage::Dispatch, cmd.PushTime);
+    }
+    if (cmd.Type == 3 || cmd.Type == 4) {
+      // The pipeline reads the text in the ring's arena and releases it.
+      TextArena *arena =
+          cmd.HasText ? mCtx.Commands->GetTextArena() : nullptr;
+
+      if (!mCtx.Speech->Submit(cmd.Type == 4, arena, cmd.Text,
+                               mCtx.Host->GetVoice(), cmd.PushTime)) {
+        mCtx.Commands->ReleaseText(cmd);
+      }
+
+      mCtx.Host->RequestSynthesis();
+    } else {
+      mCtx.Commands->ReleaseText(cmd);
+    }
+    if (cmd.Type == 1 && mCtx.Bank != nullptr) {
+      mCtx.Bank->Prefetch(cmd.SFXIndex);
+    }
+
+    mWindow[(mWindowFront + mWindowCount) % LookaheadCommands] = cmd;
+    mWindowCount += 1;
+  }
+
+  pumpVoice();
+
+  // The voice stream also asks for more when it was stopped, so the voice
+  // is only done when the stream is idle. What follows starts where it
+  // ended.
+  if (mIsSpeaking && !mFeed.IsStreaming && mCtx.VoiceStream->IsIdle()) {
+    mIsSpeaking = false;
+
+    if (mCtx.VoiceStream->GetEndFrame() > mCursor) {
+      mCursor = mCtx.VoiceStream->GetEndFrame();
+    }
+  }
+  // Waves overlap each other, but waits and voices start after the waves
+  // queued before them.
+  while (!mIsSpeaking && mWindowCount > 0) {
+    cmd = mWindow[mWindowFront];
+
+    if (cmd.Type != 1 && !mCtx.SFX->Settle(&mCursor)) {
+      break;
+    }
+    if (cmd.Type == 3 || cmd.Type == 4) {
+      SpeechState state = mCtx.Speech->GetFrontState();
+
+      if (state == SpeechState::Pending) {
+        break;
+      }
+      if (state == SpeechState::Ready) {
+        VoiceStart start = beginVoice(schedule(), cmd.PushTime);
+
+        if (start == VoiceStart::Waiting) {
+          break;
+        }
+        if (start == VoiceStart::Started) {
+          mCtx.Host->Report(cmd.Type == 4 ? SchedulerEvent::PlaySSML
+                                          : SchedulerEvent::PlayText);
+          mIsSpeaking = true;
+
+          if (mCtx.Stats != nullptr) {
+            mCtx.Stats->Record(LatencyStage::Feed, cmd.PushTime);
+          }
+        }
+      } else {
+        mCtx.Host->Report(SchedulerEvent::SkipFailedVoice);
+        mCtx.Speech->PopFront();
+      }
+    } else if (cmd.Type == 1) {
+      mCtx.Host->Report(SchedulerEvent::PlaySFX);
+
+      SFXRequest request;
+
+      request.SFXIndex = cmd.SFXIndex;
+      request.StartFrame = schedule();
+      request.Gain = cmd.Gain;
+      request.Pan = cmd.Pan;
+      request.PushTime = cmd.PushTime;
+
+      mCtx.SFX->Push(request);
+      mCtx.Host->RequestSFX();
+    } else if (cmd.Type == 2) {
+      mCtx.Host->Report(SchedulerEvent::Wait);
+
+      double frames =
+          cmd.WaitDuration * mCtx.OutputMixer->GetSamplesPerSec();
+
+      mCursor = schedule() + static_cast<uint64_t>(frames > 0.0 ? frames : 0);
+    }
+
+    mWindowFront = (mWindowFront + 1) % LookaheadCommands;
+    mWindowCount -= 1;
+  }
+}
+
+bool CommandScheduler::IsDone() const {
+  return mWindowCount == 0 && !mIsSpeaking && !mFeed.IsStreaming &&
+         mCtx.Commands->IsEmpty() &&
+         mCtx.Speech->GetFrontState() == SpeechState::Empty;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "commandring.h"
+#include "latencystats.h"
+#include "mixer.h"
+#include "sfxbank.h"
+#include "sfxqueue.h"
+#include "speechpipeline.h"
+#include "streamsource.h"
+#include "synthesizer.h"
+
+// Things the command loop reports as it plays commands.
+enum class SchedulerEvent {
+  PlayText,
+  PlaySSML,
+  PlaySFX,
+  Wait,
+  // The utterance failed to synthesize.
+  SkipFailedVoice,
+  // The synthesized wave has a header the voice stream cannot play.
+  SkipUnsupportedVoice
+};
+
+// SchedulerHost connects a CommandScheduler to the threads around it.
+class SchedulerHost {
+public:
+  virtual ~SchedulerHost() = default;
+
+  // Returns the voice the next utterance is synthesized with.
+  virtual VoiceSettings GetVoice() = 0;
+  // An utterance was submitted to the speech pipeline.
+  virtual void RequestSynthesis() = 0;
+  // An SFX request was pushed to the SFX queue.
+  virtual void RequestSFX() = 0;
+  virtual void Report(SchedulerEvent event) {}
+};
+
+struct SchedulerContext {
+  CommandRing *Commands = nullptr;
+  SpeechPipeline *Speech = nullptr;
+  StreamSource *VoiceStream = nullptr;
+  SFXQueue *SFX = nullptr;
+  // Waves are prefetched from it when their commands are popped. May be
+  // nullptr.
+  SFXBank *Bank = nullptr;
+  Mixer *OutputMixer = nullptr;
+  LatencyStats *Stats = nullptr;
+  // Set while the scheduler has nothing left to pop, so that Push knows
+  // to wake it up.
+  std::atomic<bool> *IsIdle = nullptr;
+  SchedulerHost *Host = nullptr;
+};
+
+// CommandScheduler plays the commands in the ring in order. Voice commands
+// are submitted to the speech pipeline as soon as they are popped, so that
+// they are synthesized ahead of playback, and their waves are copied into
+// the voice stream as they arrive. Sound effects go through the SFX queue.
+//
+// Commands are placed on the mixer clock: waves and voices start at a
+// cursor, and waits move it forward, so the spacing between commands does
+// not depend on how fast the threads pass them on.
+//
+// Run does whatever can be done and returns. It does not block, so the
+// caller decides when to run it again: after a push, when synthesis made
+// progress, when the voice stream wants data and when an SFX request
+// reached the source. Everything happens on the calling thread, so a
+// caller that runs it on a virtual clock gets the same result every time.
+class CommandScheduler {
+public:
+  explicit CommandScheduler(const SchedulerContext &ctx);
+
+  void Run();
+
+  // Whether nothing is queued, waiting or being spoken.
+  bool IsDone() const;
+
+private:
+  // Commands are popped at most this far ahead of the one being played.
+  static constexpr uint32_t LookaheadCommands = 8;
+
+  // Progress of the utterance being copied into the voice stream.
+  struct VoiceFeed {
+    bool IsStreaming = false;
+    uint64_t Offset = 0;
+    uint64_t End = 0;
+  };
+
+  enum class VoiceStart { Waiting, Started, Skipped };
+
+  uint64_t schedule();
+  void discard(uint32_t nextGeneration);
+  void pumpVoice();
+  VoiceStart beginVoice(uint64_t startFrame, uint64_t pushTime);
+
+  SchedulerContext mCtx;
+
+  QueuedCommand mWindow[LookaheadCommands];
+  uint32_t mWindowFront = 0;
+  uint32_t mWindowCount = 0;
+  uint32_t mGeneration = 0;
+  VoiceFeed mFeed;
+  bool mIsSpeaking = false;
+  // Mixer frame at which the next command starts.
+  uint64_t mCursor = 0;
+};
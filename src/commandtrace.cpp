@@ -0,0 +1,413 @@
+#include <cstring>
+#include <cwchar>
+#include <iterator>
+
+#include "commandtrace.h"
+
+namespace {
+const char Magic[4] = {'A', 'N', 'T', 'R'};
+
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Appends text as UTF-16. wchar_t is UTF-16 on Windows and UTF-32 elsewhere.
+void toUTF16(const wchar_t *text, size_t length, std::vector<uint16_t> *units) {
+  for (size_t i = 0; i < length; i++) {
+    uint32_t c = static_cast<uint32_t>(text[i]);
+
+    if (sizeof(wchar_t) > 2 && c > 0xFFFF) {
+      c -= 0x10000;
+      units->push_back(static_cast<uint16_t>(0xD800 + (c >> 10)));
+      units->push_back(static_cast<uint16_t>(0xDC00 + (c & 0x3FF)));
+    } else {
+      units->push_back(static_cast<uint16_t>(c));
+    }
+  }
+}
+
+void fromUTF16(const uint16_t *units, size_t length, std::wstring *text) {
+  text->clear();
+
+  for (size_t i = 0; i < length; i++) {
+    uint32_t c = units[i];
+
+    if (sizeof(wchar_t) > 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < length &&
+        units[i + 1] >= 0xDC00 && units[i + 1] < 0xE000) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (units[i + 1] - 0xDC00);
+      i += 1;
+    }
+
+    text->push_back(static_cast<wchar_t>(c));
+  }
+}
+} // namespace
+
+CommandTraceWriter::CommandTraceWriter() {}
+
+CommandTraceWriter::~CommandTraceWriter() { Close(); }
+
+void CommandTraceWriter::SetClock(LatencyClock clock, void *context) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mClock = clock;
+  mClockContext = context;
+}
+
+bool CommandTraceWriter::Open(const char *path) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mIsOpen) {
+    return false;
+  }
+
+  mFile.open(path, std::ios::binary | std::ios::trunc);
+
+  if (!mFile) {
+    return false;
+  }
+
+  uint8_t header[8]{};
+
+  std::memcpy(header, Magic, sizeof(Magic));
+  header[4] = static_cast<uint8_t>(Version & 0xFF);
+  header[5] = static_cast<uint8_t>(Version >> 8);
+
+  mFile.write(reinterpret_cast<const char *>(header), sizeof(header));
+  mIsOpen = true;
+  mLastTime = 0;
+
+  return static_cast<bool>(mFile);
+}
+
+bool CommandTraceWriter::Close() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mIsOpen) {
+    return false;
+  }
+
+  mIsOpen = false;
+  mFile.close();
+
+  return !mFile.fail();
+}
+
+bool CommandTraceWriter::IsOpen() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mIsOpen;
+}
+
+void CommandTraceWriter::WritePush(const Command *const *commands,
+                                   int32_t length, bool isForcePush) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mIsOpen) {
+    return;
+  }
+
+  begin(TraceEventType::Push);
+  mRecord.push_back(isForcePush ? 1 : 0);
+  putVarint(static_cast<uint64_t>(length > 0 ? length : 0));
+
+  for (int32_t i = 0; i < length; i++) {
+    const Command &c = *commands[i];
+
+    putVarint(zigzag(c.Type));
+
+    switch (c.Type) {
+    case 1:
+      putVarint(zigzag(c.SFXIndex));
+      putBytes(&c.Gain, sizeof(c.Gain));
+      putBytes(&c.Pan, sizeof(c.Pan));
+      break;
+    case 2:
+      putBytes(&c.WaitDuration, sizeof(c.WaitDuration));
+      break;
+    case 3:
+    case 4:
+      putText(c.Text);
+      break;
+    }
+  }
+
+  flush();
+}
+
+void CommandTraceWriter::WriteVoices(const VoiceTable &table,
+                                     const wchar_t *const *ids) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mIsOpen) {
+    return;
+  }
+
+  begin(TraceEventType::Voices);
+  putVarint(table.Count);
+  putVarint(table.DefaultVoiceIndex);
+
+  for (uint32_t i = 0; i < table.Count; i++) {
+    putBytes(&table.Voices[i].SpeakingRate, sizeof(double));
+    putBytes(&table.Voices[i].AudioPitch, sizeof(double));
+    putBytes(&table.Voices[i].AudioVolume, sizeof(double));
+    putText(ids != nullptr ? ids[i] : nullptr);
+  }
+
+  flush();
+}
+
+void CommandTraceWriter::WriteDefaultVoice(uint32_t index) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mIsOpen) {
+    return;
+  }
+
+  begin(TraceEventType::DefaultVoice);
+  putVarint(index);
+  flush();
+}
+
+void CommandTraceWriter::WriteVoiceSetting(TraceEventType type,
+                                           uint32_t index, double value) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mIsOpen || (type != TraceEventType::SpeakingRate &&
+                   type != TraceEventType::AudioPitch &&
+                   type != TraceEventType::AudioVolume)) {
+    return;
+  }
+
+  begin(type);
+  putVarint(index);
+  putBytes(&value, sizeof(value));
+  flush();
+}
+
+void CommandTraceWriter::begin(TraceEventType type) {
+  uint64_t now = mClock != nullptr ? mClock(mClockContext) : LatencyNow();
+  // Threads may read the clock in a different order than they take the
+  // lock; the trace never goes back in time.
+  uint64_t delta = now > mLastTime ? now - mLastTime : 0;
+
+  mLastTime += delta;
+  mRecord.clear();
+  mRecord.push_back(static_cast<uint8_t>(type));
+  putVarint(delta);
+}
+
+void CommandTraceWriter::putVarint(uint64_t value) {
+  while (value >= 0x80) {
+    mRecord.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+
+  mRecord.push_back(static_cast<uint8_t>(value));
+}
+
+void CommandTraceWriter::putBytes(const void *data, size_t length) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+
+  mRecord.insert(mRecord.end(), p, p + length);
+}
+
+// Lengths are stored plus one, so that a missing text differs from an empty
+// one.
+void CommandTraceWriter::putText(const wchar_t *text) {
+  if (text == nullptr) {
+    putVarint(0);
+    return;
+  }
+
+  std::vector<uint16_t> units;
+
+  toUTF16(text, std::wcslen(text), &units);
+  putVarint(units.size() + 1);
+
+  for (uint16_t unit : units) {
+    mRecord.push_back(static_cast<uint8_t>(unit & 0xFF));
+    mRecord.push_back(static_cast<uint8_t>(unit >> 8));
+  }
+}
+
+void CommandTraceWriter::flush() {
+  mFile.write(reinterpret_cast<const char *>(mRecord.data()),
+              static_cast<std::streamsize>(mRecord.size()));
+}
+
+bool CommandTraceReader::Open(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    return false;
+  }
+
+  mData.assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  mOffset = 8;
+  mTime = 0;
+  mIsBroken = false;
+
+  return mData.size() >= 8 && std::memcmp(mData.data(), Magic, 4) == 0 &&
+         (mData[4] | mData[5] << 8) == CommandTraceWriter::Version;
+}
+
+bool CommandTraceReader::Next(TraceEvent *event) {
+  if (mIsBroken || mOffset >= mData.size()) {
+    return false;
+  }
+
+  size_t start = mOffset;
+  uint8_t type = mData[mOffset++];
+  uint64_t delta{0};
+  uint64_t value{0};
+  bool ok = getVarint(&delta);
+
+  *event = TraceEvent();
+  event->Type = static_cast<TraceEventType>(type);
+  event->Time = mTime + delta;
+
+  switch (event->Type) {
+  case TraceEventType::Push: {
+    uint8_t flags{0};
+
+    ok = ok && getBytes(&flags, 1) && getVarint(&value);
+    event->IsForcePush = (flags & 1) != 0;
+
+    for (uint64_t i = 0; ok && i < value; i++) {
+      TraceCommand c;
+      uint64_t n{0};
+
+      ok = getVarint(&n);
+      c.Type = static_cast<int16_t>(unzigzag(n));
+
+      switch (c.Type) {
+      case 1:
+        ok = ok && getVarint(&n) && getBytes(&c.Gain, sizeof(c.Gain)) &&
+             getBytes(&c.Pan, sizeof(c.Pan));
+        c.SFXIndex = static_cast<int16_t>(unzigzag(n));
+        break;
+      case 2:
+        ok = ok && getBytes(&c.WaitDuration, sizeof(c.WaitDuration));
+        break;
+      case 3:
+      case 4:
+        ok = ok && getText(&c.Text, &c.HasText);
+        break;
+      }
+
+      event->Commands.push_back(c);
+    }
+    break;
+  }
+  case TraceEventType::Voices: {
+    uint64_t index{0};
+
+    ok = ok && getVarint(&value) && getVarint(&index);
+    event->DefaultVoiceIndex = static_cast<uint32_t>(index);
+
+    for (uint64_t i = 0; ok && i < value; i++) {
+      VoiceProsody voice;
+      std::wstring id;
+
+      ok = getBytes(&voice.SpeakingRate, sizeof(double)) &&
+           getBytes(&voice.AudioPitch, sizeof(double)) &&
+           getBytes(&voice.AudioVolume, sizeof(double)) && getText(&id);
+
+      event->Voices.push_back(voice);
+      event->VoiceIds.push_back(id);
+    }
+    break;
+  }
+  case TraceEventType::DefaultVoice:
+    ok = ok && getVarint(&value);
+    event->Index = static_cast<uint32_t>(value);
+    break;
+  case TraceEventType::SpeakingRate:
+  case TraceEventType::AudioPitch:
+  case TraceEventType::AudioVolume:
+    ok = ok && getVarint(&value) && getBytes(&event->Value, sizeof(double));
+    event->Index = static_cast<uint32_t>(value);
+    break;
+  default:
+    ok = false;
+    break;
+  }
+  if (!ok) {
+    mIsBroken = true;
+    mOffset = start;
+    return false;
+  }
+
+  mTime = event->Time;
+
+  return true;
+}
+
+bool CommandTraceReader::IsBroken() const { return mIsBroken; }
+
+bool CommandTraceReader::getVarint(uint64_t *value) {
+  *value = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (mOffset >= mData.size()) {
+      return false;
+    }
+
+    uint8_t b = mData[mOffset++];
+
+    *value |= static_cast<uint64_t>(b & 0x7F) << shift;
+
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool CommandTraceReader::getBytes(void *data, size_t length) {
+  if (mData.size() - mOffset < length) {
+    return false;
+  }
+
+  std::memcpy(data, mData.data() + mOffset, length);
+  mOffset += length;
+
+  return true;
+}
+
+bool CommandTraceReader::getText(std::wstring *text, bool *hasText) {
+  uint64_t n{0};
+
+  if (!getVarint(&n)) {
+    return false;
+  }
+  if (hasText != nullptr) {
+    *hasText = n > 0;
+  }
+  if (n == 0) {
+    text->clear();
+    return true;
+  }
+  if ((mData.size() - mOffset) / 2 < n - 1) {
+    return false;
+  }
+
+  std::vector<uint16_t> units(n - 1);
+
+  for (uint64_t i = 0; i < n - 1; i++) {
+    units[i] = static_cast<uint16_t>(mData[mOffset] | mData[mOffset + 1] << 8);
+    mOffset += 2;
+  }
+
+  fromUTF16(units.data(), units.size(), text);
+
+  return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "latencystats.h"
+#include "types.h"
+#include "voicesettings.h"
+
+// Kinds of records in a command trace.
+enum class TraceEventType {
+  // A Push call with its commands.
+  Push,
+  // Every voice and the default voice, written when the trace starts.
+  Voices,
+  DefaultVoice,
+  SpeakingRate,
+  AudioPitch,
+  AudioVolume
+};
+
+// TraceCommand is a Command as it was passed to Push.
+struct TraceCommand {
+  int16_t Type = 0;
+  int16_t SFXIndex = 0;
+  double WaitDuration = 0.0;
+  // Voice commands may be pushed without text.
+  bool HasText = false;
+  std::wstring Text;
+  float Gain = 1.0f;
+  float Pan = 0.0f;
+};
+
+struct TraceEvent {
+  TraceEventType Type = TraceEventType::Push;
+  // In nanoseconds, on the clock of the recorder.
+  uint64_t Time = 0;
+
+  // Push.
+  bool IsForcePush = false;
+  std::vector<TraceCommand> Commands;
+
+  // Voices.
+  uint32_t DefaultVoiceIndex = 0;
+  std::vector<VoiceProsody> Voices;
+  std::vector<std::wstring> VoiceIds;
+
+  // DefaultVoice and the prosody changes.
+  uint32_t Index = 0;
+  double Value = 0.0;
+};
+
+// CommandTraceWriter records Push calls and voice setting changes to a
+// compact binary file, so that a session can be replayed later. Any thread
+// may write; records are stamped and ordered under one lock. Writes are
+// ignored while no file is open.
+//
+// Layout, version 1, little endian:
+//
+//   header   8 bytes: "ANTR", version as uint16, reserved
+//   records  type as uint8, time since the previous record in nanoseconds
+//            as a varint, then the payload of the type
+//
+// Counts, indices and text lengths are varints; SFX indices are zigzag
+// varints; gains, pans and prosody values are stored as they are. Text is
+// UTF-16 without a terminator.
+class CommandTraceWriter {
+public:
+  static constexpr uint16_t Version = 1;
+
+  CommandTraceWriter();
+  ~CommandTraceWriter();
+
+  // Records are stamped with LatencyNow unless another clock is set. Set it
+  // before Open.
+  void SetClock(LatencyClock clock, void *context);
+
+  bool Open(const char *path);
+  bool Close();
+  bool IsOpen() const;
+
+  void WritePush(const Command *const *commands, int32_t length,
+                 bool isForcePush);
+  // ids may be nullptr.
+  void WriteVoices(const VoiceTable &table, const wchar_t *const *ids);
+  void WriteDefaultVoice(uint32_t index);
+  // type is one of the prosody changes.
+  void WriteVoiceSetting(TraceEventType type, uint32_t index, double value);
+
+private:
+  void begin(TraceEventType type);
+  void putVarint(uint64_t value);
+  void putBytes(const void *data, size_t length);
+  void putText(const wchar_t *text);
+  void flush();
+
+  LatencyClock mClock = nullptr;
+  void *mClockContext = nullptr;
+  std::ofstream mFile;
+  bool mIsOpen = false;
+  uint64_t mLastTime = 0;
+  // One record, written to the file once it is complete.
+  std::vector<uint8_t> mRecord;
+  mutable std::mutex mMutex;
+};
+
+// CommandTraceReader reads a trace written by CommandTraceWriter.
+class CommandTraceReader {
+public:
+  bool Open(const char *path);
+
+  // Returns false at the end of the trace or when the rest of it is broken.
+  bool Next(TraceEvent *event);
+  // Whether reading stopped at a broken or truncated record. A trace whose
+  // recorder was not closed may end in the middle of a record.
+  bool IsBroken() const;
+
+private:
+  bool getVarint(uint64_t *value);
+  bool getBytes(void *data, size_t length);
+  bool getText(std::wstring *text, bool *hasText = nullptr);
+
+  std::vector<uint8_t> mData;
+  size_t mOffset = 0;
+  uint64_t mTime = 0;
+  bool mIsBroken = false;
+};
@@ -3,34 +3,50 @@
 #include <cppaudio/engine.h>
 #include <windows.h>
 
+#include "commandchannel.h"
+#include "commandring.h"
+#include "latencystats.h"
+#include "mixer.h"
+#include "rendertelemetry.h"
+#include "sfxbank.h"
+#include "sfxqueue.h"
+#include "sfxsource.h"
+#include "speechpipeline.h"
+#include "streamperiod.h"
+#include "streamsource.h"
 #include "types.h"
+#include "voicesettings.h"
+
+// Bus indices of the output mixer.
+constexpr int32_t VoiceBus = 0;
+constexpr int32_t SFXBus = 1;
 
 struct LogLoopContext {
   HANDLE QuitEvent = nullptr;
 };
 
+// Names of a voice. They do not change after the voice info thread is done;
+// everything that can be changed lives in Settings.
 struct VoiceProperty {
   wchar_t *Id = nullptr;
   wchar_t *DisplayName = nullptr;
   wchar_t *Language = nullptr;
-  double SpeakingRate = 1.0;
-  double AudioVolume = 1.0;
-  double AudioPitch = 1.0;
 };
 
 struct VoiceInfoContext {
   unsigned int Count = 0;
-  unsigned int DefaultVoiceIndex = 0;
   VoiceProperty **VoiceProperties = nullptr;
+  VoiceSettingsStore *Settings = nullptr;
 };
 
 struct VoiceLoopContext {
   HANDLE FeedEvent = nullptr;
   HANDLE NextEvent = nullptr;
   HANDLE QuitEvent = nullptr;
-  bool IsSSML = false;
-  wchar_t *Text = nullptr;
-  PCMAudio::RingEngine *VoiceEngine = nullptr;
+  HANDLE ReadyEvent = nullptr;
+  SpeechPipeline *Speech = nullptr;
+  SpeechCache *Cache = nullptr;
+  StreamSource *VoiceStream = nullptr;
   VoiceInfoContext *VoiceInfoCtx = nullptr;
 };
 
@@ -38,9 +54,8 @@ struct SFXLoopContext {
   HANDLE FeedEvent = nullptr;
   HANDLE NextEvent = nullptr;
   HANDLE QuitEvent = nullptr;
-  int16_t SFXIndex = 0;
-  double WaitDuration = 0.0;
-  PCMAudio::LauncherEngine *SFXEngine = nullptr;
+  SFXQueue *Queue = nullptr;
+  SFXBank *Bank = nullptr;
 };
 
 struct CommandLoopContext {
@@ -48,15 +63,25 @@ struct CommandLoopContext {
   HANDLE QuitEvent = nullptr;
   VoiceLoopContext *VoiceLoopCtx = nullptr;
   SFXLoopContext *SFXLoopCtx = nullptr;
-  Command **Commands = nullptr;
-  bool IsIdle = true;
-  int32_t ReadIndex = 0;
-  int32_t WriteIndex = 0;
-  int32_t MaxCommands = 256;
+  CommandRing *Commands = nullptr;
+  Mixer *OutputMixer = nullptr;
+  LatencyStats *Stats = nullptr;
+  std::atomic<bool> IsIdle{true};
+};
+
+// The command pipe takes one client at a time and pushes the batches it
+// sends to Sink.
+struct CommandPipeContext {
+  HANDLE QuitEvent = nullptr;
+  const wchar_t *PipeName = nullptr;
+  CommandSink *Sink = nullptr;
 };
 
 struct AudioLoopContext {
-  HANDLE NextEvent = nullptr;
   HANDLE QuitEvent = nullptr;
-  PCMAudio::Engine *Engine = nullptr;
+  HANDLE RestartEvent = nullptr;
+  std::atomic<LatencyMode> Latency{LatencyMode::Low};
+  HANDLE NextEvents[Mixer::MaxBuses]{};
+  Mixer *OutputMixer = nullptr;
+  RenderTelemetry *Telemetry = nullptr;
 };
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#endif
+// The AVX2 kernel is built whatever the target, and chosen at run time on
+// processors that have it.
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CONVERT_TARGET_AVX2
+#else
+#define CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#define CONVERT_AVX2
+#endif
+
+#include "convert.h"
+
+namespace {
+// The largest float below 1.0. Scaling it by 2^31 still fits in int32_t.
+constexpr float maxInput = 0.99999994f;
+
+inline int32_t scaleSample(float s, float scale, int32_t max) {
+  s = std::min(std::max(s, -1.0f), maxInput);
+
+  return std::min(static_cast<int32_t>(std::lrintf(s * scale)), max);
+}
+
+#if defined(CONVERT_AVX2)
+bool detectAVX2() {
+#if defined(_MSC_VER)
+  int info[4];
+
+  __cpuid(info, 0);
+
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // The processor has AVX and the system saves the YMM registers.
+  __cpuid(info, 1);
+
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 ||
+      (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+const bool hasAVX2 = detectAVX2();
+
+// Converts whole vectors of 8 and returns how many samples it converted.
+CONVERT_TARGET_AVX2 size_t convertToInt32AVX2(const float *src, int32_t *dst,
+                                              size_t samples) {
+  const __m256 lo = _mm256_set1_ps(-1.0f);
+  const __m256 hi = _mm256_set1_ps(maxInput);
+  const __m256 scale = _mm256_set1_ps(2147483648.0f);
+  size_t i{};
+
+  for (; i + 8 <= samples; i += 8) {
+    __m256 s = _mm256_loadu_ps(src + i);
+    s = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(s, lo), hi), scale);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        _mm256_cvtps_epi32(s));
+  }
+
+  return i;
+}
+#endif
+} // namespace
+
+void ConvertToInt16(const float *src, int16_t *dst, size_t samples) {
+  size_t i{};
+
+#if defined(CONVERT_SSE2)
+  const __m128 lo = _mm_set1_ps(-1.0f);
+  const __m128 hi = _mm_set1_ps(maxInput);
+  const __m128 scale = _mm_set1_ps(32768.0f);
+
+  // _mm_packs_epi32 saturates 32768 to 32767.
+  for (; i + 8 <= samples; i += 8) {
+    __m128 a = _mm_loadu_ps(src + i);
+    __m128 b = _mm_loadu_ps(src + i + 4);
+    a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(a, lo), hi), scale);
+    b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(b, lo), hi), scale);
+    __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] = static_cast<int16_t>(scaleSample(src[i], 32768.0f, 32767));
+  }
+}
+
+void ConvertToInt24(const float *src, uint8_t *dst, size_t samples) {
+  for (size_t i = 0; i < samples; i++) {
+    int32_t s = scaleSample(src[i], 8388608.0f, 8388607);
+
+    dst[3 * i + 0] = static_cast<uint8_t>(s & 0xFF);
+    dst[3 * i + 1] = static_cast<uint8_t>((s >> 8) & 0xFF);
+    dst[3 * i + 2] = static_cast<uint8_t>((s >> 16) & 0xFF);
+  }
+}
+
+void ConvertToInt32(const float *src, int32_t *dst, size_t samples) {
+  size_t i{};
+
+#if defined(CONVERT_AVX2)
+  if (hasAVX2) {
+    i = convertToInt32AVX2(src, dst, samples);
+  }
+#endif
+#if defined(CONVERT_SSE2)
+  const __m128 lo = _mm_set1_ps(-1.0f);
+  const __m128 hi = _mm_set1_ps(maxInput);
+  const __m128 scale = _mm_set1_ps(2147483648.0f);
+
+  for (; i + 4 <= samples; i += 4) {
+    __m128 s = _mm_loadu_ps(src + i);
+    s = _mm_mul_ps(_mm_min_ps(_mm_max_ps(s, lo), hi), scale);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_cvtps_epi32(s));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] = scaleSample(src[i], 2147483648.0f, INT32_MAX);
+  }
+}
+
+void ConvertToFloat32(const float *src, float *dst, size_t samples) {
+  size_t i{};
+
+#if defined(CONVERT_SSE2)
+  const __m128 lo = _mm_set1_ps(-1.0f);
+  const __m128 hi = _mm_set1_ps(1.0f);
+
+  for (; i + 4 <= samples; i += 4) {
+    __m128 s = _mm_loadu_ps(src + i);
+
+    _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(s, lo), hi));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] = std::min(std::max(src[i], -1.0f), 1.0f);
+  }
+}
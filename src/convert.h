@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversion from normalized float samples to device sample formats. Input is
+// clamped to [-1.0, 1.0) and rounded to nearest.
+void ConvertToInt16(const float *src, int16_t *dst, size_t samples);
+void ConvertToInt24(const float *src, uint8_t *dst, size_t samples);
+void ConvertToInt32(const float *src, int32_t *dst, size_t samples);
+void ConvertToFloat32(const float *src, float *dst, size_t samples);
@@ -0,0 +1,122 @@
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GAINRAMP_SSE2
+#endif
+
+#include <cmath>
+
+#include "gainramp.h"
+
+namespace {
+// Exponential ramps cannot reach zero, so they stop here and jump.
+constexpr float silenceGain = 1e-4f;
+} // namespace
+
+GainRamp::GainRamp(float gain) { Set(gain); }
+
+void GainRamp::Set(float gain) {
+  mGain = gain;
+  mTarget = gain;
+  mEnd = gain;
+  mStep = 0.0f;
+  mRemaining = 0;
+}
+
+void GainRamp::Start(float target, uint32_t frames, RampCurve curve) {
+  if (frames == 0) {
+    Set(target);
+    return;
+  }
+
+  mCurve = curve;
+  mTarget = target;
+  mRemaining = frames;
+
+  if (curve == RampCurve::Linear) {
+    mEnd = target;
+    mStep = (target - mGain) / frames;
+    return;
+  }
+
+  mGain = mGain < silenceGain ? silenceGain : mGain;
+  mEnd = target < silenceGain ? silenceGain : target;
+  mStep = static_cast<float>(std::pow(static_cast<double>(mEnd) / mGain,
+                                      1.0 / frames));
+}
+
+bool GainRamp::IsRamping() const { return mRemaining > 0; }
+
+float GainRamp::GetGain() const { return mGain; }
+
+float GainRamp::GetTarget() const { return mTarget; }
+
+void GainRamp::Fill(float *envelope, uint32_t frames) {
+  render(envelope, frames, false);
+}
+
+void GainRamp::Scale(float *envelope, uint32_t frames) {
+  render(envelope, frames, true);
+}
+
+void GainRamp::Skip(uint32_t frames) {
+  advance(frames < mRemaining ? frames : mRemaining);
+}
+
+void GainRamp::render(float *envelope, uint32_t frames, bool isScaling) {
+  uint32_t n = frames < mRemaining ? frames : mRemaining;
+  bool isLinear = mCurve == RampCurve::Linear;
+  uint32_t i{};
+
+#if defined(GAINRAMP_SSE2)
+  if (n >= 4) {
+    float s = mStep;
+    __m128 g{};
+    __m128 step{};
+
+    if (isLinear) {
+      g = _mm_add_ps(_mm_set1_ps(mGain),
+                     _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f),
+                                _mm_set1_ps(s)));
+      step = _mm_set1_ps(4.0f * s);
+    } else {
+      g = _mm_mul_ps(_mm_set1_ps(mGain),
+                     _mm_set_ps(s * s * s, s * s, s, 1.0f));
+      step = _mm_set1_ps(s * s * s * s);
+    }
+    for (; i + 4 <= n; i += 4) {
+      __m128 v = isScaling ? _mm_mul_ps(_mm_loadu_ps(envelope + i), g) : g;
+
+      _mm_storeu_ps(envelope + i, v);
+      g = isLinear ? _mm_add_ps(g, step) : _mm_mul_ps(g, step);
+    }
+  }
+#endif
+
+  float g = isLinear ? mGain + mStep * i
+                     : mGain * static_cast<float>(std::pow(mStep, i));
+
+  for (; i < n; i++) {
+    envelope[i] = isScaling ? envelope[i] * g : g;
+    g = isLinear ? g + mStep : g * mStep;
+  }
+
+  advance(n);
+
+  for (; i < frames; i++) {
+    envelope[i] = isScaling ? envelope[i] * mGain : mGain;
+  }
+}
+
+// Recomputes the gain from the end of the curve, so that rounding does not
+// add up over long ramps.
+void GainRamp::advance(uint32_t frames) {
+  mRemaining -= frames;
+
+  if (mRemaining == 0) {
+    mGain = mTarget;
+  } else if (mCurve == RampCurve::Linear) {
+    mGain = mEnd - mStep * mRemaining;
+  } else {
+    mGain = mEnd / static_cast<float>(std::pow(mStep, mRemaining));
+  }
+}
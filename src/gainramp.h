@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// Shapes of a gain ramp.
+enum class RampCurve {
+  // Equal steps of gain. Best for short ramps and crossfades.
+  Linear,
+  // Equal steps in decibels, which sounds even over long fades. Ramps
+  // from or to silence start or end at -80 dB.
+  Exponential
+};
+
+// GainRamp moves a gain to a target over a number of frames, one frame at a
+// time. It belongs to one thread and never allocates.
+class GainRamp {
+public:
+  explicit GainRamp(float gain = 1.0f);
+
+  // Jumps to gain and ends the ramp in progress.
+  void Set(float gain);
+  // Starts from the current gain, so that a ramp in progress changes course
+  // without a step. The gain reaches target after frames.
+  void Start(float target, uint32_t frames, RampCurve curve);
+
+  bool IsRamping() const;
+  float GetGain() const;
+  float GetTarget() const;
+
+  // Writes the gain of each of the next frames to envelope, or multiplies
+  // envelope by it, and moves on.
+  void Fill(float *envelope, uint32_t frames);
+  void Scale(float *envelope, uint32_t frames);
+  // Moves on without producing the gains.
+  void Skip(uint32_t frames);
+
+private:
+  void render(float *envelope, uint32_t frames, bool isScaling);
+  void advance(uint32_t frames);
+
+  RampCurve mCurve = RampCurve::Linear;
+  float mGain = 1.0f;
+  float mTarget = 1.0f;
+  // Where the curve ends. It differs from mTarget when an exponential ramp
+  // goes to silence.
+  float mEnd = 1.0f;
+  // Added per frame when linear, multiplied when exponential.
+  float mStep = 0.0f;
+  uint32_t mRemaining = 0;
+};
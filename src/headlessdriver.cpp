@@ -0,0 +1,55 @@
+#include <chrono>
+#include <thread>
+
+#include "headlessdriver.h"
+
+HeadlessDriver::HeadlessDriver(Renderer *renderer, AudioSink *sink,
+                               uint32_t periodFrames, bool isRealtime)
+    : mRenderer(renderer), mSink(sink), mPeriodFrames(periodFrames),
+      mIsRealtime(isRealtime) {}
+
+bool HeadlessDriver::Run(uint64_t totalFrames) {
+  using clock = std::chrono::steady_clock;
+
+  const StreamFormat &format = mSink->GetStreamFormat();
+
+  if (mPeriodFrames == 0 || format.SamplesPerSec == 0) {
+    return false;
+  }
+
+  const auto period = std::chrono::nanoseconds(
+      1000000000ULL * mPeriodFrames / format.SamplesPerSec);
+  auto deadline = clock::now();
+
+  for (uint64_t rendered = 0; rendered < totalFrames;
+       rendered += mPeriodFrames) {
+    if (mIsRealtime) {
+      deadline += period;
+      std::this_thread::sleep_until(deadline);
+    }
+
+    int32_t completions[Mixer::MaxBuses]{};
+
+    if (!mRenderer->Render(mSink, completions)) {
+      return false;
+    }
+
+    mFramesRendered += mPeriodFrames;
+
+    for (int32_t i = 0; i < Mixer::MaxBuses; i++) {
+      mCompletions[i] += completions[i];
+    }
+  }
+
+  return true;
+}
+
+uint64_t HeadlessDriver::GetFramesRendered() const { return mFramesRendered; }
+
+uint64_t HeadlessDriver::GetCompletions(int32_t bus) const {
+  if (bus < 0 || bus >= Mixer::MaxBuses) {
+    return 0;
+  }
+
+  return mCompletions[bus];
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "audiosink.h"
+#include "renderer.h"
+
+// HeadlessDriver stands in for the WASAPI event loop. It renders one period
+// per tick of a simulated device clock, either paced in real time or as fast
+// as possible for offline runs.
+class HeadlessDriver {
+public:
+  HeadlessDriver(Renderer *renderer, AudioSink *sink, uint32_t periodFrames,
+                 bool isRealtime);
+
+  // Renders until at least totalFrames frames have been written.
+  bool Run(uint64_t totalFrames);
+
+  uint64_t GetFramesRendered() const;
+  uint64_t GetCompletions(int32_t bus) const;
+
+private:
+  Renderer *mRenderer = nullptr;
+  AudioSink *mSink = nullptr;
+  uint32_t mPeriodFrames = 0;
+  bool mIsRealtime = false;
+  uint64_t mFramesRendered = 0;
+  uint64_t mCompletions[Mixer::MaxBuses]{};
+};
@@ -0,0 +1,152 @@
+#include <chrono>
+
+#include "latencystats.h"
+
+uint64_t LatencyNow() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  uint64_t ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+
+  return ns > 0 ? ns : 1;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+  uint64_t micros = nanoseconds / 1000;
+  uint64_t max = mMax.load(std::memory_order_relaxed);
+
+  // The bucket is counted first, so that readers never see more values
+  // than the buckets hold.
+  mBuckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+  mSum.fetch_add(micros, std::memory_order_relaxed);
+  mCount.fetch_add(1, std::memory_order_release);
+
+  while (micros > max && !mMax.compare_exchange_weak(
+                             max, micros, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  mCount.store(0, std::memory_order_relaxed);
+  mSum.store(0, std::memory_order_relaxed);
+  mMax.store(0, std::memory_order_relaxed);
+
+  for (int32_t i = 0; i < BucketCount; i++) {
+    mBuckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  return mCount.load(std::memory_order_acquire);
+}
+
+double LatencyHistogram::GetMean() const {
+  uint64_t count = GetCount();
+
+  if (count == 0) {
+    return 0.0;
+  }
+
+  return static_cast<double>(mSum.load(std::memory_order_relaxed)) / count;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double fraction) const {
+  uint64_t count = GetCount();
+  uint64_t max = GetMax();
+
+  if (count == 0) {
+    return 0;
+  }
+
+  double rank = fraction * count;
+  uint64_t target = rank < 1.0 ? 1 : static_cast<uint64_t>(rank + 0.999999);
+  uint64_t seen{0};
+
+  for (int32_t i = 0; i < BucketCount; i++) {
+    seen += mBuckets[i].load(std::memory_order_relaxed);
+
+    if (seen >= target) {
+      uint64_t edge = upperEdgeOf(i);
+
+      return edge < max ? edge : max;
+    }
+  }
+
+  return max;
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+  return mMax.load(std::memory_order_relaxed);
+}
+
+int32_t LatencyHistogram::bucketOf(uint64_t micros) {
+  if (micros < SubBuckets * 2) {
+    return static_cast<int32_t>(micros);
+  }
+
+  int32_t shift{0};
+
+  while ((micros >> shift) >= SubBuckets * 2) {
+    shift += 1;
+  }
+  if (shift > MaxShift) {
+    return BucketCount - 1;
+  }
+
+  return SubBuckets * shift + static_cast<int32_t>(micros >> shift);
+}
+
+uint64_t LatencyHistogram::upperEdgeOf(int32_t bucket) {
+  if (bucket < SubBuckets * 2) {
+    return static_cast<uint64_t>(bucket);
+  }
+
+  int32_t shift = bucket / SubBuckets - 1;
+  uint64_t sub = static_cast<uint64_t>(bucket - SubBuckets * shift);
+
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyStats::SetClock(LatencyClock clock, void *context) {
+  mClock = clock;
+  mClockContext = context;
+}
+
+void LatencyStats::SetObserver(LatencyObserver observer, void *context) {
+  mObserver = observer;
+  mObserverContext = context;
+}
+
+uint64_t LatencyStats::Now() const {
+  return mClock != nullptr ? mClock(mClockContext) : LatencyNow();
+}
+
+void LatencyStats::Record(LatencyStage stage, uint64_t pushTime) {
+  if (pushTime == 0) {
+    return;
+  }
+
+  Record(stage, pushTime, Now());
+}
+
+void LatencyStats::Record(LatencyStage stage, uint64_t pushTime,
+                          uint64_t now) {
+  if (pushTime == 0) {
+    return;
+  }
+  if (mObserver != nullptr) {
+    mObserver(mObserverContext, stage, pushTime, now);
+  }
+
+  mStages[static_cast<int32_t>(stage)].Record(now > pushTime ? now - pushTime
+                                                             : 0);
+}
+
+const LatencyHistogram &LatencyStats::Get(LatencyStage stage) const {
+  return mStages[static_cast<int32_t>(stage)];
+}
+
+void LatencyStats::Reset() {
+  for (int32_t i = 0; i < LatencyStageCount; i++) {
+    mStages[i].Reset();
+  }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Points a command passes on its way from Push to the speakers.
+enum class LatencyStage {
+  // The command loop took the command off the ring.
+  Dispatch,
+  // The speech pipeline started and finished synthesizing the utterance.
+  // Utterances found in the cache skip both.
+  SynthesisStart,
+  SynthesisEnd,
+  // The voice stream or the SFX source was handed the sound.
+  Feed,
+  // The first sample that is not silent was rendered.
+  FirstSample
+};
+
+constexpr int32_t LatencyStageCount = 5;
+
+// Returns a monotonic timestamp in nanoseconds. Zero is never returned, so
+// that it can mean "not stamped".
+uint64_t LatencyNow();
+
+// LatencyHistogram counts durations in log-linear buckets: below 64 us every
+// microsecond has its own bucket, above that every power of two is split
+// into 32. Values are kept to within about 3% up to 12 days. Record never
+// blocks or allocates, so any thread may call it, including the render
+// thread.
+class LatencyHistogram {
+public:
+  void Record(uint64_t nanoseconds);
+  void Reset();
+
+  uint64_t GetCount() const;
+  // All in microseconds. A percentile is the upper edge of the bucket that
+  // holds it, so it is never lower than the value it stands for.
+  double GetMean() const;
+  uint64_t GetPercentile(double fraction) const;
+  uint64_t GetMax() const;
+
+private:
+  static constexpr int32_t SubBuckets = 32;
+  static constexpr int32_t MaxShift = 35;
+  static constexpr int32_t BucketCount = SubBuckets * (MaxShift + 2);
+
+  static int32_t bucketOf(uint64_t micros);
+  static uint64_t upperEdgeOf(int32_t bucket);
+
+  std::atomic<uint64_t> mBuckets[BucketCount]{};
+  std::atomic<uint64_t> mCount{0};
+  std::atomic<uint64_t> mSum{0};
+  std::atomic<uint64_t> mMax{0};
+};
+
+// Returns the current time in nanoseconds, for stats that do not run on
+// LatencyNow.
+typedef uint64_t (*LatencyClock)(void *context);
+
+// Called with every duration recorded.
+typedef void (*LatencyObserver)(void *context, LatencyStage stage,
+                                uint64_t pushTime, uint64_t now);
+
+// LatencyStats keeps a histogram per stage of the time from Push to the
+// stage.
+//
+// Stages are timed with LatencyNow unless another clock is set, e.g. the
+// virtual clock of a replay. The clock and the observer must be set before
+// anything is recorded.
+class LatencyStats {
+public:
+  void SetClock(LatencyClock clock, void *context);
+  void SetObserver(LatencyObserver observer, void *context);
+  uint64_t Now() const;
+
+  // Commands without a pushTime are not recorded.
+  void Record(LatencyStage stage, uint64_t pushTime);
+  void Record(LatencyStage stage, uint64_t pushTime, uint64_t now);
+  const LatencyHistogram &Get(LatencyStage stage) const;
+  void Reset();
+
+private:
+  LatencyHistogram mStages[LatencyStageCount];
+  LatencyClock mClock = nullptr;
+  void *mClockContext = nullptr;
+  LatencyObserver mObserver = nullptr;
+  void *mObserverContext = nullptr;
+};
@@ -1,11 +1,12 @@
 #include <cpplogger/cpplogger.h>
 #include <cpprest/http_client.h>
-#include <iostream>
-#include <sstream>
-#include <stdexcept>
+#include <string>
+
+#include <strsafe.h>
 
 #include "context.h"
 #include "logloop.h"
+#include "logshipper.h"
 #include "util.h"
 
 using namespace web;
@@ -14,13 +15,133 @@ using namespace web::http::client;
 
 extern Logger::Logger *Log;
 
-pplx::task<http_response> postRequest(json::value postData) {
-  http_client client(U("http://localhost:7901/v1/log"));
+namespace {
+// The logger cannot signal new messages, so it is drained this often. The
+// shipper decides when they are sent.
+constexpr DWORD DrainIntervalMilliseconds = 250;
+constexpr std::chrono::seconds SendTimeout{5};
+
+// HttpLogTransport posts batches through one client, which keeps its
+// connection alive between them. A request in flight is abandoned as soon
+// as quitEvent is signaled, so that teardown does not wait for it.
+class HttpLogTransport : public LogTransport {
+public:
+  HttpLogTransport(HANDLE quitEvent)
+      : mClient(U("http://localhost:7901/v1/log"), makeConfig()),
+        mQuitEvent(quitEvent) {
+    mDoneEvent =
+        CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+  }
+
+  ~HttpLogTransport() { SafeCloseHandle(&mDoneEvent); }
+
+  bool Send(const std::string &body) override {
+    if (mDoneEvent == nullptr) {
+      return false;
+    }
+
+    pplx::cancellation_token_source cancel;
+    HANDLE doneEvent = mDoneEvent;
+    pplx::task<http_response> task;
+
+    try {
+      task = mClient.request(methods::POST, U(""), body, "application/json",
+                             cancel.get_token());
+    } catch (...) {
+      return false;
+    }
+
+    task.then([doneEvent](pplx::task<http_response>) { SetEvent(doneEvent); });
+
+    HANDLE waitArray[2] = {mQuitEvent, mDoneEvent};
+    DWORD waitResult = WaitForMultipleObjects(2, waitArray, FALSE, INFINITE);
+
+    if (waitResult == WAIT_OBJECT_0 + 0) {
+      cancel.cancel();
+      WaitForSingleObject(mDoneEvent, INFINITE);
+      // The event resets when it is waited for; pass it on to the loop.
+      SetEvent(mQuitEvent);
+      return false;
+    }
+
+    try {
+      status_code status = task.get().status_code();
+
+      return status >= 200 && status < 300;
+    } catch (...) {
+      return false;
+    }
+  }
+
+private:
+  static http_client_config makeConfig() {
+    http_client_config config;
+
+    config.set_timeout(SendTimeout);
+
+    return config;
+  }
+
+  http_client mClient;
+  HANDLE mQuitEvent = nullptr;
+  HANDLE mDoneEvent = nullptr;
+};
 
-  return client.request(methods::POST, U(""), postData.serialize(),
-                        U("application/json"));
+std::string toUTF8(const utility::string_t &s) {
+  return utility::conversions::to_utf8string(s);
 }
 
+// Moves the messages held by the logger into the shipper, one entry each.
+// When the logger holds an object, its other fields frame every batch, so
+// that the receiver gets the same document as before, only shorter.
+void drainLog(LogShipper *shipper, LogShipper::Clock::time_point now) {
+  if (Log->IsEmpty()) {
+    return;
+  }
+
+  json::value document = Log->ToJSON();
+
+  Log->Clear();
+
+  const json::value *messages{nullptr};
+  std::string prefix{"["};
+  std::string suffix{"]"};
+
+  if (document.is_array()) {
+    messages = &document;
+  } else if (document.is_object()) {
+    std::string fields;
+    utility::string_t name;
+
+    for (const auto &field : document.as_object()) {
+      if (messages == nullptr && field.second.is_array()) {
+        messages = &field.second;
+        name = field.first;
+        continue;
+      }
+
+      fields += toUTF8(json::value::string(field.first).serialize());
+      fields += ":" + toUTF8(field.second.serialize()) + ",";
+    }
+
+    prefix = "{" + fields + toUTF8(json::value::string(name).serialize()) +
+             ":[";
+    suffix = "]}";
+  }
+  if (messages == nullptr) {
+    shipper->SetFraming("[", "]");
+    shipper->Append(toUTF8(document.serialize()), now);
+    return;
+  }
+
+  shipper->SetFraming(prefix, suffix);
+
+  for (const json::value &message : messages->as_array()) {
+    shipper->Append(toUTF8(message.serialize()), now);
+  }
+}
+} // namespace
+
 DWORD WINAPI logLoop(LPVOID context) {
   LogLoopContext *ctx = static_cast<LogLoopContext *>(context);
 
@@ -28,35 +149,39 @@ DWORD WINAPI logLoop(LPVOID context) {
     return E_FAIL;
   }
 
+  HttpLogTransport transport(ctx->QuitEvent);
+  LogShipper shipper(&transport);
+  uint64_t droppedCount{0};
   bool isActive{true};
 
   while (isActive) {
-    HANDLE waitArray[1] = {ctx->QuitEvent};
-    DWORD waitResult = WaitForMultipleObjects(1, waitArray, FALSE, 0);
+    LogShipper::Clock::time_point now = LogShipper::Clock::now();
 
-    if (waitResult == WAIT_OBJECT_0 + 0) {
-      isActive = false;
-      continue;
-    }
+    drainLog(&shipper, now);
+    shipper.Ship(now);
 
-    Sleep(10000);
+    if (shipper.GetDroppedCount() != droppedCount) {
+      wchar_t msg[64]{};
 
-    if (Log->IsEmpty()) {
-      continue;
-    }
+      StringCbPrintfW(msg, sizeof(msg), L"Dropped %llu log messages",
+                      shipper.GetDroppedCount() - droppedCount);
+      Log->Warn(msg, GetCurrentThreadId(), __LONGFILE__);
 
-    json::value message = Log->ToJSON();
+      droppedCount = shipper.GetDroppedCount();
+    }
 
-    try {
-      postRequest(message).wait();
-    } catch (...) {
-      Log->Warn(L"Failed to send log messages", GetCurrentThreadId(),
-                __LONGFILE__);
+    DWORD timeout = DrainIntervalMilliseconds;
+    LogShipper::Clock::duration wait =
+        shipper.GetWait(LogShipper::Clock::now());
 
-      continue;
+    if (wait < std::chrono::milliseconds(timeout)) {
+      timeout = static_cast<DWORD>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(wait)
+              .count());
+    }
+    if (WaitForSingleObject(ctx->QuitEvent, timeout) == WAIT_OBJECT_0) {
+      isActive = false;
     }
-
-    Log->Clear();
   }
 
   return S_OK;
@@ -0,0 +1,116 @@
+#include <utility>
+
+#include "logshipper.h"
+
+LogShipper::LogShipper(LogTransport *transport,
+                       const LogShipperOptions &options)
+    : mTransport(transport), mOptions(options) {
+  if (mOptions.BatchEntries == 0) {
+    mOptions.BatchEntries = 1;
+  }
+  if (mOptions.MaxEntries < mOptions.BatchEntries) {
+    mOptions.MaxEntries = mOptions.BatchEntries;
+  }
+}
+
+void LogShipper::SetFraming(const std::string &prefix,
+                            const std::string &suffix) {
+  mPrefix = prefix;
+  mSuffix = suffix;
+}
+
+void LogShipper::Append(std::string entry, Clock::time_point now) {
+  mEntries.push_back(Entry{std::move(entry), now});
+
+  while (mEntries.size() > mOptions.MaxEntries) {
+    mEntries.pop_front();
+    mDroppedCount += 1;
+  }
+}
+
+LogShipper::Clock::duration
+LogShipper::GetWait(Clock::time_point now) const {
+  if (mEntries.empty()) {
+    return Clock::duration::max();
+  }
+
+  Clock::time_point due = mEntries.size() >= mOptions.BatchEntries
+                              ? now
+                              : mEntries.front().Time + mOptions.Deadline;
+
+  if (due < mRetryTime) {
+    due = mRetryTime;
+  }
+
+  return due > now ? due - now : Clock::duration::zero();
+}
+
+void LogShipper::Ship(Clock::time_point now) {
+  std::string body;
+
+  while (isDue(now)) {
+    size_t count = makeBatch(&body);
+
+    if (!mTransport->Send(body)) {
+      mFailedCount += 1;
+      mBackoff = mBackoff == Clock::duration::zero() ? mOptions.MinBackoff
+                                                     : mBackoff * 2;
+
+      if (mBackoff > mOptions.MaxBackoff) {
+        mBackoff = mOptions.MaxBackoff;
+      }
+
+      mRetryTime = now + mBackoff;
+
+      return;
+    }
+
+    mEntries.erase(mEntries.begin(), mEntries.begin() + count);
+    mSentCount += count;
+    mBackoff = Clock::duration::zero();
+  }
+}
+
+size_t LogShipper::GetQueuedCount() const { return mEntries.size(); }
+
+uint64_t LogShipper::GetSentCount() const { return mSentCount; }
+
+uint64_t LogShipper::GetDroppedCount() const { return mDroppedCount; }
+
+uint64_t LogShipper::GetFailedCount() const { return mFailedCount; }
+
+bool LogShipper::isDue(Clock::time_point now) const {
+  if (mEntries.empty() || now < mRetryTime) {
+    return false;
+  }
+
+  return mEntries.size() >= mOptions.BatchEntries ||
+         now - mEntries.front().Time >= mOptions.Deadline;
+}
+
+// Writes the oldest entries that fit into body and returns how many it
+// took. The first entry is always taken.
+size_t LogShipper::makeBatch(std::string *body) const {
+  size_t count{0};
+
+  body->assign(mPrefix);
+
+  for (const Entry &entry : mEntries) {
+    size_t length = body->size() + entry.Text.size() + mSuffix.size() + 1;
+
+    if (count == mOptions.BatchEntries ||
+        (count > 0 && length > mOptions.MaxBatchBytes)) {
+      break;
+    }
+    if (count > 0) {
+      body->push_back(',');
+    }
+
+    body->append(entry.Text);
+    count += 1;
+  }
+
+  body->append(mSuffix);
+
+  return count;
+}
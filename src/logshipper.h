@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// LogTransport delivers one batch to the log receiver. Send returns false
+// when the batch was not accepted and should be retried.
+class LogTransport {
+public:
+  virtual ~LogTransport() {}
+
+  virtual bool Send(const std::string &body) = 0;
+};
+
+struct LogShipperOptions {
+  // A batch is sent as soon as this many entries are waiting.
+  uint32_t BatchEntries = 256;
+  // Batches are cut short before they grow past this, unless a single
+  // entry is longer.
+  uint32_t MaxBatchBytes = 65536;
+  // Beyond this, the oldest entries are dropped.
+  uint32_t MaxEntries = 4096;
+  // No entry waits longer than this while the receiver is reachable.
+  std::chrono::milliseconds Deadline{2000};
+  // After a failed send, the next attempt waits for the backoff, which
+  // doubles with every failure in a row.
+  std::chrono::milliseconds MinBackoff{500};
+  std::chrono::milliseconds MaxBackoff{30000};
+};
+
+// LogShipper queues log entries and sends them in batches through a
+// transport. Entries are UTF-8 JSON values; a batch is the prefix, the
+// entries separated by commas, and the suffix.
+//
+// It belongs to one thread, which appends entries, sleeps for GetWait and
+// calls Ship. The time is passed in, so that it can be driven by a fake
+// clock.
+class LogShipper {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit LogShipper(LogTransport *transport,
+                      const LogShipperOptions &options = LogShipperOptions());
+
+  // Defaults to a JSON array.
+  void SetFraming(const std::string &prefix, const std::string &suffix);
+
+  void Append(std::string entry, Clock::time_point now);
+
+  // Returns how long until Ship has something to send; zero when it has
+  // now, and Clock::duration::max() when nothing is queued.
+  Clock::duration GetWait(Clock::time_point now) const;
+  // Sends the batches that are due. Stops at the first failure and backs
+  // off.
+  void Ship(Clock::time_point now);
+
+  size_t GetQueuedCount() const;
+  uint64_t GetSentCount() const;
+  uint64_t GetDroppedCount() const;
+  uint64_t GetFailedCount() const;
+
+private:
+  struct Entry {
+    std::string Text;
+    Clock::time_point Time;
+  };
+
+  bool isDue(Clock::time_point now) const;
+  size_t makeBatch(std::string *body) const;
+
+  LogTransport *mTransport = nullptr;
+  LogShipperOptions mOptions;
+  std::string mPrefix = "[";
+  std::string mSuffix = "]";
+
+  std::deque<Entry> mEntries;
+  Clock::time_point mRetryTime;
+  Clock::duration mBackoff{0};
+
+  uint64_t mSentCount = 0;
+  uint64_t mDroppedCount = 0;
+  uint64_t mFailedCount = 0;
+};
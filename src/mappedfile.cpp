@@ -0,0 +1,119 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+MappedFile::MappedFile() {}
+
+MappedFile::~MappedFile() { Close(); }
+
+#ifdef _WIN32
+bool MappedFile::Open(const char *path) {
+  Close();
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER size{};
+
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  mFile = file;
+  mMapping = mapping;
+  mData = static_cast<const char *>(data);
+  mSize = static_cast<size_t>(size.QuadPart);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData != nullptr) {
+    UnmapViewOfFile(mData);
+  }
+  if (mMapping != nullptr) {
+    CloseHandle(mMapping);
+  }
+  if (mFile != nullptr) {
+    CloseHandle(mFile);
+  }
+
+  mData = nullptr;
+  mSize = 0;
+  mMapping = nullptr;
+  mFile = nullptr;
+}
+#else
+bool MappedFile::Open(const char *path) {
+  Close();
+
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st {};
+
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  mData = static_cast<const char *>(data);
+  mSize = static_cast<size_t>(st.st_size);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (mData != nullptr) {
+    munmap(const_cast<char *>(mData), mSize);
+  }
+
+  mData = nullptr;
+  mSize = 0;
+}
+#endif
+
+const char *MappedFile::GetData() const { return mData; }
+
+size_t MappedFile::GetSize() const { return mSize; }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+// MappedFile maps a whole file read-only into memory.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  bool Open(const char *path);
+  void Close();
+
+  const char *GetData() const;
+  size_t GetSize() const;
+
+private:
+  const char *mData = nullptr;
+  size_t mSize = 0;
+#ifdef _WIN32
+  void *mFile = nullptr;
+  void *mMapping = nullptr;
+#endif
+};
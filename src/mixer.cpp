@@ -0,0 +1,412 @@
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIXER_SSE2
+#endif
+
+#include <cstring>
+
+#include "mixer.h"
+
+namespace {
+// Length of the ramp behind SetGain.
+constexpr double gainSmoothingSeconds = 0.005;
+
+uint32_t toFrames(double seconds, uint32_t samplesPerSec) {
+  double frames = seconds * samplesPerSec + 0.5;
+
+  return frames > 0.0 ? static_cast<uint32_t>(frames) : 0;
+}
+} // namespace
+
+Mixer::Mixer() {}
+
+Mixer::~Mixer() { Close(); }
+
+int32_t Mixer::AddBus(MixerSource *source, float gain) {
+  if (source == nullptr || mBusCount == MaxBuses) {
+    return -1;
+  }
+
+  Bus &bus = mBuses[mBusCount];
+
+  bus.Source = source;
+  bus.Gain.store(gain);
+  bus.Fader.Set(gain);
+
+  return mBusCount++;
+}
+
+int32_t Mixer::GetBusCount() const { return mBusCount; }
+
+void Mixer::SetGain(int32_t bus, float gain) {
+  RampGain(bus, gain, gainSmoothingSeconds, RampCurve::Linear);
+}
+
+float Mixer::GetGain(int32_t bus) const {
+  if (bus < 0 || bus >= mBusCount) {
+    return 0.0f;
+  }
+
+  return mBuses[bus].Gain.load(std::memory_order_relaxed);
+}
+
+bool Mixer::RampGain(int32_t bus, float gain, double seconds, RampCurve curve,
+                     uint64_t startFrame, bool isStopping) {
+  if (bus < 0 || bus >= mBusCount) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mRampMutex);
+
+  Bus &b = mBuses[bus];
+  uint64_t w = b.RampWriteIndex.load(std::memory_order_relaxed);
+  uint64_t r = b.RampReadIndex.load(std::memory_order_acquire);
+
+  if (w - r >= RampCapacity) {
+    return false;
+  }
+
+  RampRequest &request = b.Ramps[w % RampCapacity];
+
+  request.Gain = gain < 0.0f ? 0.0f : gain;
+  request.Seconds = seconds > 0.0 ? seconds : 0.0;
+  request.Curve = curve;
+  request.StartFrame = startFrame;
+  request.IsStopping = isStopping;
+
+  b.Gain.store(request.Gain, std::memory_order_relaxed);
+  b.RampWriteIndex.store(w + 1, std::memory_order_release);
+
+  return true;
+}
+
+void Mixer::SetDucking(int32_t bus, const DuckSettings &settings) {
+  if (bus < 0 || bus >= mBusCount) {
+    return;
+  }
+
+  Bus &b = mBuses[bus];
+  bool isKeyed = settings.KeyBus >= 0 && settings.KeyBus < mBusCount &&
+                 settings.KeyBus != bus;
+
+  b.DuckGain.store(settings.Gain < 0.0f ? 0.0f : settings.Gain,
+                   std::memory_order_relaxed);
+  b.DuckAttack.store(settings.AttackSeconds, std::memory_order_relaxed);
+  b.DuckHold.store(settings.HoldSeconds, std::memory_order_relaxed);
+  b.DuckRelease.store(settings.ReleaseSeconds, std::memory_order_relaxed);
+  b.DuckKey.store(isKeyed ? settings.KeyBus : -1, std::memory_order_release);
+}
+
+void Mixer::SetResampleQuality(int32_t bus, ResampleQuality quality) {
+  if (bus < 0 || bus >= mBusCount) {
+    return;
+  }
+
+  mBuses[bus].Source->SetResampleQuality(quality);
+}
+
+bool Mixer::Open(uint32_t samplesPerSec, uint16_t channels,
+                 uint32_t maxFrames) {
+  Close();
+
+  if (mBusCount == 0 || channels == 0 || maxFrames == 0) {
+    return false;
+  }
+
+  mChannels = channels;
+  mMaxFrames = maxFrames;
+  mSamplesPerSec.store(samplesPerSec, std::memory_order_relaxed);
+  mScratch = new float[mBusCount * maxFrames * channels]{};
+  mEnvelope = new float[maxFrames]{};
+
+  for (int32_t i = 0; i < mBusCount; i++) {
+    mBuses[i].Source->SetTargetSamplesPerSec(samplesPerSec);
+  }
+
+  return true;
+}
+
+void Mixer::Close() {
+  delete[] mScratch;
+  mScratch = nullptr;
+
+  delete[] mEnvelope;
+  mEnvelope = nullptr;
+
+  mMaxFrames = 0;
+}
+
+// Every source renders before anything is mixed, so that ducking follows the
+// key in the same block whatever the order of the buses.
+void Mixer::Render(float *dst, uint32_t frames, int32_t *completions) {
+  size_t samples = static_cast<size_t>(frames) * mChannels;
+  size_t stride = static_cast<size_t>(mMaxFrames) * mChannels;
+  uint64_t position = mPosition.load(std::memory_order_relaxed);
+  bool isMixed{false};
+
+  mPosition.store(position + frames, std::memory_order_release);
+
+  // Sources keep running when muted so that they stay in time.
+  for (int32_t i = 0; i < mBusCount; i++) {
+    Bus &bus = mBuses[i];
+
+    completions[i] =
+        bus.Source->Render(mScratch + i * stride, position, frames, mChannels);
+    bus.IsSilent = bus.Source->IsSilent();
+  }
+  for (int32_t i = 0; i < mBusCount; i++) {
+    Bus &bus = mBuses[i];
+    const float *src = mScratch + i * stride;
+
+    duck(bus, frames);
+
+    if (bus.IsSilent) {
+      automate(bus, position, frames, nullptr);
+      continue;
+    }
+    if (isVarying(bus, position, frames)) {
+      automate(bus, position, frames, mEnvelope);
+
+      if (isMixed) {
+        MixAddEnvelope(dst, src, mEnvelope, frames, mChannels);
+      } else {
+        MixCopyEnvelope(dst, src, mEnvelope, frames, mChannels);
+      }
+    } else {
+      float gain = bus.Fader.GetGain() * bus.Duck.GetGain();
+
+      if (isMixed) {
+        MixAdd(dst, src, gain, samples);
+      } else {
+        MixCopy(dst, src, gain, samples);
+      }
+    }
+
+    isMixed = true;
+  }
+  if (!isMixed) {
+    std::memset(dst, 0, sizeof(float) * samples);
+  }
+}
+
+// Starts ducking as soon as the key plays, and lets go once it has been
+// silent for the hold time.
+void Mixer::duck(Bus &bus, uint32_t frames) {
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+  int32_t key = bus.DuckKey.load(std::memory_order_acquire);
+  float gain = bus.DuckGain.load(std::memory_order_relaxed);
+  double attack = bus.DuckAttack.load(std::memory_order_relaxed);
+
+  if (key >= 0 && !mBuses[key].IsSilent) {
+    bus.KeySilentFrames = 0;
+
+    if (!bus.IsDucked || (!bus.Duck.IsRamping() &&
+                          bus.Duck.GetTarget() != gain)) {
+      bus.IsDucked = true;
+      bus.Duck.Start(gain, toFrames(attack, samplesPerSec),
+                     RampCurve::Exponential);
+    }
+
+    return;
+  }
+  if (!bus.IsDucked) {
+    return;
+  }
+
+  uint32_t hold = toFrames(bus.DuckHold.load(std::memory_order_relaxed),
+                           samplesPerSec);
+  uint64_t silent = bus.KeySilentFrames;
+
+  bus.KeySilentFrames += frames;
+
+  // The release starts on the frame the hold runs out, which automate
+  // applies.
+  if (key < 0 || silent + frames > hold) {
+    bus.IsDucked = false;
+    bus.IsReleasing = true;
+    bus.ReleaseOffset =
+        key < 0 || silent >= hold ? 0 : static_cast<uint32_t>(hold - silent);
+    bus.ReleaseFrames = toFrames(
+        bus.DuckRelease.load(std::memory_order_relaxed), samplesPerSec);
+  }
+}
+
+// Whether the gain of bus changes within the block.
+bool Mixer::isVarying(const Bus &bus, uint64_t position,
+                      uint32_t frames) const {
+  if (bus.Fader.IsRamping() || bus.Duck.IsRamping() || bus.IsReleasing) {
+    return true;
+  }
+
+  uint64_t w = bus.RampWriteIndex.load(std::memory_order_acquire);
+  uint64_t r = bus.RampReadIndex.load(std::memory_order_relaxed);
+
+  return r < w && bus.Ramps[r % RampCapacity].StartFrame < position + frames;
+}
+
+// Starts the ramps due within the block on the frame they are due, and
+// writes the gain of every frame to envelope. Without envelope the ramps
+// only move on.
+void Mixer::automate(Bus &bus, uint64_t position, uint32_t frames,
+                     float *envelope) {
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+  uint64_t w = bus.RampWriteIndex.load(std::memory_order_acquire);
+  uint64_t r = bus.RampReadIndex.load(std::memory_order_relaxed);
+  uint32_t done{0};
+
+  for (; r < w; r++) {
+    const RampRequest &request = bus.Ramps[r % RampCapacity];
+
+    if (request.StartFrame >= position + frames) {
+      break;
+    }
+
+    uint32_t offset = request.StartFrame > position
+                          ? static_cast<uint32_t>(request.StartFrame - position)
+                          : 0;
+
+    if (offset > done) {
+      if (envelope != nullptr) {
+        bus.Fader.Fill(envelope + done, offset - done);
+      } else {
+        bus.Fader.Skip(offset - done);
+      }
+
+      done = offset;
+    }
+
+    bus.Fader.Start(request.Gain, toFrames(request.Seconds, samplesPerSec),
+                    request.Curve);
+    bus.IsStopping = request.IsStopping;
+  }
+
+  bus.RampReadIndex.store(r, std::memory_order_release);
+
+  if (envelope != nullptr) {
+    bus.Fader.Fill(envelope + done, frames - done);
+  } else {
+    bus.Fader.Skip(frames - done);
+  }
+
+  uint32_t ducked{0};
+
+  if (bus.IsReleasing) {
+    ducked = bus.ReleaseOffset;
+
+    if (envelope != nullptr) {
+      bus.Duck.Scale(envelope, ducked);
+    } else {
+      bus.Duck.Skip(ducked);
+    }
+
+    bus.IsReleasing = false;
+    bus.Duck.Start(1.0f, bus.ReleaseFrames, RampCurve::Exponential);
+  }
+  if (envelope != nullptr) {
+    bus.Duck.Scale(envelope + ducked, frames - ducked);
+  } else {
+    bus.Duck.Skip(frames - ducked);
+  }
+  if (bus.IsStopping && !bus.Fader.IsRamping()) {
+    bus.IsStopping = false;
+    bus.Source->Stop();
+  }
+}
+
+uint64_t Mixer::GetPosition() const {
+  return mPosition.load(std::memory_order_acquire);
+}
+
+uint32_t Mixer::GetSamplesPerSec() const {
+  return mSamplesPerSec.load(std::memory_order_relaxed);
+}
+
+void MixAdd(float *dst, const float *src, float gain, size_t samples) {
+  size_t i{};
+
+#if defined(MIXER_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+
+  for (; i + 4 <= samples; i += 4) {
+    __m128 s = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), s));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+void MixCopy(float *dst, const float *src, float gain, size_t samples) {
+  size_t i{};
+
+#if defined(MIXER_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+
+  for (; i + 4 <= samples; i += 4) {
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] = src[i] * gain;
+  }
+}
+
+namespace {
+void mixEnvelope(float *dst, const float *src, const float *envelope,
+                 uint32_t frames, uint16_t channels, bool isAdding) {
+  uint32_t f{};
+
+#if defined(MIXER_SSE2)
+  if (channels == 1) {
+    for (; f + 4 <= frames; f += 4) {
+      __m128 s = _mm_mul_ps(_mm_loadu_ps(src + f), _mm_loadu_ps(envelope + f));
+
+      if (isAdding) {
+        s = _mm_add_ps(_mm_loadu_ps(dst + f), s);
+      }
+
+      _mm_storeu_ps(dst + f, s);
+    }
+  } else if (channels == 2) {
+    // Each gain covers both samples of its frame.
+    for (; f + 4 <= frames; f += 4) {
+      __m128 e = _mm_loadu_ps(envelope + f);
+      __m128 lo = _mm_mul_ps(_mm_loadu_ps(src + f * 2), _mm_unpacklo_ps(e, e));
+      __m128 hi =
+          _mm_mul_ps(_mm_loadu_ps(src + f * 2 + 4), _mm_unpackhi_ps(e, e));
+
+      if (isAdding) {
+        lo = _mm_add_ps(_mm_loadu_ps(dst + f * 2), lo);
+        hi = _mm_add_ps(_mm_loadu_ps(dst + f * 2 + 4), hi);
+      }
+
+      _mm_storeu_ps(dst + f * 2, lo);
+      _mm_storeu_ps(dst + f * 2 + 4, hi);
+    }
+  }
+#endif
+
+  for (; f < frames; f++) {
+    for (uint16_t c = 0; c < channels; c++) {
+      size_t i = static_cast<size_t>(f) * channels + c;
+      float s = src[i] * envelope[f];
+
+      dst[i] = isAdding ? dst[i] + s : s;
+    }
+  }
+}
+} // namespace
+
+void MixAddEnvelope(float *dst, const float *src, const float *envelope,
+                    uint32_t frames, uint16_t channels) {
+  mixEnvelope(dst, src, envelope, frames, channels, true);
+}
+
+void MixCopyEnvelope(float *dst, const float *src, const float *envelope,
+                     uint32_t frames, uint16_t channels) {
+  mixEnvelope(dst, src, envelope, frames, channels, false);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "gainramp.h"
+#include "resampler.h"
+
+// MixerSource produces blocks of interleaved normalized floats for one bus.
+// position is the mixer frame the block starts at, which sources use to start
+// scheduled sounds on the exact frame. Render returns the number of times the
+// source completed during the block.
+//
+// Sources that know when they play nothing report it through IsSilent, and
+// the mixer leaves them out of the mix.
+class MixerSource {
+public:
+  virtual ~MixerSource() {}
+
+  virtual void SetTargetSamplesPerSec(uint32_t samplesPerSec) = 0;
+  // Sources that convert rates use quality for what they convert next.
+  virtual void SetResampleQuality(ResampleQuality quality) {}
+  // Fades out and discards whatever the source has queued.
+  virtual void Stop() {}
+  virtual int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                         uint16_t channels) = 0;
+  // Whether the last block rendered was all zeros.
+  virtual bool IsSilent() const { return false; }
+};
+
+// DuckSettings lowers a bus while another bus, the key, is playing.
+struct DuckSettings {
+  // -1 turns ducking off.
+  int32_t KeyBus = -1;
+  float Gain = 0.5f;
+  double AttackSeconds = 0.01;
+  // How long the key has to stay silent before the gain comes back, so that
+  // short pauses do not pump. It counts from the first block the key is
+  // silent in.
+  double HoldSeconds = 0.15;
+  double ReleaseSeconds = 0.25;
+};
+
+// Mixer sums a fixed set of buses into one stream. Buses are added before
+// Open; their gains may be changed from any thread.
+//
+// Each bus has a fader that moves along ramps, and may be ducked under
+// another bus. Both are applied per frame, so gain changes do not click.
+// Buses whose source is silent are not mixed at all; their ramps still move
+// on.
+//
+// The mixer counts the frames it renders. The count keeps running across
+// Close and Open, so it serves as the clock that commands are scheduled on.
+class Mixer {
+public:
+  static constexpr int32_t MaxBuses = 4;
+
+  Mixer();
+  ~Mixer();
+
+  // Returns the index of the new bus, or -1 when no bus is left.
+  int32_t AddBus(MixerSource *source, float gain);
+  int32_t GetBusCount() const;
+
+  // Ramps to gain over a few milliseconds.
+  void SetGain(int32_t bus, float gain);
+  // Returns the gain that bus was last asked to reach.
+  float GetGain(int32_t bus) const;
+  // Moves the fader of bus to gain over seconds, starting at startFrame on
+  // the mixer clock, or with the next block once that frame has passed.
+  // Ramps apply in the order they are made, each from wherever the gain is
+  // at the time. With isStopping, the source is stopped when the ramp ends.
+  // Returns false when too many ramps are waiting for the render thread.
+  bool RampGain(int32_t bus, float gain, double seconds, RampCurve curve,
+                uint64_t startFrame = 0, bool isStopping = false);
+  // Takes effect from the next block.
+  void SetDucking(int32_t bus, const DuckSettings &settings);
+  // Lets each bus trade conversion cost for quality, e.g. cheap for sound
+  // effects and high quality for speech.
+  void SetResampleQuality(int32_t bus, ResampleQuality quality);
+
+  bool Open(uint32_t samplesPerSec, uint16_t channels, uint32_t maxFrames);
+  void Close();
+
+  // Mixes frames into dst. completions must hold GetBusCount() entries.
+  void Render(float *dst, uint32_t frames, int32_t *completions);
+
+  // Returns the first frame that no block has started rendering yet. Sounds
+  // scheduled at or after it start on time if they are queued before the
+  // next block.
+  uint64_t GetPosition() const;
+  uint32_t GetSamplesPerSec() const;
+
+private:
+  static constexpr uint32_t RampCapacity = 16;
+
+  struct RampRequest {
+    float Gain = 1.0f;
+    double Seconds = 0.0;
+    RampCurve Curve = RampCurve::Linear;
+    uint64_t StartFrame = 0;
+    bool IsStopping = false;
+  };
+
+  struct Bus {
+    MixerSource *Source = nullptr;
+    std::atomic<float> Gain{1.0f};
+
+    // Written under mRampMutex, read by the render thread.
+    RampRequest Ramps[RampCapacity];
+    std::atomic<uint64_t> RampWriteIndex{0};
+    std::atomic<uint64_t> RampReadIndex{0};
+
+    std::atomic<int32_t> DuckKey{-1};
+    std::atomic<float> DuckGain{1.0f};
+    std::atomic<double> DuckAttack{0.0};
+    std::atomic<double> DuckHold{0.0};
+    std::atomic<double> DuckRelease{0.0};
+
+    // Owned by the render thread.
+    GainRamp Fader;
+    GainRamp Duck;
+    bool IsStopping = false;
+    bool IsDucked = false;
+    bool IsSilent = false;
+    uint64_t KeySilentFrames = 0;
+    // A release due within the block, frames into it.
+    bool IsReleasing = false;
+    uint32_t ReleaseOffset = 0;
+    uint32_t ReleaseFrames = 0;
+  };
+
+  void duck(Bus &bus, uint32_t frames);
+  bool isVarying(const Bus &bus, uint64_t position, uint32_t frames) const;
+  void automate(Bus &bus, uint64_t position, uint32_t frames,
+                float *envelope);
+
+  Bus mBuses[MaxBuses];
+  int32_t mBusCount = 0;
+  std::mutex mRampMutex;
+  uint16_t mChannels = 0;
+  uint32_t mMaxFrames = 0;
+  // One block per bus.
+  float *mScratch = nullptr;
+  float *mEnvelope = nullptr;
+  std::atomic<uint64_t> mPosition{0};
+  std::atomic<uint32_t> mSamplesPerSec{0};
+};
+
+// Computes dst[i] += src[i] * gain.
+void MixAdd(float *dst, const float *src, float gain, size_t samples);
+
+// Computes dst[i] = src[i] * gain.
+void MixCopy(float *dst, const float *src, float gain, size_t samples);
+
+// Computes dst[i] += src[i] * envelope[f], where f is the frame of sample i.
+void MixAddEnvelope(float *dst, const float *src, const float *envelope,
+                    uint32_t frames, uint16_t channels);
+
+// Computes dst[i] = src[i] * envelope[f], where f is the frame of sample i.
+void MixCopyEnvelope(float *dst, const float *src, const float *envelope,
+                     uint32_t frames, uint16_t channels);
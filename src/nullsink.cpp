@@ -0,0 +1,41 @@
+#include "nullsink.h"
+
+NullSink::NullSink(const StreamFormat &format, uint32_t periodFrames)
+    : mFormat(format), mPeriodFrames(periodFrames) {
+  mBuffer = new uint8_t[periodFrames * BytesPerFrame(format)]{};
+}
+
+NullSink::~NullSink() {
+  delete[] mBuffer;
+  mBuffer = nullptr;
+}
+
+const StreamFormat &NullSink::GetStreamFormat() const { return mFormat; }
+
+bool NullSink::GetAvailableFrames(uint32_t *frames) {
+  *frames = mPeriodFrames;
+
+  return true;
+}
+
+bool NullSink::GetBuffer(uint32_t frames, uint8_t **data) {
+  if (frames > mPeriodFrames) {
+    return false;
+  }
+
+  *data = mBuffer;
+
+  return true;
+}
+
+bool NullSink::ReleaseBuffer(uint32_t frames) {
+  if (frames > mPeriodFrames) {
+    return false;
+  }
+
+  mFramesWritten += frames;
+
+  return true;
+}
+
+uint64_t NullSink::GetFramesWritten() const { return mFramesWritten; }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include "audiosink.h"
+
+// NullSink accepts one period per call and discards it.
+class NullSink : public AudioSink {
+public:
+  NullSink(const StreamFormat &format, uint32_t periodFrames);
+  ~NullSink();
+
+  const StreamFormat &GetStreamFormat() const override;
+  bool GetAvailableFrames(uint32_t *frames) override;
+  bool GetBuffer(uint32_t frames, uint8_t **data) override;
+  bool ReleaseBuffer(uint32_t frames) override;
+
+  uint64_t GetFramesWritten() const;
+
+private:
+  StreamFormat mFormat;
+  uint32_t mPeriodFrames = 0;
+  uint8_t *mBuffer = nullptr;
+  uint64_t mFramesWritten = 0;
+};
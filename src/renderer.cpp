@@ -0,0 +1,58 @@
+#include "renderer.h"
+
+Renderer::Renderer(Mixer *mixer) : mMixer(mixer) {}
+
+Renderer::~Renderer() { Close(); }
+
+bool Renderer::Open(const StreamFormat &format, uint32_t maxFrames) {
+  Close();
+
+  mSampleWriter = ChooseSampleWriter(format.Format, format.Channels);
+
+  if (mSampleWriter == nullptr ||
+      !mMixer->Open(format.SamplesPerSec, format.Channels, maxFrames)) {
+    return false;
+  }
+
+  mFormat = format;
+  mMaxFrames = maxFrames;
+  mBuffer = new float[maxFrames * format.Channels]{};
+
+  return true;
+}
+
+void Renderer::Close() {
+  delete[] mBuffer;
+  mBuffer = nullptr;
+
+  mSampleWriter = nullptr;
+  mMaxFrames = 0;
+
+  mMixer->Close();
+}
+
+bool Renderer::Render(AudioSink *sink, int32_t *completions) {
+  uint32_t frames{};
+  uint8_t *data{nullptr};
+
+  for (int32_t i = 0; i < mMixer->GetBusCount(); i++) {
+    completions[i] = 0;
+  }
+  if (mBuffer == nullptr || !sink->GetAvailableFrames(&frames)) {
+    return false;
+  }
+  if (frames > mMaxFrames) {
+    frames = mMaxFrames;
+  }
+  if (frames == 0) {
+    return true;
+  }
+  if (!sink->GetBuffer(frames, &data)) {
+    return false;
+  }
+
+  mMixer->Render(mBuffer, frames, completions);
+  mSampleWriter(mBuffer, data, frames, mFormat.Channels);
+
+  return sink->ReleaseBuffer(frames);
+}
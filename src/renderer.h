@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include "audiosink.h"
+#include "mixer.h"
+
+// Renderer pulls mixed blocks and writes them into an AudioSink in the sink's
+// sample format. It owns the intermediate float buffer, so Render never
+// allocates.
+class Renderer {
+public:
+  explicit Renderer(Mixer *mixer);
+  ~Renderer();
+
+  bool Open(const StreamFormat &format, uint32_t maxFrames);
+  void Close();
+
+  // Fills every frame the sink can accept. completions receives the number of
+  // times each bus completed during the period.
+  bool Render(AudioSink *sink, int32_t *completions);
+
+private:
+  Mixer *mMixer = nullptr;
+  StreamFormat mFormat;
+  SampleWriter mSampleWriter = nullptr;
+  float *mBuffer = nullptr;
+  uint32_t mMaxFrames = 0;
+};
@@ -0,0 +1,192 @@
+#include "rendertelemetry.h"
+
+namespace {
+constexpr uint32_t underrunFlag = 1;
+constexpr uint32_t lateFlag = 2;
+constexpr uint32_t failedFlag = 4;
+
+uint32_t toMicros(uint64_t nanoseconds) {
+  uint64_t micros = nanoseconds / 1000;
+
+  return micros > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(micros);
+}
+} // namespace
+
+RenderTelemetry::RenderTelemetry(uint32_t capacity) {
+  mCapacity = 1;
+
+  while (mCapacity < capacity) {
+    mCapacity <<= 1;
+  }
+
+  mMask = mCapacity - 1;
+  mSlots = new Slot[mCapacity];
+}
+
+RenderTelemetry::~RenderTelemetry() {
+  delete[] mSlots;
+  mSlots = nullptr;
+}
+
+void RenderTelemetry::Start(uint32_t periodMicros, MMCSSStatus mmcss) {
+  mPreviousWake = 0;
+  mPeriodMicros.store(periodMicros, std::memory_order_relaxed);
+  mMMCSS.store(mmcss, std::memory_order_relaxed);
+}
+
+void RenderTelemetry::Record(uint64_t wakeTime, uint64_t fillNanoseconds,
+                             uint32_t paddingFrames, uint32_t framesWritten,
+                             bool isFailed) {
+  uint64_t sequence = mSequence.load(std::memory_order_relaxed) + 1;
+  uint32_t periodMicros = mPeriodMicros.load(std::memory_order_relaxed);
+  uint32_t intervalMicros{0};
+  uint32_t flags = isFailed ? failedFlag : 0;
+
+  // The buffer starts out empty, so the first period of a stream is not an
+  // underrun.
+  if (mPreviousWake != 0) {
+    intervalMicros =
+        toMicros(wakeTime > mPreviousWake ? wakeTime - mPreviousWake : 0);
+
+    if (!isFailed && paddingFrames == 0) {
+      flags |= underrunFlag;
+    }
+    if (periodMicros > 0 && intervalMicros > periodMicros + periodMicros / 2) {
+      flags |= lateFlag;
+    }
+  }
+
+  mPreviousWake = wakeTime;
+
+  Slot &slot = mSlots[(sequence - 1) & mMask];
+  uint32_t version = slot.Version.load(std::memory_order_relaxed);
+
+  slot.Version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.Sequence.store(sequence, std::memory_order_relaxed);
+  slot.WakeTime.store(wakeTime, std::memory_order_relaxed);
+  slot.IntervalMicros.store(intervalMicros, std::memory_order_relaxed);
+  slot.FillMicros.store(toMicros(fillNanoseconds), std::memory_order_relaxed);
+  slot.PaddingFrames.store(paddingFrames, std::memory_order_relaxed);
+  slot.FramesWritten.store(framesWritten, std::memory_order_relaxed);
+  slot.Flags.store(flags, std::memory_order_relaxed);
+
+  slot.Version.store(version + 2, std::memory_order_release);
+
+  // The totals are guarded the same way, so that a reader sees them all
+  // from the same period.
+  uint32_t totalsVersion = mTotalsVersion.load(std::memory_order_relaxed);
+
+  mTotalsVersion.store(totalsVersion + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (flags & underrunFlag) {
+    mUnderruns.store(mUnderruns.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  }
+  if (flags & lateFlag) {
+    uint32_t lateMicros = intervalMicros - periodMicros;
+
+    mLateWakeups.store(mLateWakeups.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+
+    if (lateMicros > mMaxLateMicros.load(std::memory_order_relaxed)) {
+      mMaxLateMicros.store(lateMicros, std::memory_order_relaxed);
+    }
+  }
+  if (flags & failedFlag) {
+    mFailures.store(mFailures.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  }
+
+  mFramesWritten.store(mFramesWritten.load(std::memory_order_relaxed) +
+                           framesWritten,
+                       std::memory_order_relaxed);
+  mSequence.store(sequence, std::memory_order_relaxed);
+
+  mTotalsVersion.store(totalsVersion + 2, std::memory_order_release);
+
+  if (!isFailed) {
+    mFillTimes.Record(fillNanoseconds);
+  }
+}
+
+uint32_t RenderTelemetry::Read(RenderPeriod *periods, uint32_t count) const {
+  uint64_t last = mSequence.load(std::memory_order_acquire);
+  uint64_t first = last > count ? last - count + 1 : 1;
+  uint32_t copied{0};
+
+  if (last - first + 1 > mCapacity) {
+    first = last - mCapacity + 1;
+  }
+  for (uint64_t sequence = first; sequence <= last; sequence++) {
+    const Slot &slot = mSlots[(sequence - 1) & mMask];
+    uint32_t version = slot.Version.load(std::memory_order_acquire);
+    RenderPeriod period;
+
+    if (version & 1) {
+      continue;
+    }
+
+    uint32_t flags = slot.Flags.load(std::memory_order_relaxed);
+
+    period.Sequence = slot.Sequence.load(std::memory_order_relaxed);
+    period.WakeTime = slot.WakeTime.load(std::memory_order_relaxed);
+    period.IntervalMicros =
+        slot.IntervalMicros.load(std::memory_order_relaxed);
+    period.FillMicros = slot.FillMicros.load(std::memory_order_relaxed);
+    period.PaddingFrames = slot.PaddingFrames.load(std::memory_order_relaxed);
+    period.FramesWritten = slot.FramesWritten.load(std::memory_order_relaxed);
+    period.IsUnderrun = (flags & underrunFlag) != 0;
+    period.IsLate = (flags & lateFlag) != 0;
+    period.IsFailed = (flags & failedFlag) != 0;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // The writer lapped the reader and reused the slot for a later period.
+    if (slot.Version.load(std::memory_order_relaxed) != version ||
+        period.Sequence != sequence) {
+      continue;
+    }
+
+    periods[copied] = period;
+    copied += 1;
+  }
+
+  return copied;
+}
+
+RenderTotals RenderTelemetry::GetTotals() const {
+  RenderTotals totals;
+  uint32_t version{0};
+
+  do {
+    version = mTotalsVersion.load(std::memory_order_acquire);
+
+    if (version & 1) {
+      continue;
+    }
+
+    totals.Periods = mSequence.load(std::memory_order_relaxed);
+    totals.Underruns = mUnderruns.load(std::memory_order_relaxed);
+    totals.LateWakeups = mLateWakeups.load(std::memory_order_relaxed);
+    totals.Failures = mFailures.load(std::memory_order_relaxed);
+    totals.FramesWritten = mFramesWritten.load(std::memory_order_relaxed);
+    totals.MaxLateMicros = mMaxLateMicros.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version & 1) ||
+           mTotalsVersion.load(std::memory_order_relaxed) != version);
+
+  totals.PeriodMicros = mPeriodMicros.load(std::memory_order_relaxed);
+  totals.MMCSS = mMMCSS.load(std::memory_order_relaxed);
+
+  return totals;
+}
+
+const LatencyHistogram &RenderTelemetry::GetFillTimes() const {
+  return mFillTimes;
+}
+
+uint32_t RenderTelemetry::GetCapacity() const { return mCapacity; }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "latencystats.h"
+
+// Whether the render thread runs in the MMCSS "Audio" class.
+enum class MMCSSStatus : int32_t {
+  Unknown = 0,
+  Disabled = 1,
+  Registered = 2,
+  Failed = 3
+};
+
+// RenderPeriod describes one wake-up of the render thread.
+struct RenderPeriod {
+  // Counts periods since the telemetry was created, from 1.
+  uint64_t Sequence = 0;
+  // LatencyNow() when the thread woke up.
+  uint64_t WakeTime = 0;
+  // Time since the previous wake-up, or 0 for the first period of a stream.
+  uint32_t IntervalMicros = 0;
+  // Time spent mixing and writing the period.
+  uint32_t FillMicros = 0;
+  // Frames still queued in the device buffer at wake-up.
+  uint32_t PaddingFrames = 0;
+  uint32_t FramesWritten = 0;
+  // The device buffer had run dry.
+  bool IsUnderrun = false;
+  // The thread woke up more than half a period late.
+  bool IsLate = false;
+  // The period could not be rendered.
+  bool IsFailed = false;
+};
+
+struct RenderTotals {
+  uint64_t Periods = 0;
+  uint64_t Underruns = 0;
+  uint64_t LateWakeups = 0;
+  uint64_t Failures = 0;
+  uint64_t FramesWritten = 0;
+  uint32_t MaxLateMicros = 0;
+  // The device period of the current stream, or 0 when unknown.
+  uint32_t PeriodMicros = 0;
+  MMCSSStatus MMCSS = MMCSSStatus::Unknown;
+};
+
+// RenderTelemetry keeps the most recent periods in a preallocated ring,
+// along with running totals and a histogram of fill times.
+//
+// One thread writes at a time: the render thread of the current stream.
+// Start and Record never block, allocate or make system calls. Any thread
+// may read; each slot is guarded by a sequence counter, so readers skip
+// periods that are overwritten while they copy them and never hold up the
+// writer.
+class RenderTelemetry {
+public:
+  // capacity is rounded up to a power of two.
+  explicit RenderTelemetry(uint32_t capacity = 1024);
+  ~RenderTelemetry();
+
+  // Writer side. Start is called by the render thread of every new stream
+  // before its first period.
+  void Start(uint32_t periodMicros, MMCSSStatus mmcss);
+  void Record(uint64_t wakeTime, uint64_t fillNanoseconds,
+              uint32_t paddingFrames, uint32_t framesWritten, bool isFailed);
+
+  // Reader side. Read copies up to count of the most recent periods, oldest
+  // first, and returns how many it copied.
+  uint32_t Read(RenderPeriod *periods, uint32_t count) const;
+  RenderTotals GetTotals() const;
+  const LatencyHistogram &GetFillTimes() const;
+  uint32_t GetCapacity() const;
+
+private:
+  struct Slot {
+    // Odd while the writer is filling the slot.
+    std::atomic<uint32_t> Version{0};
+    std::atomic<uint64_t> Sequence{0};
+    std::atomic<uint64_t> WakeTime{0};
+    std::atomic<uint32_t> IntervalMicros{0};
+    std::atomic<uint32_t> FillMicros{0};
+    std::atomic<uint32_t> PaddingFrames{0};
+    std::atomic<uint32_t> FramesWritten{0};
+    std::atomic<uint32_t> Flags{0};
+  };
+
+  Slot *mSlots = nullptr;
+  uint32_t mCapacity = 0;
+  uint32_t mMask = 0;
+
+  // Owned by the writer.
+  uint64_t mPreviousWake = 0;
+
+  std::atomic<uint64_t> mSequence{0};
+  std::atomic<uint32_t> mTotalsVersion{0};
+  std::atomic<uint64_t> mUnderruns{0};
+  std::atomic<uint64_t> mLateWakeups{0};
+  std::atomic<uint64_t> mFailures{0};
+  std::atomic<uint64_t> mFramesWritten{0};
+  std::atomic<uint32_t> mMaxLateMicros{0};
+  std::atomic<uint32_t> mPeriodMicros{0};
+  std::atomic<MMCSSStatus> mMMCSS{MMCSSStatus::Unknown};
+
+  LatencyHistogram mFillTimes;
+};
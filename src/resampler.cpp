@@ -0,0 +1,279 @@
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2
+#endif
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "resampler.h"
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+// Enough phases that positions off the rate pair's grid, as when the pitch
+// is changed, are within a fraction of a percent of a frame.
+constexpr uint32_t minPhases = 256;
+constexpr uint32_t maxPhases = 4096;
+
+struct Design {
+  uint32_t Taps;
+  // Kaiser window shape.
+  double Beta;
+  // The -6 dB point in cycles per frame of the lower rate. The window's
+  // transition band ends near 0.5.
+  double Cutoff;
+};
+
+Design designOf(ResampleQuality quality) {
+  if (quality == ResampleQuality::ShortSinc) {
+    return Design{16, 5.65, 0.38};
+  }
+
+  return Design{64, 10.06, 0.45};
+}
+
+uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t r = a % b;
+    a = b;
+    b = r;
+  }
+
+  return a;
+}
+
+// Zeroth order modified Bessel function of the first kind.
+double besselI0(double x) {
+  double sum{1.0};
+  double term{1.0};
+
+  for (int k = 1; k < 64; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+
+    if (term < sum * 1e-17) {
+      break;
+    }
+  }
+
+  return sum;
+}
+
+// Frees the tables at exit.
+struct TableCache {
+  ~TableCache() {
+    for (ResampleTable *table : Tables) {
+      delete table;
+    }
+  }
+
+  std::mutex Mutex;
+  std::vector<ResampleTable *> Tables;
+};
+
+TableCache tableCache;
+} // namespace
+
+uint32_t ResampledFrames(uint32_t srcFrames, uint32_t srcRate,
+                         uint32_t dstRate) {
+  if (srcFrames == 0 || srcRate == 0) {
+    return 0;
+  }
+
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(srcFrames) * dstRate + srcRate - 1) / srcRate);
+}
+
+void ResampleLinear(const float *src, uint32_t srcFrames, uint16_t channels,
+                    uint32_t srcRate, uint32_t dstRate, float *dst) {
+  uint32_t dstFrames = ResampledFrames(srcFrames, srcRate, dstRate);
+
+  for (uint32_t i = 0; i < dstFrames; i++) {
+    // Fixed point keeps long waves from drifting.
+    uint64_t position = static_cast<uint64_t>(i) * srcRate;
+    uint32_t index = static_cast<uint32_t>(position / dstRate);
+    float t = static_cast<float>(position % dstRate) / dstRate;
+    uint32_t next = index + 1 < srcFrames ? index + 1 : index;
+
+    for (uint16_t c = 0; c < channels; c++) {
+      float a = src[index * channels + c];
+      float b = src[next * channels + c];
+
+      dst[i * channels + c] = a + (b - a) * t;
+    }
+  }
+}
+
+void Resample(const float *src, uint32_t srcFrames, uint16_t channels,
+              uint32_t srcRate, uint32_t dstRate, ResampleQuality quality,
+              float *dst) {
+  const ResampleTable *table =
+      ResampleTable::Find(srcRate, dstRate, quality);
+
+  if (table == nullptr) {
+    ResampleLinear(src, srcFrames, channels, srcRate, dstRate, dst);
+    return;
+  }
+
+  uint32_t dstFrames = ResampledFrames(srcFrames, srcRate, dstRate);
+  uint32_t taps = table->GetTaps();
+  uint32_t lead = taps / 2 - 1;
+  uint32_t padded = srcFrames + taps;
+  // One channel at a time, with silence on both sides, so that every window
+  // is contiguous.
+  float *planar = new float[padded];
+
+  for (uint16_t c = 0; c < channels; c++) {
+    std::memset(planar, 0, sizeof(float) * padded);
+
+    for (uint32_t i = 0; i < srcFrames; i++) {
+      planar[lead + i] = src[i * channels + c];
+    }
+    for (uint32_t i = 0; i < dstFrames; i++) {
+      uint64_t position = static_cast<uint64_t>(i) * srcRate;
+      uint32_t index = static_cast<uint32_t>(position / dstRate);
+      uint64_t remainder = position % dstRate;
+      uint32_t phase = static_cast<uint32_t>(
+          (remainder * table->GetPhases() + dstRate / 2) / dstRate);
+
+      dst[i * channels + c] =
+          DotProduct(planar + index, table->GetPhase(phase), taps);
+    }
+  }
+
+  delete[] planar;
+  planar = nullptr;
+}
+
+float DotProduct(const float *a, const float *b, uint32_t length) {
+  uint32_t i{};
+  float sum{};
+
+#if defined(RESAMPLER_SSE2)
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+
+  for (; i + 8 <= length; i += 8) {
+    acc0 = _mm_add_ps(acc0,
+                      _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                       _mm_loadu_ps(b + i + 4)));
+  }
+  for (; i + 4 <= length; i += 4) {
+    acc0 = _mm_add_ps(acc0,
+                      _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+
+  float lanes[4];
+
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+  for (; i < length; i++) {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+const ResampleTable *ResampleTable::Find(uint32_t srcRate, uint32_t dstRate,
+                                         ResampleQuality quality) {
+  if (quality == ResampleQuality::Linear || srcRate == dstRate ||
+      srcRate == 0 || dstRate == 0) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(tableCache.Mutex);
+
+  for (ResampleTable *table : tableCache.Tables) {
+    if (table->mSrcRate == srcRate && table->mDstRate == dstRate &&
+        table->mQuality == quality) {
+      return table;
+    }
+  }
+
+  tableCache.Tables.push_back(new ResampleTable(srcRate, dstRate, quality));
+
+  return tableCache.Tables.back();
+}
+
+ResampleTable::ResampleTable(uint32_t srcRate, uint32_t dstRate,
+                             ResampleQuality quality)
+    : mSrcRate(srcRate), mDstRate(dstRate), mQuality(quality) {
+  Design design = designOf(quality);
+  double ratio = static_cast<double>(dstRate) / srcRate;
+  double scale = ratio < 1.0 ? ratio : 1.0;
+  uint32_t grid = dstRate / gcd(srcRate, dstRate);
+
+  // Downsampling widens the filter by the rate ratio.
+  mTaps = static_cast<uint32_t>(std::ceil(design.Taps / scale));
+  mTaps = (mTaps + 3) / 4 * 4;
+  mTaps = mTaps < MaxResampleTaps ? mTaps : MaxResampleTaps;
+
+  mPhases = grid;
+
+  while (mPhases < minPhases) {
+    mPhases *= 2;
+  }
+
+  mPhases = mPhases < maxPhases ? mPhases : maxPhases;
+  mCoefficients = new float[(mPhases + 1) * mTaps];
+
+  // Twice the cutoff in cycles per input frame.
+  double bandwidth = 2.0 * design.Cutoff * scale;
+  double half = mTaps / 2.0;
+  double i0Beta = besselI0(design.Beta);
+
+  for (uint32_t p = 0; p <= mPhases; p++) {
+    float *coefficients = mCoefficients + p * mTaps;
+    double t = static_cast<double>(p) / mPhases;
+    double sum{0.0};
+    double values[MaxResampleTaps];
+
+    for (uint32_t k = 0; k < mTaps; k++) {
+      double x = static_cast<double>(k) - (half - 1.0) - t;
+      double u = x / half;
+      double window =
+          u * u < 1.0 ? besselI0(design.Beta * std::sqrt(1.0 - u * u)) / i0Beta
+                      : 0.0;
+      double sinc = x == 0.0 ? 1.0
+                             : std::sin(pi * bandwidth * x) /
+                                   (pi * bandwidth * x);
+
+      values[k] = sinc * window;
+      sum += values[k];
+    }
+    // Each phase passes DC unchanged.
+    for (uint32_t k = 0; k < mTaps; k++) {
+      coefficients[k] = static_cast<float>(values[k] / sum);
+    }
+  }
+}
+
+ResampleTable::~ResampleTable() {
+  delete[] mCoefficients;
+  mCoefficients = nullptr;
+}
+
+uint32_t ResampleTable::GetSrcRate() const { return mSrcRate; }
+
+uint32_t ResampleTable::GetDstRate() const { return mDstRate; }
+
+ResampleQuality ResampleTable::GetQuality() const { return mQuality; }
+
+uint32_t ResampleTable::GetTaps() const { return mTaps; }
+
+uint32_t ResampleTable::GetPhases() const { return mPhases; }
+
+const float *ResampleTable::GetPhase(double t) const {
+  uint32_t phase = static_cast<uint32_t>(t * mPhases + 0.5);
+
+  return GetPhase(phase < mPhases ? phase : mPhases);
+}
+
+const float *ResampleTable::GetPhase(uint32_t phase) const {
+  return mCoefficients + phase * mTaps;
+}
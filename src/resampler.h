@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+// Cost and quality tiers of sample rate conversion.
+enum class ResampleQuality {
+  // Linear interpolation. Cheapest; images and aliases are barely
+  // suppressed.
+  Linear,
+  // 16 taps per phase and about 60 dB of stopband rejection.
+  ShortSinc,
+  // 64 taps per phase and about 100 dB of stopband rejection.
+  LongSinc
+};
+
+// The most taps a ResampleTable has per phase.
+constexpr uint32_t MaxResampleTaps = 256;
+
+// Returns the number of frames ResampleLinear and Resample produce for
+// srcFrames.
+uint32_t ResampledFrames(uint32_t srcFrames, uint32_t srcRate,
+                         uint32_t dstRate);
+
+// Converts interleaved frames from srcRate to dstRate by linear
+// interpolation. dst must hold ResampledFrames() frames.
+void ResampleLinear(const float *src, uint32_t srcFrames, uint16_t channels,
+                    uint32_t srcRate, uint32_t dstRate, float *dst);
+
+// Converts interleaved frames from srcRate to dstRate with the filter of
+// quality. Frames outside src count as silence. dst must hold
+// ResampledFrames() frames.
+void Resample(const float *src, uint32_t srcFrames, uint16_t channels,
+              uint32_t srcRate, uint32_t dstRate, ResampleQuality quality,
+              float *dst);
+
+// Returns the sum of a[i] * b[i]. length must be a multiple of 4.
+float DotProduct(const float *a, const float *b, uint32_t length);
+
+// ResampleTable is a polyphase windowed sinc filter for one rate pair. An
+// output frame that lies a fraction t of a frame after input frame x is the
+// dot product of input frames x - GetTaps() / 2 + 1 to x + GetTaps() / 2
+// and the coefficients of GetPhase(t).
+//
+// The phases are a multiple of the reduced output rate, so converting at the
+// exact rate pair never falls between phases.
+class ResampleTable {
+public:
+  // Returns the table for the rate pair, building it on first use. Tables
+  // live until the process exits, so the pointer can be kept. Returns
+  // nullptr for Linear and when the rates are equal, which need no table.
+  // Safe to call from any thread, but it may allocate.
+  static const ResampleTable *Find(uint32_t srcRate, uint32_t dstRate,
+                                   ResampleQuality quality);
+
+  ~ResampleTable();
+
+  uint32_t GetSrcRate() const;
+  uint32_t GetDstRate() const;
+  ResampleQuality GetQuality() const;
+  // A multiple of 4.
+  uint32_t GetTaps() const;
+  uint32_t GetPhases() const;
+  // t is in [0, 1]; it is rounded to the nearest phase.
+  const float *GetPhase(double t) const;
+  // phase is in [0, GetPhases()]. The last phase equals the first one,
+  // shifted by one frame.
+  const float *GetPhase(uint32_t phase) const;
+
+private:
+  ResampleTable(uint32_t srcRate, uint32_t dstRate, ResampleQuality quality);
+
+  uint32_t mSrcRate = 0;
+  uint32_t mDstRate = 0;
+  ResampleQuality mQuality = ResampleQuality::Linear;
+  uint32_t mTaps = 0;
+  uint32_t mPhases = 0;
+  float *mCoefficients = nullptr;
+};
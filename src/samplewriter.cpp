@@ -0,0 +1,65 @@
+#include "convert.h"
+#include "samplewriter.h"
+
+namespace {
+void writeInt16(const float *src, uint8_t *dst, uint32_t frames,
+                uint16_t channels) {
+  ConvertToInt16(src, reinterpret_cast<int16_t *>(dst),
+                 static_cast<size_t>(frames) * channels);
+}
+
+void writeInt24(const float *src, uint8_t *dst, uint32_t frames,
+                uint16_t channels) {
+  ConvertToInt24(src, dst, static_cast<size_t>(frames) * channels);
+}
+
+void writeInt32(const float *src, uint8_t *dst, uint32_t frames,
+                uint16_t channels) {
+  ConvertToInt32(src, reinterpret_cast<int32_t *>(dst),
+                 static_cast<size_t>(frames) * channels);
+}
+
+void writeFloat32(const float *src, uint8_t *dst, uint32_t frames,
+                  uint16_t channels) {
+  ConvertToFloat32(src, reinterpret_cast<float *>(dst),
+                   static_cast<size_t>(frames) * channels);
+}
+} // namespace
+
+SampleWriter ChooseSampleWriter(SampleFormat format, uint16_t channels) {
+  if (channels == 0) {
+    return nullptr;
+  }
+
+  switch (format) {
+  case SampleFormat::Int16:
+    return writeInt16;
+  case SampleFormat::Int24:
+    return writeInt24;
+  case SampleFormat::Int32:
+    return writeInt32;
+  case SampleFormat::Float32:
+    return writeFloat32;
+  default:
+    break;
+  }
+
+  return nullptr;
+}
+
+const wchar_t *SampleFormatName(SampleFormat format) {
+  switch (format) {
+  case SampleFormat::Int16:
+    return L"int16";
+  case SampleFormat::Int24:
+    return L"int24";
+  case SampleFormat::Int32:
+    return L"int32";
+  case SampleFormat::Float32:
+    return L"float32";
+  default:
+    break;
+  }
+
+  return L"unknown";
+}
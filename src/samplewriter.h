@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+enum class SampleFormat { Unknown, Int16, Int24, Int32, Float32 };
+
+// Writes frames of interleaved normalized floats into a device buffer.
+// Samples are converted one by one whatever the channel layout, so there is
+// one writer per format and channels only sets how many samples there are.
+typedef void (*SampleWriter)(const float *src, uint8_t *dst, uint32_t frames,
+                             uint16_t channels);
+
+// Returns the writer for the given format and channel count, or nullptr when
+// the format is not supported or there are no channels.
+SampleWriter ChooseSampleWriter(SampleFormat format, uint16_t channels);
+
+const wchar_t *SampleFormatName(SampleFormat format);
@@ -0,0 +1,258 @@
+#include <cstring>
+
+#include "resampler.h"
+#include "sfxbank.h"
+#include "waveheader.h"
+
+namespace {
+void deleteWave(SFXWave *wave) {
+  if (wave == nullptr) {
+    return;
+  }
+
+  if (wave->IsOwned) {
+    delete[] wave->Samples;
+  }
+
+  delete wave;
+}
+} // namespace
+
+SFXBank::SFXBank(int16_t maxWaves, uint32_t workerCount)
+    : mMaxWaves(maxWaves) {
+  mSlots = new Slot[maxWaves];
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    mWorkers.emplace_back(&SFXBank::work, this);
+  }
+}
+
+SFXBank::~SFXBank() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mIsQuitting = true;
+  }
+
+  mQueued.notify_all();
+
+  for (auto &worker : mWorkers) {
+    worker.join();
+  }
+  for (int16_t i = 0; i < mMaxWaves; i++) {
+    deleteWave(mSlots[i].Wave);
+  }
+  for (SFXWave *wave : mRetired) {
+    deleteWave(wave);
+  }
+
+  delete[] mSlots;
+  mSlots = nullptr;
+}
+
+bool SFXBank::SetPath(int16_t index, const char *path) {
+  if (index < 0 || index >= mMaxWaves || path == nullptr) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSlots[index].Path = path;
+  mSlots[index].State = SlotState::Unloaded;
+
+  return true;
+}
+
+bool SFXBank::LoadBank(const char *path) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (!mBank.Open(path)) {
+    return false;
+  }
+
+  BankEntry entry;
+
+  for (int16_t i = 0; i < mMaxWaves; i++) {
+    if (!mBank.GetEntry(static_cast<uint32_t>(i), &entry)) {
+      continue;
+    }
+
+    mSlots[i].IsInBank = true;
+    mSlots[i].State = SlotState::Unloaded;
+  }
+
+  return true;
+}
+
+void SFXBank::SetSamplesPerSec(uint32_t samplesPerSec) {
+  mSamplesPerSec.store(samplesPerSec, std::memory_order_relaxed);
+}
+
+void SFXBank::SetResampleQuality(ResampleQuality quality) {
+  mQuality.store(quality, std::memory_order_relaxed);
+}
+
+void SFXBank::Prefetch(int16_t index) {
+  if (index < 0 || index >= mMaxWaves || mWorkers.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  Slot &slot = mSlots[index];
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+
+  if (slot.State == SlotState::Ready &&
+      slot.Wave->SamplesPerSec != samplesPerSec) {
+    slot.State = SlotState::Unloaded;
+  }
+  if (slot.State != SlotState::Unloaded) {
+    return;
+  }
+
+  slot.State = SlotState::Queued;
+  mQueue.push_back(index);
+  mQueued.notify_one();
+}
+
+const SFXWave *SFXBank::Acquire(int16_t index) {
+  if (index < 0 || index >= mMaxWaves) {
+    return nullptr;
+  }
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  Slot &slot = mSlots[index];
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+
+  if (slot.State == SlotState::Ready &&
+      slot.Wave->SamplesPerSec != samplesPerSec) {
+    slot.State = SlotState::Unloaded;
+  }
+  // Decoding here is faster than waiting for a worker to get to it.
+  if (slot.State == SlotState::Unloaded || slot.State == SlotState::Queued) {
+    decodeSlot(index, lock);
+  }
+
+  mDecoded.wait(lock, [&slot] { return slot.State != SlotState::Decoding; });
+
+  return slot.State == SlotState::Ready ? slot.Wave : nullptr;
+}
+
+int16_t SFXBank::GetMaxWaves() const { return mMaxWaves; }
+
+uint32_t SFXBank::GetDecodedCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mDecodedCount;
+}
+
+void SFXBank::work() {
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  while (true) {
+    mQueued.wait(lock, [this] { return mIsQuitting || !mQueue.empty(); });
+
+    if (mIsQuitting) {
+      break;
+    }
+
+    int16_t index = mQueue.front();
+    mQueue.pop_front();
+
+    // Acquire may have decoded it in the meantime.
+    if (mSlots[index].State == SlotState::Queued) {
+      decodeSlot(index, lock);
+    }
+  }
+}
+
+void SFXBank::decodeSlot(int16_t index, std::unique_lock<std::mutex> &lock) {
+  Slot &slot = mSlots[index];
+  std::string path = slot.Path;
+  bool isInBank = slot.IsInBank;
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+
+  slot.State = SlotState::Decoding;
+  lock.unlock();
+
+  BankEntry entry;
+  SFXWave *wave{nullptr};
+
+  if (isInBank && mBank.GetEntry(static_cast<uint32_t>(index), &entry)) {
+    wave = decodeEntry(entry, samplesPerSec);
+  } else {
+    wave = decode(path, samplesPerSec);
+  }
+
+  lock.lock();
+
+  if (slot.Wave != nullptr) {
+    mRetired.push_back(slot.Wave);
+  }
+
+  slot.Wave = wave;
+  slot.State = wave != nullptr ? SlotState::Ready : SlotState::Failed;
+  mDecodedCount += wave != nullptr ? 1 : 0;
+  mDecoded.notify_all();
+}
+
+SFXWave *SFXBank::decode(const std::string &path, uint32_t samplesPerSec) {
+  MappedFile file;
+  BankEntry entry;
+
+  if (!file.Open(path.c_str())) {
+    return nullptr;
+  }
+
+  float *decoded = DecodeWave(file.GetData(), file.GetSize(), &entry.Frames,
+                              &entry.Channels, &entry.SamplesPerSec);
+
+  if (decoded == nullptr) {
+    return nullptr;
+  }
+
+  entry.Samples = decoded;
+
+  SFXWave *wave = decodeEntry(entry, samplesPerSec);
+
+  // Without resampling the wave takes over the decoded samples.
+  if (wave->Samples == decoded) {
+    wave->IsOwned = true;
+  } else {
+    delete[] decoded;
+  }
+
+  return wave;
+}
+
+// Returns a wave pointing at the entry's samples when the rate already
+// matches, otherwise a resampled copy.
+SFXWave *SFXBank::decodeEntry(const BankEntry &entry,
+                              uint32_t samplesPerSec) {
+  SFXWave *wave = new SFXWave;
+
+  wave->Channels = entry.Channels;
+
+  if (samplesPerSec == 0 || samplesPerSec == entry.SamplesPerSec) {
+    wave->Samples = entry.Samples;
+    wave->IsOwned = false;
+    wave->Frames = entry.Frames;
+    wave->SamplesPerSec = entry.SamplesPerSec;
+
+    return wave;
+  }
+
+  wave->Frames =
+      ResampledFrames(entry.Frames, entry.SamplesPerSec, samplesPerSec);
+  wave->SamplesPerSec = samplesPerSec;
+
+  float *resampled = new float[wave->Frames * entry.Channels];
+
+  Resample(entry.Samples, entry.Frames, entry.Channels, entry.SamplesPerSec,
+           samplesPerSec, mQuality.load(std::memory_order_relaxed), resampled);
+
+  wave->Samples = resampled;
+
+  return wave;
+}
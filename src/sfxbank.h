@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bankfile.h"
+#include "resampler.h"
+
+// SFXWave is a sound effect decoded to normalized floats at the device rate.
+// Mono and stereo sources keep their channel count; others are cut to
+// stereo. Waves taken from a bank file at its own rate point into the mapped
+// view instead of owning their samples.
+struct SFXWave {
+  const float *Samples = nullptr;
+  bool IsOwned = true;
+  uint32_t Frames = 0;
+  uint16_t Channels = 0;
+  uint32_t SamplesPerSec = 0;
+};
+
+// SFXBank holds up to maxWaves sound effects. Files are only mapped and
+// decoded the first time a wave is needed, either by a worker after Prefetch
+// or by the thread calling Acquire.
+class SFXBank {
+public:
+  SFXBank(int16_t maxWaves, uint32_t workerCount);
+  ~SFXBank();
+
+  // Records where the wave for index lives. Nothing is read here.
+  bool SetPath(int16_t index, const char *path);
+  // Maps a bank file packed by sfxpack and serves its entries in place of
+  // files set by SetPath. Only the index is read here. Must be called before
+  // any wave is acquired.
+  bool LoadBank(const char *path);
+  // Waves decoded for another rate are decoded again on next use.
+  void SetSamplesPerSec(uint32_t samplesPerSec);
+  // Applies to waves decoded from now on.
+  void SetResampleQuality(ResampleQuality quality);
+
+  // Queues index for decoding on a worker unless it is ready or queued.
+  void Prefetch(int16_t index);
+  // Returns the decoded wave, waiting for or doing the decoding if needed.
+  // The wave stays valid until the bank is destroyed. Returns nullptr when
+  // the wave is missing or cannot be decoded.
+  const SFXWave *Acquire(int16_t index);
+
+  int16_t GetMaxWaves() const;
+  uint32_t GetDecodedCount() const;
+
+private:
+  enum class SlotState { Empty, Unloaded, Queued, Decoding, Ready, Failed };
+
+  struct Slot {
+    SlotState State = SlotState::Empty;
+    std::string Path;
+    bool IsInBank = false;
+    SFXWave *Wave = nullptr;
+  };
+
+  void work();
+  SFXWave *decode(const std::string &path, uint32_t samplesPerSec);
+  SFXWave *decodeEntry(const BankEntry &entry, uint32_t samplesPerSec);
+  void decodeSlot(int16_t index, std::unique_lock<std::mutex> &lock);
+
+  Slot *mSlots = nullptr;
+  BankFile mBank;
+  int16_t mMaxWaves = 0;
+  std::atomic<uint32_t> mSamplesPerSec{0};
+  std::atomic<ResampleQuality> mQuality{ResampleQuality::Linear};
+  uint32_t mDecodedCount = 0;
+
+  // Waves replaced after a rate change may still be playing.
+  std::vector<SFXWave *> mRetired;
+
+  std::deque<int16_t> mQueue;
+  std::vector<std::thread> mWorkers;
+  bool mIsQuitting = false;
+  mutable std::mutex mMutex;
+  std::condition_variable mQueued;
+  std::condition_variable mDecoded;
+};
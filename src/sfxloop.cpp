@@ -27,15 +27,29 @@ DWORD WINAPI sfxLoop(LPVOID context) {
       break;
     }
 
-    bool ok{};
-
-    if (ctx->SFXIndex < 0) {
-      ok = ctx->SFXEngine->Sleep(ctx->WaitDuration);
-    } else {
-      ok = ctx->SFXEngine->Feed(ctx->SFXIndex);
-    }
-    if (!ok) {
-      Log->Warn(L"Failed to feed", GetCurrentThreadId(), __LONGFILE__);
+    SFXRequest request;
+    uint32_t generation{0};
+
+    while (isActive && ctx->Queue->Take(&request, &generation)) {
+      // Decodes the wave here unless a worker has already done it.
+      const SFXWave *wave = ctx->Bank->Acquire(request.SFXIndex);
+
+      if (wave == nullptr) {
+        Log->Warn(L"Failed to load SFX", GetCurrentThreadId(), __LONGFILE__);
+      }
+
+      // A missing wave is still handed over so that every request resolves.
+      // The source only refuses requests while the render thread is behind.
+      while (!ctx->Queue->Submit(request, wave, generation)) {
+        if (WaitForSingleObject(ctx->QuitEvent, 1) == WAIT_OBJECT_0) {
+          isActive = false;
+          break;
+        }
+      }
+      // The command loop schedules what follows once the wave's end is known.
+      if (isActive && !SetEvent(ctx->NextEvent)) {
+        Log->Fail(L"Failed to send event", GetCurrentThreadId(), __LONGFILE__);
+      }
     }
   }
 
@@ -0,0 +1,71 @@
+#include "sfxqueue.h"
+
+SFXQueue::SFXQueue(SFXSource *source, LatencyStats *stats)
+    : mSource(source), mStats(stats) {}
+
+void SFXQueue::Push(const SFXRequest &request) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mRequests.push_back(request);
+  mIssued += 1;
+}
+
+bool SFXQueue::Settle(uint64_t *cursor) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mResolved != mIssued) {
+    return false;
+  }
+  if (mEndFrame > *cursor) {
+    *cursor = mEndFrame;
+  }
+
+  return true;
+}
+
+void SFXQueue::Discard() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mIssued -= mRequests.size();
+  mRequests.clear();
+  mGeneration += 1;
+  mEndFrame = 0;
+  mSource->Stop();
+}
+
+bool SFXQueue::Take(SFXRequest *request, uint32_t *generation) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mRequests.empty()) {
+    return false;
+  }
+
+  *request = mRequests.front();
+  *generation = mGeneration;
+  mRequests.pop_front();
+
+  return true;
+}
+
+bool SFXQueue::Submit(const SFXRequest &request, const SFXWave *wave,
+                      uint32_t generation) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mGeneration != generation) {
+    wave = nullptr;
+  }
+  if (!mSource->Play(wave, request.Gain, request.Pan, request.StartFrame,
+                     request.PushTime)) {
+    return false;
+  }
+  if (wave != nullptr && mStats != nullptr) {
+    mStats->Record(LatencyStage::Feed, request.PushTime);
+  }
+  if (wave != nullptr && request.StartFrame + wave->Frames > mEndFrame) {
+    mEndFrame = request.StartFrame + wave->Frames;
+  }
+
+  mResolved += 1;
+
+  return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "latencystats.h"
+#include "sfxsource.h"
+
+// SFXRequest asks for a wave to be played at StartFrame on the mixer clock.
+struct SFXRequest {
+  int16_t SFXIndex = 0;
+  uint64_t StartFrame = 0;
+  float Gain = 1.0f;
+  float Pan = 0.0f;
+  uint64_t PushTime = 0;
+};
+
+// SFXQueue passes SFX requests from the command loop to the thread that
+// loads their waves and hands them to an SFXSource. It remembers where the
+// latest wave handed over ends, so that the command loop can start what
+// follows the waves once all their lengths are known.
+//
+// A request taken before Discard still reaches the source, but without a
+// wave, so that every request completes exactly once.
+class SFXQueue {
+public:
+  SFXQueue(SFXSource *source, LatencyStats *stats);
+
+  // Command loop side.
+  void Push(const SFXRequest &request);
+  // Returns false while some request pushed has not reached the source.
+  // Otherwise moves cursor to where the latest wave ends, if that is later.
+  bool Settle(uint64_t *cursor);
+  // Drops the queued requests and fades out the waves playing.
+  void Discard();
+
+  // Loader side.
+  bool Take(SFXRequest *request, uint32_t *generation);
+  // Plays wave for request, or nothing when the queue was discarded since
+  // the request was taken. wave may be nullptr. Returns false while the
+  // source is full.
+  bool Submit(const SFXRequest &request, const SFXWave *wave,
+              uint32_t generation);
+
+private:
+  SFXSource *mSource = nullptr;
+  LatencyStats *mStats = nullptr;
+
+  std::mutex mMutex;
+  std::deque<SFXRequest> mRequests;
+  uint32_t mGeneration = 0;
+  // Requests pushed that were not dropped, and those handed to the source.
+  uint64_t mIssued = 0;
+  uint64_t mResolved = 0;
+  uint64_t mEndFrame = 0;
+};
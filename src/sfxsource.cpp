@@ -0,0 +1,288 @@
+#include <cstring>
+
+#include "sfxsource.h"
+
+namespace {
+// Length of the fade applied to stopped and stolen voices.
+constexpr double stopFadeSeconds = 0.005;
+} // namespace
+
+SFXSource::SFXSource(SFXBank *bank, uint32_t maxVoices, StealPolicy policy)
+    : mBank(bank), mMaxVoices(maxVoices > 0 ? maxVoices : 1),
+      mPolicy(policy) {
+  mVoiceCount = mMaxVoices * 2;
+  mVoices = new Voice[mVoiceCount];
+}
+
+SFXSource::~SFXSource() {
+  delete[] mVoices;
+  mVoices = nullptr;
+}
+
+bool SFXSource::Play(const SFXWave *wave, float gain, float pan,
+                     uint64_t startFrame, uint64_t pushTime) {
+  Request request;
+
+  if (gain < 0.0f) {
+    gain = 0.0f;
+  }
+  if (pan < -1.0f) {
+    pan = -1.0f;
+  }
+  if (pan > 1.0f) {
+    pan = 1.0f;
+  }
+
+  // Balance rather than constant power, so that centered waves play at the
+  // level they were recorded at.
+  request.Wave = wave;
+  request.StartFrame = startFrame;
+  request.PushTime = pushTime;
+  request.Gain = gain;
+  request.LeftGain = pan > 0.0f ? gain * (1.0f - pan) : gain;
+  request.RightGain = pan < 0.0f ? gain * (1.0f + pan) : gain;
+
+  return push(request);
+}
+
+void SFXSource::Stop() {
+  uint64_t serial = mWriteIndex.load(std::memory_order_acquire);
+  uint64_t current = mStopSerial.load(std::memory_order_relaxed);
+
+  while (current < serial &&
+         !mStopSerial.compare_exchange_weak(current, serial,
+                                            std::memory_order_release)) {
+  }
+}
+
+uint32_t SFXSource::GetMaxVoices() const { return mMaxVoices; }
+
+uint64_t SFXSource::GetCompletedCount() const {
+  return mCompletedCount.load(std::memory_order_acquire);
+}
+
+uint64_t SFXSource::GetStolenCount() const {
+  return mStolenCount.load(std::memory_order_relaxed);
+}
+
+void SFXSource::SetLatencyStats(LatencyStats *stats) { mStats = stats; }
+
+void SFXSource::SetTargetSamplesPerSec(uint32_t samplesPerSec) {
+  mSamplesPerSec.store(samplesPerSec, std::memory_order_relaxed);
+
+  if (mBank != nullptr) {
+    mBank->SetSamplesPerSec(samplesPerSec);
+  }
+}
+
+void SFXSource::SetResampleQuality(ResampleQuality quality) {
+  if (mBank != nullptr) {
+    mBank->SetResampleQuality(quality);
+  }
+}
+
+int32_t SFXSource::Render(float *dst, uint64_t position, uint32_t frames,
+                          uint16_t channels) {
+  std::memset(dst, 0, sizeof(float) * frames * channels);
+
+  mIsSilent = true;
+
+  uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+  uint64_t r = mReadIndex.load(std::memory_order_relaxed);
+  uint64_t w = mWriteIndex.load(std::memory_order_acquire);
+  uint64_t stopSerial = mStopSerial.load(std::memory_order_acquire);
+  int32_t completions{0};
+
+  for (; r < w; r++) {
+    const Request &request = mRequests[r % RequestCapacity];
+
+    if (r < stopSerial) {
+      completions += 1;
+      continue;
+    }
+
+    completions += start(request, r);
+  }
+
+  mReadIndex.store(r, std::memory_order_release);
+
+  float fadeStep = static_cast<float>(1.0 / (stopFadeSeconds * samplesPerSec));
+
+  for (uint32_t i = 0; i < mVoiceCount; i++) {
+    Voice &voice = mVoices[i];
+
+    if (!voice.IsActive) {
+      continue;
+    }
+    if (voice.Serial < stopSerial) {
+      voice.IsReleasing = true;
+    }
+
+    completions += mixVoice(voice, dst, position, frames, channels, fadeStep);
+  }
+
+  mCompletedCount.fetch_add(static_cast<uint64_t>(completions),
+                            std::memory_order_release);
+
+  return completions;
+}
+
+bool SFXSource::IsSilent() const { return mIsSilent; }
+
+bool SFXSource::push(const Request &request) {
+  uint64_t w = mWriteIndex.load(std::memory_order_relaxed);
+  uint64_t r = mReadIndex.load(std::memory_order_acquire);
+
+  if (w - r >= RequestCapacity) {
+    return false;
+  }
+
+  mRequests[w % RequestCapacity] = request;
+  mWriteIndex.store(w + 1, std::memory_order_release);
+
+  return true;
+}
+
+// Returns the number of requests that completed while making room.
+int32_t SFXSource::start(const Request &request, uint64_t serial) {
+  if (request.Wave == nullptr || request.Wave->Frames == 0) {
+    return 1;
+  }
+
+  int32_t completions{0};
+  Voice *voice = findVoice(&completions);
+
+  voice->IsActive = true;
+  voice->IsReleasing = false;
+  voice->IsHeard = false;
+  voice->Wave = request.Wave;
+  voice->Serial = serial;
+  voice->StartFrame = request.StartFrame;
+  voice->Position = 0;
+  voice->PushTime = request.PushTime;
+  voice->Gain = request.Gain;
+  voice->LeftGain = request.LeftGain;
+  voice->RightGain = request.RightGain;
+  voice->Fade = 1.0f;
+
+  return completions;
+}
+
+// Returns a free voice. When maxVoices are playing, one of them is stolen and
+// left to fade out. When every voice is busy fading, the one closest to
+// silence is cut.
+SFXSource::Voice *SFXSource::findVoice(int32_t *completions) {
+  Voice *idle{nullptr};
+  Voice *victim{nullptr};
+  Voice *quietest{nullptr};
+  uint32_t playing{0};
+
+  for (uint32_t i = 0; i < mVoiceCount; i++) {
+    Voice &voice = mVoices[i];
+
+    if (!voice.IsActive) {
+      idle = idle == nullptr ? &voice : idle;
+      continue;
+    }
+    if (voice.IsReleasing) {
+      if (quietest == nullptr || voice.Fade < quietest->Fade) {
+        quietest = &voice;
+      }
+      continue;
+    }
+
+    playing += 1;
+
+    if (victim == nullptr) {
+      victim = &voice;
+    } else if (mPolicy == StealPolicy::Quietest &&
+               voice.Gain != victim->Gain) {
+      victim = voice.Gain < victim->Gain ? &voice : victim;
+    } else if (voice.Serial < victim->Serial) {
+      victim = &voice;
+    }
+  }
+  if (playing >= mMaxVoices) {
+    victim->IsReleasing = true;
+    mStolenCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (idle != nullptr) {
+    return idle;
+  }
+  // With at most maxVoices playing, at least maxVoices are fading here.
+  quietest->IsActive = false;
+  *completions += 1;
+
+  return quietest;
+}
+
+// Adds the next frames of voice to dst. Returns 1 when the voice ended.
+int32_t SFXSource::mixVoice(Voice &voice, float *dst, uint64_t position,
+                            uint32_t frames, uint16_t channels,
+                            float fadeStep) {
+  const SFXWave *wave = voice.Wave;
+  uint32_t i{0};
+
+  // Voices stopped before they start end without a sound.
+  if (voice.StartFrame > position && voice.IsReleasing) {
+    voice.IsActive = false;
+    return 1;
+  }
+  if (voice.StartFrame > position) {
+    if (voice.StartFrame - position >= frames) {
+      return 0;
+    }
+
+    i = static_cast<uint32_t>(voice.StartFrame - position);
+  }
+
+  uint32_t first = i;
+
+  for (; i < frames && voice.Position < wave->Frames; i++) {
+    float fade{1.0f};
+
+    if (voice.IsReleasing) {
+      if (voice.Fade <= 0.0f) {
+        break;
+      }
+
+      fade = voice.Fade;
+      voice.Fade -= fadeStep;
+    }
+
+    const float *frame = wave->Samples + voice.Position * wave->Channels;
+    float left = frame[0] * voice.LeftGain * fade;
+    float right = frame[wave->Channels - 1] * voice.RightGain * fade;
+    float *out = dst + i * channels;
+
+    if (!voice.IsHeard && (left != 0.0f || right != 0.0f)) {
+      voice.IsHeard = true;
+
+      if (mStats != nullptr) {
+        uint32_t samplesPerSec = mSamplesPerSec.load(std::memory_order_relaxed);
+
+        mStats->Record(LatencyStage::FirstSample, voice.PushTime,
+                       mStats->Now() + i * 1000000000ull / samplesPerSec);
+      }
+    }
+    if (channels == 1) {
+      out[0] += 0.5f * (left + right);
+    } else {
+      out[0] += left;
+      out[1] += right;
+    }
+
+    voice.Position += 1;
+  }
+
+  mIsSilent = mIsSilent && i == first;
+
+  if (voice.Position < wave->Frames &&
+      !(voice.IsReleasing && voice.Fade <= 0.0f)) {
+    return 0;
+  }
+
+  voice.IsActive = false;
+
+  return 1;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "latencystats.h"
+#include "mixer.h"
+#include "sfxbank.h"
+
+// Decides which voice makes room when a wave is played while every voice is
+// busy.
+enum class StealPolicy {
+  // The voice that started first.
+  Oldest,
+  // The voice with the lowest gain, the oldest of them on ties.
+  Quietest
+};
+
+// SFXSource mixes up to maxVoices sound effects at once, each with its own
+// gain and pan. Play is called from one control thread and queues a request
+// that the render thread picks up at the start of its next block; the wave
+// starts on the requested mixer frame. Every request completes exactly once:
+// when its wave ends, when it is stopped or stolen and the fade is done, or
+// straight away when the wave could not be loaded.
+//
+// All voices are allocated up front; Render never allocates.
+class SFXSource : public MixerSource {
+public:
+  SFXSource(SFXBank *bank, uint32_t maxVoices, StealPolicy policy);
+  ~SFXSource();
+
+  // wave may be nullptr, which completes without playing anything. pan runs
+  // from -1 (left) to 1 (right). The wave starts at startFrame on the mixer
+  // clock, or right away when that frame has passed. pushTime is when the
+  // command behind it was pushed, for the latency stats. Returns false when
+  // too many requests are waiting for the render thread.
+  bool Play(const SFXWave *wave, float gain, float pan,
+            uint64_t startFrame = 0, uint64_t pushTime = 0);
+  // Fades out every request made so far. Safe to call from any thread.
+  void Stop() override;
+
+  uint32_t GetMaxVoices() const;
+  uint64_t GetCompletedCount() const;
+  uint64_t GetStolenCount() const;
+  // Records when each wave first renders a sample that is not silent. Set
+  // before rendering starts.
+  void SetLatencyStats(LatencyStats *stats);
+
+  void SetTargetSamplesPerSec(uint32_t samplesPerSec) override;
+  // Waves are converted once, when the bank decodes them.
+  void SetResampleQuality(ResampleQuality quality) override;
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override;
+  bool IsSilent() const override;
+
+private:
+  static constexpr uint32_t RequestCapacity = 64;
+
+  struct Request {
+    const SFXWave *Wave = nullptr;
+    uint64_t StartFrame = 0;
+    uint64_t PushTime = 0;
+    float Gain = 1.0f;
+    float LeftGain = 1.0f;
+    float RightGain = 1.0f;
+  };
+
+  struct Voice {
+    bool IsActive = false;
+    bool IsReleasing = false;
+    bool IsHeard = false;
+    const SFXWave *Wave = nullptr;
+    uint64_t Serial = 0;
+    uint64_t StartFrame = 0;
+    uint64_t Position = 0;
+    uint64_t PushTime = 0;
+    float Gain = 1.0f;
+    float LeftGain = 1.0f;
+    float RightGain = 1.0f;
+    float Fade = 1.0f;
+  };
+
+  bool push(const Request &request);
+  int32_t start(const Request &request, uint64_t serial);
+  Voice *findVoice(int32_t *completions);
+  int32_t mixVoice(Voice &voice, float *dst, uint64_t position,
+                   uint32_t frames, uint16_t channels, float fadeStep);
+
+  SFXBank *mBank = nullptr;
+  uint32_t mMaxVoices = 0;
+  StealPolicy mPolicy = StealPolicy::Oldest;
+  LatencyStats *mStats = nullptr;
+  std::atomic<uint32_t> mSamplesPerSec{48000};
+
+  Request mRequests[RequestCapacity];
+  std::atomic<uint64_t> mWriteIndex{0};
+  std::atomic<uint64_t> mReadIndex{0};
+  // Requests with a smaller serial are stopped.
+  std::atomic<uint64_t> mStopSerial{0};
+
+  std::atomic<uint64_t> mCompletedCount{0};
+  std::atomic<uint64_t> mStolenCount{0};
+
+  // Owned by the render thread. Twice maxVoices, so that stolen voices can
+  // fade out while the voices replacing them start.
+  Voice *mVoices = nullptr;
+  uint32_t mVoiceCount = 0;
+  bool mIsSilent = true;
+};
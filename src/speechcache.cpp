@@ -0,0 +1,112 @@
+#include <cstring>
+
+#include "speechcache.h"
+
+SpeechCache::SpeechCache(uint64_t budgetBytes) : mBudget(budgetBytes) {}
+
+void SpeechCache::MakeKey(bool isSSML, const wchar_t *text, uint32_t length,
+                          const VoiceSettings &voice, std::wstring *key) {
+  double prosody[3] = {voice.SpeakingRate, voice.AudioPitch,
+                       voice.AudioVolume};
+  constexpr size_t bitsLength = 3 * sizeof(double) / sizeof(wchar_t);
+  wchar_t bits[bitsLength];
+
+  std::memcpy(bits, prosody, sizeof(prosody));
+
+  key->assign(1, isSSML ? L'S' : L'T');
+
+  if (voice.VoiceId != nullptr) {
+    key->append(voice.VoiceId);
+  }
+
+  key->push_back(L'\0');
+  key->append(bits, bitsLength);
+  key->append(text, length);
+}
+
+SpeechWave SpeechCache::Find(const std::wstring &key) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  auto found = mIndex.find(key);
+
+  if (found == mIndex.end()) {
+    mMissCount += 1;
+    return nullptr;
+  }
+
+  mHitCount += 1;
+  mEntries.splice(mEntries.begin(), mEntries, found->second);
+
+  return found->second->Wave;
+}
+
+void SpeechCache::Insert(const std::wstring &key, const SpeechWave &wave) {
+  uint64_t size = wave->size() + key.size() * sizeof(wchar_t);
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (size > mBudget) {
+    return;
+  }
+
+  auto found = mIndex.find(key);
+
+  if (found != mIndex.end()) {
+    mSize -= found->second->Size;
+    mEntries.erase(found->second);
+    mIndex.erase(found);
+  }
+
+  mEntries.push_front(Entry{key, wave, size});
+  mIndex.emplace(key, mEntries.begin());
+  mSize += size;
+
+  evict();
+}
+
+void SpeechCache::Clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mEntries.clear();
+  mIndex.clear();
+  mSize = 0;
+}
+
+void SpeechCache::evict() {
+  while (mSize > mBudget && !mEntries.empty()) {
+    mSize -= mEntries.back().Size;
+    mIndex.erase(mEntries.back().Key);
+    mEntries.pop_back();
+  }
+}
+
+void SpeechCache::SetBudget(uint64_t budgetBytes) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mBudget = budgetBytes;
+  evict();
+}
+
+uint64_t SpeechCache::GetBudget() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mBudget;
+}
+
+uint64_t SpeechCache::GetSize() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mSize;
+}
+
+uint64_t SpeechCache::GetHitCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mHitCount;
+}
+
+uint64_t SpeechCache::GetMissCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mMissCount;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "synthesizer.h"
+
+typedef std::shared_ptr<std::vector<char>> SpeechWave;
+
+// SpeechCache keeps synthesized waves keyed by text and voice settings and
+// evicts the least recently used ones to stay within a byte budget. It is
+// safe to use from several threads.
+class SpeechCache {
+public:
+  SpeechCache(uint64_t budgetBytes);
+
+  static void MakeKey(bool isSSML, const wchar_t *text, uint32_t length,
+                      const VoiceSettings &voice, std::wstring *key);
+
+  // Returns nullptr on a miss. The wave stays valid while it is referenced,
+  // even if it is evicted.
+  SpeechWave Find(const std::wstring &key);
+  void Insert(const std::wstring &key, const SpeechWave &wave);
+  void Clear();
+
+  void SetBudget(uint64_t budgetBytes);
+  uint64_t GetBudget() const;
+  uint64_t GetSize() const;
+  uint64_t GetHitCount() const;
+  uint64_t GetMissCount() const;
+
+private:
+  struct Entry {
+    std::wstring Key;
+    SpeechWave Wave;
+    uint64_t Size = 0;
+  };
+
+  void evict();
+
+  std::list<Entry> mEntries;
+  std::unordered_map<std::wstring, std::list<Entry>::iterator> mIndex;
+  uint64_t mBudget = 0;
+  uint64_t mSize = 0;
+  uint64_t mHitCount = 0;
+  uint64_t mMissCount = 0;
+  mutable std::mutex mMutex;
+};
@@ -0,0 +1,248 @@
+#include <cstring>
+
+#include "speechpipeline.h"
+
+// JobWriter appends synthesized pieces to a running job.
+class SpeechPipeline::JobWriter : public SpeechWriter {
+public:
+  JobWriter(SpeechPipeline *pipeline, Job *job, SpeechProgress progress,
+            void *context)
+      : mPipeline(pipeline), mJob(job), mProgress(progress),
+        mContext(context) {}
+
+  void Write(const char *data, size_t length) override {
+    {
+      std::lock_guard<std::mutex> lock(mPipeline->mMutex);
+
+      mJob->Wave->insert(mJob->Wave->end(), data, data + length);
+    }
+    if (mProgress != nullptr) {
+      mProgress(mContext);
+    }
+  }
+
+private:
+  SpeechPipeline *mPipeline = nullptr;
+  Job *mJob = nullptr;
+  SpeechProgress mProgress = nullptr;
+  void *mContext = nullptr;
+};
+
+SpeechPipeline::SpeechPipeline(uint32_t depth, SpeechCache *cache)
+    : mCache(cache), mDepth(depth > 0 ? depth : 1) {
+  mJobs = new Job[mDepth + 1];
+  mQueue = new Job *[mDepth]{};
+}
+
+SpeechPipeline::~SpeechPipeline() {
+  delete[] mQueue;
+  mQueue = nullptr;
+
+  delete[] mJobs;
+  mJobs = nullptr;
+}
+
+void SpeechPipeline::SetLatencyStats(LatencyStats *stats) { mStats = stats; }
+
+bool SpeechPipeline::Submit(bool isSSML, TextArena *arena,
+                            const TextSpan &text, const VoiceSettings &voice,
+                            uint64_t pushTime) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mCount == mDepth) {
+    return false;
+  }
+
+  Job *job{nullptr};
+
+  // With at most one job running, a free one always exists here.
+  for (uint32_t i = 0; i <= mDepth && job == nullptr; i++) {
+    if (mJobs[i].State == JobState::Free) {
+      job = &mJobs[i];
+    }
+  }
+
+  job->State = JobState::Queued;
+  job->IsSSML = isSSML;
+  job->Arena = arena;
+  job->Text = text;
+  job->Voice = voice;
+  job->Wave = nullptr;
+  job->PushTime = pushTime;
+
+  if (mCache != nullptr) {
+    const wchar_t *s = arena != nullptr ? arena->Resolve(text) : L"";
+
+    SpeechCache::MakeKey(isSSML, s, text.Length, voice, &job->Key);
+    job->Wave = mCache->Find(job->Key);
+  }
+  if (job->Wave != nullptr) {
+    job->State = JobState::Done;
+    release(job);
+  }
+
+  mQueue[(mFront + mCount) % mDepth] = job;
+  mCount += 1;
+
+  return true;
+}
+
+bool SpeechPipeline::IsFull() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mCount == mDepth;
+}
+
+SpeechState SpeechPipeline::GetFrontState() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mCount == 0) {
+    return SpeechState::Empty;
+  }
+
+  const Job &job = *mQueue[mFront];
+
+  if (job.Wave != nullptr && !job.Wave->empty()) {
+    return SpeechState::Ready;
+  }
+
+  return job.State == JobState::Done ? SpeechState::Failed
+                                     : SpeechState::Pending;
+}
+
+uint32_t SpeechPipeline::ReadFront(uint64_t offset, char *dst,
+                                   uint32_t length, bool *isComplete) const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  *isComplete = false;
+
+  if (mCount == 0 || mQueue[mFront]->Wave == nullptr) {
+    return 0;
+  }
+
+  const Job &job = *mQueue[mFront];
+  uint64_t size = job.Wave->size();
+  uint32_t n{0};
+
+  if (offset < size) {
+    n = size - offset < length ? static_cast<uint32_t>(size - offset)
+                               : length;
+    std::memcpy(dst, job.Wave->data() + offset, n);
+  }
+
+  *isComplete = job.State == JobState::Done && offset + n >= size;
+
+  return n;
+}
+
+void SpeechPipeline::discard(Job *job) {
+  if (job->State == JobState::Running) {
+    job->State = JobState::Discarded;
+  } else {
+    job->State = JobState::Free;
+    job->Wave = nullptr;
+    release(job);
+  }
+}
+
+void SpeechPipeline::release(Job *job) {
+  if (job->Arena != nullptr) {
+    job->Arena->Release(job->Text);
+    job->Arena = nullptr;
+  }
+}
+
+void SpeechPipeline::PopFront() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mCount == 0) {
+    return;
+  }
+
+  discard(mQueue[mFront]);
+
+  mFront = (mFront + 1) % mDepth;
+  mCount -= 1;
+}
+
+void SpeechPipeline::Cancel() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  for (uint32_t i = 0; i < mCount; i++) {
+    discard(mQueue[(mFront + i) % mDepth]);
+  }
+
+  mCancelledCount += mCount;
+  mFront = (mFront + mCount) % mDepth;
+  mCount = 0;
+}
+
+bool SpeechPipeline::ProcessNext(Synthesizer *synthesizer,
+                                 SpeechProgress progress, void *context) {
+  Job *job{nullptr};
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (uint32_t i = 0; i < mCount; i++) {
+      Job &candidate = *mQueue[(mFront + i) % mDepth];
+
+      if (candidate.State == JobState::Queued) {
+        candidate.State = JobState::Running;
+        candidate.Wave = std::make_shared<std::vector<char>>();
+        job = &candidate;
+        break;
+      }
+    }
+  }
+  if (job == nullptr) {
+    return false;
+  }
+  if (mStats != nullptr) {
+    mStats->Record(LatencyStage::SynthesisStart, job->PushTime);
+  }
+
+  // The command loop leaves the text of a running job alone, so it is read
+  // without holding the lock.
+  JobWriter writer(this, job, progress, context);
+  const wchar_t *text =
+      job->Arena != nullptr ? job->Arena->Resolve(job->Text) : L"";
+  bool succeeded =
+      synthesizer->Synthesize(job->IsSSML, text, job->Voice, &writer);
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    release(job);
+
+    if (job->State == JobState::Discarded) {
+      job->State = JobState::Free;
+      job->Wave = nullptr;
+      return true;
+    }
+    if (succeeded && mCache != nullptr) {
+      mCache->Insert(job->Key, job->Wave);
+    }
+    if (succeeded && mStats != nullptr) {
+      mStats->Record(LatencyStage::SynthesisEnd, job->PushTime);
+    }
+    if (!succeeded) {
+      job->Wave->clear();
+    }
+
+    job->State = JobState::Done;
+  }
+  if (progress != nullptr) {
+    progress(context);
+  }
+
+  return true;
+}
+
+uint32_t SpeechPipeline::GetDepth() const { return mDepth; }
+
+uint64_t SpeechPipeline::GetCancelledCount() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return mCancelledCount;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "latencystats.h"
+#include "speechcache.h"
+#include "synthesizer.h"
+#include "textarena.h"
+
+enum class SpeechState { Empty, Pending, Ready, Failed };
+
+typedef void (*SpeechProgress)(void *context);
+
+// SpeechPipeline holds up to depth utterances that are synthesized ahead of
+// playback. The command loop submits jobs and takes results in submission
+// order; a worker thread calls ProcessNext to synthesize them. With a cache,
+// utterances synthesized before are ready as soon as they are submitted.
+//
+// Results are readable while they are still being synthesized, so playback
+// can start with the first piece.
+class SpeechPipeline {
+public:
+  SpeechPipeline(uint32_t depth, SpeechCache *cache);
+  ~SpeechPipeline();
+
+  // Records when synthesis starts and ends. Set before the worker starts.
+  void SetLatencyStats(LatencyStats *stats);
+
+  // Command loop side. The text is read in place from the arena it was
+  // allocated in, and released once the job is done with it: when the
+  // result is found in the cache, synthesized or dropped. A job without text
+  // has no arena. When Submit fails the caller keeps the text. pushTime is
+  // when the command was pushed, for the latency stats.
+  bool Submit(bool isSSML, TextArena *arena, const TextSpan &text,
+              const VoiceSettings &voice, uint64_t pushTime = 0);
+  bool IsFull() const;
+  // Ready means some of the front wave can be read.
+  SpeechState GetFrontState() const;
+  // Copies up to length bytes of the front wave starting at offset and
+  // returns how many were copied. isComplete is set once offset reaches the
+  // end of a wave that is fully synthesized.
+  uint32_t ReadFront(uint64_t offset, char *dst, uint32_t length,
+                     bool *isComplete) const;
+  // Removes the front job, discarding it if it is still being synthesized.
+  void PopFront();
+  // Drops every job. A job being synthesized is discarded when it finishes.
+  void Cancel();
+
+  // Worker side. Synthesizes the oldest queued job and returns false when
+  // there was none. progress is called whenever more of it can be read.
+  bool ProcessNext(Synthesizer *synthesizer, SpeechProgress progress,
+                   void *context);
+
+  uint32_t GetDepth() const;
+  uint64_t GetCancelledCount() const;
+
+private:
+  enum class JobState { Free, Queued, Running, Discarded, Done };
+
+  struct Job {
+    JobState State = JobState::Free;
+    bool IsSSML = false;
+    // Set while the job holds its text.
+    TextArena *Arena = nullptr;
+    TextSpan Text;
+    std::wstring Key;
+    VoiceSettings Voice;
+    SpeechWave Wave;
+    uint64_t PushTime = 0;
+  };
+
+  class JobWriter;
+
+  void discard(Job *job);
+  void release(Job *job);
+
+  // One job more than the depth, so a job discarded while the worker is
+  // synthesizing it never blocks a submit.
+  Job *mJobs = nullptr;
+  Job **mQueue = nullptr;
+  SpeechCache *mCache = nullptr;
+  LatencyStats *mStats = nullptr;
+  uint32_t mDepth = 0;
+  uint32_t mFront = 0;
+  uint32_t mCount = 0;
+  uint64_t mCancelledCount = 0;
+  mutable std::mutex mMutex;
+};
@@ -0,0 +1,42 @@
+#include "streamperiod.h"
+
+uint32_t ChoosePeriodFrames(LatencyMode mode, const EnginePeriod &period) {
+  if (mode != LatencyMode::Low || period.MinFrames == 0 ||
+      period.MinFrames >= period.DefaultFrames) {
+    return 0;
+  }
+
+  uint32_t frames = period.MinFrames;
+
+  // The period must be a multiple of the fundamental period.
+  if (period.FundamentalFrames > 0 && frames % period.FundamentalFrames != 0) {
+    frames += period.FundamentalFrames - frames % period.FundamentalFrames;
+  }
+  // No multiple lies between the smallest and the largest period.
+  if (period.MaxFrames > 0 && frames > period.MaxFrames) {
+    return 0;
+  }
+  if (frames >= period.DefaultFrames) {
+    return 0;
+  }
+
+  return frames;
+}
+
+bool OpenSharedStream(SharedStreamClient *client, LatencyMode mode,
+                      uint32_t *periodFrames) {
+  EnginePeriod period;
+
+  *periodFrames = 0;
+
+  if (mode == LatencyMode::Low && client->GetSharedModeEnginePeriod(&period)) {
+    uint32_t frames = ChoosePeriodFrames(mode, period);
+
+    if (frames > 0 && client->InitializeSharedAudioStream(frames)) {
+      *periodFrames = frames;
+      return true;
+    }
+  }
+
+  return client->InitializeDefault();
+}
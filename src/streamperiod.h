@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+enum class LatencyMode : int32_t { Default = 0, Low = 1 };
+
+struct EnginePeriod {
+  uint32_t DefaultFrames = 0;
+  uint32_t FundamentalFrames = 0;
+  uint32_t MinFrames = 0;
+  uint32_t MaxFrames = 0;
+};
+
+// SharedStreamClient covers the shared-mode initialization calls of
+// IAudioClient3, so period negotiation can run against a fake client.
+class SharedStreamClient {
+public:
+  virtual ~SharedStreamClient() {}
+
+  // Fails when the client is a plain IAudioClient, which only has the
+  // default initialization.
+  virtual bool GetSharedModeEnginePeriod(EnginePeriod *period) = 0;
+  virtual bool InitializeSharedAudioStream(uint32_t periodFrames) = 0;
+  virtual bool InitializeDefault() = 0;
+};
+
+// Returns the period to request for mode, or 0 when the default
+// initialization should be used. The period is the smallest the engine
+// allows, rounded up to a multiple of the fundamental period, as long as it
+// stays within the largest one and below the default one.
+uint32_t ChoosePeriodFrames(LatencyMode mode, const EnginePeriod &period);
+
+// Initializes the client for mode. When the engine rejects the low latency
+// period the stream falls back to the default one. periodFrames receives the
+// requested period, or 0 for the default.
+bool OpenSharedStream(SharedStreamClient *client, LatencyMode mode,
+                      uint32_t *periodFrames);
@@ -0,0 +1,379 @@
+#include <cstring>
+
+#include "streamsource.h"
+#include "voicesettings.h"
+#include "waveheader.h"
+
+namespace {
+// Length of the fade applied by Stop.
+constexpr double stopFadeSeconds = 0.005;
+// Streams at higher rates are time stretched with shorter windows.
+constexpr uint32_t maxStretchSamplesPerSec = 48000;
+
+// The stream is stretched by rate / pitch, which must not be clamped again.
+static_assert(VoiceProsody::MinSpeakingRate / VoiceProsody::MaxAudioPitch >=
+                  TimeStretch::MinTempo,
+              "slowest tempo is out of range");
+static_assert(VoiceProsody::MaxSpeakingRate / VoiceProsody::MinAudioPitch <=
+                  TimeStretch::MaxTempo,
+              "fastest tempo is out of range");
+
+double clamp(double value, double low, double high) {
+  return value < low ? low : value > high ? high : value;
+}
+} // namespace
+
+StreamSource::StreamSource(uint32_t capacity)
+    : mStretch(maxStretchSamplesPerSec) {
+  mCapacity = 1;
+
+  while (mCapacity < capacity) {
+    mCapacity <<= 1;
+  }
+
+  mMask = mCapacity - 1;
+  mData = new uint8_t[mCapacity]{};
+}
+
+StreamSource::~StreamSource() {
+  delete[] mData;
+  mData = nullptr;
+}
+
+bool StreamSource::IsIdle() const {
+  return !mIsPlaying.load(std::memory_order_acquire);
+}
+
+bool StreamSource::Begin(const StreamFormat &format, uint64_t startFrame,
+                         uint64_t pushTime) {
+  if (!IsIdle() || BytesPerFrame(format) == 0) {
+    return false;
+  }
+
+  mFormat = format;
+  mBytesPerFrame = BytesPerFrame(format);
+  mStartFrame = startFrame;
+  mPushTime = pushTime;
+  // Looked up here, since building a table allocates.
+  mTable = ResampleTable::Find(
+      format.SamplesPerSec,
+      mTargetSamplesPerSec.load(std::memory_order_relaxed),
+      mQuality.load(std::memory_order_relaxed));
+
+  // A producer that was stopped may have written after its stream
+  // finished. The render thread leaves the indices alone while idle.
+  mReadIndex.store(mWriteIndex.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+  mIsEnded.store(false, std::memory_order_relaxed);
+  mIsStopping.store(false, std::memory_order_relaxed);
+  mIsPlaying.store(true, std::memory_order_release);
+
+  return true;
+}
+
+uint32_t StreamSource::Write(const char *data, uint32_t length) {
+  uint64_t w = mWriteIndex.load(std::memory_order_relaxed);
+  uint32_t writable = GetWritableBytes();
+  uint32_t n = length < writable ? length : writable;
+  uint32_t offset = static_cast<uint32_t>(w & mMask);
+  uint32_t head = mCapacity - offset < n ? mCapacity - offset : n;
+
+  std::memcpy(mData + offset, data, head);
+  std::memcpy(mData, data + head, n - head);
+
+  mWriteIndex.store(w + n, std::memory_order_release);
+
+  return n;
+}
+
+uint32_t StreamSource::GetWritableBytes() const {
+  uint64_t queued = mWriteIndex.load(std::memory_order_relaxed) -
+                    mReadIndex.load(std::memory_order_acquire);
+
+  return mCapacity - static_cast<uint32_t>(queued);
+}
+
+void StreamSource::End() { mIsEnded.store(true, std::memory_order_release); }
+
+void StreamSource::Stop() {
+  if (!IsIdle()) {
+    mIsStopping.store(true, std::memory_order_release);
+  }
+}
+
+void StreamSource::SetLowWatermark(uint32_t bytes, StreamNotify notify,
+                                   void *context) {
+  mLowWatermark = bytes;
+  mNotify = notify;
+  mNotifyContext = context;
+}
+
+void StreamSource::SetLatencyStats(LatencyStats *stats) { mStats = stats; }
+
+void StreamSource::SetProsody(double rate, double pitch) {
+  mRate.store(rate, std::memory_order_relaxed);
+  mPitch.store(pitch, std::memory_order_relaxed);
+}
+
+void StreamSource::SetTargetSamplesPerSec(uint32_t samplesPerSec) {
+  mTargetSamplesPerSec.store(samplesPerSec, std::memory_order_relaxed);
+}
+
+void StreamSource::SetResampleQuality(ResampleQuality quality) {
+  mQuality.store(quality, std::memory_order_relaxed);
+}
+
+bool StreamSource::readFrame(uint64_t *readIndex, float *frame) {
+  uint64_t w = mWriteIndex.load(std::memory_order_acquire);
+
+  if (w - *readIndex < mBytesPerFrame) {
+    return false;
+  }
+
+  uint32_t bytesPerSample = BytesPerSample(mFormat.Format);
+  uint8_t sample[4]{};
+
+  for (uint16_t c = 0; c < mFormat.Channels; c++) {
+    for (uint32_t b = 0; b < bytesPerSample; b++) {
+      sample[b] = mData[(*readIndex + c * bytesPerSample + b) & mMask];
+    }
+    // Only the first two source channels are played.
+    if (c < 2) {
+      frame[c] = DecodeSample(mFormat.Format, sample);
+    }
+  }
+  if (mFormat.Channels == 1) {
+    frame[1] = frame[0];
+  }
+
+  *readIndex += mBytesPerFrame;
+
+  return true;
+}
+
+// Reads the next frame through the time stretch. Once the producer has
+// ended the stream and the buffer is dry, the stretch is flushed.
+bool StreamSource::nextFrame(uint64_t *readIndex, float *frame,
+                             bool isEnded) {
+  while (!mStretch.Read(frame)) {
+    float input[2]{};
+
+    if (mStretch.IsDrained()) {
+      return false;
+    }
+    if (readFrame(readIndex, input)) {
+      if (!mStretch.Write(input)) {
+        return false;
+      }
+
+      continue;
+    }
+    if (!isEnded) {
+      return false;
+    }
+
+    mStretch.End();
+  }
+
+  return true;
+}
+
+void StreamSource::pushHistory(const float *frame) {
+  for (int c = 0; c < 2; c++) {
+    mHistory[c][mHistoryIndex] = frame[c];
+    mHistory[c][mHistoryIndex + mTaps] = frame[c];
+  }
+
+  mHistoryIndex = mHistoryIndex + 1 < mTaps ? mHistoryIndex + 1 : 0;
+}
+
+int32_t StreamSource::Render(float *dst, uint64_t position, uint32_t frames,
+                             uint16_t channels) {
+  std::memset(dst, 0, sizeof(float) * frames * channels);
+
+  mIsSilent = true;
+
+  if (!mIsPlaying.load(std::memory_order_acquire)) {
+    return 0;
+  }
+
+  uint32_t target = mTargetSamplesPerSec.load(std::memory_order_relaxed);
+
+  if (!mIsRendering) {
+    mIsRendering = true;
+    mIsArmed = true;
+    mFilter = mTable;
+
+    // The device rate changed since Begin.
+    if (mFilter != nullptr &&
+        (mFilter->GetSrcRate() != mFormat.SamplesPerSec ||
+         mFilter->GetDstRate() != target)) {
+      mFilter = nullptr;
+    }
+
+    mTaps = mFilter != nullptr ? mFilter->GetTaps() : 2;
+    mHistoryIndex = 0;
+    std::memset(mHistory, 0, sizeof(mHistory));
+    // Frames are read up front until the first one reaches the middle of the
+    // window, so the first output frame is the first frame of
+    // the stream rather than silence.
+    mPosition = mTaps / 2 + 1.0;
+    mDrainCount = 0;
+    mFade = 1.0f;
+    mIsHeard = false;
+    mStretch.Reset(mFormat.SamplesPerSec);
+  }
+  double rate = mRate.load(std::memory_order_relaxed);
+  double pitch = mPitch.load(std::memory_order_relaxed);
+
+  rate = clamp(rate, VoiceProsody::MinSpeakingRate,
+               VoiceProsody::MaxSpeakingRate);
+  pitch =
+      clamp(pitch, VoiceProsody::MinAudioPitch, VoiceProsody::MaxAudioPitch);
+
+  mStretch.SetTempo(rate / pitch);
+  mStep = static_cast<double>(mFormat.SamplesPerSec) / target * pitch;
+
+  bool isStopping = mIsStopping.load(std::memory_order_acquire);
+  float fadeStep = static_cast<float>(1.0 / (stopFadeSeconds * target));
+  uint64_t r = mReadIndex.load(std::memory_order_relaxed);
+  bool isFinished{false};
+  bool isStarved{false};
+  uint32_t i{0};
+
+  // A stream stopped before its start frame finishes without a sound.
+  if (mStartFrame > position && isStopping) {
+    isFinished = true;
+  } else if (mStartFrame > position) {
+    if (mStartFrame - position >= frames) {
+      return 0;
+    }
+
+    i = static_cast<uint32_t>(mStartFrame - position);
+  }
+
+  uint32_t first = i;
+
+  for (; i < frames && !isFinished && !isStarved; i++) {
+    while (mPosition >= 1.0) {
+      float next[2]{};
+
+      if (!nextFrame(&r, next, false)) {
+        // A stopped stream does not wait for data that may never come: it
+        // holds the newest frame and fades out from it.
+        if (isStopping) {
+          next[0] = mHistory[0][mHistoryIndex + mTaps - 1];
+          next[1] = mHistory[1][mHistoryIndex + mTaps - 1];
+          pushHistory(next);
+          mPosition -= 1.0;
+          continue;
+        }
+        if (!mIsEnded.load(std::memory_order_acquire)) {
+          isStarved = true;
+          break;
+        }
+        // End is set after the last write, so look once more before
+        // finishing. Silence follows until the last frame has passed the
+        // middle of the window, so that it is played too.
+        if (!nextFrame(&r, next, true)) {
+          if (mDrainCount == mTaps / 2) {
+            isFinished = true;
+            break;
+          }
+
+          mDrainCount += 1;
+        }
+      }
+
+      pushHistory(next);
+      mPosition -= 1.0;
+    }
+    if (isFinished || isStarved) {
+      break;
+    }
+
+    const float *lefts = mHistory[0] + mHistoryIndex;
+    const float *rights = mHistory[1] + mHistoryIndex;
+    float left{};
+    float right{};
+
+    if (mFilter != nullptr) {
+      const float *coefficients = mFilter->GetPhase(mPosition);
+
+      left = DotProduct(lefts, coefficients, mTaps);
+      right = DotProduct(rights, coefficients, mTaps);
+    } else {
+      float t = static_cast<float>(mPosition);
+
+      left = lefts[0] + (lefts[1] - lefts[0]) * t;
+      right = rights[0] + (rights[1] - rights[0]) * t;
+    }
+
+    if (isStopping) {
+      left *= mFade;
+      right *= mFade;
+      mFade -= fadeStep;
+      isFinished = mFade <= 0.0f;
+    }
+
+    if (!mIsHeard && (left != 0.0f || right != 0.0f)) {
+      mIsHeard = true;
+
+      if (mStats != nullptr) {
+        mStats->Record(LatencyStage::FirstSample, mPushTime,
+                       mStats->Now() + i * 1000000000ull / target);
+      }
+    }
+
+    float *frame = dst + i * channels;
+
+    if (channels == 1) {
+      frame[0] = 0.5f * (left + right);
+    } else {
+      frame[0] = left;
+      frame[1] = right;
+    }
+
+    mPosition += mStep;
+  }
+
+  mIsSilent = i == first;
+
+  if (isStarved) {
+    mUnderrunCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (isFinished) {
+    // Whatever is left belongs to a stopped stream.
+    mEndFrame.store(position + i, std::memory_order_relaxed);
+    mReadIndex.store(mWriteIndex.load(std::memory_order_acquire),
+                     std::memory_order_release);
+    mIsRendering = false;
+    mIsPlaying.store(false, std::memory_order_release);
+
+    return 1;
+  }
+
+  mReadIndex.store(r, std::memory_order_release);
+
+  uint64_t queued = mWriteIndex.load(std::memory_order_acquire) - r;
+
+  if (queued >= mLowWatermark) {
+    mIsArmed = true;
+  } else if (mIsArmed && mNotify != nullptr &&
+             !mIsEnded.load(std::memory_order_acquire)) {
+    mIsArmed = false;
+    mNotify(mNotifyContext);
+  }
+
+  return 0;
+}
+
+bool StreamSource::IsSilent() const { return mIsSilent; }
+
+uint64_t StreamSource::GetUnderrunCount() const {
+  return mUnderrunCount.load(std::memory_order_relaxed);
+}
+
+uint64_t StreamSource::GetEndFrame() const {
+  return mEndFrame.load(std::memory_order_acquire);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "audiosink.h"
+#include "latencystats.h"
+#include "mixer.h"
+#include "timestretch.h"
+
+typedef void (*StreamNotify)(void *context);
+
+// StreamSource plays PCM that arrives in pieces. One producer thread begins a
+// stream with its format, writes data as it becomes available and ends it;
+// the render thread converts it to the mixer's rate and channel layout. The
+// stream completes once it has ended and everything written was played.
+//
+// Speed and pitch can be changed while a stream plays: the stream is time
+// stretched by the speed over the pitch, then resampled faster by the
+// pitch.
+class StreamSource : public MixerSource {
+public:
+  // capacity is in bytes and rounded up to a power of two.
+  StreamSource(uint32_t capacity);
+  ~StreamSource();
+
+  // Producer side. Begin fails unless the previous stream has completed, and
+  // discards whatever was written to it since. The stream starts playing at
+  // startFrame on the mixer clock, or right away when that frame has passed.
+  // pushTime is when the command behind it was pushed, for the latency stats.
+  bool IsIdle() const;
+  bool Begin(const StreamFormat &format, uint64_t startFrame = 0,
+             uint64_t pushTime = 0);
+  // Returns the number of bytes accepted, which is less than length when the
+  // buffer is full.
+  uint32_t Write(const char *data, uint32_t length);
+  uint32_t GetWritableBytes() const;
+  void End();
+  // Fades out and discards whatever is queued. The stream completes when
+  // the fade is done, even if it is starved and End is never called.
+  void Stop() override;
+
+  // Takes effect from the next block. rate is the playback speed and pitch
+  // scales the frequencies, both relative to the stream as written; 1 plays
+  // it as is. Both are clamped to the VoiceProsody limits. Safe to call from
+  // any thread.
+  void SetProsody(double rate, double pitch);
+
+  // notify is called from the render thread when the queued data drops below
+  // bytes while the stream has not ended.
+  void SetLowWatermark(uint32_t bytes, StreamNotify notify, void *context);
+  // Records when each stream first renders a sample that is not silent.
+  // Set before rendering starts.
+  void SetLatencyStats(LatencyStats *stats);
+
+  void SetTargetSamplesPerSec(uint32_t samplesPerSec) override;
+  // Applies from the next Begin.
+  void SetResampleQuality(ResampleQuality quality) override;
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override;
+  bool IsSilent() const override;
+
+  uint64_t GetUnderrunCount() const;
+  // Returns the mixer frame right after the last stream that completed.
+  uint64_t GetEndFrame() const;
+
+private:
+  bool readFrame(uint64_t *readIndex, float *frame);
+  bool nextFrame(uint64_t *readIndex, float *frame, bool isEnded);
+  void pushHistory(const float *frame);
+
+  uint8_t *mData = nullptr;
+  uint32_t mCapacity = 0;
+  uint32_t mMask = 0;
+
+  std::atomic<uint64_t> mReadIndex{0};
+  std::atomic<uint64_t> mWriteIndex{0};
+  std::atomic<bool> mIsPlaying{false};
+  std::atomic<bool> mIsEnded{false};
+  std::atomic<bool> mIsStopping{false};
+  std::atomic<uint32_t> mTargetSamplesPerSec{48000};
+  std::atomic<double> mRate{1.0};
+  std::atomic<double> mPitch{1.0};
+  std::atomic<ResampleQuality> mQuality{ResampleQuality::Linear};
+
+  StreamFormat mFormat;
+  uint32_t mBytesPerFrame = 0;
+  uint64_t mStartFrame = 0;
+  uint64_t mPushTime = 0;
+  const ResampleTable *mTable = nullptr;
+  std::atomic<uint64_t> mEndFrame{0};
+
+  uint32_t mLowWatermark = 0;
+  StreamNotify mNotify = nullptr;
+  void *mNotifyContext = nullptr;
+  LatencyStats *mStats = nullptr;
+
+  // Owned by the render thread.
+  bool mIsRendering = false;
+  bool mIsArmed = false;
+  bool mIsSilent = true;
+  bool mIsHeard = false;
+  uint32_t mDrainCount = 0;
+  // nullptr interpolates linearly.
+  const ResampleTable *mFilter = nullptr;
+  uint32_t mTaps = 2;
+  double mStep = 1.0;
+  double mPosition = 1.0;
+  // The last mTaps frames of each channel, oldest at mHistoryIndex. Each is
+  // written twice, so that the window is contiguous.
+  uint32_t mHistoryIndex = 0;
+  float mHistory[2][MaxResampleTaps * 2]{};
+  float mFade = 1.0f;
+  TimeStretch mStretch;
+  std::atomic<uint64_t> mUnderrunCount{0};
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// VoiceSettings selects the voice and prosody an utterance is synthesized
+// with. VoiceId is only used to tell voices apart. Version is the version of
+// the VoiceTable they were read from, so synthesizers can skip reapplying
+// settings that did not change.
+struct VoiceSettings {
+  uint64_t Version = 0;
+  unsigned int VoiceIndex = 0;
+  const wchar_t *VoiceId = nullptr;
+  double SpeakingRate = 1.0;
+  double AudioPitch = 1.0;
+  double AudioVolume = 1.0;
+};
+
+// SpeechWriter receives a synthesized WAV file image in pieces, starting with
+// the header.
+class SpeechWriter {
+public:
+  virtual ~SpeechWriter() = default;
+
+  virtual void Write(const char *data, size_t length) = 0;
+};
+
+// Synthesizer turns text or SSML into a WAV file image. Implementations may
+// block; they are only called from the speech pipeline's worker thread.
+class Synthesizer {
+public:
+  virtual ~Synthesizer() = default;
+
+  virtual bool Synthesize(bool isSSML, const wchar_t *text,
+                          const VoiceSettings &voice,
+                          SpeechWriter *writer) = 0;
+};
@@ -0,0 +1,173 @@
+#include <cwchar>
+
+#include "textarena.h"
+
+namespace {
+uint32_t roundUp(uint32_t n) {
+  uint32_t v{1};
+
+  while (v < n) {
+    v <<= 1;
+  }
+
+  return v;
+}
+} // namespace
+
+TextArena::TextArena(uint32_t initialCapacity, uint32_t maxCapacity,
+                     uint32_t maxStrings) {
+  Slab *slab = new Slab;
+
+  slab->Capacity = roundUp(initialCapacity);
+  slab->Data = new wchar_t[slab->Capacity]{};
+
+  mSlab.store(slab);
+  mCapacity.store(slab->Capacity);
+  mMaxCapacity = roundUp(maxCapacity);
+
+  if (mMaxCapacity < slab->Capacity) {
+    mMaxCapacity = slab->Capacity;
+  }
+
+  mRecordMask = roundUp(maxStrings) - 1;
+  mRecords = new Record[mRecordMask + 1];
+}
+
+TextArena::~TextArena() {
+  Slab *slab = mSlab.load();
+
+  while (slab != nullptr) {
+    Slab *previous = slab->Previous.load();
+
+    delete[] slab->Data;
+    delete slab;
+
+    slab = previous;
+  }
+
+  delete[] mRecords;
+  mRecords = nullptr;
+}
+
+bool TextArena::Allocate(const wchar_t *text, uint32_t length,
+                         TextSpan *span) {
+  uint32_t size = length + 1;
+
+  reclaim();
+
+  if (mNextId - mTailId > mRecordMask) {
+    return false;
+  }
+
+  while (true) {
+    Slab *slab = mSlab.load(std::memory_order_relaxed);
+    uint64_t start = mTail > slab->Start ? mTail : slab->Start;
+    uint64_t pos = mHead;
+    uint32_t offset =
+        static_cast<uint32_t>((pos - slab->Start) & (slab->Capacity - 1));
+
+    // Strings never wrap; the rest of the slab is skipped instead.
+    if (offset + size > slab->Capacity) {
+      pos += slab->Capacity - offset;
+      offset = 0;
+    }
+    if (size <= slab->Capacity && pos + size - start <= slab->Capacity) {
+      Record &record = mRecords[mNextId & mRecordMask];
+
+      std::wmemcpy(slab->Data + offset, text, length);
+      slab->Data[offset + length] = L'\0';
+
+      record.End = pos + size;
+      record.IsReleased.store(false, std::memory_order_relaxed);
+
+      span->Position = pos;
+      span->Length = length;
+      span->Id = mNextId;
+
+      mHead = pos + size;
+      mNextId += 1;
+
+      uint32_t used = static_cast<uint32_t>(mHead - mTail);
+
+      if (used > mHighWatermark.load(std::memory_order_relaxed)) {
+        mHighWatermark.store(used, std::memory_order_relaxed);
+      }
+
+      return true;
+    }
+    if (slab->Capacity >= mMaxCapacity) {
+      return false;
+    }
+
+    Slab *next = new Slab;
+
+    next->Capacity = slab->Capacity * 2;
+    next->Data = new wchar_t[next->Capacity]{};
+    next->Start = mHead;
+    next->Previous.store(slab, std::memory_order_relaxed);
+
+    mSlab.store(next, std::memory_order_release);
+    mCapacity.store(next->Capacity, std::memory_order_relaxed);
+  }
+}
+
+// Moves the tail past the strings released in allocation order, and frees
+// the slabs it left behind.
+void TextArena::reclaim() {
+  while (mTailId < mNextId) {
+    Record &record = mRecords[mTailId & mRecordMask];
+
+    if (!record.IsReleased.load(std::memory_order_acquire)) {
+      break;
+    }
+
+    mTail = record.End;
+    mTailId += 1;
+  }
+
+  Slab *slab = mSlab.load(std::memory_order_relaxed);
+
+  // Slabs older than the one holding the tail are no longer referenced.
+  while (slab != nullptr && slab->Start > mTail) {
+    slab = slab->Previous.load(std::memory_order_relaxed);
+  }
+  if (slab == nullptr) {
+    return;
+  }
+
+  Slab *old = slab->Previous.exchange(nullptr, std::memory_order_acq_rel);
+
+  while (old != nullptr) {
+    Slab *previous = old->Previous.load(std::memory_order_relaxed);
+
+    delete[] old->Data;
+    delete old;
+
+    old = previous;
+  }
+}
+
+// Slabs newer than the one holding the span are never freed while it is
+// held, so the walk stops before it reaches one that may be.
+const wchar_t *TextArena::Resolve(const TextSpan &span) const {
+  Slab *slab = mSlab.load(std::memory_order_acquire);
+
+  while (slab->Start > span.Position) {
+    slab = slab->Previous.load(std::memory_order_acquire);
+  }
+
+  return slab->Data + ((span.Position - slab->Start) & (slab->Capacity - 1));
+}
+
+void TextArena::Release(const TextSpan &span) {
+  mRecords[span.Id & mRecordMask].IsReleased.store(true,
+                                                   std::memory_order_release);
+}
+
+uint32_t TextArena::GetCapacity() const {
+  return mCapacity.load(std::memory_order_relaxed);
+}
+
+uint32_t TextArena::GetHighWatermark() const {
+  return mHighWatermark.load(std::memory_order_relaxed);
+}
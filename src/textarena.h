@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// TextSpan is a string allocated in a TextArena.
+struct TextSpan {
+  uint64_t Position = 0;
+  uint32_t Length = 0;
+  // Counts the allocations, so that Release can find the span's record.
+  uint64_t Id = 0;
+};
+
+// TextArena is a slab of wchar_t that one producer allocates null-terminated
+// strings from. Positions grow monotonically and are mapped onto the slab
+// modulo its capacity.
+//
+// Spans are released from any thread and in any order, by whoever holds
+// them at the time. The producer reclaims their space when it allocates, in
+// allocation order, so a span that is held for long keeps the strings
+// allocated after it from being reused until it is released.
+//
+// When the slab is full it is replaced by one twice as large, up to
+// maxCapacity. The old slab is kept until all text in it is reclaimed, so
+// positions never move while in use.
+class TextArena {
+public:
+  // Capacities are in characters and rounded up to powers of two. At most
+  // maxStrings strings are allocated and not yet reclaimed at a time.
+  TextArena(uint32_t initialCapacity, uint32_t maxCapacity,
+            uint32_t maxStrings);
+  ~TextArena();
+
+  // Producer side. Copies length characters of text plus a terminator, or
+  // returns false when the arena is full.
+  bool Allocate(const wchar_t *text, uint32_t length, TextSpan *span);
+
+  // Returns the text of a span that has not been released. Safe to call from
+  // any thread.
+  const wchar_t *Resolve(const TextSpan &span) const;
+
+  // Gives the text of span back. Safe to call from any thread, once per span.
+  void Release(const TextSpan &span);
+
+  uint32_t GetCapacity() const;
+  uint32_t GetHighWatermark() const;
+
+private:
+  struct Slab {
+    wchar_t *Data = nullptr;
+    uint32_t Capacity = 0;
+    uint64_t Start = 0;
+    std::atomic<Slab *> Previous{nullptr};
+  };
+
+  struct Record {
+    std::atomic<bool> IsReleased{true};
+    // Position just past the string. Owned by the producer.
+    uint64_t End = 0;
+  };
+
+  void reclaim();
+
+  std::atomic<Slab *> mSlab{nullptr};
+  std::atomic<uint32_t> mCapacity{0};
+  uint32_t mMaxCapacity = 0;
+  Record *mRecords = nullptr;
+  uint32_t mRecordMask = 0;
+  std::atomic<uint32_t> mHighWatermark{0};
+
+  // Owned by the producer. Text before the tail is reclaimed, and so are the
+  // strings before the tail id.
+  uint64_t mHead = 0;
+  uint64_t mTail = 0;
+  uint64_t mNextId = 0;
+  uint64_t mTailId = 0;
+};
@@ -0,0 +1,280 @@
+#include <cmath>
+#include <cstring>
+
+#include "timestretch.h"
+
+namespace {
+// Windows overlap by half, so a window is twice the hop.
+constexpr double hopSeconds = 0.012;
+// How far a window may be moved to line up with the one before.
+constexpr double toleranceSeconds = 0.006;
+constexpr double pi = 3.14159265358979323846;
+
+uint32_t framesOf(double seconds, uint32_t samplesPerSec) {
+  return static_cast<uint32_t>(std::lround(seconds * samplesPerSec));
+}
+} // namespace
+
+TimeStretch::TimeStretch(uint32_t maxSamplesPerSec) {
+  mMaxHop = framesOf(hopSeconds, maxSamplesPerSec);
+  mMaxHop = mMaxHop > 0 ? mMaxHop : 1;
+  mMaxTolerance = framesOf(toleranceSeconds, maxSamplesPerSec);
+
+  // The buffered input reaches back to where the last window continues and
+  // ahead over the next hop, so it spans at most two hops at the highest
+  // tempo, a window and the search on either side.
+  mCapacity = 2 * static_cast<uint32_t>(std::ceil(MaxTempo * mMaxHop)) +
+              4 * mMaxHop + 4 * mMaxTolerance;
+
+  mInput = new float[mCapacity * 2]{};
+  mMid = new float[mCapacity]{};
+  mWindow = new float[mMaxHop * 2]{};
+  mTail = new float[mMaxHop * 2]{};
+  mOutput = new float[mMaxHop * 2]{};
+  mSegment = new float[mMaxHop * 4]{};
+  mSearch = new float[mMaxHop + mMaxTolerance * 2]{};
+  mNatural = new float[mMaxHop]{};
+
+  Reset(maxSamplesPerSec);
+}
+
+TimeStretch::~TimeStretch() {
+  delete[] mInput;
+  mInput = nullptr;
+
+  delete[] mMid;
+  mMid = nullptr;
+
+  delete[] mWindow;
+  mWindow = nullptr;
+
+  delete[] mTail;
+  mTail = nullptr;
+
+  delete[] mOutput;
+  mOutput = nullptr;
+
+  delete[] mSegment;
+  mSegment = nullptr;
+
+  delete[] mSearch;
+  mSearch = nullptr;
+
+  delete[] mNatural;
+  mNatural = nullptr;
+}
+
+void TimeStretch::Reset(uint32_t samplesPerSec) {
+  mHop = framesOf(hopSeconds, samplesPerSec);
+  mHop = mHop < 1 ? 1 : mHop > mMaxHop ? mMaxHop : mHop;
+  mTolerance = framesOf(toleranceSeconds, samplesPerSec);
+  mTolerance = mTolerance > mMaxTolerance ? mMaxTolerance : mTolerance;
+
+  // Periodic Hann, so that windows a hop apart sum to one.
+  for (uint32_t i = 0; i < mHop * 2; i++) {
+    mWindow[i] = static_cast<float>(0.5 - 0.5 * std::cos(pi * i / mHop));
+  }
+
+  mInputStart = 0;
+  mInputOffset = 0;
+  mInputCount = 0;
+  mIsEnded = false;
+
+  // The first window starts a hop before the input, so the output does not
+  // fade in.
+  mAnalysis = 0.0;
+  mPrevious = -static_cast<int64_t>(mHop);
+  mIsPrimed = false;
+  mIsDrained = false;
+  mOutputIndex = 0;
+  mOutputCount = 0;
+}
+
+void TimeStretch::SetTempo(double tempo) {
+  mTempo = tempo < MinTempo ? MinTempo : tempo > MaxTempo ? MaxTempo : tempo;
+}
+
+bool TimeStretch::Write(const float *frame) {
+  if (mInputOffset + mInputCount == mCapacity) {
+    if (mInputOffset == 0) {
+      return false;
+    }
+
+    std::memmove(mInput, mInput + mInputOffset * 2,
+                 sizeof(float) * mInputCount * 2);
+    std::memmove(mMid, mMid + mInputOffset, sizeof(float) * mInputCount);
+    mInputOffset = 0;
+  }
+
+  uint32_t slot = mInputOffset + mInputCount;
+
+  mInput[slot * 2] = frame[0];
+  mInput[slot * 2 + 1] = frame[1];
+  mMid[slot] = 0.5f * (frame[0] + frame[1]);
+  mInputCount += 1;
+
+  return true;
+}
+
+void TimeStretch::End() { mIsEnded = true; }
+
+bool TimeStretch::Read(float *frame) {
+  while (mOutputIndex >= mOutputCount) {
+    if (!makeHop()) {
+      return false;
+    }
+  }
+
+  frame[0] = mOutput[mOutputIndex * 2];
+  frame[1] = mOutput[mOutputIndex * 2 + 1];
+  mOutputIndex += 1;
+
+  return true;
+}
+
+bool TimeStretch::IsDrained() const { return mIsDrained; }
+
+// Copies count input frames from start. Frames that are not buffered are
+// silence.
+void TimeStretch::fetch(int64_t start, uint32_t count, float *stereo,
+                        float *mid) const {
+  int64_t end = start + count;
+  int64_t first = start > mInputStart ? start : mInputStart;
+  int64_t last = end < mInputStart + mInputCount ? end
+                                                 : mInputStart + mInputCount;
+  uint32_t head = first < end ? static_cast<uint32_t>(first - start) : count;
+  uint32_t body = last > first ? static_cast<uint32_t>(last - first) : 0;
+  uint32_t slot = mInputOffset;
+
+  if (body > 0) {
+    slot += static_cast<uint32_t>(first - mInputStart);
+  }
+
+  if (stereo != nullptr) {
+    std::memset(stereo, 0, sizeof(float) * count * 2);
+  }
+  if (mid != nullptr) {
+    std::memset(mid, 0, sizeof(float) * count);
+  }
+  if (body == 0) {
+    return;
+  }
+  if (stereo != nullptr) {
+    std::memcpy(stereo + head * 2, mInput + slot * 2,
+                sizeof(float) * body * 2);
+  }
+  if (mid != nullptr) {
+    std::memcpy(mid + head, mMid + slot, sizeof(float) * body);
+  }
+}
+
+// Produces the next hop of output. Returns false when more input is needed
+// or the output has ended.
+bool TimeStretch::makeHop() {
+  if (mIsDrained) {
+    return false;
+  }
+
+  int64_t total = mInputStart + mInputCount;
+  int64_t natural = mPrevious + mHop;
+  bool isSearching = mTempo != 1.0 && mTolerance > 0;
+
+  // At a tempo of 1 the natural continuation is used as is, so the windows
+  // overlap-add back to the input.
+  if (!isSearching) {
+    mAnalysis = static_cast<double>(natural);
+  }
+  if (mIsEnded && mAnalysis >= static_cast<double>(total)) {
+    mIsDrained = true;
+    return false;
+  }
+
+  int64_t position = static_cast<int64_t>(std::floor(mAnalysis));
+  int64_t low = isSearching ? position - mTolerance : position;
+  int64_t high = isSearching ? position + mTolerance : position;
+  // The input has to cover the hop too, so that a full hop is not made of
+  // input that turns out to be past the end.
+  int64_t reach = static_cast<int64_t>(std::ceil(mAnalysis + mHop * mTempo));
+  int64_t needed = high + mHop * 2;
+
+  needed = needed > natural + mHop ? needed : natural + mHop;
+  needed = needed > reach ? needed : reach;
+
+  if (!mIsEnded && needed > total) {
+    return false;
+  }
+  if (!mIsPrimed) {
+    fetch(mPrevious, mHop * 2, mSegment, nullptr);
+
+    for (uint32_t i = 0; i < mHop * 2; i++) {
+      mTail[i] = mSegment[mHop * 2 + i] * mWindow[mHop + i / 2];
+    }
+
+    mIsPrimed = true;
+  }
+
+  int64_t selected = position;
+
+  if (isSearching) {
+    uint32_t candidates = static_cast<uint32_t>(high - low) + 1;
+    float bestScore = -1.0f;
+
+    fetch(low, candidates - 1 + mHop, nullptr, mSearch);
+    fetch(natural, mHop, nullptr, mNatural);
+
+    for (uint32_t d = 0; d < candidates; d++) {
+      const float *candidate = mSearch + d;
+      float correlation{0.0f};
+      float energy{1e-9f};
+
+      for (uint32_t j = 0; j < mHop; j++) {
+        correlation += candidate[j] * mNatural[j];
+        energy += candidate[j] * candidate[j];
+      }
+
+      float score = correlation / std::sqrt(energy);
+
+      if (score > bestScore) {
+        bestScore = score;
+        selected = low + d;
+      }
+    }
+  }
+
+  fetch(selected, mHop * 2, mSegment, nullptr);
+
+  for (uint32_t i = 0; i < mHop * 2; i++) {
+    mOutput[i] = mTail[i] + mSegment[i] * mWindow[i / 2];
+    mTail[i] = mSegment[mHop * 2 + i] * mWindow[mHop + i / 2];
+  }
+
+  mOutputIndex = 0;
+  mOutputCount = mHop;
+
+  if (mIsEnded) {
+    double remaining = static_cast<double>(total) - mAnalysis;
+    double frames = std::ceil(remaining / mTempo);
+
+    mOutputCount = frames < mHop ? static_cast<uint32_t>(frames) : mHop;
+  }
+
+  mPrevious = selected;
+  mAnalysis += mHop * mTempo;
+
+  // Drop the input that no later window can reach.
+  int64_t keep = static_cast<int64_t>(std::floor(mAnalysis)) - mTolerance;
+
+  keep = keep < mPrevious + mHop ? keep : mPrevious + mHop;
+
+  if (keep > mInputStart) {
+    int64_t dropped = keep - mInputStart;
+    uint32_t n = dropped < mInputCount ? static_cast<uint32_t>(dropped)
+                                       : mInputCount;
+
+    mInputStart += n;
+    mInputOffset += n;
+    mInputCount -= n;
+  }
+
+  return true;
+}
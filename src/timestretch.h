@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+// TimeStretch changes the tempo of stereo audio without changing its pitch.
+// It uses WSOLA: windows are taken from the input at the tempo, each one
+// nudged to where it best continues the one before, and overlap-added. It
+// never allocates after construction, so it can run on the render thread.
+//
+// At a tempo of 1 every window is taken where the one before ends, so the
+// output equals the input up to float rounding in the overlap-add. Output
+// starts once a window of input is buffered, at any tempo.
+class TimeStretch {
+public:
+  static constexpr double MinTempo = 0.25;
+  static constexpr double MaxTempo = 12.0;
+
+  // Buffers are sized for maxSamplesPerSec. Faster input is processed with
+  // shorter windows.
+  TimeStretch(uint32_t maxSamplesPerSec);
+  ~TimeStretch();
+
+  // Forgets all input and output.
+  void Reset(uint32_t samplesPerSec);
+  // Takes effect from the next window.
+  void SetTempo(double tempo);
+
+  // Returns false when the input buffer is full. It never is while Read
+  // asks for more input.
+  bool Write(const float *frame);
+  // After End, input that is missing reads as silence, and the output ends
+  // where the input does.
+  void End();
+
+  // Returns false when more input is needed, or once everything was read
+  // after End.
+  bool Read(float *frame);
+  bool IsDrained() const;
+
+private:
+  bool makeHop();
+  void fetch(int64_t start, uint32_t count, float *stereo, float *mid) const;
+
+  uint32_t mMaxHop = 0;
+  uint32_t mMaxTolerance = 0;
+  uint32_t mCapacity = 0;
+
+  float *mInput = nullptr;
+  float *mMid = nullptr;
+  float *mWindow = nullptr;
+  float *mTail = nullptr;
+  float *mOutput = nullptr;
+  float *mSegment = nullptr;
+  float *mSearch = nullptr;
+  float *mNatural = nullptr;
+
+  uint32_t mHop = 1;
+  uint32_t mTolerance = 0;
+  double mTempo = 1.0;
+
+  // Input frames [mInputStart, mInputStart + mInputCount) are buffered,
+  // starting at slot mInputOffset.
+  int64_t mInputStart = 0;
+  uint32_t mInputOffset = 0;
+  uint32_t mInputCount = 0;
+  bool mIsEnded = false;
+
+  double mAnalysis = 0.0;
+  int64_t mPrevious = 0;
+  bool mIsPrimed = false;
+  bool mIsDrained = false;
+  uint32_t mOutputIndex = 0;
+  uint32_t mOutputCount = 0;
+};
@@ -7,4 +7,43 @@ typedef struct {
   int16_t SFXIndex;
   double WaitDuration;
   wchar_t *Text;
+  float Gain;
+  float Pan;
 } Command;
+
+// Time from Push to one stage, in microseconds.
+typedef struct {
+  int64_t Count;
+  double Mean;
+  double P50;
+  double P90;
+  double P99;
+  double P999;
+  double Max;
+} LatencySummary;
+
+// Render thread counters since Setup. Times are in microseconds; MMCSS holds
+// an MMCSSStatus.
+typedef struct {
+  int64_t Periods;
+  int64_t Underruns;
+  int64_t LateWakeups;
+  int64_t Failures;
+  int64_t FramesWritten;
+  double FillP50;
+  double FillP99;
+  double FillMax;
+  int32_t PeriodMicros;
+  int32_t MaxLateMicros;
+  int32_t MMCSS;
+} RenderSummary;
+
+// One wake-up of the render thread. Flags: 1 underrun, 2 late, 4 failed.
+typedef struct {
+  int64_t Sequence;
+  int32_t IntervalMicros;
+  int32_t FillMicros;
+  int32_t PaddingFrames;
+  int32_t FramesWritten;
+  int32_t Flags;
+} RenderPeriodSample;
@@ -14,6 +14,8 @@ void SafeCloseHandle(HANDLE *pHandle) {
   }
 }
 
+void SignalEvent(void *event) { SetEvent(static_cast<HANDLE>(event)); }
+
 char *getBytes(IBuffer ^ buffer) {
   ComPtr<IInspectable> i = reinterpret_cast<IInspectable *>(buffer);
   ComPtr<IBufferByteAccess> bufferByteAccess;
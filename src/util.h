@@ -16,4 +16,6 @@ template <class T> void SafeRelease(T **ppT) {
 }
 
 void SafeCloseHandle(HANDLE *pHandle);
+// Signals the event passed as context; used as a StreamNotify callback.
+void SignalEvent(void *event);
 char *getBytes(IBuffer ^ buffer);
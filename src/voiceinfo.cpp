@@ -36,6 +36,8 @@ DWORD WINAPI voiceInfo(LPVOID context) {
   ctx->Count = synth->AllVoices->Size;
   ctx->VoiceProperties = new VoiceProperty *[synth->AllVoices->Size];
 
+  VoiceProsody *prosodies = new VoiceProsody[ctx->Count > 0 ? ctx->Count : 1];
+
   unsigned int defaultVoiceIndex{};
   VoiceInformation ^ defaultInfo = synth->DefaultVoice;
 
@@ -59,16 +61,20 @@ DWORD WINAPI voiceInfo(LPVOID context) {
     std::wmemcpy(ctx->VoiceProperties[i]->Language,
                  synth->Voice->Language->Data(), languageLength);
 
-    ctx->VoiceProperties[i]->SpeakingRate = synth->Options->SpeakingRate;
-    ctx->VoiceProperties[i]->AudioPitch = synth->Options->AudioPitch;
-    ctx->VoiceProperties[i]->AudioVolume = synth->Options->AudioVolume;
+    prosodies[i].SpeakingRate = synth->Options->SpeakingRate;
+    prosodies[i].AudioPitch = synth->Options->AudioPitch;
+    prosodies[i].AudioVolume = synth->Options->AudioVolume;
 
     if (defaultInfo->Id->Equals(synth->Voice->Id)) {
       defaultVoiceIndex = i;
     }
   }
 
-  ctx->DefaultVoiceIndex = defaultVoiceIndex;
+  ctx->Settings =
+      new VoiceSettingsStore(ctx->Count, defaultVoiceIndex, prosodies);
+
+  delete[] prosodies;
+  prosodies = nullptr;
 
   RoUninitialize();
 
@@ -20,6 +20,109 @@ using Windows::Foundation::Metadata::ApiInformation;
 
 extern Logger::Logger *Log;
 
+namespace {
+// Size of the pieces read from a synthesized stream.
+constexpr unsigned int ReadChunkBytes = 16384;
+
+class WinRTSynthesizer : public Synthesizer {
+public:
+  WinRTSynthesizer();
+
+  bool Synthesize(bool isSSML, const wchar_t *text, const VoiceSettings &voice,
+                  SpeechWriter *writer) override;
+
+private:
+  void applyVoiceSettings(const VoiceSettings &voice);
+
+  SpeechSynthesizer ^ mSynth;
+  uint64_t mVersion{0};
+};
+
+WinRTSynthesizer::WinRTSynthesizer() : mSynth(ref new SpeechSynthesizer()) {
+  if (ApiInformation::IsApiContractPresent(
+          "Windows.Foundation.UniversalApiContract", 6, 0)) {
+    mSynth->Options->AppendedSilence = SpeechAppendedSilence::Min;
+  }
+}
+
+// Every property set is a WinRT call, so the synthesizer is only touched
+// when the settings were changed since the last utterance.
+void WinRTSynthesizer::applyVoiceSettings(const VoiceSettings &voice) {
+  if (voice.VoiceId == nullptr || voice.Version == mVersion) {
+    return;
+  }
+
+  mSynth->Voice = mSynth->AllVoices->GetAt(voice.VoiceIndex);
+  mSynth->Options->SpeakingRate = voice.SpeakingRate;
+  mSynth->Options->AudioPitch = voice.AudioPitch;
+  mSynth->Options->AudioVolume = voice.AudioVolume;
+  mVersion = voice.Version;
+}
+
+bool WinRTSynthesizer::Synthesize(bool isSSML, const wchar_t *text,
+                                  const VoiceSettings &voice,
+                                  SpeechWriter *writer) {
+  applyVoiceSettings(voice);
+
+  task<SpeechSynthesisStream ^> speechTask;
+
+  if (isSSML) {
+    try {
+      Platform::String ^ ssml = ref new Platform::String(text);
+      speechTask = create_task(mSynth->SynthesizeSsmlToStreamAsync(ssml));
+    } catch (Platform::Exception ^ e) {
+      Log->Warn(L"Failed to call SynthesizeSsmlToStreamAsync",
+                GetCurrentThreadId(), __LONGFILE__);
+      return false;
+    }
+
+    // Broken SSML string (e.g. unbalanced brackets) makes the task done.
+
+    if (speechTask.is_done()) {
+      Log->Warn(
+          L"Failed to continue speech synthesis (probably SSML is broken)",
+          GetCurrentThreadId(), __LONGFILE__);
+      return false;
+    }
+  } else {
+    try {
+      Platform::String ^ plainText = ref new Platform::String(text);
+      speechTask =
+          create_task(mSynth->SynthesizeTextToStreamAsync(plainText));
+    } catch (Platform::Exception ^ e) {
+      Log->Warn(L"Failed to call SynthesizeTextToStreamAsync",
+                GetCurrentThreadId(), __LONGFILE__);
+      return false;
+    }
+  }
+
+  // Only the header and one chunk have to arrive before playback can start.
+  try {
+    SpeechSynthesisStream ^ speechStream = speechTask.get();
+    Buffer ^ buffer = ref new Buffer(ReadChunkBytes);
+
+    while (true) {
+      IBuffer ^ chunk = create_task(speechStream->ReadAsync(
+                                        buffer, ReadChunkBytes,
+                                        InputStreamOptions::None))
+                            .get();
+
+      if (chunk->Length == 0) {
+        break;
+      }
+
+      writer->Write(getBytes(chunk), chunk->Length);
+    }
+  } catch (Platform::Exception ^ e) {
+    Log->Warn(L"Failed to complete speech synthesis", GetCurrentThreadId(),
+              __LONGFILE__);
+    return false;
+  }
+
+  return true;
+}
+} // namespace
+
 DWORD WINAPI voiceLoop(LPVOID context) {
   Log->Info(L"Start Voice loop thread", GetCurrentThreadId(), __LONGFILE__);
 
@@ -33,28 +136,12 @@ DWORD WINAPI voiceLoop(LPVOID context) {
   RoInitialize(RO_INIT_MULTITHREADED);
 
   bool isActive{true};
-  auto synth = ref new SpeechSynthesizer();
+  WinRTSynthesizer *synth = new WinRTSynthesizer();
 
   while (isActive) {
     HANDLE waitArray[2] = {ctx->FeedEvent, ctx->QuitEvent};
     DWORD waitResult = WaitForMultipleObjects(2, waitArray, FALSE, INFINITE);
 
-    if (ctx->VoiceInfoCtx != nullptr &&
-        ctx->VoiceInfoCtx->VoiceProperties != nullptr) {
-      unsigned int index = ctx->VoiceInfoCtx->DefaultVoiceIndex;
-
-      synth->Voice = synth->AllVoices->GetAt(index);
-      synth->Options->SpeakingRate =
-          ctx->VoiceInfoCtx->VoiceProperties[index]->SpeakingRate;
-      synth->Options->AudioPitch =
-          ctx->VoiceInfoCtx->VoiceProperties[index]->AudioPitch;
-      synth->Options->AudioVolume =
-          ctx->VoiceInfoCtx->VoiceProperties[index]->AudioVolume;
-    }
-    if (ApiInformation::IsApiContractPresent(
-            "Windows.Foundation.UniversalApiContract", 6, 0)) {
-      synth->Options->AppendedSilence = SpeechAppendedSilence::Min;
-    }
     switch (waitResult) {
     case WAIT_OBJECT_0 + 0: // ctx->FeedEvent
       break;
@@ -63,67 +150,18 @@ DWORD WINAPI voiceLoop(LPVOID context) {
       continue;
     }
 
-    task<SpeechSynthesisStream ^> speechTask;
-
-    if (ctx->IsSSML) {
-      try {
-        Platform::String ^ ssml = ref new Platform::String(ctx->Text);
-        speechTask = create_task(synth->SynthesizeSsmlToStreamAsync(ssml));
-      } catch (Platform::Exception ^ e) {
-        Log->Warn(L"Failed to call SynthesizeSsmlToStreamAsync",
-                  GetCurrentThreadId(), __LONGFILE__);
-        continue;
-      }
-
-      // Broken SSML string (e.g. unbalanced brackets) makes the task done.
-
-      if (speechTask.is_done()) {
-        Log->Warn(
-            L"Failed to continue speech synthesis (probably SSML is broken)",
-            GetCurrentThreadId(), __LONGFILE__);
-        continue;
-      }
-    } else {
-      try {
-        Platform::String ^ text = ref new Platform::String(ctx->Text);
-        speechTask = create_task(synth->SynthesizeTextToStreamAsync(text));
-      } catch (Platform::Exception ^ e) {
-        Log->Warn(L"Failed to call SynthesizeTextToStreamAsync",
-                  GetCurrentThreadId(), __LONGFILE__);
-        continue;
+    // Synthesize everything the command loop has queued ahead of playback.
+    while (ctx->Speech->ProcessNext(synth, SignalEvent, ctx->ReadyEvent)) {
+      if (WaitForSingleObject(ctx->QuitEvent, 0) == WAIT_OBJECT_0) {
+        isActive = false;
+        break;
       }
     }
-
-    int32_t waveLength{0};
-
-    speechTask
-        .then([&ctx, &waveLength](SpeechSynthesisStream ^ speechStream) {
-          waveLength = static_cast<int32_t>(speechStream->Size);
-          Buffer ^ buffer = ref new Buffer(waveLength);
-
-          auto result = create_task(speechStream->ReadAsync(
-              buffer, waveLength,
-              Windows::Storage::Streams::InputStreamOptions::None));
-
-          return result;
-        })
-        .then([&ctx, &waveLength](IBuffer ^ buffer) {
-          if (waveLength > 0) {
-            char *wave = getBytes(buffer);
-            ctx->VoiceEngine->Feed(wave, waveLength);
-          }
-        })
-        .then([](task<void> previous) {
-          try {
-            previous.get();
-          } catch (Platform::Exception ^ e) {
-            Log->Warn(L"Failed to complete speech synthesis",
-                      GetCurrentThreadId(), __LONGFILE__);
-          }
-        })
-        .wait();
   }
 
+  delete synth;
+  synth = nullptr;
+
   RoUninitialize();
 
   Log->Info(L"End Voice loop thread", GetCurrentThreadId(), __LONGFILE__);
@@ -0,0 +1,167 @@
+#include <algorithm>
+
+#include "voicesettings.h"
+
+VoiceSettingsStore::VoiceSettingsStore(uint32_t count,
+                                       uint32_t defaultVoiceIndex,
+                                       const VoiceProsody *voices)
+    : mCount(count) {
+  VoiceTable *table = new VoiceTable();
+
+  table->Version = 1;
+  table->DefaultVoiceIndex = defaultVoiceIndex < count ? defaultVoiceIndex : 0;
+  table->Count = count;
+  table->Voices = new VoiceProsody[count > 0 ? count : 1]{};
+
+  if (voices != nullptr) {
+    std::copy(voices, voices + count, table->Voices);
+  }
+
+  mTable.store(table);
+}
+
+VoiceSettingsStore::~VoiceSettingsStore() {
+  deleteTable(mTable.exchange(nullptr));
+
+  for (VoiceTable *table : mRetired) {
+    deleteTable(table);
+  }
+
+  mRetired.clear();
+}
+
+// Tables are only freed with the store, so a table that was replaced after it
+// was loaded can still be pinned safely; the reader then tries again. A write
+// reuses a table only while nobody holds it, and publishes it after it is
+// written, so a pin that sticks is on a complete table.
+const VoiceTable *VoiceSettingsStore::Acquire() {
+  while (true) {
+    VoiceTable *table = mTable.load();
+
+    table->Readers.fetch_add(1);
+
+    if (mTable.load() == table) {
+      return table;
+    }
+
+    table->Readers.fetch_sub(1);
+  }
+}
+
+void VoiceSettingsStore::Release(const VoiceTable *table) {
+  table->Readers.fetch_sub(1);
+}
+
+uint32_t VoiceSettingsStore::GetCount() const { return mCount; }
+
+uint64_t VoiceSettingsStore::GetVersion() {
+  const VoiceTable *table = Acquire();
+  uint64_t version = table->Version;
+
+  Release(table);
+
+  return version;
+}
+
+bool VoiceSettingsStore::SetDefaultVoice(uint32_t index) {
+  if (index >= mCount) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+
+  VoiceTable *table = copyTable();
+
+  table->DefaultVoiceIndex = index;
+  publish(table);
+
+  return true;
+}
+
+bool VoiceSettingsStore::SetSpeakingRate(uint32_t index, double rate) {
+  if (index >= mCount) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+
+  VoiceTable *table = copyTable();
+
+  table->Voices[index].SpeakingRate = rate;
+  publish(table);
+
+  return true;
+}
+
+bool VoiceSettingsStore::SetAudioPitch(uint32_t index, double audioPitch) {
+  if (index >= mCount) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+
+  VoiceTable *table = copyTable();
+
+  table->Voices[index].AudioPitch = audioPitch;
+  publish(table);
+
+  return true;
+}
+
+bool VoiceSettingsStore::SetAudioVolume(uint32_t index, double audioVolume) {
+  if (index >= mCount) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mWriteMutex);
+
+  VoiceTable *table = copyTable();
+
+  table->Voices[index].AudioVolume = audioVolume;
+  publish(table);
+
+  return true;
+}
+
+// Called with mWriteMutex held, so the current table cannot change.
+VoiceTable *VoiceSettingsStore::copyTable() {
+  const VoiceTable *current = mTable.load();
+  VoiceTable *table{nullptr};
+
+  for (size_t i = 0; i < mRetired.size() && table == nullptr; i++) {
+    if (mRetired[i]->Readers.load() == 0) {
+      table = mRetired[i];
+      mRetired[i] = mRetired.back();
+      mRetired.pop_back();
+    }
+  }
+  if (table == nullptr) {
+    table = new VoiceTable();
+    table->Voices = new VoiceProsody[mCount > 0 ? mCount : 1]{};
+  }
+
+  table->Version = current->Version + 1;
+  table->DefaultVoiceIndex = current->DefaultVoiceIndex;
+  table->Count = current->Count;
+
+  std::copy(current->Voices, current->Voices + mCount, table->Voices);
+
+  return table;
+}
+
+// The old table is kept for readers that may still hold it. Only as many
+// tables pile up as readers hold at once.
+void VoiceSettingsStore::publish(VoiceTable *table) {
+  mRetired.push_back(mTable.exchange(table));
+}
+
+void VoiceSettingsStore::deleteTable(VoiceTable *table) {
+  if (table == nullptr) {
+    return;
+  }
+
+  delete[] table->Voices;
+  table->Voices = nullptr;
+
+  delete table;
+}
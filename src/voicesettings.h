@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Prosody of one voice. The API clamps settings to these limits, and the
+// stream source stretches and resamples within them.
+struct VoiceProsody {
+  static constexpr double MinSpeakingRate = 0.5;
+  static constexpr double MaxSpeakingRate = 6.0;
+  static constexpr double MinAudioPitch = 0.5;
+  static constexpr double MaxAudioPitch = 2.0;
+
+  double SpeakingRate = 1.0;
+  double AudioPitch = 1.0;
+  double AudioVolume = 1.0;
+};
+
+// VoiceTable is one published version of the voice settings. It is never
+// modified while a reader holds it; every change publishes a new table with
+// a higher Version.
+struct VoiceTable {
+  uint64_t Version = 0;
+  uint32_t DefaultVoiceIndex = 0;
+  uint32_t Count = 0;
+  VoiceProsody *Voices = nullptr;
+  // Readers holding the table.
+  mutable std::atomic<uint32_t> Readers{0};
+};
+
+// VoiceSettingsStore holds the current VoiceTable. Readers never block: they
+// pin the current table with Acquire and unpin it with Release. Writers copy
+// the table, change the copy and swap it in. Writers are serialized and never
+// wait for readers: a replaced table is kept and reused by a later write
+// once nobody holds it.
+class VoiceSettingsStore {
+public:
+  VoiceSettingsStore(uint32_t count, uint32_t defaultVoiceIndex,
+                     const VoiceProsody *voices);
+  ~VoiceSettingsStore();
+
+  // The table stays valid until it is passed to Release.
+  const VoiceTable *Acquire();
+  void Release(const VoiceTable *table);
+
+  uint32_t GetCount() const;
+  uint64_t GetVersion();
+
+  // Return false when index is out of range.
+  bool SetDefaultVoice(uint32_t index);
+  bool SetSpeakingRate(uint32_t index, double rate);
+  bool SetAudioPitch(uint32_t index, double audioPitch);
+  bool SetAudioVolume(uint32_t index, double audioVolume);
+
+private:
+  VoiceTable *copyTable();
+  void publish(VoiceTable *table);
+
+  static void deleteTable(VoiceTable *table);
+
+  const uint32_t mCount;
+  std::atomic<VoiceTable *> mTable{nullptr};
+  // Replaced tables, some of which may still be held. Guarded by mWriteMutex.
+  std::vector<VoiceTable *> mRetired;
+  std::mutex mWriteMutex;
+};
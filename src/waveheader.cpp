@@ -0,0 +1,176 @@
+#include <cstring>
+
+#include "waveheader.h"
+
+namespace {
+constexpr uint16_t formatTagPCM = 1;
+constexpr uint16_t formatTagFloat = 3;
+constexpr uint16_t formatTagExtensible = 0xFFFE;
+
+uint16_t getUint16(const char *p) {
+  const uint8_t *u = reinterpret_cast<const uint8_t *>(p);
+
+  return static_cast<uint16_t>(u[0] | (u[1] << 8));
+}
+
+uint32_t getUint32(const char *p) {
+  const uint8_t *u = reinterpret_cast<const uint8_t *>(p);
+
+  return static_cast<uint32_t>(u[0]) | (static_cast<uint32_t>(u[1]) << 8) |
+         (static_cast<uint32_t>(u[2]) << 16) |
+         (static_cast<uint32_t>(u[3]) << 24);
+}
+
+int32_t getInt24(const uint8_t *p) {
+  int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+
+  return (v ^ 0x800000) - 0x800000;
+}
+
+SampleFormat sampleFormatFromTag(uint16_t tag, uint16_t bitsPerSample) {
+  if (tag == formatTagFloat && bitsPerSample == 32) {
+    return SampleFormat::Float32;
+  }
+  if (tag != formatTagPCM) {
+    return SampleFormat::Unknown;
+  }
+  switch (bitsPerSample) {
+  case 16:
+    return SampleFormat::Int16;
+  case 24:
+    return SampleFormat::Int24;
+  case 32:
+    return SampleFormat::Int32;
+  }
+
+  return SampleFormat::Unknown;
+}
+} // namespace
+
+bool ParseWaveHeader(const char *data, size_t length, StreamFormat *format,
+                     size_t *dataOffset, uint32_t *dataLength) {
+  if (length < 12 || std::memcmp(data, "RIFF", 4) != 0 ||
+      std::memcmp(data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  bool hasFormat{false};
+  size_t offset{12};
+
+  while (offset + 8 <= length) {
+    const char *chunk = data + offset;
+    uint32_t chunkSize = getUint32(chunk + 4);
+
+    if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!hasFormat) {
+        return false;
+      }
+
+      *dataOffset = offset + 8;
+      *dataLength = chunkSize;
+
+      return true;
+    }
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      if (chunkSize < 16 || offset + 8 + chunkSize > length) {
+        return false;
+      }
+
+      uint16_t tag = getUint16(chunk + 8);
+      uint16_t bitsPerSample = getUint16(chunk + 22);
+
+      // The real format tag is the first two bytes of the SubFormat GUID.
+      if (tag == formatTagExtensible) {
+        if (chunkSize < 40) {
+          return false;
+        }
+
+        tag = getUint16(chunk + 32);
+      }
+
+      format->Format = sampleFormatFromTag(tag, bitsPerSample);
+      format->Channels = getUint16(chunk + 10);
+      format->SamplesPerSec = getUint32(chunk + 12);
+
+      if (format->Format == SampleFormat::Unknown || format->Channels == 0 ||
+          format->SamplesPerSec == 0) {
+        return false;
+      }
+
+      hasFormat = true;
+    }
+
+    // Chunks are padded to an even size.
+    offset += 8 + static_cast<size_t>(chunkSize) + (chunkSize & 1);
+  }
+
+  return false;
+}
+
+float DecodeSample(SampleFormat format, const uint8_t *p) {
+  switch (format) {
+  case SampleFormat::Int16: {
+    int16_t v{};
+    std::memcpy(&v, p, sizeof(v));
+    return static_cast<float>(v) / 32768.0f;
+  }
+  case SampleFormat::Int24:
+    return static_cast<float>(getInt24(p)) / 8388608.0f;
+  case SampleFormat::Int32: {
+    int32_t v{};
+    std::memcpy(&v, p, sizeof(v));
+    return static_cast<float>(v) / 2147483648.0f;
+  }
+  case SampleFormat::Float32: {
+    float v{};
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  default:
+    return 0.0f;
+  }
+}
+
+float *DecodeWave(const char *data, size_t length, uint32_t *frames,
+                  uint16_t *channels, uint32_t *samplesPerSec) {
+  StreamFormat format;
+  size_t dataOffset{0};
+  uint32_t dataLength{0};
+
+  if (!ParseWaveHeader(data, length, &format, &dataOffset, &dataLength)) {
+    return nullptr;
+  }
+
+  size_t available = length - dataOffset;
+
+  if (dataLength == 0 || dataLength > available) {
+    dataLength = static_cast<uint32_t>(available);
+  }
+
+  uint32_t bytesPerSample = BytesPerSample(format.Format);
+  uint32_t bytesPerFrame = BytesPerFrame(format);
+  uint32_t srcFrames = dataLength / bytesPerFrame;
+  uint16_t dstChannels = format.Channels < 2 ? format.Channels : 2;
+
+  if (srcFrames == 0) {
+    return nullptr;
+  }
+
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(data + dataOffset);
+  float *decoded = new float[srcFrames * dstChannels];
+
+  for (uint32_t i = 0; i < srcFrames; i++) {
+    const uint8_t *frame = src + i * bytesPerFrame;
+
+    for (uint16_t c = 0; c < dstChannels; c++) {
+      decoded[i * dstChannels + c] =
+          DecodeSample(format.Format, frame + c * bytesPerSample);
+    }
+  }
+
+  *frames = srcFrames;
+  *channels = dstChannels;
+  *samplesPerSec = format.SamplesPerSec;
+
+  return decoded;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "audiosink.h"
+
+// Parses a RIFF/WAVE header up to the start of the data chunk. Returns false
+// when the header is incomplete, malformed or in an unsupported format.
+// dataLength is the declared size of the data chunk, which streams may leave
+// as zero or 0xFFFFFFFF.
+bool ParseWaveHeader(const char *data, size_t length, StreamFormat *format,
+                     size_t *dataOffset, uint32_t *dataLength);
+
+// Converts one sample in format to a normalized float.
+float DecodeSample(SampleFormat format, const uint8_t *p);
+
+// Decodes a whole WAV file image to interleaved normalized floats with at
+// most two channels. Returns nullptr when the image cannot be decoded;
+// otherwise the caller owns the returned array.
+float *DecodeWave(const char *data, size_t length, uint32_t *frames,
+                  uint16_t *channels, uint32_t *samplesPerSec);
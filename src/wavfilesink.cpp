@@ -0,0 +1,123 @@
+#include <cstring>
+
+#include "wavfilesink.h"
+
+namespace {
+constexpr uint16_t formatTagPCM = 1;
+constexpr uint16_t formatTagFloat = 3;
+constexpr uint32_t headerSize = 44;
+
+void putUint16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v & 0xFF);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+void putUint32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+  }
+}
+} // namespace
+
+WavFileSink::WavFileSink(const StreamFormat &format, uint32_t periodFrames)
+    : mFormat(format), mPeriodFrames(periodFrames) {
+  mBuffer = new uint8_t[periodFrames * BytesPerFrame(format)]{};
+}
+
+WavFileSink::~WavFileSink() {
+  Close();
+
+  delete[] mBuffer;
+  mBuffer = nullptr;
+}
+
+bool WavFileSink::Open(const char *path) {
+  if (mFile.is_open() || BytesPerFrame(mFormat) == 0) {
+    return false;
+  }
+
+  mFile.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  mFramesWritten = 0;
+
+  return mFile.is_open() && writeHeader();
+}
+
+bool WavFileSink::Close() {
+  if (!mFile.is_open()) {
+    return true;
+  }
+
+  bool ok = writeHeader();
+  mFile.close();
+
+  return ok && !mFile.fail();
+}
+
+bool WavFileSink::writeHeader() {
+  uint8_t header[headerSize]{};
+  uint32_t blockAlign = BytesPerFrame(mFormat);
+  uint64_t dataSize = mFramesWritten * blockAlign;
+
+  if (dataSize > UINT32_MAX - headerSize) {
+    return false;
+  }
+
+  std::memcpy(header + 0, "RIFF", 4);
+  putUint32(header + 4, static_cast<uint32_t>(dataSize) + headerSize - 8);
+  std::memcpy(header + 8, "WAVE", 4);
+  std::memcpy(header + 12, "fmt ", 4);
+  putUint32(header + 16, 16);
+  putUint16(header + 20, mFormat.Format == SampleFormat::Float32
+                             ? formatTagFloat
+                             : formatTagPCM);
+  putUint16(header + 22, mFormat.Channels);
+  putUint32(header + 24, mFormat.SamplesPerSec);
+  putUint32(header + 28, mFormat.SamplesPerSec * blockAlign);
+  putUint16(header + 32, static_cast<uint16_t>(blockAlign));
+  putUint16(header + 34, BytesPerSample(mFormat.Format) * 8);
+  std::memcpy(header + 36, "data", 4);
+  putUint32(header + 40, static_cast<uint32_t>(dataSize));
+
+  std::streampos position = mFile.tellp();
+
+  mFile.seekp(0);
+  mFile.write(reinterpret_cast<const char *>(header), headerSize);
+
+  if (position > static_cast<std::streampos>(headerSize)) {
+    mFile.seekp(position);
+  }
+
+  return !mFile.fail();
+}
+
+const StreamFormat &WavFileSink::GetStreamFormat() const { return mFormat; }
+
+bool WavFileSink::GetAvailableFrames(uint32_t *frames) {
+  *frames = mPeriodFrames;
+
+  return true;
+}
+
+bool WavFileSink::GetBuffer(uint32_t frames, uint8_t **data) {
+  if (!mFile.is_open() || frames > mPeriodFrames) {
+    return false;
+  }
+
+  *data = mBuffer;
+
+  return true;
+}
+
+bool WavFileSink::ReleaseBuffer(uint32_t frames) {
+  if (frames > mPeriodFrames) {
+    return false;
+  }
+
+  mFile.write(reinterpret_cast<const char *>(mBuffer),
+              frames * BytesPerFrame(mFormat));
+  mFramesWritten += frames;
+
+  return !mFile.fail();
+}
+
+uint64_t WavFileSink::GetFramesWritten() const { return mFramesWritten; }
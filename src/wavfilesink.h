@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+
+#include "audiosink.h"
+
+// WavFileSink writes every period to a RIFF/WAVE file. The header is
+// finalized by Close, so identical input always yields identical files.
+class WavFileSink : public AudioSink {
+public:
+  WavFileSink(const StreamFormat &format, uint32_t periodFrames);
+  ~WavFileSink();
+
+  bool Open(const char *path);
+  bool Close();
+
+  const StreamFormat &GetStreamFormat() const override;
+  bool GetAvailableFrames(uint32_t *frames) override;
+  bool GetBuffer(uint32_t frames, uint8_t **data) override;
+  bool ReleaseBuffer(uint32_t frames) override;
+
+  uint64_t GetFramesWritten() const;
+
+private:
+  bool writeHeader();
+
+  StreamFormat mFormat;
+  std::ofstream mFile;
+  uint32_t mPeriodFrames = 0;
+  uint8_t *mBuffer = nullptr;
+  uint64_t mFramesWritten = 0;
+};
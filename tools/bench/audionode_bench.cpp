@@ -0,0 +1,848 @@
+// audionode_bench runs each stage of the render pipeline offline, faster than
+// real time, against a null sink and reports what it costs: nanoseconds per
+// frame (or per command for the ring), heap allocations and cache misses.
+// Inputs are synthetic and seeded, so runs on different commits see the same
+// samples and the same command schedule.
+//
+// Results can be written to a tab separated file with -o. Given a previous
+// file with -b, the change of each benchmark against it is printed.
+//
+// Usage: audionode_bench [-s seconds] [-r repeats] [-f filter] [-o results]
+//                        [-b baseline]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "commandchannel.h"
+#include "commandring.h"
+#include "gainramp.h"
+#include "headlessdriver.h"
+#include "mixer.h"
+#include "nullsink.h"
+#include "renderer.h"
+#include "sfxsource.h"
+#include "streamsource.h"
+
+// Every allocation in the process goes through these, so the count covers
+// the library as well as the benchmark.
+namespace {
+std::atomic<uint64_t> allocationCount{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (void *p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+const double pi = 3.14159265358979323846;
+
+constexpr uint32_t SamplesPerSec = 48000;
+constexpr uint16_t Channels = 2;
+constexpr uint32_t PeriodFrames = 480;
+
+void usage() {
+  std::fprintf(stderr, "usage: audionode_bench [-s seconds] [-r repeats] "
+                       "[-f filter] [-o results] [-b baseline]\n");
+}
+
+// Noise that is the same on every platform, unlike std::rand.
+class Noise {
+public:
+  explicit Noise(uint32_t seed) : mState(seed != 0 ? seed : 1) {}
+
+  // Returns a value in [-0.5, 0.5).
+  float Next() {
+    mState ^= mState << 13;
+    mState ^= mState >> 17;
+    mState ^= mState << 5;
+
+    return static_cast<float>(mState) / 4294967296.0f - 0.5f;
+  }
+
+private:
+  uint32_t mState;
+};
+
+// CacheCounter counts last level cache misses of this thread in user space.
+// Where the counter cannot be opened, e.g. in containers without
+// perf_event access, IsAvailable is false and Read returns 0.
+class CacheCounter {
+public:
+  CacheCounter() {
+#ifdef __linux__
+    perf_event_attr attr;
+
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    mFD = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~CacheCounter() {
+#ifdef __linux__
+    if (mFD >= 0) {
+      close(mFD);
+    }
+#endif
+  }
+
+  bool IsAvailable() const { return mFD >= 0; }
+
+  void Start() {
+#ifdef __linux__
+    if (mFD >= 0) {
+      ioctl(mFD, PERF_EVENT_IOC_RESET, 0);
+      ioctl(mFD, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t Stop() {
+    uint64_t count{0};
+
+#ifdef __linux__
+    if (mFD >= 0) {
+      ioctl(mFD, PERF_EVENT_IOC_DISABLE, 0);
+
+      if (read(mFD, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+#endif
+
+    return count;
+  }
+
+private:
+  int mFD = -1;
+};
+
+CacheCounter *cacheCounter{nullptr};
+
+struct Result {
+  std::string Name;
+  // What one item is: a frame, or a command for the ring.
+  const char *Unit = "frame";
+  uint64_t Items = 0;
+  double Nanoseconds = 0.0;
+  uint64_t Allocations = 0;
+  uint64_t CacheMisses = 0;
+
+  double PerItem() const { return Items > 0 ? Nanoseconds / Items : 0.0; }
+};
+
+// Probe measures the section between Start and Stop.
+class Probe {
+public:
+  void Start() {
+    mAllocations = allocationCount.load();
+    cacheCounter->Start();
+    mStart = std::chrono::steady_clock::now();
+  }
+
+  void Stop(Result *result, uint64_t items) {
+    auto end = std::chrono::steady_clock::now();
+
+    result->CacheMisses = cacheCounter->Stop();
+    result->Allocations = allocationCount.load() - mAllocations;
+    result->Nanoseconds =
+        std::chrono::duration<double, std::nano>(end - mStart).count();
+    result->Items = items;
+  }
+
+private:
+  std::chrono::steady_clock::time_point mStart;
+  uint64_t mAllocations = 0;
+};
+
+// ToneSource is a bus that costs next to nothing, so that mixer benchmarks
+// measure the mixer.
+class ToneSource : public MixerSource {
+public:
+  explicit ToneSource(double frequency) {
+    for (uint32_t i = 0; i < TableFrames; i++) {
+      mTable[i] = static_cast<float>(
+          0.25 * std::sin(2.0 * pi * frequency * i / SamplesPerSec));
+    }
+  }
+
+  void SetTargetSamplesPerSec(uint32_t samplesPerSec) override {}
+
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override {
+    for (uint32_t i = 0; i < frames; i++) {
+      float s = mTable[(position + i) % TableFrames];
+
+      for (uint16_t c = 0; c < channels; c++) {
+        *dst++ = s;
+      }
+    }
+
+    return 0;
+  }
+
+private:
+  static constexpr uint32_t TableFrames = 4800;
+
+  float mTable[TableFrames];
+};
+
+std::vector<float> makeNoise(size_t samples, uint32_t seed) {
+  std::vector<float> v(samples);
+  Noise noise(seed);
+
+  for (float &s : v) {
+    s = noise.Next() * 1.8f;
+  }
+
+  return v;
+}
+
+// Makes a short click with a decaying tail, the shape of a typical key sound.
+SFXWave makeWave(std::vector<float> *samples, uint32_t frames, uint32_t seed) {
+  Noise noise(seed);
+
+  samples->resize(frames * Channels);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    float envelope = std::exp(-6.0f * i / frames);
+
+    for (uint16_t c = 0; c < Channels; c++) {
+      (*samples)[i * Channels + c] = noise.Next() * envelope;
+    }
+  }
+
+  SFXWave wave;
+
+  wave.Samples = samples->data();
+  wave.IsOwned = false;
+  wave.Frames = frames;
+  wave.Channels = Channels;
+  wave.SamplesPerSec = SamplesPerSec;
+
+  return wave;
+}
+
+// Makes 16 bit mono speech stand-in: a gliding tone over noise.
+std::vector<int16_t> makeSpeech(uint32_t samplesPerSec, double seconds) {
+  uint32_t frames = static_cast<uint32_t>(samplesPerSec * seconds);
+  std::vector<int16_t> pcm(frames);
+  Noise noise(7);
+  double phase{0.0};
+
+  for (uint32_t i = 0; i < frames; i++) {
+    double frequency = 120.0 + 80.0 * std::sin(2.0 * pi * 3.0 * i /
+                                                samplesPerSec);
+
+    phase += 2.0 * pi * frequency / samplesPerSec;
+    pcm[i] = static_cast<int16_t>(6000.0 * std::sin(phase) +
+                                  1500.0 * noise.Next());
+  }
+
+  return pcm;
+}
+
+uint64_t framesFor(double seconds) {
+  uint64_t frames = static_cast<uint64_t>(SamplesPerSec * seconds);
+
+  return frames - frames % PeriodFrames + PeriodFrames;
+}
+
+void benchConvert(SampleFormat format, double seconds, Result *result) {
+  SampleWriter writer = ChooseSampleWriter(format, Channels);
+  std::vector<float> src = makeNoise(PeriodFrames * Channels, 1);
+  std::vector<uint8_t> dst(PeriodFrames * Channels * 4);
+  uint64_t frames = framesFor(seconds);
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    writer(src.data(), dst.data(), PeriodFrames, Channels);
+  }
+
+  probe.Stop(result, frames);
+}
+
+void benchMixKernel(bool isEnvelope, double seconds, Result *result) {
+  std::vector<float> src = makeNoise(PeriodFrames * Channels, 2);
+  std::vector<float> dst(PeriodFrames * Channels);
+  std::vector<float> envelope(PeriodFrames);
+  GainRamp ramp(0.0f);
+  uint64_t frames = framesFor(seconds);
+  Probe probe;
+
+  ramp.Start(1.0f, PeriodFrames, RampCurve::Linear);
+  ramp.Fill(envelope.data(), PeriodFrames);
+  probe.Start();
+
+  // Four buses per block, as many as the mixer holds.
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    for (int32_t bus = 0; bus < Mixer::MaxBuses; bus++) {
+      if (isEnvelope) {
+        MixAddEnvelope(dst.data(), src.data(), envelope.data(), PeriodFrames,
+                       Channels);
+      } else {
+        MixAdd(dst.data(), src.data(), 0.5f,
+               static_cast<size_t>(PeriodFrames) * Channels);
+      }
+    }
+  }
+
+  probe.Stop(result, frames);
+}
+
+void benchGainRamp(RampCurve curve, double seconds, Result *result) {
+  std::vector<float> envelope(PeriodFrames);
+  GainRamp ramp(1.0f);
+  uint64_t frames = framesFor(seconds);
+  float target{0.0f};
+  Probe probe;
+
+  probe.Start();
+
+  // A new 100 ms fade every ten blocks, changing course mid-ramp.
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    if (i % (PeriodFrames * 10) == 0) {
+      target = target > 0.5f ? 0.1f : 1.0f;
+      ramp.Start(target, SamplesPerSec / 10, curve);
+    }
+
+    ramp.Fill(envelope.data(), PeriodFrames);
+  }
+
+  probe.Stop(result, frames);
+}
+
+// Renders four tone buses through Mixer, Renderer and NullSink. With
+// isFading, every bus is ramped all the time and one bus ducks the others.
+void benchRenderLoop(bool isFading, SampleFormat format, double seconds,
+                     Result *result) {
+  ToneSource tones[Mixer::MaxBuses] = {ToneSource(220.0), ToneSource(330.0),
+                                       ToneSource(440.0), ToneSource(550.0)};
+  StreamFormat streamFormat;
+  Mixer mixer;
+  Renderer renderer(&mixer);
+
+  streamFormat.Format = format;
+  streamFormat.Channels = Channels;
+  streamFormat.SamplesPerSec = SamplesPerSec;
+
+  NullSink sink(streamFormat, PeriodFrames);
+  HeadlessDriver driver(&renderer, &sink, PeriodFrames, false);
+
+  for (ToneSource &tone : tones) {
+    mixer.AddBus(&tone, 0.5f);
+  }
+  if (isFading) {
+    DuckSettings ducking;
+
+    ducking.KeyBus = 0;
+
+    for (int32_t bus = 1; bus < Mixer::MaxBuses; bus++) {
+      mixer.SetDucking(bus, ducking);
+    }
+  }
+  if (!renderer.Open(streamFormat, PeriodFrames)) {
+    std::fprintf(stderr, "audionode_bench: failed to open renderer\n");
+    std::exit(1);
+  }
+
+  uint64_t frames = framesFor(seconds);
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    if (isFading && i % (PeriodFrames * 5) == 0) {
+      for (int32_t bus = 0; bus < Mixer::MaxBuses; bus++) {
+        float gain = (i / (PeriodFrames * 5) + bus) % 2 == 0 ? 0.2f : 0.8f;
+
+        mixer.RampGain(bus, gain, 0.05, RampCurve::Exponential);
+      }
+    }
+
+    driver.Run(PeriodFrames);
+  }
+
+  probe.Stop(result, driver.GetFramesRendered());
+}
+
+// Launches a key sound every 20 ms on an 8 voice SFXSource, so that voices
+// are stolen, and renders it through the mixer.
+void benchSFXLaunch(double seconds, Result *result) {
+  std::vector<float> samples[16];
+  SFXWave waves[16];
+  StreamFormat streamFormat;
+  SFXSource sfx(nullptr, 8, StealPolicy::Oldest);
+  Mixer mixer;
+  Renderer renderer(&mixer);
+
+  for (uint32_t i = 0; i < 16; i++) {
+    waves[i] = makeWave(&samples[i], SamplesPerSec / 10 + i * 1200, i + 1);
+  }
+
+  streamFormat.Format = SampleFormat::Float32;
+  streamFormat.Channels = Channels;
+  streamFormat.SamplesPerSec = SamplesPerSec;
+
+  NullSink sink(streamFormat, PeriodFrames);
+  HeadlessDriver driver(&renderer, &sink, PeriodFrames, false);
+
+  mixer.AddBus(&sfx, 1.0f);
+  renderer.Open(streamFormat, PeriodFrames);
+
+  uint64_t frames = framesFor(seconds);
+  uint32_t launched{0};
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    if ((i / PeriodFrames) % 2 == 0) {
+      float pan = static_cast<float>(launched % 5) * 0.5f - 1.0f;
+
+      sfx.Play(&waves[launched % 16], 0.8f, pan, mixer.GetPosition());
+      launched += 1;
+    }
+
+    driver.Run(PeriodFrames);
+  }
+
+  probe.Stop(result, driver.GetFramesRendered());
+}
+
+// Pushes commands with text into a CommandRing and pops them on the same
+// thread. Counts commands rather than frames.
+void benchRingFeed(double seconds, Result *result) {
+  CommandRing ring(64, OverflowPolicy::DropOldest, 4096, 65536);
+  const wchar_t *texts[] = {L"a", L"space", L"Hello, world.",
+                            L"The quick brown fox jumps over the lazy dog."};
+  // About one command per keystroke at 10 keys per second, scaled up so
+  // that the run is long enough to time.
+  uint64_t commands = static_cast<uint64_t>(seconds * 100000);
+  QueuedCommand cmd;
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t i = 0; i < commands; i++) {
+    if (i % 4 == 0) {
+      ring.Push(1, static_cast<int16_t>(i % 16), 0.0, nullptr);
+    } else {
+      ring.Push(3, 0, 0.0, texts[i % 4]);
+    }
+    if (i % 8 == 7) {
+      while (ring.Pop(&cmd)) {
+        ring.GetText(cmd);
+        ring.ReleaseText(cmd);
+      }
+    }
+  }
+
+  probe.Stop(result, commands);
+}
+
+// Queues commands into the ring as the command pipe receives them: as
+// binary frames read 4 KiB at a time, decoded and pushed by CommandChannel.
+class RingSink : public CommandSink {
+public:
+  explicit RingSink(CommandRing *ring) : mRing(ring) {}
+
+  int32_t Push(Command **commands, int32_t length,
+               bool isForcePush) override {
+    for (int32_t i = 0; i < length; i++) {
+      PushCommand(mRing, *commands[i], 0);
+    }
+
+    return 0;
+  }
+
+private:
+  CommandRing *mRing = nullptr;
+};
+
+void benchRingChannel(double seconds, Result *result) {
+  CommandRing ring(64, OverflowPolicy::DropOldest, 4096, 65536);
+  RingSink sink(&ring);
+  CommandChannel channel(&sink);
+  const wchar_t *texts[] = {L"a", L"space", L"Hello, world.",
+                            L"The quick brown fox jumps over the lazy dog."};
+  std::vector<uint8_t> stream;
+
+  // One keystroke per frame, a key sound with its word every fourth.
+  for (uint32_t i = 0; i < 1024; i++) {
+    Command c[2]{};
+    const Command *pointers[2] = {&c[0], &c[1]};
+
+    c[0].Type = 1;
+    c[0].SFXIndex = static_cast<int16_t>(i % 16 + 1);
+    c[0].Gain = 1.0f;
+    c[1].Type = 3;
+    c[1].Text = const_cast<wchar_t *>(texts[i % 4]);
+    c[1].Gain = 1.0f;
+
+    EncodeCommandFrame(pointers, i % 4 == 3 ? 2 : 1, 0, i, &stream);
+  }
+
+  uint64_t commands = static_cast<uint64_t>(seconds * 100000);
+  uint64_t perStream = 1024 + 256;
+  QueuedCommand cmd;
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t done = 0; done < commands; done += perStream) {
+    for (size_t offset = 0; offset < stream.size(); offset += 4096) {
+      channel.Receive(stream.data() + offset,
+                      std::min<size_t>(4096, stream.size() - offset));
+
+      while (ring.Pop(&cmd)) {
+        ring.GetText(cmd);
+        ring.ReleaseText(cmd);
+      }
+    }
+  }
+
+  probe.Stop(result, (commands + perStream - 1) / perStream * perStream);
+}
+
+// The whole pipeline as the DLL runs it: commands go through the ring, text
+// starts a resampled voice stream fed in pieces, key sounds go to an 8 voice
+// SFXSource ducked under the voice, and both are mixed and written as 16 bit
+// stereo.
+void benchPipeline(double seconds, Result *result) {
+  std::vector<float> samples[16];
+  SFXWave waves[16];
+  std::vector<int16_t> speech = makeSpeech(22050, 1.5);
+  StreamFormat speechFormat;
+  StreamFormat streamFormat;
+  CommandRing ring(64, OverflowPolicy::DropOldest, 4096, 65536);
+  StreamSource voice(65536);
+  SFXSource sfx(nullptr, 8, StealPolicy::Oldest);
+  Mixer mixer;
+  Renderer renderer(&mixer);
+  DuckSettings ducking;
+
+  for (uint32_t i = 0; i < 16; i++) {
+    waves[i] = makeWave(&samples[i], SamplesPerSec / 10 + i * 1200, i + 1);
+  }
+
+  speechFormat.Format = SampleFormat::Int16;
+  speechFormat.Channels = 1;
+  speechFormat.SamplesPerSec = 22050;
+
+  streamFormat.Format = SampleFormat::Int16;
+  streamFormat.Channels = Channels;
+  streamFormat.SamplesPerSec = SamplesPerSec;
+
+  NullSink sink(streamFormat, PeriodFrames);
+  HeadlessDriver driver(&renderer, &sink, PeriodFrames, false);
+
+  mixer.AddBus(&voice, 1.0f);
+  mixer.AddBus(&sfx, 1.0f);
+  mixer.SetResampleQuality(0, ResampleQuality::LongSinc);
+  mixer.SetResampleQuality(1, ResampleQuality::ShortSinc);
+  ducking.KeyBus = 0;
+  mixer.SetDucking(1, ducking);
+  renderer.Open(streamFormat, PeriodFrames);
+
+  const char *pcm = reinterpret_cast<const char *>(speech.data());
+  uint32_t pcmBytes = static_cast<uint32_t>(speech.size() * sizeof(int16_t));
+  uint32_t written{0};
+  bool isFeeding{false};
+  uint64_t frames = framesFor(seconds);
+  QueuedCommand cmd;
+  Probe probe;
+
+  probe.Start();
+
+  for (uint64_t i = 0; i < frames; i += PeriodFrames) {
+    uint64_t period = i / PeriodFrames;
+
+    // A key sound every 50 ms and a phrase every 2 s.
+    if (period % 5 == 0) {
+      ring.Push(1, static_cast<int16_t>(period % 16), 0.0, nullptr);
+    }
+    if (period % 200 == 0) {
+      ring.Push(3, 0, 0.0, L"The quick brown fox jumps over the lazy dog.");
+    }
+    while (ring.Pop(&cmd)) {
+      if (cmd.Type == 1) {
+        sfx.Play(&waves[cmd.SFXIndex], 0.8f, 0.0f, mixer.GetPosition());
+      } else if (cmd.Type == 3 && !isFeeding) {
+        ring.GetText(cmd);
+
+        if (voice.Begin(speechFormat, mixer.GetPosition())) {
+          isFeeding = true;
+          written = 0;
+        }
+      }
+
+      ring.ReleaseText(cmd);
+    }
+
+    if (isFeeding) {
+      written += voice.Write(pcm + written, pcmBytes - written);
+
+      if (written == pcmBytes) {
+        voice.End();
+        isFeeding = false;
+      }
+    }
+
+    driver.Run(PeriodFrames);
+  }
+
+  probe.Stop(result, driver.GetFramesRendered());
+}
+
+struct Benchmark {
+  const char *Name;
+  void (*Run)(double seconds, Result *result);
+};
+
+const Benchmark benchmarks[] = {
+    {"convert/int16",
+     [](double s, Result *r) { benchConvert(SampleFormat::Int16, s, r); }},
+    {"convert/int24",
+     [](double s, Result *r) { benchConvert(SampleFormat::Int24, s, r); }},
+    {"convert/int32",
+     [](double s, Result *r) { benchConvert(SampleFormat::Int32, s, r); }},
+    {"convert/float32",
+     [](double s, Result *r) { benchConvert(SampleFormat::Float32, s, r); }},
+    {"mix/add", [](double s, Result *r) { benchMixKernel(false, s, r); }},
+    {"mix/envelope", [](double s, Result *r) { benchMixKernel(true, s, r); }},
+    {"fade/linear",
+     [](double s, Result *r) { benchGainRamp(RampCurve::Linear, s, r); }},
+    {"fade/exponential",
+     [](double s, Result *r) { benchGainRamp(RampCurve::Exponential, s, r); }},
+    {"render/steady",
+     [](double s, Result *r) {
+       benchRenderLoop(false, SampleFormat::Int16, s, r);
+     }},
+    {"render/fading",
+     [](double s, Result *r) {
+       benchRenderLoop(true, SampleFormat::Int16, s, r);
+     }},
+    {"render/float32",
+     [](double s, Result *r) {
+       benchRenderLoop(false, SampleFormat::Float32, s, r);
+     }},
+    {"sfx/launch", benchSFXLaunch},
+    {"ring/feed",
+     [](double s, Result *r) {
+       benchRingFeed(s, r);
+       r->Unit = "command";
+     }},
+    {"ring/channel",
+     [](double s, Result *r) {
+       benchRingChannel(s, r);
+       r->Unit = "command";
+     }},
+    {"pipeline", benchPipeline},
+};
+
+// Reads the ns per item of each benchmark in a file written by -o.
+bool readBaseline(const char *path, std::map<std::string, double> *baseline) {
+  FILE *file = std::fopen(path, "r");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  char line[512];
+
+  while (std::fgets(line, sizeof(line), file) != nullptr) {
+    char name[128];
+    char unit[32];
+    unsigned long long items{};
+    double perItem{};
+
+    if (line[0] == '#' ||
+        std::sscanf(line, "%127s %31s %llu %lf", name, unit, &items,
+                    &perItem) != 4) {
+      continue;
+    }
+
+    (*baseline)[name] = perItem;
+  }
+
+  std::fclose(file);
+
+  return true;
+}
+
+bool writeResults(const char *path, const std::vector<Result> &results,
+                  double seconds, int repeats) {
+  FILE *file = std::fopen(path, "w");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  std::fprintf(file, "# audionode_bench seconds=%g repeats=%d\n", seconds,
+               repeats);
+  std::fprintf(file, "# name\tunit\titems\tns_per_item\tallocations\t"
+                     "cache_misses\n");
+
+  for (const Result &result : results) {
+    std::fprintf(file, "%s\t%s\t%llu\t%.3f\t%llu\t%lld\n", result.Name.c_str(),
+                 result.Unit, static_cast<unsigned long long>(result.Items),
+                 result.PerItem(),
+                 static_cast<unsigned long long>(result.Allocations),
+                 cacheCounter->IsAvailable()
+                     ? static_cast<long long>(result.CacheMisses)
+                     : -1LL);
+  }
+
+  std::fclose(file);
+
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  double seconds{60.0};
+  int repeats{3};
+  const char *filter{nullptr};
+  const char *outputPath{nullptr};
+  const char *baselinePath{nullptr};
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seconds = std::atof(argv[++i]);
+    } else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      repeats = std::atoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (seconds <= 0.0 || repeats <= 0) {
+    usage();
+    return 2;
+  }
+
+  std::map<std::string, double> baseline;
+
+  if (baselinePath != nullptr && !readBaseline(baselinePath, &baseline)) {
+    std::fprintf(stderr, "audionode_bench: cannot read %s\n", baselinePath);
+    return 1;
+  }
+
+  CacheCounter counter;
+
+  cacheCounter = &counter;
+
+  if (!counter.IsAvailable()) {
+    std::fprintf(stderr,
+                 "audionode_bench: cache misses are not available here\n");
+  }
+
+  std::vector<Result> results;
+
+  std::printf("%-18s %10s %10s %8s %12s %12s %9s\n", "benchmark", "ns/item",
+              "realtime", "unit", "allocations", "cache miss", "change");
+
+  for (const Benchmark &benchmark : benchmarks) {
+    if (filter != nullptr && std::strstr(benchmark.Name, filter) == nullptr) {
+      continue;
+    }
+
+    Result best;
+
+    // The fastest run is the one least disturbed by the rest of the system.
+    for (int i = 0; i < repeats; i++) {
+      Result result;
+
+      benchmark.Run(seconds, &result);
+
+      if (i == 0 || result.PerItem() < best.PerItem()) {
+        best = result;
+      }
+    }
+
+    best.Name = benchmark.Name;
+
+    char realtime[16] = "-";
+    char misses[24] = "-";
+    char change[16] = "";
+
+    if (std::strcmp(best.Unit, "frame") == 0 && best.PerItem() > 0.0) {
+      std::snprintf(realtime, sizeof(realtime), "%.0fx",
+                    1e9 / best.PerItem() / SamplesPerSec);
+    }
+    if (counter.IsAvailable()) {
+      std::snprintf(misses, sizeof(misses), "%llu",
+                    static_cast<unsigned long long>(best.CacheMisses));
+    }
+
+    auto it = baseline.find(best.Name);
+
+    if (it != baseline.end() && it->second > 0.0) {
+      std::snprintf(change, sizeof(change), "%+.1f%%",
+                    (best.PerItem() / it->second - 1.0) * 100.0);
+    }
+
+    std::printf("%-18s %10.2f %10s %8s %12llu %12s %9s\n", best.Name.c_str(),
+                best.PerItem(), realtime, best.Unit,
+                static_cast<unsigned long long>(best.Allocations), misses,
+                change);
+    std::fflush(stdout);
+
+    results.push_back(best);
+  }
+
+  if (outputPath != nullptr &&
+      !writeResults(outputPath, results, seconds, repeats)) {
+    std::fprintf(stderr, "audionode_bench: cannot write %s\n", outputPath);
+    return 1;
+  }
+
+  return 0;
+}
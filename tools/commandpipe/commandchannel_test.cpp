@@ -0,0 +1,345 @@
+// Sends command frames through CommandChannel into a CommandRing, the way
+// the command pipe does, both fed piece by piece and over a Unix domain
+// socket that stands in for the named pipe.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "check.h"
+#include "commandchannel.h"
+#include "commandring.h"
+
+namespace {
+// Queues batches the way the DLL does.
+class RingSink : public CommandSink {
+public:
+  explicit RingSink(uint32_t capacity)
+      : Ring(capacity, OverflowPolicy::Reject, 4096, 65536) {}
+
+  int32_t Push(Command **commands, int32_t length,
+               bool isForcePush) override {
+    Batches += 1;
+
+    if (length <= 0) {
+      return -1;
+    }
+    if (isForcePush) {
+      Ring.BeginForcePush();
+    }
+    for (int32_t i = 0; i < length; i++) {
+      if (!PushCommand(&Ring, *commands[i], 0)) {
+        return -2;
+      }
+    }
+
+    return 0;
+  }
+
+  CommandRing Ring;
+  int Batches = 0;
+};
+
+Command sfx(int16_t index, float gain = 1.0f, float pan = 0.0f) {
+  Command c{};
+
+  c.Type = 1;
+  c.SFXIndex = index;
+  c.Gain = gain;
+  c.Pan = pan;
+
+  return c;
+}
+
+Command wait(double seconds) {
+  Command c{};
+
+  c.Type = 2;
+  c.WaitDuration = seconds;
+  c.Gain = 1.0f;
+
+  return c;
+}
+
+Command text(int16_t type, const wchar_t *s) {
+  Command c{};
+
+  c.Type = type;
+  c.Text = const_cast<wchar_t *>(s);
+  c.Gain = 1.0f;
+
+  return c;
+}
+
+void encode(std::vector<Command> commands, uint8_t flags, uint32_t sequence,
+            std::vector<uint8_t> *frame) {
+  std::vector<const Command *> pointers;
+
+  for (const Command &c : commands) {
+    pointers.push_back(&c);
+  }
+
+  EncodeCommandFrame(pointers.data(), static_cast<uint16_t>(pointers.size()),
+                     flags, sequence, frame);
+}
+
+uint32_t getU32(const uint8_t *p) {
+  uint32_t value;
+
+  std::memcpy(&value, p, sizeof(value));
+
+  return value;
+}
+
+void testCommands() {
+  RingSink sink(16);
+  CommandChannel channel(&sink);
+  std::vector<uint8_t> frame;
+  std::vector<uint8_t> replies;
+
+  encode({sfx(3, 0.5f, -1.0f), wait(0.25), text(3, L"héllo \U0001F600"),
+          text(4, nullptr), text(9, L"unknown")},
+         CommandFrameReply, 7, &frame);
+
+  // One byte at a time, so that every field is split at least once.
+  for (size_t i = 0; i < frame.size(); i++) {
+    CHECK(channel.Receive(&frame[i], 1));
+    CHECK(channel.GetFrameCount() == (i + 1 == frame.size() ? 1u : 0u));
+  }
+
+  CHECK(sink.Batches == 1);
+  CHECK(channel.TakeReplies(&replies));
+  CHECK(replies.size() == 12);
+  CHECK(getU32(replies.data()) == 8);
+  CHECK(getU32(replies.data() + 4) == 7);
+  CHECK(getU32(replies.data() + 8) == 0);
+  CHECK(!channel.TakeReplies(&replies));
+  CHECK(replies.empty());
+
+  QueuedCommand cmd;
+
+  CHECK(sink.Ring.Pop(&cmd));
+  CHECK(cmd.Type == 1 && cmd.SFXIndex == 2);
+  CHECK(cmd.Gain == 0.5f && cmd.Pan == -1.0f);
+  CHECK(sink.Ring.Pop(&cmd));
+  CHECK(cmd.Type == 2 && cmd.WaitDuration == 0.25);
+  CHECK(sink.Ring.Pop(&cmd));
+  CHECK(cmd.Type == 3 && cmd.HasText);
+  CHECK(std::wstring(sink.Ring.GetText(cmd)) == L"héllo \U0001F600");
+  sink.Ring.ReleaseText(cmd);
+  CHECK(sink.Ring.Pop(&cmd));
+  CHECK(cmd.Type == 4 && !cmd.HasText);
+  // Unknown types are skipped, as Push does.
+  CHECK(!sink.Ring.Pop(&cmd));
+}
+
+void testPieces() {
+  RingSink sink(1024);
+  CommandChannel channel(&sink);
+  std::vector<uint8_t> stream;
+  const wchar_t *words[] = {L"a", L"space", L"", L"The quick brown fox"};
+
+  for (int i = 0; i < 300; i++) {
+    if (i % 3 == 0) {
+      encode({text(3, words[i % 4]), sfx(static_cast<int16_t>(i % 100 + 1))},
+             0, i, &stream);
+    } else {
+      encode({sfx(static_cast<int16_t>(i % 100 + 1))}, 0, i, &stream);
+    }
+  }
+
+  // Pieces of every size up to a few frames.
+  size_t offset{0};
+
+  for (size_t n = 1; offset < stream.size(); n = n % 97 + 1) {
+    size_t length = std::min(n, stream.size() - offset);
+
+    CHECK(channel.Receive(stream.data() + offset, length));
+    offset += length;
+  }
+
+  CHECK(channel.GetFrameCount() == 300);
+  CHECK(sink.Batches == 300);
+
+  QueuedCommand cmd;
+
+  for (int i = 0; i < 300; i++) {
+    if (i % 3 == 0) {
+      CHECK(sink.Ring.Pop(&cmd));
+      CHECK(cmd.Type == 3);
+      CHECK(std::wstring(sink.Ring.GetText(cmd)) == words[i % 4]);
+      sink.Ring.ReleaseText(cmd);
+    }
+
+    CHECK(sink.Ring.Pop(&cmd));
+    CHECK(cmd.Type == 1 && cmd.SFXIndex == i % 100);
+  }
+
+  CHECK(!sink.Ring.Pop(&cmd));
+}
+
+void testForcePush() {
+  RingSink sink(16);
+  CommandChannel channel(&sink);
+  std::vector<uint8_t> frames;
+
+  encode({sfx(1), wait(1.0), sfx(2)}, 0, 0, &frames);
+  encode({sfx(3)}, CommandFrameForcePush, 1, &frames);
+  CHECK(channel.Receive(frames.data(), frames.size()));
+
+  QueuedCommand cmd;
+
+  CHECK(sink.Ring.Pop(&cmd));
+  CHECK(cmd.SFXIndex == 2);
+  CHECK(!sink.Ring.Pop(&cmd));
+  CHECK(sink.Ring.GetSkippedCount() == 3);
+}
+
+void testBroken() {
+  RingSink sink(16);
+  CommandChannel channel(&sink);
+  std::vector<uint8_t> frame;
+  std::vector<uint8_t> good;
+
+  encode({sfx(1)}, 0, 0, &good);
+
+  // Too large.
+  uint32_t length = MaxCommandFrameBytes + 1;
+
+  frame.resize(4);
+  std::memcpy(frame.data(), &length, 4);
+  CHECK(channel.Receive(good.data(), good.size()));
+  CHECK(!channel.Receive(frame.data(), frame.size()));
+  CHECK(channel.IsBroken());
+  CHECK(!channel.Receive(good.data(), good.size()));
+  CHECK(sink.Batches == 1);
+
+  // A new connection starts over.
+  channel.Reset();
+  CHECK(!channel.IsBroken());
+  CHECK(channel.Receive(good.data(), good.size()));
+  CHECK(sink.Batches == 2);
+
+  // Another version.
+  frame = good;
+  frame[4] = 2;
+  CHECK(!channel.Receive(frame.data(), frame.size()));
+  channel.Reset();
+
+  // More commands than the frame holds.
+  frame = good;
+  frame[6] = 2;
+  CHECK(!channel.Receive(frame.data(), frame.size()));
+  channel.Reset();
+
+  // Text running past the end of the frame.
+  frame.clear();
+  encode({text(3, L"abc")}, 0, 0, &frame);
+  frame[frame.size() - 10] = 200;
+  CHECK(!channel.Receive(frame.data(), frame.size()));
+  channel.Reset();
+
+  // Bytes left over after the commands.
+  frame = good;
+  frame.push_back(0);
+  frame[0] += 1;
+  CHECK(!channel.Receive(frame.data(), frame.size()));
+  CHECK(sink.Batches == 2);
+}
+
+// The client sends frames and reads the replies over a socket while a
+// server thread reads the other end, as the pipe loop does.
+void testLoopback() {
+  int fds[2];
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    std::perror("socketpair");
+    failures += 1;
+    return;
+  }
+
+  RingSink sink(1024);
+  bool isServerBroken{false};
+
+  std::thread server([&]() {
+    CommandChannel channel(&sink);
+    std::vector<uint8_t> replies;
+    char buffer[4096];
+
+    while (true) {
+      ssize_t n = read(fds[1], buffer, sizeof(buffer));
+
+      if (n <= 0) {
+        break;
+      }
+      if (!channel.Receive(buffer, static_cast<size_t>(n))) {
+        isServerBroken = true;
+        break;
+      }
+      if (channel.TakeReplies(&replies) &&
+          write(fds[1], replies.data(), replies.size()) !=
+              static_cast<ssize_t>(replies.size())) {
+        break;
+      }
+    }
+
+    close(fds[1]);
+  });
+
+  constexpr uint32_t Frames = 500;
+  std::vector<uint8_t> received;
+
+  for (uint32_t i = 0; i < Frames; i++) {
+    std::vector<uint8_t> frame;
+
+    encode({sfx(static_cast<int16_t>(i % 50 + 1))},
+           i % 10 == 9 ? CommandFrameReply : 0, i, &frame);
+
+    CHECK(write(fds[0], frame.data(), frame.size()) ==
+          static_cast<ssize_t>(frame.size()));
+  }
+
+  shutdown(fds[0], SHUT_WR);
+
+  char buffer[256];
+  ssize_t n;
+
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+    received.insert(received.end(), buffer, buffer + n);
+  }
+
+  server.join();
+  close(fds[0]);
+
+  CHECK(!isServerBroken);
+  CHECK(sink.Batches == static_cast<int>(Frames));
+  CHECK(received.size() == Frames / 10 * 12);
+
+  for (size_t i = 0; i + 12 <= received.size(); i += 12) {
+    CHECK(getU32(received.data() + i + 4) == (i / 12) * 10 + 9);
+    CHECK(getU32(received.data() + i + 8) == 0);
+  }
+
+  QueuedCommand cmd;
+
+  for (uint32_t i = 0; i < Frames; i++) {
+    CHECK(sink.Ring.Pop(&cmd));
+    CHECK(cmd.SFXIndex == static_cast<int16_t>(i % 50));
+  }
+}
+} // namespace
+
+int main() {
+  testCommands();
+  testPieces();
+  testForcePush();
+  testBroken();
+  testLoopback();
+
+  return TestResult();
+}
@@ -0,0 +1,193 @@
+// Checks that CommandRing drops the oldest commands and their text when it
+// overflows, that popped text stays put until it is released, and that a
+// consumer popping while the producer drops never sees a torn command. The
+// stress test is meant to be run under ThreadSanitizer too.
+
+#include <cwchar>
+#include <string>
+#include <thread>
+
+#include "check.h"
+#include "commandring.h"
+
+namespace {
+// Every field is derived from i, so a command mixed from two pushes shows.
+bool push(CommandRing *ring, uint32_t i) {
+  if (i % 2 == 0) {
+    return ring->Push(1, static_cast<int16_t>(i % 1000), i, nullptr,
+                      static_cast<float>(i % 997), 0.0f, i);
+  }
+
+  std::wstring text = L"command " + std::to_wstring(i);
+
+  return ring->Push(3, 0, i, text.c_str(), 1.0f, 0.0f, i);
+}
+
+// Releases the text of cmd once it is checked.
+bool isIntact(CommandRing &ring, const QueuedCommand &cmd) {
+  uint32_t i = static_cast<uint32_t>(cmd.WaitDuration);
+
+  if (cmd.PushTime != i) {
+    return false;
+  }
+  if (i % 2 == 0) {
+    return cmd.Type == 1 && cmd.SFXIndex == static_cast<int16_t>(i % 1000) &&
+           cmd.Gain == static_cast<float>(i % 997) && !cmd.HasText;
+  }
+
+  bool isText = cmd.Type == 3 && cmd.HasText &&
+                std::wstring(ring.GetText(cmd)) ==
+                    L"command " + std::to_wstring(i);
+
+  ring.ReleaseText(cmd);
+
+  return isText;
+}
+
+void testDropOldest() {
+  CommandRing ring(4, OverflowPolicy::DropOldest, 64, 64);
+
+  for (uint32_t i = 0; i < 10; i++) {
+    CHECK(push(&ring, i));
+  }
+
+  CHECK(ring.GetDroppedCount() == 6);
+  CHECK(!ring.IsEmpty());
+
+  QueuedCommand cmd;
+
+  for (uint32_t i = 6; i < 10; i++) {
+    CHECK(ring.Pop(&cmd));
+    CHECK(cmd.WaitDuration == i);
+    CHECK(isIntact(ring, cmd));
+  }
+
+  CHECK(!ring.Pop(&cmd));
+  CHECK(ring.IsEmpty());
+}
+
+// The text arena fills long before the ring does. The oldest commands are
+// dropped to free it instead of rejecting the new one.
+void testTextOverflow() {
+  CommandRing ring(1024, OverflowPolicy::DropOldest, 64, 64);
+
+  for (uint32_t i = 1; i < 2000; i += 2) {
+    CHECK(push(&ring, i));
+  }
+
+  CHECK(ring.GetRejectedCount() == 0);
+  CHECK(ring.GetDroppedCount() > 900);
+  CHECK(ring.GetTextCapacity() == 64);
+
+  QueuedCommand cmd;
+  uint32_t popped{0};
+  double last{0.0};
+
+  while (ring.Pop(&cmd)) {
+    CHECK(cmd.WaitDuration > last);
+    CHECK(isIntact(ring, cmd));
+    last = cmd.WaitDuration;
+    popped += 1;
+  }
+
+  CHECK(last == 1999);
+  CHECK(popped + ring.GetDroppedCount() == 1000);
+
+  // Text longer than the arena can never fit.
+  std::wstring text(100, L'x');
+
+  CHECK(!ring.Push(3, 0, 0.0, text.c_str()));
+  CHECK(ring.GetRejectedCount() == 1);
+}
+
+// The text of a popped command survives the producer dropping the commands
+// after it. Their text is not reused while it is held, so the arena fills
+// up and text is rejected until it is released.
+void testTextAfterDrop() {
+  CommandRing ring(2, OverflowPolicy::DropOldest, 64, 64);
+  QueuedCommand cmd;
+  QueuedCommand next;
+  uint32_t i{3};
+
+  CHECK(push(&ring, 1));
+  CHECK(ring.Pop(&cmd));
+
+  for (; i < 40 && push(&ring, i); i += 2) {
+  }
+
+  CHECK(i < 40);
+  CHECK(ring.GetRejectedCount() == 1);
+  CHECK(std::wstring(ring.GetText(cmd)) == L"command 1");
+  CHECK(push(&ring, 0));
+
+  ring.ReleaseText(cmd);
+
+  CHECK(push(&ring, i));
+  CHECK(ring.Pop(&next));
+  CHECK(next.WaitDuration == 0 && isIntact(ring, next));
+  CHECK(ring.Pop(&next));
+  CHECK(next.WaitDuration == i && isIntact(ring, next));
+  CHECK(!ring.Pop(&next));
+}
+
+void testStress() {
+  constexpr uint32_t Commands = 200000;
+  CommandRing ring(16, OverflowPolicy::DropOldest, 256, 256);
+  uint32_t popped{0};
+  bool isOrdered{true};
+  bool isIntactAll{true};
+
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < Commands; i++) {
+      if (!push(&ring, i)) {
+        break;
+      }
+    }
+  });
+
+  QueuedCommand cmd;
+  double last{-1.0};
+
+  // Pops in bursts, so that the ring keeps overflowing.
+  while (true) {
+    bool isDone = ring.GetRejectedCount() > 0;
+
+    while (ring.Pop(&cmd)) {
+      isOrdered = isOrdered && cmd.WaitDuration > last;
+      isIntactAll = isIntactAll && isIntact(ring, cmd);
+      last = cmd.WaitDuration;
+      popped += 1;
+    }
+    if (isDone || last == Commands - 1) {
+      break;
+    }
+
+    std::this_thread::yield();
+  }
+
+  producer.join();
+
+  while (ring.Pop(&cmd)) {
+    isOrdered = isOrdered && cmd.WaitDuration > last;
+    isIntactAll = isIntactAll && isIntact(ring, cmd);
+    last = cmd.WaitDuration;
+    popped += 1;
+  }
+
+  CHECK(isOrdered);
+  CHECK(isIntactAll);
+  CHECK(ring.GetRejectedCount() == 0);
+  CHECK(last == Commands - 1);
+  CHECK(popped + ring.GetDroppedCount() == Commands);
+  CHECK(ring.GetTextHighWatermark() <= 256);
+}
+} // namespace
+
+int main() {
+  testDropOldest();
+  testTextOverflow();
+  testTextAfterDrop();
+  testStress();
+
+  return TestResult();
+}
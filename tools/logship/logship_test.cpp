@@ -0,0 +1,180 @@
+// Drives LogShipper with a fake clock against a stand-in receiver that
+// records every batch and fails on request.
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "logshipper.h"
+
+namespace {
+typedef LogShipper::Clock Clock;
+typedef std::chrono::milliseconds ms;
+
+class Receiver : public LogTransport {
+public:
+  bool Send(const std::string &body) override {
+    Attempts += 1;
+
+    if (IsDown) {
+      return false;
+    }
+
+    Batches.push_back(body);
+
+    return true;
+  }
+
+  bool IsDown = false;
+  int Attempts = 0;
+  std::vector<std::string> Batches;
+};
+
+std::string entry(int i) { return "{\"n\":" + std::to_string(i) + "}"; }
+
+void testDeadline() {
+  Receiver receiver;
+  LogShipper shipper(&receiver);
+  Clock::time_point t0 = Clock::now();
+
+  CHECK(shipper.GetWait(t0) == Clock::duration::max());
+
+  for (int i = 0; i < 3; i++) {
+    shipper.Append(entry(i), t0);
+  }
+
+  CHECK(shipper.GetWait(t0) == ms(2000));
+
+  shipper.Ship(t0 + ms(1999));
+  CHECK(receiver.Attempts == 0);
+
+  shipper.Ship(t0 + ms(2000));
+  CHECK(receiver.Batches.size() == 1);
+  CHECK(receiver.Batches[0] == "[{\"n\":0},{\"n\":1},{\"n\":2}]");
+  CHECK(shipper.GetQueuedCount() == 0);
+  CHECK(shipper.GetSentCount() == 3);
+}
+
+void testThreshold() {
+  Receiver receiver;
+  LogShipperOptions options;
+
+  options.BatchEntries = 4;
+
+  LogShipper shipper(&receiver, options);
+  Clock::time_point t0 = Clock::now();
+
+  for (int i = 0; i < 10; i++) {
+    shipper.Append(entry(i), t0);
+  }
+
+  CHECK(shipper.GetWait(t0) == Clock::duration::zero());
+
+  // Two full batches go now; the rest waits for the deadline.
+  shipper.Ship(t0);
+  CHECK(receiver.Batches.size() == 2);
+  CHECK(shipper.GetQueuedCount() == 2);
+  CHECK(shipper.GetWait(t0) == ms(2000));
+}
+
+void testBatchBytes() {
+  Receiver receiver;
+  LogShipperOptions options;
+
+  options.MaxBatchBytes = 24;
+
+  LogShipper shipper(&receiver, options);
+  Clock::time_point t0 = Clock::now();
+
+  shipper.SetFraming("{\"m\":[", "]}");
+  shipper.Append(entry(1), t0);
+  shipper.Append(entry(2), t0);
+  shipper.Append(std::string(40, ' '), t0);
+  shipper.Ship(t0 + ms(2000));
+
+  CHECK(receiver.Batches.size() == 2);
+  CHECK(receiver.Batches[0] == "{\"m\":[{\"n\":1},{\"n\":2}]}");
+  // An entry longer than a batch still goes, on its own.
+  CHECK(receiver.Batches[1].size() == 48);
+
+  for (const std::string &batch : receiver.Batches) {
+    CHECK(batch.size() <= 24 || batch == receiver.Batches[1]);
+  }
+}
+
+void testBackoff() {
+  Receiver receiver;
+  LogShipper shipper(&receiver);
+  Clock::time_point t = Clock::now();
+
+  shipper.Append(entry(0), t);
+  receiver.IsDown = true;
+  t += ms(2000);
+
+  // Waits double from 500 ms up to 30 s.
+  ms waits[] = {ms(500),   ms(1000),  ms(2000),  ms(4000),
+                ms(8000),  ms(16000), ms(30000), ms(30000)};
+
+  for (ms wait : waits) {
+    int attempts = receiver.Attempts;
+
+    shipper.Ship(t);
+    CHECK(receiver.Attempts == attempts + 1);
+    CHECK(shipper.GetWait(t) == wait);
+
+    shipper.Ship(t + wait - ms(1));
+    CHECK(receiver.Attempts == attempts + 1);
+
+    t += wait;
+  }
+
+  CHECK(shipper.GetQueuedCount() == 1);
+  CHECK(shipper.GetFailedCount() == 8);
+
+  receiver.IsDown = false;
+  shipper.Ship(t);
+  CHECK(receiver.Batches.size() == 1);
+
+  // Success resets the backoff.
+  shipper.Append(entry(1), t);
+  receiver.IsDown = true;
+  shipper.Ship(t + ms(2000));
+  CHECK(shipper.GetWait(t + ms(2000)) == ms(500));
+}
+
+void testDrops() {
+  Receiver receiver;
+  LogShipperOptions options;
+
+  options.BatchEntries = 4;
+  options.MaxEntries = 8;
+
+  LogShipper shipper(&receiver, options);
+  Clock::time_point t0 = Clock::now();
+
+  receiver.IsDown = true;
+
+  for (int i = 0; i < 20; i++) {
+    shipper.Append(entry(i), t0);
+  }
+
+  CHECK(shipper.GetQueuedCount() == 8);
+  CHECK(shipper.GetDroppedCount() == 12);
+
+  receiver.IsDown = false;
+  shipper.Ship(t0);
+  CHECK(receiver.Batches.size() == 2);
+  CHECK(receiver.Batches[0].find(entry(12)) == 1);
+  CHECK(shipper.GetSentCount() == 8);
+}
+} // namespace
+
+int main() {
+  testDeadline();
+  testThreshold();
+  testBatchBytes();
+  testBackoff();
+  testDrops();
+
+  return TestResult();
+}
@@ -0,0 +1,253 @@
+// Renders Mixer offline and checks its gain frame by frame: how long ramps
+// take and the frame they start on, also inside a block, and when ducking
+// attacks, holds and releases.
+
+#include <cmath>
+#include <vector>
+
+#include "check.h"
+#include "mixer.h"
+
+namespace {
+constexpr uint32_t SamplesPerSec = 48000;
+constexpr uint32_t BlockFrames = 256;
+
+// Plays 1 on every channel.
+class ConstantSource : public MixerSource {
+public:
+  void SetTargetSamplesPerSec(uint32_t samplesPerSec) override {}
+
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override {
+    for (uint32_t i = 0; i < frames * channels; i++) {
+      dst[i] = 1.0f;
+    }
+
+    return 0;
+  }
+};
+
+// Plays in the blocks that start within one of its intervals, and is silent
+// otherwise.
+class KeySource : public ConstantSource {
+public:
+  struct Interval {
+    uint64_t On;
+    uint64_t Off;
+  };
+
+  KeySource(std::vector<Interval> intervals) : mIntervals(intervals) {}
+
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override {
+    mIsSilent = true;
+
+    for (const Interval &interval : mIntervals) {
+      if (position >= interval.On && position < interval.Off) {
+        mIsSilent = false;
+      }
+    }
+
+    return ConstantSource::Render(dst, position, frames, channels);
+  }
+
+  bool IsSilent() const override { return mIsSilent; }
+
+private:
+  std::vector<Interval> mIntervals;
+  bool mIsSilent = true;
+};
+
+// Renders frames in blocks and returns the mono output.
+std::vector<float> render(Mixer *mixer, uint32_t frames) {
+  std::vector<float> output(frames);
+  int32_t completions[Mixer::MaxBuses];
+
+  for (uint32_t done = 0; done < frames; done += BlockFrames) {
+    uint32_t n = frames - done < BlockFrames ? frames - done : BlockFrames;
+
+    mixer->Render(output.data() + done, n, completions);
+  }
+
+  return output;
+}
+
+bool isNear(float a, float b) { return std::fabs(a - b) <= 1e-4f; }
+
+// Whether output holds gain over [first, last).
+bool isFlat(const std::vector<float> &output, uint32_t first, uint32_t last,
+            float gain) {
+  for (uint32_t f = first; f < last; f++) {
+    if (output[f] != gain) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Whether output follows a ramp from `from` to `to` over frames, starting at
+// first, with the shape of curve.
+bool isRamp(const std::vector<float> &output, uint32_t first, uint32_t frames,
+            float from, float to, RampCurve curve) {
+  for (uint32_t k = 0; k < frames; k++) {
+    float t = static_cast<float>(k) / frames;
+    float gain = curve == RampCurve::Linear
+                     ? from + (to - from) * t
+                     : from * std::pow(to / from, t);
+
+    if (!isNear(output[first + k], gain)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// A linear ramp of 480 frames that starts 232 frames into the fourth block,
+// then an exponential one in the middle of the sixth.
+void testRampLength() {
+  ConstantSource source;
+  Mixer mixer;
+
+  CHECK(mixer.AddBus(&source, 1.0f) == 0);
+  CHECK(mixer.Open(SamplesPerSec, 1, BlockFrames));
+  CHECK(mixer.RampGain(0, 0.0f, 0.01, RampCurve::Linear, 1000));
+  CHECK(mixer.RampGain(0, 0.25f, 0.01, RampCurve::Exponential, 1500));
+  CHECK(mixer.GetGain(0) == 0.25f);
+
+  std::vector<float> output = render(&mixer, 2560);
+
+  CHECK(isFlat(output, 0, 1001, 1.0f));
+  CHECK(output[1001] < 1.0f);
+  CHECK(isRamp(output, 1000, 480, 1.0f, 0.0f, RampCurve::Linear));
+  CHECK(isFlat(output, 1480, 1500, 0.0f));
+
+  // From silence, exponential ramps start at -80 dB.
+  CHECK(isRamp(output, 1500, 480, 1e-4f, 0.25f, RampCurve::Exponential));
+  CHECK(output[1979] < 0.25f);
+  CHECK(isFlat(output, 1980, 2560, 0.25f));
+}
+
+// A ramp whose frame has passed starts with the next block, and two ramps
+// in one block each start on their own frame, the second from wherever the
+// first got to.
+void testRampStart() {
+  ConstantSource source;
+  Mixer mixer;
+
+  CHECK(mixer.AddBus(&source, 1.0f) == 0);
+  CHECK(mixer.Open(SamplesPerSec, 1, BlockFrames));
+
+  std::vector<float> before = render(&mixer, 512);
+
+  CHECK(isFlat(before, 0, 512, 1.0f));
+  CHECK(mixer.RampGain(0, 0.5f, 0.001, RampCurve::Linear, 100));
+  CHECK(mixer.RampGain(0, 1.0f, 0.001, RampCurve::Linear, 512 + 96));
+  CHECK(mixer.RampGain(0, 0.0f, 0.0, RampCurve::Linear, 512 + 200));
+
+  std::vector<float> output = render(&mixer, 512);
+
+  // 0.001 s is 48 frames. The first ramp is only halfway at frame 24 when
+  // the second starts.
+  CHECK(isRamp(output, 0, 48, 1.0f, 0.5f, RampCurve::Linear));
+  CHECK(isFlat(output, 48, 97, 0.5f));
+  CHECK(isRamp(output, 96, 48, 0.5f, 1.0f, RampCurve::Linear));
+  CHECK(isFlat(output, 144, 200, 1.0f));
+  CHECK(isFlat(output, 200, 512, 0.0f));
+}
+
+// The key plays from frame 1024 to 2048. The attack starts with the key,
+// the hold of 480 frames runs out 224 frames into the block at 2304, and
+// the release starts on that frame.
+void testDuck() {
+  ConstantSource music;
+  KeySource key({{1024, 2048}});
+  Mixer mixer;
+  DuckSettings settings;
+
+  // The key is muted, so that only the ducked bus is heard.
+  CHECK(mixer.AddBus(&music, 1.0f) == 0);
+  CHECK(mixer.AddBus(&key, 0.0f) == 1);
+  CHECK(mixer.Open(SamplesPerSec, 1, BlockFrames));
+
+  settings.KeyBus = 1;
+  settings.Gain = 0.25f;
+  settings.AttackSeconds = 0.002;
+  settings.HoldSeconds = 0.01;
+  settings.ReleaseSeconds = 0.004;
+  mixer.SetDucking(0, settings);
+
+  std::vector<float> output = render(&mixer, 4096);
+
+  CHECK(isFlat(output, 0, 1025, 1.0f));
+  CHECK(isRamp(output, 1024, 96, 1.0f, 0.25f, RampCurve::Exponential));
+  CHECK(isFlat(output, 1120, 2529, 0.25f));
+  CHECK(isRamp(output, 2528, 192, 0.25f, 1.0f, RampCurve::Exponential));
+  CHECK(output[2719] < 1.0f);
+  CHECK(isFlat(output, 2720, 4096, 1.0f));
+}
+
+// The key comes back during the hold, which starts over, and again during
+// the release, which turns back from where it got to.
+void testDuckRetrigger() {
+  ConstantSource music;
+  KeySource key({{0, 256}, {512, 768}, {1280, 1536}});
+  Mixer mixer;
+  DuckSettings settings;
+
+  CHECK(mixer.AddBus(&music, 1.0f) == 0);
+  CHECK(mixer.AddBus(&key, 0.0f) == 1);
+  CHECK(mixer.Open(SamplesPerSec, 1, BlockFrames));
+
+  settings.KeyBus = 1;
+  settings.Gain = 0.5f;
+  settings.AttackSeconds = 0.002;
+  settings.HoldSeconds = 0.008;
+  settings.ReleaseSeconds = 0.01;
+  mixer.SetDucking(0, settings);
+
+  std::vector<float> output = render(&mixer, 2560);
+
+  // The silent block at 256 is shorter than the hold of 384 frames. After
+  // 768 the hold runs out at 1152.
+  CHECK(isRamp(output, 0, 96, 1.0f, 0.5f, RampCurve::Exponential));
+  CHECK(isFlat(output, 96, 1153, 0.5f));
+
+  // 128 frames into the release of 480, the key plays again.
+  float released = 0.5f * std::pow(2.0f, 128.0f / 480);
+
+  CHECK(isNear(output[1216], 0.5f * std::pow(2.0f, 64.0f / 480)));
+  CHECK(isNear(output[1279], 0.5f * std::pow(2.0f, 127.0f / 480)));
+  CHECK(isRamp(output, 1280, 96, released, 0.5f, RampCurve::Exponential));
+  CHECK(isFlat(output, 1376, 1921, 0.5f));
+  CHECK(isRamp(output, 1920, 480, 0.5f, 1.0f, RampCurve::Exponential));
+  CHECK(isFlat(output, 2400, 2560, 1.0f));
+
+  // Ducking turned off lets go at once, without waiting for the hold.
+  KeySource second({{0, 1 << 20}});
+  Mixer other;
+
+  CHECK(other.AddBus(&music, 1.0f) == 0);
+  CHECK(other.AddBus(&second, 0.0f) == 1);
+  CHECK(other.Open(SamplesPerSec, 1, BlockFrames));
+  other.SetDucking(0, settings);
+  output = render(&other, 512);
+  CHECK(isFlat(output, 96, 512, 0.5f));
+
+  settings.KeyBus = -1;
+  other.SetDucking(0, settings);
+  output = render(&other, 1024);
+  CHECK(isRamp(output, 0, 480, 0.5f, 1.0f, RampCurve::Exponential));
+  CHECK(isFlat(output, 480, 1024, 1.0f));
+}
+} // namespace
+
+int main() {
+  testRampLength();
+  testRampStart();
+  testDuck();
+  testDuckRetrigger();
+
+  return TestResult();
+}
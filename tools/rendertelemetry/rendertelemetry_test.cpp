@@ -0,0 +1,149 @@
+// Feeds RenderTelemetry made-up periods and checks what a reader sees,
+// including while the writer runs on another thread.
+
+#include <atomic>
+#include <thread>
+
+#include "check.h"
+#include "rendertelemetry.h"
+
+namespace {
+constexpr uint64_t us = 1000;
+constexpr uint64_t t0 = 1000000 * us;
+
+void testFlags() {
+  RenderTelemetry telemetry(8);
+
+  telemetry.Start(10000, MMCSSStatus::Registered);
+
+  // The first period starts with an empty buffer.
+  telemetry.Record(t0, 300 * us, 0, 480, false);
+  telemetry.Record(t0 + 10000 * us, 200 * us, 480, 480, false);
+  // 16 ms after the previous one with a 10 ms period.
+  telemetry.Record(t0 + 26000 * us, 250 * us, 0, 960, false);
+  telemetry.Record(t0 + 36000 * us, 100 * us, 0, 0, true);
+
+  RenderPeriod periods[8];
+
+  CHECK(telemetry.Read(periods, 8) == 4);
+  CHECK(periods[0].Sequence == 1);
+  CHECK(periods[0].IntervalMicros == 0);
+  CHECK(!periods[0].IsUnderrun);
+  CHECK(periods[1].IntervalMicros == 10000);
+  CHECK(periods[1].FillMicros == 200);
+  CHECK(!periods[1].IsUnderrun && !periods[1].IsLate);
+  CHECK(periods[2].IsUnderrun && periods[2].IsLate);
+  CHECK(periods[2].PaddingFrames == 0);
+  CHECK(periods[3].IsFailed && !periods[3].IsUnderrun);
+
+  RenderTotals totals = telemetry.GetTotals();
+
+  CHECK(totals.Periods == 4);
+  CHECK(totals.Underruns == 1);
+  CHECK(totals.LateWakeups == 1);
+  CHECK(totals.Failures == 1);
+  CHECK(totals.FramesWritten == 1920);
+  CHECK(totals.MaxLateMicros == 6000);
+  CHECK(totals.PeriodMicros == 10000);
+  CHECK(totals.MMCSS == MMCSSStatus::Registered);
+
+  // Failed periods are not counted as fill times.
+  CHECK(telemetry.GetFillTimes().GetCount() == 3);
+  CHECK(telemetry.GetFillTimes().GetMax() == 300);
+
+  // A new stream starts over with an empty buffer.
+  telemetry.Start(0, MMCSSStatus::Failed);
+  telemetry.Record(t0 + 500000 * us, 100 * us, 0, 480, false);
+  telemetry.Record(t0 + 900000 * us, 100 * us, 240, 240, false);
+
+  totals = telemetry.GetTotals();
+
+  CHECK(totals.Periods == 6);
+  CHECK(totals.Underruns == 1);
+  CHECK(totals.LateWakeups == 1);
+  CHECK(totals.MMCSS == MMCSSStatus::Failed);
+}
+
+void testWrap() {
+  RenderTelemetry telemetry(5);
+  RenderPeriod periods[16];
+
+  CHECK(telemetry.GetCapacity() == 8);
+  CHECK(telemetry.Read(periods, 16) == 0);
+
+  telemetry.Start(10000, MMCSSStatus::Disabled);
+
+  for (uint32_t i = 0; i < 20; i++) {
+    telemetry.Record(t0 + i * 10000 * us, 100 * us, 480, i, false);
+  }
+
+  // Only the last capacity periods are kept.
+  CHECK(telemetry.Read(periods, 16) == 8);
+  CHECK(periods[0].Sequence == 13);
+  CHECK(periods[7].Sequence == 20);
+  CHECK(periods[7].FramesWritten == 19);
+
+  CHECK(telemetry.Read(periods, 3) == 3);
+  CHECK(periods[0].Sequence == 18);
+  CHECK(periods[2].Sequence == 20);
+}
+
+// Every period the writer records carries its sequence in FramesWritten and
+// PaddingFrames, so a torn copy shows up as a mismatch.
+void testConcurrentReader() {
+  constexpr uint32_t count = 200000;
+
+  RenderTelemetry telemetry(16);
+  std::atomic<bool> isDone{false};
+  uint64_t torn{0};
+  uint64_t disordered{0};
+  uint64_t inconsistent{0};
+
+  telemetry.Start(10000, MMCSSStatus::Registered);
+
+  std::thread reader([&] {
+    RenderPeriod periods[16];
+
+    while (!isDone.load(std::memory_order_acquire)) {
+      uint32_t n = telemetry.Read(periods, 16);
+
+      for (uint32_t i = 0; i < n; i++) {
+        if (periods[i].FramesWritten != periods[i].Sequence ||
+            periods[i].PaddingFrames != periods[i].Sequence) {
+          torn += 1;
+        }
+        if (i > 0 && periods[i].Sequence <= periods[i - 1].Sequence) {
+          disordered += 1;
+        }
+      }
+
+      RenderTotals totals = telemetry.GetTotals();
+
+      // FramesWritten is the sum of 1..Periods.
+      if (totals.FramesWritten != totals.Periods * (totals.Periods + 1) / 2) {
+        inconsistent += 1;
+      }
+    }
+  });
+
+  for (uint32_t i = 1; i <= count; i++) {
+    telemetry.Record(t0 + i * 10000 * us, 100 * us, i, i, false);
+  }
+
+  isDone.store(true, std::memory_order_release);
+  reader.join();
+
+  CHECK(torn == 0);
+  CHECK(disordered == 0);
+  CHECK(inconsistent == 0);
+  CHECK(telemetry.GetTotals().Periods == count);
+}
+} // namespace
+
+int main() {
+  testFlags();
+  testWrap();
+  testConcurrentReader();
+
+  return TestResult();
+}
@@ -0,0 +1,123 @@
+// replay plays a command trace recorded by StartCommandTrace through the
+// command scheduler and the render pipeline on a virtual clock, and writes
+// what would have been heard to a WAV file. The same trace always gives the
+// same file. With -l, the time from Push to each stage is written per
+// command as a tab separated file.
+//
+// Usage: replay [-k bank] [-p periodFrames] [-l latencies] <trace> <output>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "replaysession.h"
+
+namespace {
+const char *stageNames[LatencyStageCount] = {
+    "dispatch", "synthesis_start", "synthesis_end", "feed", "first_sample"};
+
+void usage() {
+  std::fprintf(stderr, "usage: replay [-k bank] [-p periodFrames] "
+                       "[-l latencies] <trace> <output>\n");
+}
+
+bool writeLatencies(const char *path,
+                    const std::vector<CommandLatency> &latencies) {
+  FILE *file = std::fopen(path, "w");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  std::fprintf(file, "# push\tcommand\ttype\tpush_us");
+
+  for (const char *name : stageNames) {
+    std::fprintf(file, "\t%s_us", name);
+  }
+
+  std::fprintf(file, "\n");
+
+  for (const CommandLatency &latency : latencies) {
+    std::fprintf(file, "%u\t%u\t%d\t%.3f", latency.Push, latency.Index,
+                 latency.Type, latency.PushTime / 1000.0);
+
+    for (int64_t stage : latency.Stages) {
+      if (stage < 0) {
+        std::fprintf(file, "\t-");
+      } else {
+        std::fprintf(file, "\t%.3f", stage / 1000.0);
+      }
+    }
+
+    std::fprintf(file, "\n");
+  }
+
+  std::fclose(file);
+
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  ReplayOptions options;
+  const char *latencyPath{nullptr};
+  const char *paths[2]{};
+  int pathCount{0};
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      options.BankPath = argv[++i];
+    } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      options.PeriodFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      latencyPath = argv[++i];
+    } else if (argv[i][0] != '-' && pathCount < 2) {
+      paths[pathCount++] = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (pathCount != 2 || options.PeriodFrames == 0) {
+    usage();
+    return 2;
+  }
+
+  ReplaySession session(options);
+
+  if (!session.Run(paths[0], paths[1])) {
+    std::fprintf(stderr, "replay: cannot replay %s into %s\n", paths[0],
+                 paths[1]);
+    return 1;
+  }
+  if (session.IsTraceBroken()) {
+    std::fprintf(stderr, "replay: %s ends in a broken record\n", paths[0]);
+  }
+
+  std::printf("%u events, %zu commands, %.3f s rendered\n",
+              session.GetEventCount(), session.GetLatencies().size(),
+              static_cast<double>(session.GetFramesRendered()) /
+                  options.Format.SamplesPerSec);
+  std::printf("%-16s %8s %10s %10s %10s %10s\n", "stage", "count", "mean us",
+              "p50 us", "p99 us", "max us");
+
+  for (int32_t i = 0; i < LatencyStageCount; i++) {
+    const LatencyHistogram &histogram =
+        session.GetStats().Get(static_cast<LatencyStage>(i));
+
+    std::printf("%-16s %8llu %10.0f %10llu %10llu %10llu\n", stageNames[i],
+                static_cast<unsigned long long>(histogram.GetCount()),
+                histogram.GetMean(),
+                static_cast<unsigned long long>(histogram.GetPercentile(0.5)),
+                static_cast<unsigned long long>(histogram.GetPercentile(0.99)),
+                static_cast<unsigned long long>(histogram.GetMax()));
+  }
+
+  if (latencyPath != nullptr &&
+      !writeLatencies(latencyPath, session.GetLatencies())) {
+    std::fprintf(stderr, "replay: cannot write %s\n", latencyPath);
+    return 1;
+  }
+
+  return 0;
+}
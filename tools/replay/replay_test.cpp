@@ -0,0 +1,315 @@
+// Records traces with a fake clock, reads them back, and replays them to
+// check that the output is the same every time and that a force push cuts
+// off what was queued before it.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "check.h"
+#include "commandtrace.h"
+#include "replaysession.h"
+
+namespace {
+constexpr uint64_t ms = 1000000;
+
+struct FakeClock {
+  uint64_t Now = 5000 * ms;
+};
+
+uint64_t fakeNow(void *context) {
+  return static_cast<FakeClock *>(context)->Now;
+}
+
+Command sfx(int16_t index) {
+  Command c{};
+
+  c.Type = 1;
+  c.SFXIndex = index;
+  c.Gain = 1.0f;
+
+  return c;
+}
+
+Command wait(double seconds) {
+  Command c{};
+
+  c.Type = 2;
+  c.WaitDuration = seconds;
+  c.Gain = 1.0f;
+
+  return c;
+}
+
+Command text(const wchar_t *s) {
+  Command c{};
+
+  c.Type = 3;
+  c.Text = const_cast<wchar_t *>(s);
+  c.Gain = 1.0f;
+
+  return c;
+}
+
+void push(CommandTraceWriter *writer, std::vector<Command> commands,
+          bool isForcePush) {
+  std::vector<const Command *> pointers;
+
+  for (const Command &c : commands) {
+    pointers.push_back(&c);
+  }
+
+  writer->WritePush(pointers.data(), static_cast<int32_t>(pointers.size()),
+                    isForcePush);
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+void testRoundTrip(const std::string &dir) {
+  std::string path = dir + "/roundtrip.trace";
+  FakeClock clock;
+  CommandTraceWriter writer;
+  VoiceProsody voices[2];
+  const wchar_t *ids[2] = {L"voice-a", L"voice-b"};
+  VoiceTable table;
+
+  voices[1].SpeakingRate = 1.5;
+  table.Count = 2;
+  table.DefaultVoiceIndex = 1;
+  table.Voices = voices;
+
+  writer.SetClock(fakeNow, &clock);
+  CHECK(writer.Open(path.c_str()));
+  CHECK(!writer.Open(path.c_str()));
+  writer.WriteVoices(table, ids);
+  clock.Now += 20 * ms;
+  push(&writer, {sfx(3), wait(0.25), text(L"café \U0001F600")}, false);
+
+  Command empty = text(nullptr);
+
+  clock.Now += 7;
+  push(&writer, {empty, sfx(-2)}, true);
+  writer.WriteVoiceSetting(TraceEventType::AudioPitch, 1, 0.75);
+  // Not a prosody change.
+  writer.WriteVoiceSetting(TraceEventType::Push, 1, 0.75);
+  writer.WriteDefaultVoice(0);
+  CHECK(writer.Close());
+  CHECK(!writer.Close());
+
+  CommandTraceReader reader;
+  TraceEvent event;
+
+  CHECK(reader.Open(path.c_str()));
+  CHECK(reader.Next(&event));
+  CHECK(event.Type == TraceEventType::Voices);
+  CHECK(event.Time == 5000 * ms);
+  CHECK(event.Voices.size() == 2 && event.DefaultVoiceIndex == 1);
+  CHECK(event.Voices[1].SpeakingRate == 1.5);
+  CHECK(event.VoiceIds.size() == 2 && event.VoiceIds[1] == L"voice-b");
+
+  CHECK(reader.Next(&event));
+  CHECK(event.Type == TraceEventType::Push && !event.IsForcePush);
+  CHECK(event.Time == 5020 * ms);
+  CHECK(event.Commands.size() == 3);
+  CHECK(event.Commands[0].Type == 1 && event.Commands[0].SFXIndex == 3);
+  CHECK(event.Commands[1].WaitDuration == 0.25);
+  CHECK(event.Commands[2].HasText);
+  CHECK(event.Commands[2].Text == L"café \U0001F600");
+
+  CHECK(reader.Next(&event));
+  CHECK(event.IsForcePush && event.Time == 5020 * ms + 7);
+  CHECK(event.Commands.size() == 2);
+  CHECK(!event.Commands[0].HasText && event.Commands[0].Text.empty());
+  CHECK(event.Commands[1].SFXIndex == -2);
+
+  CHECK(reader.Next(&event));
+  CHECK(event.Type == TraceEventType::AudioPitch);
+  CHECK(event.Index == 1 && event.Value == 0.75);
+  CHECK(reader.Next(&event));
+  CHECK(event.Type == TraceEventType::DefaultVoice && event.Index == 0);
+  CHECK(!reader.Next(&event));
+  CHECK(!reader.IsBroken());
+
+  // A recorder that died mid-write leaves half a record.
+  std::string data = readFile(path);
+  std::string truncated = dir + "/truncated.trace";
+
+  std::ofstream(truncated, std::ios::binary)
+      .write(data.data(), static_cast<std::streamsize>(data.size() - 2));
+
+  int count{0};
+
+  CHECK(reader.Open(truncated.c_str()));
+
+  while (reader.Next(&event)) {
+    count += 1;
+  }
+
+  CHECK(count == 4);
+  CHECK(reader.IsBroken());
+
+  std::remove(path.c_str());
+  std::remove(truncated.c_str());
+}
+
+// A session of typing: key sounds, short words and a sentence, a voice
+// setting change in the middle and a force push that interrupts.
+void writeSession(const std::string &path) {
+  FakeClock clock;
+  CommandTraceWriter writer;
+  VoiceProsody voice;
+  const wchar_t *ids[1] = {L"voice"};
+  VoiceTable table;
+
+  table.Count = 1;
+  table.Voices = &voice;
+
+  writer.SetClock(fakeNow, &clock);
+  writer.Open(path.c_str());
+  writer.WriteVoices(table, ids);
+
+  for (int i = 0; i < 20; i++) {
+    clock.Now += 90 * ms + (i % 3) * 17 * ms;
+    push(&writer, {sfx(static_cast<int16_t>(1 + i % 4))}, false);
+
+    if (i % 5 == 4) {
+      push(&writer, {text(L"word"), wait(0.05), sfx(2)}, false);
+    }
+  }
+
+  clock.Now += 100 * ms;
+  writer.WriteVoiceSetting(TraceEventType::SpeakingRate, 0, 1.8);
+  push(&writer, {text(L"The quick brown fox jumps over the lazy dog.")},
+       false);
+  clock.Now += 700 * ms;
+  push(&writer, {sfx(5), text(L"Interrupted")}, true);
+  writer.Close();
+}
+
+void testDeterminism(const std::string &dir) {
+  std::string trace = dir + "/session.trace";
+  std::string first = dir + "/first.wav";
+  std::string second = dir + "/second.wav";
+  ReplayOptions options;
+
+  writeSession(trace);
+
+  ReplaySession a(options);
+  ReplaySession b(options);
+
+  CHECK(a.Run(trace.c_str(), first.c_str()));
+  CHECK(b.Run(trace.c_str(), second.c_str()));
+  CHECK(!a.IsTraceBroken());
+  CHECK(a.GetEventCount() == 28);
+  CHECK(a.GetFramesRendered() > 48000);
+  CHECK(a.GetFramesRendered() == b.GetFramesRendered());
+
+  std::string x = readFile(first);
+  std::string y = readFile(second);
+
+  CHECK(x.size() == 44 + a.GetFramesRendered() * 4);
+  CHECK(x == y);
+
+  // Reusing a session gives the same result as well.
+  CHECK(a.Run(trace.c_str(), second.c_str()));
+  CHECK(readFile(second) == x);
+
+  // Nothing is silent throughout.
+  bool isHeard{false};
+
+  for (size_t i = 44; i < x.size() && !isHeard; i++) {
+    isHeard = x[i] != 0;
+  }
+
+  CHECK(isHeard);
+
+  const std::vector<CommandLatency> &latencies = a.GetLatencies();
+  const LatencyStats &stats = a.GetStats();
+
+  CHECK(latencies.size() == 20 + 4 * 3 + 1 + 2);
+  CHECK(stats.Get(LatencyStage::Dispatch).GetCount() == latencies.size());
+
+  // Key sounds pushed while nothing else plays start within a period and
+  // the schedule lead.
+  CHECK(latencies[0].Type == 1);
+  CHECK(latencies[0].Stages[static_cast<int32_t>(LatencyStage::Dispatch)] ==
+        0);
+  CHECK(latencies[0].Stages[static_cast<int32_t>(LatencyStage::FirstSample)] >
+        0);
+  CHECK(latencies[0].Stages[static_cast<int32_t>(LatencyStage::FirstSample)] <
+        static_cast<int64_t>(20 * ms));
+
+  std::remove(trace.c_str());
+  std::remove(first.c_str());
+  std::remove(second.c_str());
+}
+
+void testForcePush(const std::string &dir) {
+  std::string trace = dir + "/force.trace";
+  std::string output = dir + "/force.wav";
+  FakeClock clock;
+  CommandTraceWriter writer;
+
+  writer.SetClock(fakeNow, &clock);
+  writer.Open(trace.c_str());
+  push(&writer,
+       {text(L"A sentence long enough to still be playing"), wait(1.0),
+        sfx(1)},
+       false);
+  clock.Now += 200 * ms;
+  push(&writer, {sfx(2)}, true);
+  writer.Close();
+
+  ReplaySession session{ReplayOptions()};
+
+  CHECK(session.Run(trace.c_str(), output.c_str()));
+
+  const std::vector<CommandLatency> &latencies = session.GetLatencies();
+  auto stage = [&](size_t i, LatencyStage s) {
+    return latencies[i].Stages[static_cast<int32_t>(s)];
+  };
+
+  CHECK(latencies.size() == 4);
+  // The sentence was heard before it was cut off.
+  CHECK(stage(0, LatencyStage::FirstSample) >= 0);
+  // The wave queued behind the wait never played.
+  CHECK(latencies[2].Type == 1);
+  CHECK(stage(2, LatencyStage::Feed) < 0);
+  CHECK(stage(2, LatencyStage::FirstSample) < 0);
+  // The force push played right away.
+  CHECK(latencies[3].PushTime == 200 * ms);
+  CHECK(stage(3, LatencyStage::FirstSample) >= 0);
+  CHECK(stage(3, LatencyStage::FirstSample) < static_cast<int64_t>(20 * ms));
+  // Rendering stops soon after the last wave, not after the sentence.
+  CHECK(session.GetFramesRendered() < 48000 / 2);
+
+  std::remove(trace.c_str());
+  std::remove(output.c_str());
+}
+} // namespace
+
+int main() {
+  char directory[] = "/tmp/replay_testXXXXXX";
+
+  if (mkdtemp(directory) == nullptr) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  testRoundTrip(directory);
+  testDeterminism(directory);
+  testForcePush(directory);
+
+  rmdir(directory);
+
+  return TestResult();
+}
@@ -0,0 +1,490 @@
+#include <cmath>
+#include <cstring>
+
+#include "commandring.h"
+#include "commandscheduler.h"
+#include "headlessdriver.h"
+#include "mixer.h"
+#include "renderer.h"
+#include "replaysession.h"
+#include "sfxbank.h"
+#include "sfxqueue.h"
+#include "sfxsource.h"
+#include "speechcache.h"
+#include "speechpipeline.h"
+#include "streamsource.h"
+#include "voicesettings.h"
+#include "wavfilesink.h"
+
+namespace {
+const double pi = 3.14159265358979323846;
+
+// The virtual clock starts here rather than at zero, which LatencyStats
+// takes as "not stamped".
+constexpr uint64_t ClockOrigin = 1000000000ULL;
+
+// Sizes and settings as Setup uses them.
+constexpr uint32_t MaxCommands = 256;
+constexpr uint32_t TextCapacity = 16384;
+constexpr uint32_t MaxTextCapacity = 262144;
+constexpr uint32_t SpeechLookahead = 2;
+constexpr uint64_t SpeechCacheBytes = 16 * 1024 * 1024;
+constexpr uint32_t VoiceStreamBytes = 65536;
+constexpr int16_t MaxWaves = 128;
+constexpr uint32_t SFXVoices = 8;
+constexpr float SFXDuckGain = 0.5f;
+constexpr int32_t VoiceBus = 0;
+constexpr int32_t SFXBus = 1;
+
+void putUint16(char *p, uint16_t v) {
+  p[0] = static_cast<char>(v & 0xFF);
+  p[1] = static_cast<char>(v >> 8);
+}
+
+void putUint32(char *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+  }
+}
+
+// ToneSynthesizer stands in for the speech synthesizer. Each utterance is a
+// tone whose pitch depends on the text and whose length grows with it,
+// 16 bit mono at 22050 Hz, written in pieces like a synthesized stream.
+class ToneSynthesizer : public Synthesizer {
+public:
+  bool Synthesize(bool isSSML, const wchar_t *text, const VoiceSettings &voice,
+                  SpeechWriter *writer) override {
+    const uint32_t samplesPerSec = 22050;
+    size_t length = std::wcslen(text);
+    uint32_t hash{2166136261u};
+
+    for (size_t i = 0; i < length; i++) {
+      hash = (hash ^ static_cast<uint32_t>(text[i])) * 16777619u;
+    }
+
+    // 50 ms per character, at least 100 ms.
+    uint32_t frames = samplesPerSec / 20 * static_cast<uint32_t>(length);
+
+    if (frames < samplesPerSec / 10) {
+      frames = samplesPerSec / 10;
+    }
+
+    double frequency = 150.0 + hash % 200;
+    double amplitude = 8000.0 * voice.AudioVolume;
+    char header[44];
+
+    std::memcpy(header, "RIFF", 4);
+    putUint32(header + 4, 36 + frames * 2);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putUint32(header + 16, 16);
+    putUint16(header + 20, 1);
+    putUint16(header + 22, 1);
+    putUint32(header + 24, samplesPerSec);
+    putUint32(header + 28, samplesPerSec * 2);
+    putUint16(header + 32, 2);
+    putUint16(header + 34, 16);
+    std::memcpy(header + 36, "data", 4);
+    putUint32(header + 40, frames * 2);
+    writer->Write(header, sizeof(header));
+
+    char chunk[4096];
+    size_t used{0};
+
+    for (uint32_t i = 0; i < frames; i++) {
+      // Short fades at both ends, so that cuts between utterances are heard
+      // as such and not as clicks of the tone.
+      double edge = std::fmin(1.0, std::fmin(i, frames - i) / 220.0);
+      int16_t s = static_cast<int16_t>(
+          amplitude * edge *
+          std::sin(2.0 * pi * frequency * i / samplesPerSec));
+
+      putUint16(chunk + used, static_cast<uint16_t>(s));
+      used += 2;
+
+      if (used == sizeof(chunk)) {
+        writer->Write(chunk, used);
+        used = 0;
+      }
+    }
+    if (used > 0) {
+      writer->Write(chunk, used);
+    }
+
+    return true;
+  }
+};
+
+// Reads the voice settings like the command loop does. Everything else is
+// polled by the session, so requests need no signal.
+class ReplayHost : public SchedulerHost {
+public:
+  ReplayHost(VoiceSettingsStore *settings,
+             const std::vector<std::wstring> *ids)
+      : mSettings(settings), mIds(ids) {}
+
+  VoiceSettings GetVoice() override {
+    VoiceSettings voice;
+    const VoiceTable *table = mSettings->Acquire();
+    unsigned int index = table->DefaultVoiceIndex;
+
+    voice.Version = table->Version;
+    voice.VoiceIndex = index;
+    voice.VoiceId = index < mIds->size() ? (*mIds)[index].c_str() : L"";
+    voice.AudioVolume = table->Voices[index].AudioVolume;
+
+    mSettings->Release(table);
+
+    return voice;
+  }
+
+  void RequestSynthesis() override {}
+  void RequestSFX() override {}
+
+private:
+  VoiceSettingsStore *mSettings = nullptr;
+  const std::vector<std::wstring> *mIds = nullptr;
+};
+
+// Makes the click played for an SFX index when there is no bank.
+SFXWave *makeClick(int16_t index, uint32_t samplesPerSec) {
+  uint32_t frames = samplesPerSec / 20 + samplesPerSec / 200 * (index % 8);
+  float *samples = new float[frames];
+  double frequency = 600.0 + 90.0 * (index % 16);
+  SFXWave *wave = new SFXWave();
+
+  for (uint32_t i = 0; i < frames; i++) {
+    samples[i] = static_cast<float>(
+        0.4 * std::exp(-5.0 * i / frames) *
+        std::sin(2.0 * pi * frequency * i / samplesPerSec));
+  }
+
+  wave->Samples = samples;
+  wave->Frames = frames;
+  wave->Channels = 1;
+  wave->SamplesPerSec = samplesPerSec;
+
+  return wave;
+}
+} // namespace
+
+ReplaySession::ReplaySession(const ReplayOptions &options)
+    : mOptions(options) {
+  mStats.SetClock(now, this);
+  mStats.SetObserver(observe, this);
+}
+
+uint64_t ReplaySession::now(void *context) {
+  return static_cast<ReplaySession *>(context)->mNow;
+}
+
+void ReplaySession::observe(void *context, LatencyStage stage,
+                            uint64_t pushTime, uint64_t now) {
+  ReplaySession *session = static_cast<ReplaySession *>(context);
+  auto it = session->mPushTimes.find(pushTime);
+
+  if (it == session->mPushTimes.end()) {
+    return;
+  }
+
+  int64_t &latency =
+      session->mLatencies[it->second].Stages[static_cast<int32_t>(stage)];
+
+  if (latency < 0) {
+    latency = static_cast<int64_t>(now > pushTime ? now - pushTime : 0);
+  }
+}
+
+bool ReplaySession::Run(const char *tracePath, const char *wavPath) {
+  CommandTraceReader reader;
+  std::vector<TraceEvent> events;
+  TraceEvent event;
+
+  mStats.Reset();
+  mNow = 0;
+  mLastPushTime = 0;
+  mFramesRendered = 0;
+  mLatencies.clear();
+  mPushTimes.clear();
+
+  if (!reader.Open(tracePath)) {
+    return false;
+  }
+  while (reader.Next(&event)) {
+    events.push_back(event);
+  }
+
+  mIsTraceBroken = reader.IsBroken();
+  mEventCount = static_cast<uint32_t>(events.size());
+
+  // The voice table is sized by the first snapshot; a trace without one
+  // plays everything with a single default voice.
+  std::vector<VoiceProsody> voices(1);
+  std::vector<std::wstring> ids(1);
+  uint32_t defaultVoice{0};
+
+  for (const TraceEvent &e : events) {
+    if (e.Type == TraceEventType::Voices && !e.Voices.empty()) {
+      voices = e.Voices;
+      ids = e.VoiceIds;
+      defaultVoice = e.DefaultVoiceIndex;
+      break;
+    }
+  }
+
+  const StreamFormat &format = mOptions.Format;
+  uint32_t period = mOptions.PeriodFrames;
+
+  VoiceSettingsStore settings(static_cast<uint32_t>(voices.size()),
+                              defaultVoice, voices.data());
+  CommandRing commands(MaxCommands, OverflowPolicy::DropOldest, TextCapacity,
+                       MaxTextCapacity);
+  SpeechCache cache(SpeechCacheBytes);
+  SpeechPipeline speech(SpeechLookahead, &cache);
+  StreamSource voiceStream(VoiceStreamBytes);
+  SFXBank *bank{nullptr};
+
+  if (mOptions.BankPath != nullptr) {
+    // No workers, so waves are decoded when they are played, in order.
+    bank = new SFXBank(MaxWaves, 0);
+
+    if (!bank->LoadBank(mOptions.BankPath)) {
+      delete bank;
+      return false;
+    }
+  }
+
+  SFXSource sfxSource(bank, SFXVoices, StealPolicy::Oldest);
+  SFXQueue sfxQueue(&sfxSource, &mStats);
+  Mixer mixer;
+  Renderer renderer(&mixer);
+  WavFileSink sink(format, period);
+  HeadlessDriver driver(&renderer, &sink, period, false);
+  ToneSynthesizer synthesizer;
+  ReplayHost host(&settings, &ids);
+  std::atomic<bool> isIdle{true};
+  std::map<int16_t, SFXWave *> clicks;
+
+  speech.SetLatencyStats(&mStats);
+  voiceStream.SetLatencyStats(&mStats);
+  sfxSource.SetLatencyStats(&mStats);
+
+  mixer.AddBus(&voiceStream, 1.0f);
+  mixer.AddBus(&sfxSource, 1.0f);
+  mixer.SetResampleQuality(VoiceBus, ResampleQuality::LongSinc);
+  mixer.SetResampleQuality(SFXBus, ResampleQuality::ShortSinc);
+
+  DuckSettings ducking;
+
+  ducking.KeyBus = VoiceBus;
+  ducking.Gain = SFXDuckGain;
+  mixer.SetDucking(SFXBus, ducking);
+
+  SchedulerContext ctx;
+
+  ctx.Commands = &commands;
+  ctx.Speech = &speech;
+  ctx.VoiceStream = &voiceStream;
+  ctx.SFX = &sfxQueue;
+  ctx.Bank = bank;
+  ctx.OutputMixer = &mixer;
+  ctx.Stats = &mStats;
+  ctx.IsIdle = &isIdle;
+  ctx.Host = &host;
+
+  CommandScheduler scheduler(ctx);
+
+  if (!renderer.Open(format, period) || !sink.Open(wavPath)) {
+    delete bank;
+    return false;
+  }
+
+  auto applyProsody = [&]() {
+    const VoiceTable *table = settings.Acquire();
+    const VoiceProsody &prosody = table->Voices[table->DefaultVoiceIndex];
+
+    voiceStream.SetProsody(prosody.SpeakingRate, prosody.AudioPitch);
+
+    settings.Release(table);
+  };
+  auto apply = [&](const TraceEvent &e, uint32_t push) {
+    switch (e.Type) {
+    case TraceEventType::Push:
+      if (e.IsForcePush) {
+        commands.BeginForcePush();
+      }
+
+      for (uint32_t i = 0; i < e.Commands.size(); i++) {
+        const TraceCommand &tc = e.Commands[i];
+        Command c{};
+        CommandLatency latency;
+        // Commands of one push share a timestamp in the DLL. Here each is a
+        // nanosecond apart, so that its stages can be told apart.
+        uint64_t pushTime = mNow > mLastPushTime ? mNow : mLastPushTime + 1;
+
+        c.Type = tc.Type;
+        c.SFXIndex = tc.SFXIndex;
+        c.WaitDuration = tc.WaitDuration;
+        c.Text = tc.HasText ? const_cast<wchar_t *>(tc.Text.c_str()) : nullptr;
+        c.Gain = tc.Gain;
+        c.Pan = tc.Pan;
+
+        latency.Push = push;
+        latency.Index = i;
+        latency.Type = tc.Type;
+        latency.PushTime = pushTime - ClockOrigin;
+
+        for (int64_t &stage : latency.Stages) {
+          stage = -1;
+        }
+
+        mLastPushTime = pushTime;
+        mPushTimes[pushTime] = mLatencies.size();
+        mLatencies.push_back(latency);
+
+        PushCommand(&commands, c, pushTime);
+      }
+
+      isIdle.store(false);
+      break;
+    case TraceEventType::Voices:
+      for (uint32_t i = 0; i < e.Voices.size(); i++) {
+        settings.SetSpeakingRate(i, e.Voices[i].SpeakingRate);
+        settings.SetAudioPitch(i, e.Voices[i].AudioPitch);
+        settings.SetAudioVolume(i, e.Voices[i].AudioVolume);
+      }
+
+      settings.SetDefaultVoice(e.DefaultVoiceIndex);
+      applyProsody();
+      break;
+    case TraceEventType::DefaultVoice:
+      settings.SetDefaultVoice(e.Index);
+      applyProsody();
+      break;
+    case TraceEventType::SpeakingRate:
+      settings.SetSpeakingRate(e.Index, e.Value);
+      applyProsody();
+      break;
+    case TraceEventType::AudioPitch:
+      settings.SetAudioPitch(e.Index, e.Value);
+      applyProsody();
+      break;
+    case TraceEventType::AudioVolume:
+      settings.SetAudioVolume(e.Index, e.Value);
+      break;
+    }
+  };
+
+  SFXRequest request;
+  uint32_t generation{0};
+  bool hasRequest{false};
+
+  // Does what the command, voice and SFX loops would do until none of them
+  // can make progress.
+  auto step = [&]() {
+    bool isProgressing{true};
+
+    while (isProgressing) {
+      isProgressing = false;
+      scheduler.Run();
+
+      while (speech.ProcessNext(&synthesizer, nullptr, nullptr)) {
+        isProgressing = true;
+      }
+      while (hasRequest || sfxQueue.Take(&request, &generation)) {
+        const SFXWave *wave{nullptr};
+
+        if (bank != nullptr) {
+          wave = bank->Acquire(request.SFXIndex);
+        } else {
+          SFXWave *&click = clicks[request.SFXIndex];
+
+          if (click == nullptr) {
+            click = makeClick(request.SFXIndex, format.SamplesPerSec);
+          }
+
+          wave = click;
+        }
+
+        // The source is full until the next period is rendered.
+        hasRequest = !sfxQueue.Submit(request, wave, generation);
+
+        if (hasRequest) {
+          break;
+        }
+
+        isProgressing = true;
+      }
+    }
+  };
+  auto clockAt = [&](uint64_t frames) {
+    return ClockOrigin + frames * 1000000000ULL / format.SamplesPerSec;
+  };
+
+  uint64_t origin = events.empty() ? 0 : events.front().Time;
+  uint64_t lastEvent = events.empty() ? 0 : events.back().Time - origin;
+  uint64_t limit =
+      static_cast<uint64_t>((lastEvent * 1e-9 + mOptions.MaxTailSeconds) *
+                            format.SamplesPerSec);
+  size_t next{0};
+  uint32_t push{0};
+  bool ok{true};
+
+  while (mFramesRendered <= limit) {
+    // The period is rendered when it starts; what happens during it is
+    // scheduled after it.
+    mNow = clockAt(mFramesRendered);
+
+    if (!driver.Run(period)) {
+      ok = false;
+      break;
+    }
+
+    mFramesRendered += period;
+    step();
+
+    uint64_t end = clockAt(mFramesRendered);
+
+    while (next < events.size() &&
+           ClockOrigin + events[next].Time - origin < end) {
+      uint64_t at = ClockOrigin + events[next].Time - origin;
+
+      mNow = at > mNow ? at : mNow;
+      apply(events[next], push);
+
+      if (events[next].Type == TraceEventType::Push) {
+        push += 1;
+      }
+
+      next += 1;
+      step();
+    }
+    if (next == events.size() && scheduler.IsDone() && !hasRequest &&
+        voiceStream.IsIdle() && sfxSource.IsSilent()) {
+      break;
+    }
+  }
+
+  ok = sink.Close() && ok;
+  renderer.Close();
+
+  for (auto &click : clicks) {
+    delete[] click.second->Samples;
+    delete click.second;
+  }
+
+  delete bank;
+
+  return ok;
+}
+
+const std::vector<CommandLatency> &ReplaySession::GetLatencies() const {
+  return mLatencies;
+}
+
+const LatencyStats &ReplaySession::GetStats() const { return mStats; }
+
+uint64_t ReplaySession::GetFramesRendered() const { return mFramesRendered; }
+
+uint32_t ReplaySession::GetEventCount() const { return mEventCount; }
+
+bool ReplaySession::IsTraceBroken() const { return mIsTraceBroken; }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "audiosink.h"
+#include "commandtrace.h"
+#include "latencystats.h"
+
+struct ReplayOptions {
+  StreamFormat Format = {SampleFormat::Int16, 2, 48000};
+  uint32_t PeriodFrames = 480;
+  // A bank packed by sfxpack. Without it, every SFX index plays a click
+  // generated from the index.
+  const char *BankPath = nullptr;
+  // How long rendering may go on after the last event while something still
+  // plays.
+  double MaxTailSeconds = 600.0;
+};
+
+// CommandLatency is the time from Push to each stage for one command, in
+// nanoseconds of the virtual clock, or -1 when the command never got there.
+struct CommandLatency {
+  uint32_t Push = 0;
+  uint32_t Index = 0;
+  int16_t Type = 0;
+  // Since the first event of the trace.
+  uint64_t PushTime = 0;
+  int64_t Stages[LatencyStageCount];
+};
+
+// ReplaySession plays a command trace through the command scheduler, the
+// speech pipeline with a synthesizer that makes tones, the SFX queue and
+// the mixer, all on one thread, and writes the result to a WAV file.
+//
+// Time is virtual. Rendering one period moves the clock on by one period,
+// and trace events are applied at their recorded offsets in between, so
+// the same trace always makes the same file, however fast the machine is.
+// Synthesis takes no virtual time.
+class ReplaySession {
+public:
+  explicit ReplaySession(const ReplayOptions &options);
+
+  bool Run(const char *tracePath, const char *wavPath);
+
+  const std::vector<CommandLatency> &GetLatencies() const;
+  const LatencyStats &GetStats() const;
+  uint64_t GetFramesRendered() const;
+  uint32_t GetEventCount() const;
+  // Whether the trace ended in a broken record; the events before it were
+  // replayed.
+  bool IsTraceBroken() const;
+
+private:
+  static uint64_t now(void *context);
+  static void observe(void *context, LatencyStage stage, uint64_t pushTime,
+                      uint64_t now);
+
+  ReplayOptions mOptions;
+  LatencyStats mStats;
+  uint64_t mNow = 0;
+  uint64_t mLastPushTime = 0;
+  uint64_t mFramesRendered = 0;
+  uint32_t mEventCount = 0;
+  bool mIsTraceBroken = false;
+  std::vector<CommandLatency> mLatencies;
+  // Push times are unique per command, so they identify the command.
+  std::map<uint64_t, size_t> mPushTimes;
+};
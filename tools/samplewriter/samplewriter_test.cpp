@@ -0,0 +1,179 @@
+// Checks the float to device sample conversions against a table of inputs,
+// in buffers long enough to run both the vector loops and the scalar tails,
+// and the writers chosen for every format and channel count.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "convert.h"
+#include "samplewriter.h"
+
+namespace {
+struct ConvertCase {
+  float Input;
+  int16_t Int16;
+  int32_t Int24;
+  int32_t Int32;
+  float Float32;
+};
+
+// Values are scaled by 2^15, 2^23 and 2^31 and rounded to nearest even. The
+// largest input is just below 1.0, so that 1.0 does not overflow.
+const ConvertCase cases[] = {
+    {0.0f, 0, 0, 0, 0.0f},
+    {0.5f, 16384, 4194304, 1073741824, 0.5f},
+    {-0.5f, -16384, -4194304, -1073741824, -0.5f},
+    {-1.0f, -32768, -8388608, INT32_MIN, -1.0f},
+    {1.0f, 32767, 8388607, 2147483520, 1.0f},
+    // Clamped.
+    {2.0f, 32767, 8388607, 2147483520, 1.0f},
+    {-3.0f, -32768, -8388608, INT32_MIN, -1.0f},
+    {0.99999994f, 32767, 8388607, 2147483520, 0.99999994f},
+    // Halfway between two int16 values.
+    {0.5f / 32768, 0, 128, 32768, 0.5f / 32768},
+    {1.5f / 32768, 2, 384, 98304, 1.5f / 32768},
+    {2.5f / 32768, 2, 640, 163840, 2.5f / 32768},
+    {-1.5f / 32768, -2, -384, -98304, -1.5f / 32768},
+    // Halfway between two int24 values.
+    {0.5f / 8388608, 0, 0, 128, 0.5f / 8388608},
+    {-1.0f / 8388608, 0, -1, -256, -1.0f / 8388608},
+    {1193046.0f / 8388608, 4660, 1193046, 305419776, 1193046.0f / 8388608},
+};
+
+constexpr size_t CaseCount = sizeof(cases) / sizeof(cases[0]);
+
+int32_t readInt24(const uint8_t *p) {
+  int32_t value = p[0] | p[1] << 8 | p[2] << 16;
+
+  return value >= 0x800000 ? value - 0x1000000 : value;
+}
+
+// Every case appears at every offset modulo the vector widths.
+std::vector<float> makeInput(size_t repeats) {
+  std::vector<float> input;
+
+  for (size_t i = 0; i < repeats; i++) {
+    for (size_t j = 0; j < CaseCount; j++) {
+      input.push_back(cases[j].Input);
+    }
+  }
+
+  return input;
+}
+
+void testConversions() {
+  std::vector<float> input = makeInput(9);
+  size_t n = input.size();
+  std::vector<int16_t> int16s(n);
+  std::vector<uint8_t> int24s(n * 3);
+  std::vector<int32_t> int32s(n);
+  std::vector<float> float32s(n);
+
+  ConvertToInt16(input.data(), int16s.data(), n);
+  ConvertToInt24(input.data(), int24s.data(), n);
+  ConvertToInt32(input.data(), int32s.data(), n);
+  ConvertToFloat32(input.data(), float32s.data(), n);
+
+  for (size_t i = 0; i < n; i++) {
+    const ConvertCase &c = cases[i % CaseCount];
+
+    if (int16s[i] != c.Int16 || readInt24(&int24s[i * 3]) != c.Int24 ||
+        int32s[i] != c.Int32 || float32s[i] != c.Float32) {
+      std::fprintf(stderr,
+                   "%g at %zu: got %d %d %d %g, want %d %d %d %g\n",
+                   c.Input, i, int16s[i], readInt24(&int24s[i * 3]),
+                   int32s[i], float32s[i], c.Int16, c.Int24, c.Int32,
+                   c.Float32);
+      failures += 1;
+    }
+  }
+}
+
+// Int24 is packed into three little endian bytes with no padding.
+void testInt24Packing() {
+  const float input[] = {1193046.0f / 8388608, -1.0f, -1.0f / 8388608, 0.5f};
+  const uint8_t expected[] = {0x56, 0x34, 0x12, 0x00, 0x00, 0x80,
+                              0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x40};
+  uint8_t bytes[sizeof(expected) + 1];
+
+  std::memset(bytes, 0xAA, sizeof(bytes));
+  ConvertToInt24(input, bytes, 4);
+
+  CHECK(std::memcmp(bytes, expected, sizeof(expected)) == 0);
+  CHECK(bytes[sizeof(expected)] == 0xAA);
+}
+
+// Every channel count gets a writer that converts exactly frames * channels
+// samples.
+void testWriters() {
+  const SampleFormat formats[] = {SampleFormat::Int16, SampleFormat::Int24,
+                                  SampleFormat::Int32, SampleFormat::Float32};
+  const uint32_t bytesPerSample[] = {2, 3, 4, 4};
+  constexpr uint32_t Frames = 37;
+
+  CHECK(ChooseSampleWriter(SampleFormat::Unknown, 2) == nullptr);
+
+  for (int f = 0; f < 4; f++) {
+    CHECK(ChooseSampleWriter(formats[f], 0) == nullptr);
+
+    for (uint16_t channels = 1; channels <= 12; channels++) {
+      SampleWriter writer = ChooseSampleWriter(formats[f], channels);
+
+      CHECK(writer != nullptr);
+
+      if (writer == nullptr) {
+        continue;
+      }
+
+      size_t samples = static_cast<size_t>(Frames) * channels;
+      size_t bytes = samples * bytesPerSample[f];
+      std::vector<float> src(samples);
+      std::vector<uint8_t> dst(bytes + 8, 0xAA);
+
+      for (size_t i = 0; i < samples; i++) {
+        src[i] = cases[i % CaseCount].Input;
+      }
+
+      writer(src.data(), dst.data(), Frames, channels);
+
+      for (size_t i = 0; i < samples; i++) {
+        const ConvertCase &c = cases[i % CaseCount];
+        const uint8_t *p = dst.data() + i * bytesPerSample[f];
+        int16_t int16;
+        int32_t int32;
+        float float32;
+
+        switch (formats[f]) {
+        case SampleFormat::Int16:
+          std::memcpy(&int16, p, 2);
+          CHECK(int16 == c.Int16);
+          break;
+        case SampleFormat::Int24:
+          CHECK(readInt24(p) == c.Int24);
+          break;
+        case SampleFormat::Int32:
+          std::memcpy(&int32, p, 4);
+          CHECK(int32 == c.Int32);
+          break;
+        default:
+          std::memcpy(&float32, p, 4);
+          CHECK(float32 == c.Float32);
+          break;
+        }
+      }
+
+      CHECK(dst[bytes] == 0xAA);
+    }
+  }
+}
+} // namespace
+
+int main() {
+  testConversions();
+  testInt24Packing();
+  testWriters();
+
+  return TestResult();
+}
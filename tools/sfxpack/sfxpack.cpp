@@ -0,0 +1,121 @@
+// sfxpack packs waves/001.wav, waves/002.wav, ... into a single bank file
+// that SFXBank maps and plays without decoding.
+//
+// Usage: sfxpack [-n count] [-r samplesPerSec] <directory> <output>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "bankfile.h"
+#include "mappedfile.h"
+#include "resampler.h"
+#include "waveheader.h"
+
+namespace {
+void usage() {
+  std::fprintf(stderr,
+               "usage: sfxpack [-n count] [-r samplesPerSec] <directory> "
+               "<output>\n");
+}
+
+// Decodes path into entry, resampled to samplesPerSec unless it is 0.
+bool loadEntry(const std::string &path, uint32_t samplesPerSec,
+               BankEntry *entry) {
+  MappedFile file;
+
+  if (!file.Open(path.c_str())) {
+    return false;
+  }
+
+  float *decoded = DecodeWave(file.GetData(), file.GetSize(), &entry->Frames,
+                              &entry->Channels, &entry->SamplesPerSec);
+
+  if (decoded == nullptr) {
+    std::fprintf(stderr, "sfxpack: %s: unsupported wave\n", path.c_str());
+    return false;
+  }
+  if (samplesPerSec == 0 || samplesPerSec == entry->SamplesPerSec) {
+    entry->Samples = decoded;
+    return true;
+  }
+
+  uint32_t frames =
+      ResampledFrames(entry->Frames, entry->SamplesPerSec, samplesPerSec);
+  float *resampled = new float[frames * entry->Channels];
+
+  // Packing happens once, so the best tier is used.
+  Resample(decoded, entry->Frames, entry->Channels, entry->SamplesPerSec,
+           samplesPerSec, ResampleQuality::LongSinc, resampled);
+
+  delete[] decoded;
+  decoded = nullptr;
+
+  entry->Samples = resampled;
+  entry->Frames = frames;
+  entry->SamplesPerSec = samplesPerSec;
+
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t count{128};
+  uint32_t samplesPerSec{0};
+  int i{1};
+
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (i + 1 >= argc) {
+      usage();
+      return 2;
+    }
+    if (std::strcmp(argv[i], "-n") == 0) {
+      count = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (std::strcmp(argv[i], "-r") == 0) {
+      samplesPerSec =
+          static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (argc - i != 2 || count == 0 || count > 32767) {
+    usage();
+    return 2;
+  }
+
+  std::string directory = argv[i];
+  const char *output = argv[i + 1];
+  BankEntry *entries = new BankEntry[count];
+  uint32_t packed{0};
+
+  for (uint32_t n = 0; n < count; n++) {
+    char name[16]{};
+
+    std::snprintf(name, sizeof(name), "/%03u.wav", n + 1);
+
+    if (loadEntry(directory + name, samplesPerSec, &entries[n])) {
+      packed += 1;
+    }
+  }
+
+  bool ok = WriteBankFile(output, entries, count);
+
+  for (uint32_t n = 0; n < count; n++) {
+    delete[] entries[n].Samples;
+  }
+
+  delete[] entries;
+  entries = nullptr;
+
+  if (!ok) {
+    std::fprintf(stderr, "sfxpack: failed to write %s\n", output);
+    return 1;
+  }
+
+  std::printf("sfxpack: packed %u of %u waves into %s\n", packed, count,
+              output);
+
+  return 0;
+}
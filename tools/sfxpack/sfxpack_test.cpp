@@ -0,0 +1,157 @@
+// Packs a few generated waves with sfxpack and reads them back through
+// BankFile and SFXBank.
+//
+// Usage: sfxpack_test <path to sfxpack>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+#include "bankfile.h"
+#include "check.h"
+#include "sfxbank.h"
+
+namespace {
+template <typename T> void put(std::ofstream &file, T v) {
+  file.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+// Writes a wave whose sample i on channel c is value(i, c).
+template <typename Sample, typename F>
+void writeWave(const std::string &path, uint16_t tag, uint16_t channels,
+               uint32_t samplesPerSec, uint32_t frames, F value) {
+  std::ofstream file(path, std::ios::binary);
+  uint16_t bits = sizeof(Sample) * 8;
+  uint32_t dataBytes = frames * channels * sizeof(Sample);
+
+  file.write("RIFF", 4);
+  put<uint32_t>(file, 36 + dataBytes);
+  file.write("WAVEfmt ", 8);
+  put<uint32_t>(file, 16);
+  put<uint16_t>(file, tag);
+  put<uint16_t>(file, channels);
+  put<uint32_t>(file, samplesPerSec);
+  put<uint32_t>(file, samplesPerSec * channels * sizeof(Sample));
+  put<uint16_t>(file, channels * sizeof(Sample));
+  put<uint16_t>(file, bits);
+  file.write("data", 4);
+  put<uint32_t>(file, dataBytes);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    for (uint16_t c = 0; c < channels; c++) {
+      put<Sample>(file, value(i, c));
+    }
+  }
+}
+
+bool near(float a, float b) { return std::fabs(a - b) < 1e-4f; }
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: sfxpack_test <path to sfxpack>\n");
+    return 2;
+  }
+
+  char directory[] = "/tmp/sfxpack_testXXXXXX";
+
+  if (mkdtemp(directory) == nullptr) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  std::string dir = directory;
+  std::string bankPath = dir + "/waves.bank";
+
+  writeWave<int16_t>(dir + "/001.wav", 1, 1, 8000, 1000,
+                     [](uint32_t i, uint16_t) {
+                       return static_cast<int16_t>(i * 16);
+                     });
+  writeWave<float>(dir + "/003.wav", 3, 2, 48000, 333,
+                   [](uint32_t i, uint16_t c) {
+                     return c == 0 ? i / 1000.0f : -(i / 1000.0f);
+                   });
+  // Not a wave at all.
+  std::ofstream(dir + "/004.wav") << "garbage";
+
+  std::string command = std::string(argv[1]) + " -n 5 " + dir + " " + bankPath;
+
+  CHECK(std::system(command.c_str()) == 0);
+
+  BankFile bank;
+  BankEntry entry;
+
+  CHECK(bank.Open(bankPath.c_str()));
+  CHECK(bank.GetCount() == 5);
+
+  CHECK(bank.GetEntry(0, &entry));
+  CHECK(entry.Frames == 1000 && entry.Channels == 1);
+  CHECK(entry.SamplesPerSec == 8000);
+  CHECK(reinterpret_cast<uintptr_t>(entry.Samples) % 64 == 0);
+  CHECK(near(entry.Samples[500], 500 * 16 / 32768.0f));
+
+  CHECK(!bank.GetEntry(1, &entry));
+
+  CHECK(bank.GetEntry(2, &entry));
+  CHECK(entry.Frames == 333 && entry.Channels == 2);
+  CHECK(entry.SamplesPerSec == 48000);
+  CHECK(reinterpret_cast<uintptr_t>(entry.Samples) % 64 == 0);
+  CHECK(near(entry.Samples[2 * 332], 0.332f));
+  CHECK(near(entry.Samples[2 * 332 + 1], -0.332f));
+
+  CHECK(!bank.GetEntry(3, &entry));
+  CHECK(!bank.GetEntry(4, &entry));
+  CHECK(!bank.GetEntry(5, &entry));
+
+  // Files that are not banks are rejected.
+  CHECK(!bank.Open((dir + "/001.wav").c_str()));
+
+  {
+    SFXBank sfx(5, 1);
+
+    CHECK(sfx.LoadBank(bankPath.c_str()));
+
+    // At the packed rate the wave points into the mapping.
+    sfx.SetSamplesPerSec(48000);
+
+    const SFXWave *wave = sfx.Acquire(2);
+
+    CHECK(wave != nullptr);
+    CHECK(wave != nullptr && !wave->IsOwned && wave->Frames == 333);
+    CHECK(wave != nullptr && near(wave->Samples[1], 0.0f));
+
+    // Other rates are resampled from the mapped samples.
+    wave = sfx.Acquire(0);
+
+    CHECK(wave != nullptr);
+    CHECK(wave != nullptr && wave->IsOwned);
+    CHECK(wave != nullptr && wave->SamplesPerSec == 48000);
+    CHECK(wave != nullptr && wave->Frames >= 5990 && wave->Frames <= 6000);
+
+    CHECK(sfx.Acquire(1) == nullptr);
+    CHECK(sfx.Acquire(3) == nullptr);
+  }
+
+  // A rate passed to the packer is applied when packing.
+  command = std::string(argv[1]) + " -n 1 -r 16000 " + dir + " " + bankPath;
+
+  CHECK(std::system(command.c_str()) == 0);
+  CHECK(bank.Open(bankPath.c_str()));
+  CHECK(bank.GetEntry(0, &entry));
+  CHECK(entry.SamplesPerSec == 16000);
+  CHECK(entry.Frames >= 1995 && entry.Frames <= 2000);
+
+  bank.Close();
+
+  for (const char *name : {"/001.wav", "/003.wav", "/004.wav", "/waves.bank"}) {
+    std::remove((dir + name).c_str());
+  }
+
+  rmdir(directory);
+
+  return TestResult();
+}
@@ -0,0 +1,170 @@
+// Plays constant waves through SFXSource: which voice is stolen under each
+// policy once the pool is full, and the level each voice reaches on the left
+// and right for its gain and pan.
+
+#include <vector>
+
+#include "check.h"
+#include "sfxsource.h"
+
+namespace {
+constexpr uint32_t SamplesPerSec = 48000;
+// Longer than the 5 ms fade of a stolen voice.
+constexpr uint32_t BlockFrames = 480;
+
+// A mono wave that holds value for a second. Values are powers of two, so
+// the sum of any set of them tells which waves are playing.
+struct ConstantWave {
+  std::vector<float> Samples;
+  SFXWave Wave;
+
+  explicit ConstantWave(float value) : Samples(SamplesPerSec, value) {
+    Wave.Samples = Samples.data();
+    Wave.IsOwned = false;
+    Wave.Frames = SamplesPerSec;
+    Wave.Channels = 1;
+    Wave.SamplesPerSec = SamplesPerSec;
+  }
+};
+
+// Renders a block and returns its last frame, which is past any fade.
+void renderBlock(SFXSource *source, uint64_t *position, float *frame) {
+  std::vector<float> block(BlockFrames * 2);
+
+  source->Render(block.data(), *position, BlockFrames, 2);
+  *position += BlockFrames;
+
+  frame[0] = block[(BlockFrames - 1) * 2];
+  frame[1] = block[(BlockFrames - 1) * 2 + 1];
+}
+
+void testStealOldest() {
+  ConstantWave a(1.0f / 2);
+  ConstantWave b(1.0f / 4);
+  ConstantWave c(1.0f / 8);
+  ConstantWave d(1.0f / 16);
+  SFXSource source(nullptr, 3, StealPolicy::Oldest);
+  uint64_t position{0};
+  float frame[2];
+
+  source.SetTargetSamplesPerSec(SamplesPerSec);
+
+  // Started in separate blocks, a is the oldest though it is the loudest.
+  CHECK(source.Play(&a.Wave, 1.0f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(source.Play(&b.Wave, 0.25f, 0.0f));
+  CHECK(source.Play(&c.Wave, 1.0f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 2 + 1.0f / 16 + 1.0f / 8);
+  CHECK(source.GetStolenCount() == 0);
+
+  CHECK(source.Play(&d.Wave, 1.0f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 16 + 1.0f / 8 + 1.0f / 16);
+  CHECK(frame[1] == frame[0]);
+  CHECK(source.GetStolenCount() == 1);
+  CHECK(source.GetCompletedCount() == 1);
+}
+
+void testStealQuietest() {
+  ConstantWave a(1.0f / 2);
+  ConstantWave b(1.0f / 4);
+  ConstantWave c(1.0f / 8);
+  ConstantWave d(1.0f / 16);
+  ConstantWave e(1.0f / 32);
+  SFXSource source(nullptr, 3, StealPolicy::Quietest);
+  uint64_t position{0};
+  float frame[2];
+
+  source.SetTargetSamplesPerSec(SamplesPerSec);
+
+  // The gain decides, not the level of the wave, and ties go to the oldest.
+  CHECK(source.Play(&a.Wave, 0.5f, 0.0f));
+  CHECK(source.Play(&b.Wave, 1.0f, 0.0f));
+  CHECK(source.Play(&c.Wave, 0.5f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 4 + 1.0f / 4 + 1.0f / 16);
+
+  CHECK(source.Play(&d.Wave, 1.0f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 4 + 1.0f / 16 + 1.0f / 16);
+
+  CHECK(source.Play(&e.Wave, 1.0f, 0.0f));
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 4 + 1.0f / 16 + 1.0f / 32);
+  CHECK(source.GetStolenCount() == 2);
+  CHECK(source.GetCompletedCount() == 2);
+}
+
+// More waves in one block than voices: each start steals from the ones
+// before it, and the stolen ones fade out alongside.
+void testStealInOneBlock() {
+  ConstantWave waves[] = {ConstantWave(1.0f / 2), ConstantWave(1.0f / 4),
+                          ConstantWave(1.0f / 8), ConstantWave(1.0f / 16),
+                          ConstantWave(1.0f / 32)};
+  SFXSource source(nullptr, 2, StealPolicy::Oldest);
+  uint64_t position{0};
+  float frame[2];
+
+  source.SetTargetSamplesPerSec(SamplesPerSec);
+
+  for (ConstantWave &wave : waves) {
+    CHECK(source.Play(&wave.Wave, 1.0f, 0.0f));
+  }
+
+  renderBlock(&source, &position, frame);
+  CHECK(frame[0] == 1.0f / 16 + 1.0f / 32);
+  CHECK(source.GetStolenCount() == 3);
+  CHECK(source.GetCompletedCount() == 3);
+}
+
+struct PanCase {
+  float Gain;
+  float Pan;
+  float Left;
+  float Right;
+};
+
+void testGainAndPan() {
+  const PanCase cases[] = {
+      {1.0f, -1.0f, 0.5f, 0.0f},    {1.0f, 0.0f, 0.5f, 0.5f},
+      {1.0f, 1.0f, 0.0f, 0.5f},     {0.5f, -1.0f, 0.25f, 0.0f},
+      {0.5f, 0.0f, 0.25f, 0.25f},   {0.5f, 1.0f, 0.0f, 0.25f},
+      {1.0f, 0.5f, 0.25f, 0.5f},    {1.0f, -0.5f, 0.5f, 0.25f},
+      {1.0f, -3.0f, 0.5f, 0.0f},    {-1.0f, 0.0f, 0.0f, 0.0f},
+  };
+  ConstantWave wave(0.5f);
+
+  for (const PanCase &c : cases) {
+    SFXSource source(nullptr, 1, StealPolicy::Oldest);
+    uint64_t position{0};
+    float frame[2];
+
+    source.SetTargetSamplesPerSec(SamplesPerSec);
+    CHECK(source.Play(&wave.Wave, c.Gain, c.Pan));
+    renderBlock(&source, &position, frame);
+    CHECK(frame[0] == c.Left);
+    CHECK(frame[1] == c.Right);
+  }
+
+  // Voices add up, each with its own gain and pan, and a mono output takes
+  // the middle.
+  SFXSource source(nullptr, 2, StealPolicy::Oldest);
+  std::vector<float> block(BlockFrames);
+
+  source.SetTargetSamplesPerSec(SamplesPerSec);
+  CHECK(source.Play(&wave.Wave, 1.0f, -1.0f));
+  CHECK(source.Play(&wave.Wave, 0.5f, 1.0f));
+  source.Render(block.data(), 0, BlockFrames, 1);
+  CHECK(block[0] == 0.5f * (0.5f + 0.25f));
+}
+} // namespace
+
+int main() {
+  testStealOldest();
+  testStealQuietest();
+  testStealInOneBlock();
+  testGainAndPan();
+
+  return TestResult();
+}
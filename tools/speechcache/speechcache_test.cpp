@@ -0,0 +1,184 @@
+// Checks that SpeechCache evicts the least recently used waves to stay
+// within its byte budget, and that its keys tell apart the voice, each part
+// of the prosody, SSML and the text.
+
+#include <cwchar>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "speechcache.h"
+
+namespace {
+SpeechWave makeWave(size_t bytes) {
+  return std::make_shared<std::vector<char>>(bytes, 'w');
+}
+
+std::wstring makeKey(const wchar_t *text, const VoiceSettings &voice,
+                     bool isSSML = false) {
+  std::wstring key;
+
+  SpeechCache::MakeKey(isSSML, text,
+                       static_cast<uint32_t>(std::wcslen(text)), voice, &key);
+
+  return key;
+}
+
+// The size of an entry is its wave and its key.
+uint64_t sizeOf(const std::wstring &key, const SpeechWave &wave) {
+  return wave->size() + key.size() * sizeof(wchar_t);
+}
+
+void testEviction() {
+  VoiceSettings voice;
+  std::wstring a = makeKey(L"a", voice);
+  std::wstring b = makeKey(L"b", voice);
+  std::wstring c = makeKey(L"c", voice);
+  std::wstring d = makeKey(L"d", voice);
+  SpeechWave wave = makeWave(1000);
+  uint64_t entry = sizeOf(a, wave);
+  SpeechCache cache(3 * entry);
+
+  cache.Insert(a, wave);
+  cache.Insert(b, makeWave(1000));
+  cache.Insert(c, makeWave(1000));
+  CHECK(cache.GetSize() == 3 * entry);
+
+  // Finding a makes b the least recently used, which d pushes out.
+  CHECK(cache.Find(a) == wave);
+  cache.Insert(d, makeWave(1000));
+  CHECK(cache.GetSize() == 3 * entry);
+  CHECK(cache.Find(b) == nullptr);
+  CHECK(cache.Find(a) != nullptr);
+  CHECK(cache.Find(c) != nullptr);
+  CHECK(cache.Find(d) != nullptr);
+  CHECK(cache.GetHitCount() == 4);
+  CHECK(cache.GetMissCount() == 1);
+
+  // Inserting a key again replaces its wave and makes it the most recent.
+  SpeechWave replaced = makeWave(1000);
+
+  cache.Insert(a, replaced);
+  cache.Insert(b, makeWave(1000));
+  CHECK(cache.Find(a) == replaced);
+  CHECK(cache.Find(c) == nullptr);
+  CHECK(cache.GetSize() == 3 * entry);
+
+  // An evicted wave stays valid while it is held.
+  SpeechWave held = cache.Find(d);
+
+  cache.Clear();
+  CHECK(cache.GetSize() == 0);
+  CHECK(cache.Find(d) == nullptr);
+  CHECK(held->size() == 1000 && (*held)[999] == 'w');
+}
+
+void testBudget() {
+  VoiceSettings voice;
+  std::wstring small = makeKey(L"small", voice);
+  std::wstring large = makeKey(L"large", voice);
+  std::wstring other = makeKey(L"other", voice);
+  SpeechWave smallWave = makeWave(100);
+  SpeechWave largeWave = makeWave(4000);
+  uint64_t budget = sizeOf(large, largeWave);
+  SpeechCache cache(budget);
+
+  // A wave larger than the whole budget is not kept, and evicts nothing.
+  cache.Insert(small, smallWave);
+  cache.Insert(other, makeWave(4001));
+  CHECK(cache.Find(other) == nullptr);
+  CHECK(cache.Find(small) != nullptr);
+
+  // One that fits exactly evicts everything else.
+  cache.Insert(large, largeWave);
+  CHECK(cache.GetSize() == budget);
+  CHECK(cache.Find(small) == nullptr);
+  CHECK(cache.Find(large) != nullptr);
+
+  // Lowering the budget evicts at once, raising it keeps what is left.
+  cache.Insert(small, smallWave);
+  CHECK(cache.GetSize() == sizeOf(small, smallWave));
+  cache.SetBudget(budget * 2);
+  cache.Insert(large, largeWave);
+  CHECK(cache.GetSize() == budget + sizeOf(small, smallWave));
+  cache.SetBudget(budget);
+  CHECK(cache.GetBudget() == budget);
+  CHECK(cache.GetSize() == budget);
+  CHECK(cache.Find(small) == nullptr);
+  cache.SetBudget(0);
+  CHECK(cache.GetSize() == 0);
+}
+
+void testKeys() {
+  VoiceSettings voice;
+  VoiceSettings other = voice;
+  std::vector<std::wstring> keys;
+
+  voice.VoiceId = L"voice-a";
+  keys.push_back(makeKey(L"hello", voice));
+  keys.push_back(makeKey(L"hello", voice, true));
+  keys.push_back(makeKey(L"hello!", voice));
+  keys.push_back(makeKey(L"", voice));
+
+  other = voice;
+  other.VoiceId = L"voice-b";
+  keys.push_back(makeKey(L"hello", other));
+
+  // The id ends where the text could start.
+  other.VoiceId = L"voice-ah";
+  keys.push_back(makeKey(L"ello", other));
+
+  other.VoiceId = nullptr;
+  keys.push_back(makeKey(L"hello", other));
+
+  other = voice;
+  other.SpeakingRate = 1.5;
+  keys.push_back(makeKey(L"hello", other));
+
+  other = voice;
+  other.AudioPitch = 1.5;
+  keys.push_back(makeKey(L"hello", other));
+
+  other = voice;
+  other.AudioVolume = 0.5;
+  keys.push_back(makeKey(L"hello", other));
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    for (size_t j = i + 1; j < keys.size(); j++) {
+      CHECK(keys[i] != keys[j]);
+    }
+  }
+
+  // The voice index and the table version are not part of the key.
+  other = voice;
+  other.VoiceIndex = 3;
+  other.Version = 42;
+  CHECK(makeKey(L"hello", other) == keys[0]);
+
+  // Only the given length of the text counts.
+  std::wstring key;
+
+  SpeechCache::MakeKey(false, L"hello world", 5, voice, &key);
+  CHECK(key == keys[0]);
+
+  // Waves under different keys are kept apart in the cache.
+  SpeechCache cache(1 << 20);
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    cache.Insert(keys[i], makeWave(i + 1));
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    SpeechWave wave = cache.Find(keys[i]);
+
+    CHECK(wave != nullptr && wave->size() == i + 1);
+  }
+}
+} // namespace
+
+int main() {
+  testEviction();
+  testBudget();
+  testKeys();
+
+  return TestResult();
+}
@@ -0,0 +1,322 @@
+// Runs SpeechPipeline against a fake synthesizer: the lookahead depth, the
+// order results come out in, cancelling while a job is being synthesized,
+// as a force push does, and that every job gives its text back.
+
+#include <condition_variable>
+#include <cwchar>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "speechpipeline.h"
+
+namespace {
+// Writes the text as bytes, in two pieces. Text starting with "fail" fails.
+// While held, Synthesize waits after the first piece until it is let go.
+class FakeSynthesizer : public Synthesizer {
+public:
+  bool Synthesize(bool isSSML, const wchar_t *text,
+                  const VoiceSettings &voice,
+                  SpeechWriter *writer) override {
+    std::string bytes(text, text + std::wcslen(text));
+
+    writer->Write(bytes.data(), bytes.size() / 2);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mTexts.push_back(text);
+    mIsRunning = true;
+    mChanged.notify_all();
+    mChanged.wait(lock, [this]() { return !mIsHeld; });
+    mIsRunning = false;
+    lock.unlock();
+
+    writer->Write(bytes.data() + bytes.size() / 2,
+                  bytes.size() - bytes.size() / 2);
+
+    return bytes.compare(0, 4, "fail") != 0;
+  }
+
+  void Hold() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mIsHeld = true;
+  }
+
+  void LetGo() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mIsHeld = false;
+    mChanged.notify_all();
+  }
+
+  void WaitUntilRunning() {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mChanged.wait(lock, [this]() { return mIsRunning; });
+  }
+
+  std::vector<std::wstring> GetTexts() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mTexts;
+  }
+
+private:
+  std::mutex mMutex;
+  std::condition_variable mChanged;
+  bool mIsHeld = false;
+  bool mIsRunning = false;
+  std::vector<std::wstring> mTexts;
+};
+
+// Room for the text of four jobs, which is as many as the tests hold.
+constexpr uint32_t MaxTexts = 4;
+
+// The text goes through an arena the way it comes from the command ring. It
+// is released here when the pipeline does not take it.
+bool submit(SpeechPipeline *pipeline, TextArena *arena, const wchar_t *text) {
+  VoiceSettings voice;
+  TextSpan span;
+
+  if (!arena->Allocate(text, std::wcslen(text), &span)) {
+    return false;
+  }
+  if (!pipeline->Submit(false, arena, span, voice)) {
+    arena->Release(span);
+    return false;
+  }
+
+  return true;
+}
+
+// Whether the pipeline released all the text it was given: only then can
+// the arena hold MaxTexts strings again.
+bool isReleased(TextArena *arena) {
+  TextSpan spans[MaxTexts];
+  uint32_t n{0};
+
+  while (n < MaxTexts && arena->Allocate(L"x", 1, &spans[n])) {
+    n += 1;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    arena->Release(spans[i]);
+  }
+
+  return n == MaxTexts;
+}
+
+// Reads the whole front wave, which must be complete.
+std::string readFront(const SpeechPipeline &pipeline) {
+  std::string wave;
+  bool isComplete{false};
+  char buffer[4];
+
+  while (!isComplete) {
+    uint32_t n = pipeline.ReadFront(wave.size(), buffer, sizeof(buffer),
+                                    &isComplete);
+
+    if (n == 0 && !isComplete) {
+      return wave + "<incomplete>";
+    }
+
+    wave.append(buffer, n);
+  }
+
+  return wave;
+}
+
+void testLookahead() {
+  SpeechPipeline pipeline(3, nullptr);
+  TextArena arena(256, 256, MaxTexts);
+  FakeSynthesizer synthesizer;
+
+  CHECK(pipeline.GetDepth() == 3);
+  CHECK(pipeline.GetFrontState() == SpeechState::Empty);
+  CHECK(!pipeline.ProcessNext(&synthesizer, nullptr, nullptr));
+
+  CHECK(submit(&pipeline, &arena, L"one"));
+  CHECK(submit(&pipeline, &arena, L"two"));
+  CHECK(!pipeline.IsFull());
+  CHECK(submit(&pipeline, &arena, L"fail three"));
+  CHECK(pipeline.IsFull());
+  CHECK(!submit(&pipeline, &arena, L"four"));
+  CHECK(pipeline.GetFrontState() == SpeechState::Pending);
+
+  // Results are synthesized ahead, up to the depth.
+  int progress{0};
+  auto onProgress = [](void *context) { *static_cast<int *>(context) += 1; };
+
+  CHECK(pipeline.ProcessNext(&synthesizer, onProgress, &progress));
+  CHECK(pipeline.ProcessNext(&synthesizer, onProgress, &progress));
+  CHECK(pipeline.ProcessNext(&synthesizer, onProgress, &progress));
+  CHECK(!pipeline.ProcessNext(&synthesizer, onProgress, &progress));
+  CHECK(progress == 9);
+  CHECK((synthesizer.GetTexts() ==
+         std::vector<std::wstring>{L"one", L"two", L"fail three"}));
+
+  CHECK(pipeline.GetFrontState() == SpeechState::Ready);
+  CHECK(readFront(pipeline) == "one");
+  pipeline.PopFront();
+  CHECK(!pipeline.IsFull());
+  CHECK(submit(&pipeline, &arena, L"four"));
+  CHECK(readFront(pipeline) == "two");
+  pipeline.PopFront();
+  CHECK(pipeline.GetFrontState() == SpeechState::Failed);
+  pipeline.PopFront();
+  CHECK(pipeline.GetFrontState() == SpeechState::Pending);
+  CHECK(pipeline.ProcessNext(&synthesizer, nullptr, nullptr));
+  CHECK(readFront(pipeline) == "four");
+  pipeline.PopFront();
+  CHECK(pipeline.GetFrontState() == SpeechState::Empty);
+  CHECK(pipeline.GetCancelledCount() == 0);
+  CHECK(isReleased(&arena));
+}
+
+// Cancels while the worker synthesizes the front job. The job is freed
+// once it finishes, without reaching the cache, and the jobs submitted after
+// the cancel come out in order. Repeated, so that a job that was never freed
+// would leave Submit without one.
+void testCancelWhileRunning() {
+  constexpr uint32_t Depth = 2;
+  SpeechCache cache(1 << 20);
+  SpeechPipeline pipeline(Depth, &cache);
+  TextArena arena(256, 256, MaxTexts);
+  FakeSynthesizer synthesizer;
+  VoiceSettings voice;
+  std::vector<std::wstring> expected;
+
+  for (int round = 0; round < 3; round++) {
+    std::wstring old = L"old " + std::to_wstring(round);
+    std::wstring skipped = L"skipped " + std::to_wstring(round);
+    std::wstring first = L"first " + std::to_wstring(round);
+    std::wstring second = L"second " + std::to_wstring(round);
+
+    synthesizer.Hold();
+    CHECK(submit(&pipeline, &arena, old.c_str()));
+    CHECK(submit(&pipeline, &arena, skipped.c_str()));
+
+    std::thread worker([&]() {
+      while (pipeline.ProcessNext(&synthesizer, nullptr, nullptr)) {
+      }
+    });
+
+    synthesizer.WaitUntilRunning();
+    CHECK(pipeline.GetFrontState() == SpeechState::Ready);
+
+    pipeline.Cancel();
+    CHECK(pipeline.GetFrontState() == SpeechState::Empty);
+    CHECK(pipeline.GetCancelledCount() == (round + 1) * Depth);
+
+    // Both slots are free while the cancelled job is still running.
+    CHECK(submit(&pipeline, &arena, first.c_str()));
+    CHECK(submit(&pipeline, &arena, second.c_str()));
+    CHECK(pipeline.IsFull());
+    CHECK(pipeline.GetFrontState() == SpeechState::Pending);
+
+    synthesizer.LetGo();
+    worker.join();
+
+    expected.push_back(old);
+    expected.push_back(first);
+    expected.push_back(second);
+    CHECK(synthesizer.GetTexts() == expected);
+
+    std::string firstBytes(first.begin(), first.end());
+    std::string secondBytes(second.begin(), second.end());
+
+    CHECK(readFront(pipeline) == firstBytes);
+    pipeline.PopFront();
+    CHECK(readFront(pipeline) == secondBytes);
+    pipeline.PopFront();
+    CHECK(pipeline.GetFrontState() == SpeechState::Empty);
+
+    std::wstring key;
+
+    SpeechCache::MakeKey(false, old.c_str(), old.size(), voice, &key);
+    CHECK(cache.Find(key) == nullptr);
+    SpeechCache::MakeKey(false, first.c_str(), first.size(), voice, &key);
+    CHECK(cache.Find(key) != nullptr);
+  }
+
+  CHECK(isReleased(&arena));
+}
+
+// PopFront on a job that is running discards it the same way.
+void testPopWhileRunning() {
+  SpeechPipeline pipeline(1, nullptr);
+  TextArena arena(256, 256, MaxTexts);
+  FakeSynthesizer synthesizer;
+
+  synthesizer.Hold();
+  CHECK(submit(&pipeline, &arena, L"abandoned"));
+
+  std::thread worker(
+      [&]() { pipeline.ProcessNext(&synthesizer, nullptr, nullptr); });
+
+  synthesizer.WaitUntilRunning();
+  pipeline.PopFront();
+  CHECK(submit(&pipeline, &arena, L"next"));
+  synthesizer.LetGo();
+  worker.join();
+
+  CHECK(pipeline.GetFrontState() == SpeechState::Pending);
+  CHECK(pipeline.ProcessNext(&synthesizer, nullptr, nullptr));
+  CHECK(readFront(pipeline) == "next");
+  CHECK(pipeline.GetCancelledCount() == 0);
+  CHECK(isReleased(&arena));
+}
+
+// A force push cancels what was queued before it. Jobs submitted after it
+// are synthesized and read in order, and ones submitted before it that were
+// already synthesized stay cached.
+void testForcePush() {
+  SpeechCache cache(1 << 20);
+  SpeechPipeline pipeline(4, &cache);
+  TextArena arena(256, 256, MaxTexts);
+  FakeSynthesizer synthesizer;
+
+  CHECK(submit(&pipeline, &arena, L"a"));
+  CHECK(submit(&pipeline, &arena, L"b"));
+  CHECK(submit(&pipeline, &arena, L"c"));
+  CHECK(pipeline.ProcessNext(&synthesizer, nullptr, nullptr));
+
+  pipeline.Cancel();
+  CHECK(pipeline.GetCancelledCount() == 3);
+
+  CHECK(submit(&pipeline, &arena, L"d"));
+  CHECK(submit(&pipeline, &arena, L"a"));
+  CHECK(submit(&pipeline, &arena, L"e"));
+
+  // The repeated one comes from the cache, ready before the one ahead of it.
+  CHECK(pipeline.GetFrontState() == SpeechState::Pending);
+
+  while (pipeline.ProcessNext(&synthesizer, nullptr, nullptr)) {
+  }
+
+  CHECK((synthesizer.GetTexts() ==
+         std::vector<std::wstring>{L"a", L"d", L"e"}));
+
+  const char *order[] = {"d", "a", "e"};
+
+  for (const char *text : order) {
+    CHECK(readFront(pipeline) == text);
+    pipeline.PopFront();
+  }
+
+  CHECK(pipeline.GetFrontState() == SpeechState::Empty);
+  CHECK(cache.GetHitCount() == 1);
+  CHECK(isReleased(&arena));
+}
+} // namespace
+
+int main() {
+  testLookahead();
+  testCancelWhileRunning();
+  testPopWhileRunning();
+  testForcePush();
+
+  return TestResult();
+}
@@ -0,0 +1,161 @@
+// Checks the THD+N, gain and timing of each resampling tier, both through
+// Resample and through StreamSource.
+//
+// Usage: resampler_test
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "check.h"
+#include "resampler.h"
+#include "streamsource.h"
+#include "thdn.h"
+
+namespace {
+const double pi = 3.14159265358979323846;
+
+std::vector<float> sine(uint32_t frames, double frequency,
+                        uint32_t samplesPerSec) {
+  std::vector<float> samples(frames * 2);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    samples[i * 2] = samples[i * 2 + 1] = static_cast<float>(
+        0.5 * std::sin(2.0 * pi * frequency * i / samplesPerSec));
+  }
+
+  return samples;
+}
+
+// THD+N of a one second sine converted by Resample, leaving out the edges.
+double thdnOf(uint32_t srcRate, uint32_t dstRate, ResampleQuality quality,
+              double frequency) {
+  std::vector<float> src = sine(srcRate, frequency, srcRate);
+  uint32_t frames = ResampledFrames(srcRate, srcRate, dstRate);
+  std::vector<float> dst(frames * 2);
+  uint32_t edge = dstRate / 10;
+
+  Resample(src.data(), srcRate, 2, srcRate, dstRate, quality, dst.data());
+
+  return MeasureTHDN(dst.data() + edge * 2, frames - edge * 2, 2, frequency,
+                     dstRate);
+}
+
+// Plays pcm through a StreamSource at 48 kHz and returns the output.
+std::vector<float> play(const std::vector<int16_t> &pcm, uint32_t srcRate,
+                        ResampleQuality quality, uint64_t *endFrame) {
+  StreamSource stream(1 << 20);
+  StreamFormat format;
+  std::vector<float> output;
+  float block[480 * 2];
+  uint64_t position{0};
+
+  format.Format = SampleFormat::Int16;
+  format.Channels = 1;
+  format.SamplesPerSec = srcRate;
+
+  stream.SetTargetSamplesPerSec(48000);
+  stream.SetResampleQuality(quality);
+  stream.Begin(format);
+  stream.Write(reinterpret_cast<const char *>(pcm.data()),
+               static_cast<uint32_t>(pcm.size() * sizeof(int16_t)));
+  stream.End();
+
+  while (position < 48000 * 10) {
+    int32_t completions = stream.Render(block, position, 480, 2);
+
+    output.insert(output.end(), block, block + 480 * 2);
+    position += 480;
+
+    if (completions > 0) {
+      break;
+    }
+  }
+
+  *endFrame = stream.GetEndFrame();
+
+  return output;
+}
+} // namespace
+
+int main() {
+  const ResampleQuality sincs[] = {ResampleQuality::ShortSinc,
+                                   ResampleQuality::LongSinc};
+  const double limits[] = {-65.0, -100.0};
+  const uint32_t pairs[][2] = {
+      {22050, 48000}, {24000, 48000}, {44100, 48000}, {48000, 22050}};
+
+  for (const uint32_t *pair : pairs) {
+    CHECK(thdnOf(pair[0], pair[1], ResampleQuality::Linear, 1000.0) < -40.0);
+
+    for (int q = 0; q < 2; q++) {
+      for (double frequency : {1000.0, 5000.0}) {
+        double thdn = thdnOf(pair[0], pair[1], sincs[q], frequency);
+
+        if (thdn >= limits[q]) {
+          std::fprintf(stderr, "%u -> %u, tier %d, %.0f Hz: %.1f dB\n",
+                       pair[0], pair[1], q + 1, frequency, thdn);
+        }
+
+        CHECK(thdn < limits[q]);
+      }
+    }
+  }
+
+  // Every phase passes DC unchanged.
+  for (ResampleQuality quality : sincs) {
+    std::vector<float> src(1000, 0.5f);
+    std::vector<float> dst(ResampledFrames(1000, 22050, 48000));
+
+    Resample(src.data(), 1000, 1, 22050, 48000, quality, dst.data());
+
+    for (size_t i = 200; i < dst.size() - 200; i++) {
+      CHECK(std::fabs(dst[i] - 0.5f) < 1e-4f);
+    }
+  }
+
+  // Tables are shared per rate pair and tier.
+  CHECK(ResampleTable::Find(22050, 48000, ResampleQuality::LongSinc) ==
+        ResampleTable::Find(22050, 48000, ResampleQuality::LongSinc));
+  CHECK(ResampleTable::Find(22050, 48000, ResampleQuality::Linear) ==
+        nullptr);
+  CHECK(ResampleTable::Find(48000, 48000, ResampleQuality::LongSinc) ==
+        nullptr);
+
+  // Streams start on their first frame and last as long as they should.
+  for (ResampleQuality quality :
+       {ResampleQuality::Linear, ResampleQuality::ShortSinc,
+        ResampleQuality::LongSinc}) {
+    std::vector<int16_t> pcm(22050);
+    uint64_t endFrame{0};
+
+    for (size_t i = 0; i < pcm.size(); i++) {
+      pcm[i] = static_cast<int16_t>(16384.0 * std::sin(2.0 * pi * 1000.0 * i /
+                                                       22050.0));
+    }
+
+    std::vector<float> output = play(pcm, 22050, quality, &endFrame);
+    uint64_t expected = ResampledFrames(22050, 22050, 48000);
+    double thdn = MeasureTHDN(output.data() + 4800 * 2, 48000 - 9600, 2,
+                              1000.0, 48000);
+
+    CHECK(endFrame + 1 >= expected && endFrame <= expected + 1);
+    // The 16 bit source limits what the long filter can show.
+    CHECK(quality != ResampleQuality::ShortSinc || thdn < -65.0);
+    CHECK(quality != ResampleQuality::LongSinc || thdn < -85.0);
+
+    std::vector<int16_t> click(100, 0);
+    int peak{0};
+
+    click[0] = 16384;
+    output = play(click, 22050, quality, &endFrame);
+
+    for (int i = 1; i < 100; i++) {
+      peak = std::fabs(output[i * 2]) > std::fabs(output[peak * 2]) ? i : peak;
+    }
+
+    CHECK(peak == 0);
+  }
+
+  return TestResult();
+}
@@ -0,0 +1,165 @@
+// srcbench measures the speed and THD+N of each resampling tier for the rate
+// pairs speech and sound effects are converted at.
+//
+// Usage: srcbench [-s seconds]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "resampler.h"
+#include "streamsource.h"
+#include "thdn.h"
+
+namespace {
+const double pi = 3.14159265358979323846;
+
+void usage() { std::fprintf(stderr, "usage: srcbench [-s seconds]\n"); }
+
+const char *nameOf(ResampleQuality quality) {
+  switch (quality) {
+  case ResampleQuality::Linear:
+    return "linear";
+  case ResampleQuality::ShortSinc:
+    return "short";
+  case ResampleQuality::LongSinc:
+    return "long";
+  }
+
+  return "";
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Returns the output frames per second Resample makes from stereo noise.
+double measureResample(uint32_t srcRate, uint32_t dstRate,
+                       ResampleQuality quality, double seconds) {
+  uint32_t frames = static_cast<uint32_t>(srcRate * seconds);
+  uint32_t dstFrames = ResampledFrames(frames, srcRate, dstRate);
+  std::vector<float> src(frames * 2);
+  std::vector<float> dst(dstFrames * 2);
+
+  std::srand(1);
+
+  for (float &s : src) {
+    s = static_cast<float>(std::rand()) / RAND_MAX - 0.5f;
+  }
+
+  // Builds the table outside of the measurement.
+  ResampleTable::Find(srcRate, dstRate, quality);
+
+  auto start = std::chrono::steady_clock::now();
+
+  Resample(src.data(), frames, 2, srcRate, dstRate, quality, dst.data());
+
+  return dstFrames / secondsSince(start);
+}
+
+// Returns the output frames per second StreamSource renders from 16 bit
+// mono, as the voice bus does.
+double measureStream(uint32_t srcRate, uint32_t dstRate,
+                     ResampleQuality quality, double seconds) {
+  uint32_t frames = static_cast<uint32_t>(srcRate * seconds);
+  std::vector<int16_t> pcm(frames);
+  StreamSource stream(static_cast<uint32_t>(pcm.size() * sizeof(int16_t)));
+  StreamFormat format;
+  float block[480 * 2];
+  uint64_t position{0};
+
+  for (uint32_t i = 0; i < frames; i++) {
+    pcm[i] = static_cast<int16_t>(8192.0 * std::sin(2.0 * pi * 440.0 * i /
+                                                    srcRate));
+  }
+
+  format.Format = SampleFormat::Int16;
+  format.Channels = 1;
+  format.SamplesPerSec = srcRate;
+
+  stream.SetTargetSamplesPerSec(dstRate);
+  stream.SetResampleQuality(quality);
+  stream.Begin(format);
+  stream.Write(reinterpret_cast<const char *>(pcm.data()),
+               static_cast<uint32_t>(pcm.size() * sizeof(int16_t)));
+  stream.End();
+
+  auto start = std::chrono::steady_clock::now();
+
+  while (stream.Render(block, position, 480, 2) == 0) {
+    position += 480;
+  }
+
+  return position / secondsSince(start);
+}
+
+double measureTHDN(uint32_t srcRate, uint32_t dstRate,
+                   ResampleQuality quality, double frequency) {
+  std::vector<float> src(srcRate);
+  uint32_t frames = ResampledFrames(srcRate, srcRate, dstRate);
+  std::vector<float> dst(frames);
+  uint32_t edge = dstRate / 10;
+
+  for (uint32_t i = 0; i < srcRate; i++) {
+    src[i] = static_cast<float>(
+        0.5 * std::sin(2.0 * pi * frequency * i / srcRate));
+  }
+
+  Resample(src.data(), srcRate, 1, srcRate, dstRate, quality, dst.data());
+
+  return MeasureTHDN(dst.data() + edge, frames - edge * 2, 1, frequency,
+                     dstRate);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  double seconds{10.0};
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seconds = std::atof(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (seconds <= 0.0) {
+    usage();
+    return 2;
+  }
+
+  const uint32_t pairs[][2] = {{16000, 48000}, {22050, 48000}, {24000, 48000},
+                               {44100, 48000}, {22050, 44100}, {48000, 44100}};
+  const ResampleQuality qualities[] = {ResampleQuality::Linear,
+                                       ResampleQuality::ShortSinc,
+                                       ResampleQuality::LongSinc};
+
+  std::printf("%-13s %-6s %5s %12s %10s %10s %10s %10s\n", "rates", "tier",
+              "taps", "frames/s", "realtime", "stream", "1k THD+N",
+              "5k THD+N");
+
+  for (const uint32_t *pair : pairs) {
+    for (ResampleQuality quality : qualities) {
+      const ResampleTable *table =
+          ResampleTable::Find(pair[0], pair[1], quality);
+      double rate = measureResample(pair[0], pair[1], quality, seconds);
+      double streamRate = measureStream(pair[0], pair[1], quality, seconds);
+      char rates[32];
+
+      std::snprintf(rates, sizeof(rates), "%u>%u", pair[0], pair[1]);
+      std::printf("%-13s %-6s %5u %12.0f %9.0fx %9.0fx %7.1f dB %7.1f dB\n",
+                  rates, nameOf(quality),
+                  table != nullptr ? table->GetTaps() : 2, rate,
+                  rate / pair[1], streamRate / pair[1],
+                  measureTHDN(pair[0], pair[1], quality, 1000.0),
+                  measureTHDN(pair[0], pair[1], quality, 5000.0));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Returns THD+N in dB: the power of everything but a sine at frequency,
+// relative to the power of that sine. Samples are read from x with stride
+// and the sine is fitted by least squares along with a DC offset.
+inline double MeasureTHDN(const float *x, size_t frames, size_t stride,
+                          double frequency, uint32_t samplesPerSec) {
+  const double pi = 3.14159265358979323846;
+  double w = 2.0 * pi * frequency / samplesPerSec;
+  // Normal equations for x ~ a sin + b cos + c.
+  double m[3][4]{};
+
+  for (size_t i = 0; i < frames; i++) {
+    double basis[3] = {std::sin(w * i), std::cos(w * i), 1.0};
+    double v = x[i * stride];
+
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        m[r][c] += basis[r] * basis[c];
+      }
+
+      m[r][3] += basis[r] * v;
+    }
+  }
+  for (int p = 0; p < 3; p++) {
+    for (int r = p + 1; r < 3; r++) {
+      double f = m[r][p] / m[p][p];
+
+      for (int c = p; c < 4; c++) {
+        m[r][c] -= f * m[p][c];
+      }
+    }
+  }
+
+  double coef[3]{};
+
+  for (int r = 2; r >= 0; r--) {
+    double v = m[r][3];
+
+    for (int c = r + 1; c < 3; c++) {
+      v -= m[r][c] * coef[c];
+    }
+
+    coef[r] = v / m[r][r];
+  }
+
+  double signal{0.0};
+  double residual{0.0};
+
+  for (size_t i = 0; i < frames; i++) {
+    double sine = coef[0] * std::sin(w * i) + coef[1] * std::cos(w * i);
+    double e = x[i * stride] - sine - coef[2];
+
+    signal += sine * sine;
+    residual += e * e;
+  }
+
+  return 10.0 * std::log10((residual + 1e-30) / (signal + 1e-30));
+}
@@ -0,0 +1,154 @@
+// Negotiates the shared-mode period against a fake audio client.
+
+#include <cstdio>
+
+#include "check.h"
+#include "streamperiod.h"
+
+namespace {
+// Records the calls OpenSharedStream makes. A client without an engine
+// period stands in for a plain IAudioClient.
+class FakeClient : public SharedStreamClient {
+public:
+  bool GetSharedModeEnginePeriod(EnginePeriod *period) override {
+    PeriodCalls += 1;
+
+    if (!HasEnginePeriod) {
+      return false;
+    }
+
+    *period = Period;
+
+    return true;
+  }
+
+  bool InitializeSharedAudioStream(uint32_t periodFrames) override {
+    SharedCalls += 1;
+    RequestedFrames = periodFrames;
+
+    return IsSharedAccepted;
+  }
+
+  bool InitializeDefault() override {
+    DefaultCalls += 1;
+
+    return IsDefaultAccepted;
+  }
+
+  EnginePeriod Period{480, 48, 144, 480};
+  bool HasEnginePeriod = true;
+  bool IsSharedAccepted = true;
+  bool IsDefaultAccepted = true;
+
+  int PeriodCalls = 0;
+  int SharedCalls = 0;
+  int DefaultCalls = 0;
+  uint32_t RequestedFrames = 0;
+};
+
+struct PeriodCase {
+  const char *Name;
+  LatencyMode Mode;
+  EnginePeriod Period;
+  uint32_t Expected;
+};
+
+void testChoosePeriodFrames() {
+  const PeriodCase cases[] = {
+      {"smallest period", LatencyMode::Low, {480, 48, 144, 480}, 144},
+      {"default mode", LatencyMode::Default, {480, 48, 144, 480}, 0},
+      {"rounded up to fundamental", LatencyMode::Low, {480, 48, 130, 480}, 144},
+      {"no fundamental", LatencyMode::Low, {480, 0, 130, 480}, 130},
+      {"rounded up to largest", LatencyMode::Low, {480, 64, 130, 192}, 192},
+      {"rounded up past largest", LatencyMode::Low, {480, 64, 130, 150}, 0},
+      {"smallest past largest", LatencyMode::Low, {480, 0, 200, 150}, 0},
+      {"no largest", LatencyMode::Low, {480, 48, 130, 0}, 144},
+      {"smallest is default", LatencyMode::Low, {480, 48, 480, 480}, 0},
+      {"rounded up to default", LatencyMode::Low, {480, 480, 440, 960}, 0},
+      {"no smallest", LatencyMode::Low, {480, 48, 0, 480}, 0},
+  };
+
+  for (const PeriodCase &c : cases) {
+    uint32_t frames = ChoosePeriodFrames(c.Mode, c.Period);
+
+    if (frames != c.Expected) {
+      std::fprintf(stderr, "%s: got %u, want %u\n", c.Name, frames,
+                   c.Expected);
+      failures += 1;
+    }
+  }
+}
+
+void testLowLatency() {
+  FakeClient client;
+  uint32_t frames{0};
+
+  CHECK(OpenSharedStream(&client, LatencyMode::Low, &frames));
+  CHECK(frames == 144);
+  CHECK(client.RequestedFrames == 144);
+  CHECK(client.SharedCalls == 1 && client.DefaultCalls == 0);
+}
+
+void testDefaultMode() {
+  FakeClient client;
+  uint32_t frames{1};
+
+  CHECK(OpenSharedStream(&client, LatencyMode::Default, &frames));
+  CHECK(frames == 0);
+  CHECK(client.PeriodCalls == 0 && client.SharedCalls == 0);
+  CHECK(client.DefaultCalls == 1);
+}
+
+// The engine rejects the period it offered, so the default one is used.
+void testRejectedPeriod() {
+  FakeClient client;
+  uint32_t frames{1};
+
+  client.IsSharedAccepted = false;
+
+  CHECK(OpenSharedStream(&client, LatencyMode::Low, &frames));
+  CHECK(frames == 0);
+  CHECK(client.SharedCalls == 1 && client.DefaultCalls == 1);
+
+  client.IsDefaultAccepted = false;
+
+  CHECK(!OpenSharedStream(&client, LatencyMode::Low, &frames));
+  CHECK(frames == 0);
+}
+
+void testNoSmallerPeriod() {
+  FakeClient client;
+  uint32_t frames{1};
+
+  client.Period = {480, 480, 480, 480};
+
+  CHECK(OpenSharedStream(&client, LatencyMode::Low, &frames));
+  CHECK(frames == 0);
+  CHECK(client.SharedCalls == 0 && client.DefaultCalls == 1);
+}
+
+// A plain IAudioClient has no engine period and is initialized the default
+// way even when low latency is asked for.
+void testAudioClient() {
+  FakeClient client;
+  uint32_t frames{1};
+
+  client.HasEnginePeriod = false;
+
+  CHECK(OpenSharedStream(&client, LatencyMode::Low, &frames));
+  CHECK(frames == 0);
+  CHECK(client.PeriodCalls == 1);
+  CHECK(client.SharedCalls == 0 && client.DefaultCalls == 1);
+}
+} // namespace
+
+int main() {
+  testChoosePeriodFrames();
+  testLowLatency();
+  testDefaultMode();
+  testRejectedPeriod();
+  testNoSmallerPeriod();
+  testAudioClient();
+
+  return TestResult();
+}
@@ -0,0 +1,173 @@
+// Plays PCM through StreamSource block by block and checks that a stream
+// always completes once it is stopped, whether it is playing, starved or
+// has not started yet, and that what is written after that never plays.
+
+#include <cmath>
+#include <vector>
+
+#include "check.h"
+#include "streamsource.h"
+
+namespace {
+constexpr uint32_t BlockFrames = 480;
+const StreamFormat format = {SampleFormat::Int16, 1, 48000};
+
+// Writes frames of a full scale square wave, so that the fade is audible in
+// every frame.
+void write(StreamSource *stream, uint32_t frames) {
+  std::vector<int16_t> samples(frames);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    samples[i] = (i / 24) % 2 == 0 ? 16000 : -16000;
+  }
+
+  CHECK(stream->Write(reinterpret_cast<const char *>(samples.data()),
+                      frames * 2) == frames * 2);
+}
+
+// Renders blocks until the stream completes and returns how many it took,
+// or -1 when it does not complete within limit blocks.
+int renderUntilDone(StreamSource *stream, uint64_t *position, int limit,
+                    float *peak = nullptr) {
+  float block[BlockFrames * 2];
+
+  for (int n = 1; n <= limit; n++) {
+    int32_t done = stream->Render(block, *position, BlockFrames, 2);
+
+    for (uint32_t i = 0; peak != nullptr && i < BlockFrames * 2; i++) {
+      *peak = std::fmax(*peak, std::fabs(block[i]));
+    }
+
+    *position += BlockFrames;
+
+    if (done == 1) {
+      return n;
+    }
+  }
+
+  return -1;
+}
+
+void testStopWhileStarved() {
+  StreamSource stream(65536);
+  uint64_t position{0};
+  float block[BlockFrames * 2];
+
+  stream.SetTargetSamplesPerSec(48000);
+  CHECK(stream.Begin(format));
+  write(&stream, BlockFrames * 10);
+
+  // The producer falls behind and never ends the stream.
+  for (int i = 0; i < 24; i++) {
+    CHECK(stream.Render(block, position, BlockFrames, 2) == 0);
+    position += BlockFrames;
+  }
+
+  CHECK(stream.GetUnderrunCount() >= 12);
+  CHECK(!stream.IsIdle());
+
+  stream.Stop();
+
+  float peak{0.0f};
+
+  // The fade is 5 ms, shorter than a block.
+  CHECK(renderUntilDone(&stream, &position, 1000, &peak) == 1);
+  CHECK(stream.IsIdle());
+  // It fades out from the held frame rather than jumping.
+  CHECK(peak > 0.0f && peak <= 16000.0f / 32768.0f + 0.01f);
+  CHECK(stream.GetEndFrame() <= position);
+
+  // The voice bus is usable again.
+  CHECK(stream.Begin(format, position));
+  write(&stream, BlockFrames);
+  stream.End();
+  CHECK(renderUntilDone(&stream, &position, 10) > 0);
+  CHECK(stream.IsIdle());
+}
+
+void testStopBeforeAnyData() {
+  StreamSource stream(65536);
+  uint64_t position{0};
+
+  stream.SetTargetSamplesPerSec(48000);
+  CHECK(stream.Begin(format));
+  stream.Stop();
+
+  float peak{0.0f};
+
+  CHECK(renderUntilDone(&stream, &position, 10, &peak) == 1);
+  CHECK(peak == 0.0f);
+  CHECK(stream.IsIdle());
+}
+
+void testStopWhilePlaying() {
+  StreamSource stream(65536);
+  uint64_t position{0};
+  float block[BlockFrames * 2];
+
+  stream.SetTargetSamplesPerSec(48000);
+  CHECK(stream.Begin(format));
+  write(&stream, BlockFrames * 20);
+  CHECK(stream.Render(block, position, BlockFrames, 2) == 0);
+  position += BlockFrames;
+
+  stream.Stop();
+
+  CHECK(renderUntilDone(&stream, &position, 10) == 1);
+  CHECK(stream.IsIdle());
+  // What was queued is discarded.
+  CHECK(stream.GetWritableBytes() == 65536);
+}
+
+// The producer keeps writing after the stream it was feeding was stopped
+// and completed. None of it plays in the next stream.
+void testWriteAfterStop() {
+  StreamSource stream(65536);
+  uint64_t position{0};
+  float block[BlockFrames * 2];
+
+  stream.SetTargetSamplesPerSec(48000);
+  CHECK(stream.Begin(format));
+  write(&stream, BlockFrames * 4);
+  CHECK(stream.Render(block, position, BlockFrames, 2) == 0);
+  position += BlockFrames;
+
+  stream.Stop();
+  CHECK(renderUntilDone(&stream, &position, 10) == 1);
+  write(&stream, BlockFrames * 4);
+
+  float peak{0.0f};
+
+  CHECK(stream.Begin(format, position));
+  CHECK(stream.GetWritableBytes() == 65536);
+  stream.End();
+  CHECK(renderUntilDone(&stream, &position, 10, &peak) == 1);
+  CHECK(peak == 0.0f);
+}
+
+void testStopBeforeStart() {
+  StreamSource stream(65536);
+  uint64_t position{0};
+
+  stream.SetTargetSamplesPerSec(48000);
+  CHECK(stream.Begin(format, 48000));
+  write(&stream, BlockFrames);
+  stream.Stop();
+
+  float peak{0.0f};
+
+  CHECK(renderUntilDone(&stream, &position, 10, &peak) == 1);
+  CHECK(peak == 0.0f);
+  CHECK(stream.IsIdle());
+}
+} // namespace
+
+int main() {
+  testStopWhileStarved();
+  testStopBeforeAnyData();
+  testStopWhilePlaying();
+  testWriteAfterStop();
+  testStopBeforeStart();
+
+  return TestResult();
+}
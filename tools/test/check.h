@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+
+// Checks for the tools/*_test programs. A failed CHECK prints its location
+// and is counted, and the test goes on, so that one run shows every failure.
+// Tests that compare whole tables print their own message and add to
+// failures instead.
+inline int failures{0};
+
+#define CHECK(cond)                                                           \
+  do {                                                                        \
+    if (!(cond)) {                                                            \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                   #cond);                                                    \
+      failures += 1;                                                          \
+    }                                                                         \
+  } while (0)
+
+// Returns the exit status of a test: 0, after printing "ok", if no check
+// failed.
+inline int TestResult() {
+  if (failures > 0) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  std::printf("ok\n");
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+// Checks that TextArena wraps strings around its slab without splitting
+// them, refuses text when it is full, grows while old text is held, and
+// reclaims released text in allocation order whatever order it is released
+// in.
+
+#include <cwchar>
+#include <string>
+
+#include "check.h"
+#include "textarena.h"
+
+namespace {
+bool allocate(TextArena *arena, const std::wstring &text, TextSpan *span) {
+  return arena->Allocate(text.c_str(), static_cast<uint32_t>(text.size()),
+                         span);
+}
+
+bool isText(const TextArena &arena, const TextSpan &span,
+            const std::wstring &text) {
+  return span.Length == text.size() && arena.Resolve(span) == text;
+}
+
+// Strings of 5 characters and a terminator take turns in a slab of 16. The
+// third of each round does not fit before the end and starts over at the
+// beginning of the slab.
+void testWrap() {
+  TextArena arena(16, 16, 4);
+  TextSpan previous;
+
+  CHECK(allocate(&arena, L"start", &previous));
+
+  for (int i = 0; i < 20; i++) {
+    std::wstring text = L"w" + std::to_wstring(1000 + i);
+    TextSpan span;
+
+    CHECK(allocate(&arena, text, &span));
+    CHECK(isText(arena, span, text));
+    CHECK(isText(arena, previous, L"start") ||
+          arena.Resolve(previous)[0] == L'w');
+    CHECK(span.Position % 16 + 6 <= 16);
+    CHECK(span.Id == static_cast<uint64_t>(i + 1));
+
+    arena.Release(previous);
+    previous = span;
+  }
+
+  CHECK(arena.GetCapacity() == 16);
+  CHECK(arena.GetHighWatermark() <= 16);
+}
+
+void testFull() {
+  TextArena arena(16, 16, 8);
+  TextSpan a;
+  TextSpan b;
+  TextSpan c;
+
+  CHECK(allocate(&arena, L"abcdef", &a));
+  CHECK(allocate(&arena, L"ghijkl", &b));
+  CHECK(!allocate(&arena, L"mnopqr", &c));
+  // The two characters left still take a shorter string.
+  CHECK(allocate(&arena, L"m", &c));
+  CHECK(!allocate(&arena, L"", &c));
+  // Longer than the slab.
+  CHECK(!allocate(&arena, std::wstring(16, L'x'), &c));
+
+  arena.Release(a);
+
+  CHECK(allocate(&arena, L"stuvwx", &c));
+  CHECK(isText(arena, b, L"ghijkl"));
+  CHECK(isText(arena, c, L"stuvwx"));
+
+  // Out of records before the slab is full.
+  TextArena few(64, 64, 2);
+
+  CHECK(allocate(&few, L"a", &a));
+  CHECK(allocate(&few, L"b", &b));
+  CHECK(!allocate(&few, L"c", &c));
+  few.Release(a);
+  CHECK(allocate(&few, L"c", &c));
+}
+
+// The slab doubles while text in the old one is held, and the old text stays
+// where it was.
+void testGrow() {
+  TextArena arena(8, 32, 8);
+  TextSpan a;
+  TextSpan b;
+  TextSpan c;
+
+  CHECK(allocate(&arena, L"first", &a));
+  CHECK(allocate(&arena, L"second", &b));
+  CHECK(arena.GetCapacity() == 16);
+  CHECK(allocate(&arena, L"third one", &c));
+  CHECK(arena.GetCapacity() == 32);
+  CHECK(isText(arena, a, L"first"));
+  CHECK(isText(arena, b, L"second"));
+  CHECK(isText(arena, c, L"third one"));
+
+  // No larger slab than the limit.
+  TextSpan d;
+
+  CHECK(!allocate(&arena, std::wstring(25, L'y'), &d));
+  CHECK(arena.GetCapacity() == 32);
+
+  // The old slabs are freed once their text is released, and c stays.
+  arena.Release(a);
+  arena.Release(b);
+
+  CHECK(allocate(&arena, std::wstring(20, L'y'), &d));
+  CHECK(isText(arena, c, L"third one"));
+  CHECK(isText(arena, d, std::wstring(20, L'y')));
+}
+
+// Text released out of order is reclaimed once everything before it is
+// released too.
+void testReleaseOrder() {
+  TextArena arena(16, 16, 8);
+  TextSpan a;
+  TextSpan b;
+  TextSpan c;
+  TextSpan d;
+
+  CHECK(allocate(&arena, L"aaaa", &a));
+  CHECK(allocate(&arena, L"bbbb", &b));
+  CHECK(allocate(&arena, L"cccc", &c));
+
+  arena.Release(b);
+  arena.Release(c);
+
+  // Only the last character is free while a is held.
+  CHECK(!allocate(&arena, L"dddd", &d));
+  CHECK(isText(arena, a, L"aaaa"));
+
+  arena.Release(a);
+
+  CHECK(allocate(&arena, L"dddd", &d));
+  CHECK(allocate(&arena, L"eeeeeeeee", &a));
+  CHECK(isText(arena, d, L"dddd"));
+  CHECK(isText(arena, a, L"eeeeeeeee"));
+}
+} // namespace
+
+int main() {
+  testWrap();
+  testFull();
+  testGrow();
+  testReleaseOrder();
+
+  return TestResult();
+}
@@ -0,0 +1,196 @@
+// Runs TimeStretch over a fixed signal: how long the output is at each tempo,
+// that a tempo of 1 gives the input back, that End drains what is buffered,
+// and that nothing is allocated after construction.
+
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "check.h"
+#include "timestretch.h"
+
+namespace {
+int allocations{0};
+} // namespace
+
+void *operator new(size_t size) {
+  allocations += 1;
+
+  if (void *p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t size) noexcept { std::free(p); }
+
+namespace {
+constexpr uint32_t SamplesPerSec = 48000;
+// A window is two hops of 12 ms.
+constexpr uint32_t WindowFrames = 1152;
+
+void signal(uint32_t i, float *frame) {
+  frame[0] = static_cast<float>(0.5 * std::sin(i * 0.031));
+  frame[1] = static_cast<float>(0.25 * std::cos(i * 0.017));
+}
+
+// Writes count frames, reading the output as it comes, then ends the input
+// and reads the rest. Returns the output, or stops at the first Write that
+// fails.
+std::vector<float> run(TimeStretch *stretch, uint32_t count) {
+  std::vector<float> output;
+  float frame[2];
+
+  for (uint32_t i = 0; i < count; i++) {
+    signal(i, frame);
+    CHECK(stretch->Write(frame));
+
+    while (stretch->Read(frame)) {
+      output.push_back(frame[0]);
+      output.push_back(frame[1]);
+    }
+  }
+
+  stretch->End();
+
+  while (stretch->Read(frame)) {
+    output.push_back(frame[0]);
+    output.push_back(frame[1]);
+  }
+
+  return output;
+}
+
+void testLength() {
+  const double tempos[] = {0.25, 0.5, 0.8, 1.0, 1.5, 2.0, 4.0, 12.0};
+  constexpr uint32_t Frames = 48000;
+  TimeStretch stretch(SamplesPerSec);
+
+  for (double tempo : tempos) {
+    stretch.Reset(SamplesPerSec);
+    stretch.SetTempo(tempo);
+
+    std::vector<float> output = run(&stretch, Frames);
+    double expected = Frames / tempo;
+
+    CHECK(std::fabs(output.size() / 2 - expected) <= 1.0);
+    CHECK(stretch.IsDrained());
+  }
+
+  // Tempos out of range are clamped.
+  stretch.Reset(SamplesPerSec);
+  stretch.SetTempo(100.0);
+  CHECK(run(&stretch, Frames).size() / 2 == 4000);
+}
+
+// The windows are taken where the ones before end, so the input comes back
+// up to rounding, frame for frame and without a delay in the output.
+void testTempoOne() {
+  constexpr uint32_t Frames = 10000;
+  TimeStretch stretch(SamplesPerSec);
+  float frame[2];
+
+  stretch.Reset(SamplesPerSec);
+
+  // Nothing comes out until a window is buffered.
+  for (uint32_t i = 0; i < WindowFrames - 1; i++) {
+    signal(i, frame);
+    CHECK(stretch.Write(frame));
+    CHECK(!stretch.Read(frame));
+  }
+
+  stretch.Reset(SamplesPerSec);
+
+  std::vector<float> output = run(&stretch, Frames);
+  float error{0.0f};
+
+  CHECK(output.size() == Frames * 2);
+
+  for (uint32_t i = 0; i < output.size() / 2 && i < Frames; i++) {
+    signal(i, frame);
+    error = std::fmax(error, std::fabs(output[i * 2] - frame[0]));
+    error = std::fmax(error, std::fabs(output[i * 2 + 1] - frame[1]));
+  }
+
+  CHECK(error < 1e-6f);
+}
+
+// End lets out input that is shorter than a window, and nothing is read
+// once the stretcher is drained.
+void testEnd() {
+  TimeStretch stretch(SamplesPerSec);
+  float frame[2];
+
+  stretch.Reset(SamplesPerSec);
+  stretch.End();
+  CHECK(!stretch.Read(frame));
+  CHECK(stretch.IsDrained());
+
+  stretch.Reset(SamplesPerSec);
+  CHECK(!stretch.IsDrained());
+
+  for (uint32_t i = 0; i < 100; i++) {
+    signal(i, frame);
+    CHECK(stretch.Write(frame));
+  }
+
+  CHECK(!stretch.Read(frame));
+  stretch.End();
+
+  uint32_t frames{0};
+
+  while (stretch.Read(frame)) {
+    frames += 1;
+  }
+
+  CHECK(frames == 100);
+  CHECK(stretch.IsDrained());
+  CHECK(!stretch.Read(frame));
+
+  // At half speed the short input takes twice as long.
+  stretch.Reset(SamplesPerSec);
+  stretch.SetTempo(0.5);
+  CHECK(run(&stretch, 100).size() / 2 == 200);
+}
+
+// Reset, a new rate and every tempo reuse the buffers from construction.
+void testNoAllocation() {
+  TimeStretch stretch(SamplesPerSec);
+  const double tempos[] = {0.25, 1.0, 3.0, 12.0};
+  int before = allocations;
+  float frame[2];
+
+  for (double tempo : tempos) {
+    stretch.Reset(22050);
+    stretch.SetTempo(tempo);
+
+    for (uint32_t i = 0; i < 20000; i++) {
+      signal(i, frame);
+      CHECK(stretch.Write(frame));
+
+      while (stretch.Read(frame)) {
+      }
+    }
+
+    stretch.End();
+
+    while (stretch.Read(frame)) {
+    }
+  }
+
+  CHECK(allocations == before);
+}
+} // namespace
+
+int main() {
+  testLength();
+  testTempoOne();
+  testEnd();
+  testNoAllocation();
+
+  return TestResult();
+}
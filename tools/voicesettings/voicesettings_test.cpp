@@ -0,0 +1,144 @@
+// Checks that VoiceSettingsStore writers finish while readers hold tables
+// back to back, and that a held table never changes under its reader.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "voicesettings.h"
+
+namespace {
+constexpr uint32_t Voices = 4;
+
+void testWrites() {
+  VoiceProsody voices[Voices]{};
+
+  voices[2].SpeakingRate = 1.5;
+
+  VoiceSettingsStore store(Voices, 2, voices);
+  const VoiceTable *first = store.Acquire();
+
+  CHECK(first->Version == 1);
+  CHECK(first->DefaultVoiceIndex == 2);
+  CHECK(first->Voices[2].SpeakingRate == 1.5);
+
+  // Writers do not wait for a table that is held.
+  CHECK(store.SetDefaultVoice(1));
+  CHECK(store.SetAudioPitch(1, 0.5));
+  CHECK(!store.SetAudioVolume(Voices, 0.5));
+  CHECK(store.GetVersion() == 3);
+  CHECK(first->Version == 1 && first->DefaultVoiceIndex == 2);
+
+  const VoiceTable *table = store.Acquire();
+
+  CHECK(table != first);
+  CHECK(table->DefaultVoiceIndex == 1);
+  CHECK(table->Voices[1].AudioPitch == 0.5);
+  CHECK(table->Voices[2].SpeakingRate == 1.5);
+
+  store.Release(table);
+  store.Release(first);
+}
+
+// Readers overlap, so at every moment some table is held. The writer sets
+// all of a voice's values to the same number in turn, and readers check that
+// a table they hold is consistent and stays the same.
+void testContinuousReaders() {
+  constexpr int Readers = 4;
+  constexpr uint32_t Writes = 20000;
+  VoiceSettingsStore store(Voices, 0, nullptr);
+  std::atomic<bool> isDone{false};
+  std::atomic<bool> isTorn{false};
+  std::atomic<bool> isBackwards{false};
+  std::vector<std::thread> readers;
+
+  // Keeps the readers overlapping from the start.
+  const VoiceTable *held = store.Acquire();
+
+  for (int i = 0; i < Readers; i++) {
+    readers.emplace_back([&]() {
+      uint64_t last{0};
+
+      while (!isDone.load()) {
+        const VoiceTable *table = store.Acquire();
+        uint64_t version = table->Version;
+        double rate = table->Voices[0].SpeakingRate;
+
+        if (version < last) {
+          isBackwards = true;
+        }
+        if (table->Voices[0].AudioPitch != rate ||
+            table->Voices[0].AudioVolume != rate) {
+          // Only the two tables between the three writes of a value may
+          // differ.
+          if (version % 3 == 1) {
+            isTorn = true;
+          }
+        }
+
+        std::this_thread::yield();
+
+        if (table->Version != version ||
+            table->Voices[0].SpeakingRate != rate) {
+          isTorn = true;
+        }
+
+        last = version;
+        store.Release(table);
+      }
+    });
+  }
+
+  std::thread writer([&]() {
+    for (uint32_t i = 0; i < Writes; i++) {
+      double value = 1.0 + i;
+
+      store.SetSpeakingRate(0, value);
+      store.SetAudioPitch(0, value);
+      store.SetAudioVolume(0, value);
+    }
+
+    isDone = true;
+  });
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+  while (!isDone.load() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (!isDone.load()) {
+    std::fprintf(stderr, "writer starved by readers\n");
+    std::_Exit(1);
+  }
+
+  writer.join();
+
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+
+  store.Release(held);
+
+  CHECK(!isTorn);
+  CHECK(!isBackwards);
+  CHECK(store.GetVersion() == 1 + 3 * Writes);
+
+  const VoiceTable *table = store.Acquire();
+
+  CHECK(table->Voices[0].SpeakingRate == Writes);
+  CHECK(table->Voices[0].AudioVolume == Writes);
+
+  store.Release(table);
+}
+} // namespace
+
+int main() {
+  testWrites();
+  testContinuousReaders();
+
+  return TestResult();
+}
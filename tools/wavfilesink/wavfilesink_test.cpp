@@ -0,0 +1,205 @@
+// Renders a fixed source through Renderer into WavFileSink and NullSink, and
+// checks the header fields and every sample byte of the files written.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+#include "check.h"
+#include "headlessdriver.h"
+#include "nullsink.h"
+#include "wavfilesink.h"
+
+namespace {
+constexpr uint32_t PeriodFrames = 480;
+
+// Sample c of frame i is a multiple of 2^-8, so it converts exactly to every
+// format.
+float value(uint64_t i, uint16_t c) {
+  return static_cast<float>(static_cast<int32_t>((i * 7 + c * 13) % 256) -
+                            128) /
+         256.0f;
+}
+
+class FixedSource : public MixerSource {
+public:
+  void SetTargetSamplesPerSec(uint32_t samplesPerSec) override {}
+
+  int32_t Render(float *dst, uint64_t position, uint32_t frames,
+                 uint16_t channels) override {
+    for (uint32_t f = 0; f < frames; f++) {
+      for (uint16_t c = 0; c < channels; c++) {
+        *dst++ = value(position + f, c);
+      }
+    }
+
+    return 0;
+  }
+};
+
+uint32_t getUint32(const std::string &s, size_t offset) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(s.data()) + offset;
+
+  return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint16_t getUint16(const std::string &s, size_t offset) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(s.data()) + offset;
+
+  return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+// Returns the bytes the sink should hold for sample c of frame i.
+std::string expectedBytes(SampleFormat format, uint64_t i, uint16_t c) {
+  float v = value(i, c);
+  int32_t s{0};
+  char bytes[4];
+
+  switch (format) {
+  case SampleFormat::Int16:
+    s = static_cast<int32_t>(v * 32768.0f);
+    return std::string{static_cast<char>(s & 0xFF),
+                       static_cast<char>((s >> 8) & 0xFF)};
+  case SampleFormat::Int24:
+    s = static_cast<int32_t>(v * 8388608.0f);
+    return std::string{static_cast<char>(s & 0xFF),
+                       static_cast<char>((s >> 8) & 0xFF),
+                       static_cast<char>((s >> 16) & 0xFF)};
+  default:
+    std::memcpy(bytes, &v, 4);
+    return std::string(bytes, 4);
+  }
+}
+
+struct WaveCase {
+  SampleFormat Format;
+  uint16_t Channels;
+  uint16_t Tag;
+  uint16_t Bits;
+};
+
+void testWavFileSink(const std::string &dir) {
+  const WaveCase cases[] = {
+      {SampleFormat::Int16, 2, 1, 16},
+      {SampleFormat::Int24, 1, 1, 24},
+      {SampleFormat::Float32, 6, 3, 32},
+  };
+
+  for (const WaveCase &c : cases) {
+    std::string path = dir + "/out.wav";
+    StreamFormat format{c.Format, c.Channels, 44100};
+    uint32_t blockAlign = c.Channels * c.Bits / 8;
+    FixedSource source;
+    Mixer mixer;
+    Renderer renderer(&mixer);
+    WavFileSink sink(format, PeriodFrames);
+    uint8_t *data{nullptr};
+
+    CHECK(!sink.GetBuffer(PeriodFrames, &data));
+    CHECK(mixer.AddBus(&source, 1.0f) == 0);
+    CHECK(renderer.Open(format, PeriodFrames));
+    CHECK(sink.Open(path.c_str()));
+    CHECK(!sink.Open(path.c_str()));
+    CHECK(!sink.GetBuffer(PeriodFrames + 1, &data));
+
+    // Rendering goes on in whole periods.
+    HeadlessDriver driver(&renderer, &sink, PeriodFrames, false);
+
+    CHECK(driver.Run(1000));
+    CHECK(sink.GetFramesWritten() == 3 * PeriodFrames);
+    CHECK(sink.Close());
+    CHECK(sink.Close());
+
+    std::string wave = readFile(path);
+    uint32_t dataSize = 3 * PeriodFrames * blockAlign;
+
+    CHECK(wave.size() == 44 + dataSize);
+
+    if (wave.size() != 44 + dataSize) {
+      continue;
+    }
+
+    CHECK(wave.compare(0, 4, "RIFF") == 0);
+    CHECK(getUint32(wave, 4) == 36 + dataSize);
+    CHECK(wave.compare(8, 8, "WAVEfmt ") == 0);
+    CHECK(getUint32(wave, 16) == 16);
+    CHECK(getUint16(wave, 20) == c.Tag);
+    CHECK(getUint16(wave, 22) == c.Channels);
+    CHECK(getUint32(wave, 24) == 44100);
+    CHECK(getUint32(wave, 28) == 44100 * blockAlign);
+    CHECK(getUint16(wave, 32) == blockAlign);
+    CHECK(getUint16(wave, 34) == c.Bits);
+    CHECK(wave.compare(36, 4, "data") == 0);
+    CHECK(getUint32(wave, 40) == dataSize);
+
+    size_t offset{44};
+    uint32_t mismatches{0};
+
+    for (uint64_t i = 0; i < 3 * PeriodFrames; i++) {
+      for (uint16_t ch = 0; ch < c.Channels; ch++) {
+        std::string bytes = expectedBytes(c.Format, i, ch);
+
+        if (wave.compare(offset, bytes.size(), bytes) != 0) {
+          mismatches += 1;
+        }
+
+        offset += bytes.size();
+      }
+    }
+
+    CHECK(mismatches == 0);
+
+    std::remove(path.c_str());
+  }
+}
+
+void testNullSink() {
+  StreamFormat format{SampleFormat::Int32, 2, 48000};
+  FixedSource source;
+  Mixer mixer;
+  Renderer renderer(&mixer);
+  NullSink sink(format, PeriodFrames);
+  uint32_t frames{0};
+  uint8_t *data{nullptr};
+
+  CHECK(sink.GetAvailableFrames(&frames) && frames == PeriodFrames);
+  CHECK(!sink.GetBuffer(PeriodFrames + 1, &data));
+  CHECK(!sink.ReleaseBuffer(PeriodFrames + 1));
+  CHECK(mixer.AddBus(&source, 1.0f) == 0);
+  CHECK(renderer.Open(format, PeriodFrames));
+
+  HeadlessDriver driver(&renderer, &sink, PeriodFrames, false);
+
+  CHECK(driver.Run(4 * PeriodFrames));
+  CHECK(sink.GetFramesWritten() == 4 * PeriodFrames);
+  CHECK(driver.GetFramesRendered() == 4 * PeriodFrames);
+  CHECK(mixer.GetPosition() == 4 * PeriodFrames);
+}
+} // namespace
+
+int main() {
+  char directory[] = "/tmp/wavfilesink_testXXXXXX";
+
+  if (mkdtemp(directory) == nullptr) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+
+  testWavFileSink(directory);
+  testNullSink();
+
+  rmdir(directory);
+
+  return TestResult();
+}